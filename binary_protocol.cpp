@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <climits>
+#include "binary_protocol.hpp"
+#include "byte_order.hpp"
+
+namespace binary_protocol
+{
+
+namespace
+{
+
+using utils::get_le;
+using utils::put_le;
+
+bool to_int(std::uint64_t value, int& i)
+{
+    if (value > static_cast<std::uint64_t>(INT_MAX)) return false;
+    i = static_cast<int>(value);
+    return true;
+}
+
+} // anonymous namespace
+
+size_t message_size(std::uint8_t type)
+{
+    switch (type)
+    {
+    case new_order: return new_order_size;
+    case cancel_order: return cancel_order_size;
+    case replenish_order: return replenish_order_size;
+    case modify_order: return modify_order_size;
+    default: return 0;
+    }
+}
+
+size_t encode(const exchange::Request& r, std::span<std::byte> out)
+{
+    std::uint8_t type;
+    switch (r.type)
+    {
+    case exchange::new_request: type = new_order; break;
+    case exchange::cancel_request: type = cancel_order; break;
+    case exchange::replenish_request: type = replenish_order; break;
+    case exchange::modify_request: type = modify_order; break;
+    default: return 0;
+    }
+
+    const size_t size = message_size(type);
+    if (out.size() < size || r.order_id < 0 || r.quantity < 0 || r.hidden_quantity < 0) return 0;
+    const bool has_symbol = type == new_order || type == modify_order;
+    if (has_symbol && r.symbol_id < 0) return 0;
+
+    std::byte* p = out.data();
+    std::fill(p, p + size, std::byte{0});
+    put_le<std::uint8_t>(p, type);
+    if (has_symbol)
+    {
+        put_le<std::uint8_t>(p + 1, r.side == order::order_side::bid ? 0 : 1);
+        put_le<std::uint8_t>(p + 2, static_cast<std::uint8_t>(r.tif));
+        put_le<std::uint8_t>(p + 3, static_cast<std::uint8_t>(r.order_type));
+    }
+    put_le<std::int32_t>(p + 4, r.time);
+    put_le<std::uint64_t>(p + 8, static_cast<std::uint64_t>(r.order_id));
+
+    switch (type)
+    {
+    case new_order:
+        put_le<std::uint32_t>(p + 16, static_cast<std::uint32_t>(r.symbol_id));
+        put_le<std::uint32_t>(p + 20, static_cast<std::uint32_t>(r.quantity));
+        put_le<std::int64_t>(p + 24, r.limit_price.unscaled());
+        put_le<std::uint32_t>(p + 32, static_cast<std::uint32_t>(r.hidden_quantity));
+        break;
+
+    case replenish_order:
+        put_le<std::uint32_t>(p + 16, static_cast<std::uint32_t>(r.quantity));
+        break;
+
+    case modify_order:
+        put_le<std::uint32_t>(p + 16, static_cast<std::uint32_t>(r.symbol_id));
+        put_le<std::uint32_t>(p + 20, static_cast<std::uint32_t>(r.quantity));
+        put_le<std::int64_t>(p + 24, r.limit_price.unscaled());
+        break;
+    }
+    return size;
+}
+
+size_t decode(std::span<const std::byte> in, exchange::Request& r)
+{
+    r = exchange::Request();
+    if (in.size() < header_size) return 0;
+
+    const std::byte* p = in.data();
+    const std::uint8_t type = get_le<std::uint8_t>(p);
+    const size_t size = message_size(type);
+    if (size == 0 || in.size() < size) return 0;
+
+    const std::uint8_t side = get_le<std::uint8_t>(p + 1);
+    const std::uint8_t tif = get_le<std::uint8_t>(p + 2);
+    const std::uint8_t order_type = get_le<std::uint8_t>(p + 3);
+    r.time = get_le<std::int32_t>(p + 4);
+    if (!to_int(get_le<std::uint64_t>(p + 8), r.order_id)) return 0;
+
+    switch (type)
+    {
+    case new_order:
+    case modify_order:
+    {
+        if (side > 1 || tif > order::time_in_force::good_till_cancel) return 0;
+        r.side = side == 0 ? order::order_side::bid : order::order_side::ask;
+        r.tif = static_cast<order::time_in_force>(tif);
+        if (!to_int(get_le<std::uint32_t>(p + 16), r.symbol_id) ||
+            !to_int(get_le<std::uint32_t>(p + 20), r.quantity))
+        {
+            return 0;
+        }
+        r.limit_price = utils::Price4(static_cast<long>(get_le<std::int64_t>(p + 24)));
+
+        if (type == modify_order)
+        {
+            r.type = exchange::modify_request;
+            r.order_type = order::order_type::limit;
+            break;
+        }
+        if (order_type > order::order_type::iceberg) return 0;
+        r.type = exchange::new_request;
+        r.order_type = static_cast<order::order_type>(order_type);
+        if (r.order_type == order::order_type::iceberg &&
+            !to_int(get_le<std::uint32_t>(p + 32), r.hidden_quantity))
+        {
+            return 0;
+        }
+        break;
+    }
+
+    case cancel_order:
+        r.type = exchange::cancel_request;
+        break;
+
+    case replenish_order:
+        r.type = exchange::replenish_request;
+        if (!to_int(get_le<std::uint32_t>(p + 16), r.quantity)) return 0;
+        break;
+    }
+    return size;
+}
+
+} // namespace binary_protocol
@@ -0,0 +1,56 @@
+#ifndef BINARY_PROTOCOL_HPP_
+#define BINARY_PROTOCOL_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include "request.hpp"
+
+// Fixed-width binary order entry protocol. Every message is little-endian and starts with an 8 byte
+// header; the message type fixes the size of the rest.
+//
+//   header      0  u8   message type ('N', 'X', 'R' or 'M')
+//               1  u8   side (0 buy, 1 sell)
+//               2  u8   tif (0 day, 1 immediate_or_cancel, 2 good_till_cancel)
+//               3  u8   order type (0 market, 1 limit, 2 iceberg)
+//               4  i32  time
+//   new         8  u64  order id       16  u32  symbol id     20  u32  quantity (displayed for iceberg)
+//              24  i64  price          32  u32  hidden quantity                       36  u32  reserved
+//   cancel      8  u64  order id
+//   replenish   8  u64  order id       16  u32  quantity                              20  u32  reserved
+//   modify      8  u64  order id       16  u32  symbol id     20  u32  quantity       24  i64  price
+//
+// Prices are Price4 unscaled units, symbols are ids interned from the symbols config in order. Fields
+// that do not apply to a message (e.g. side of a cancel) are sent as 0.
+namespace binary_protocol
+{
+
+enum message_type : std::uint8_t
+{
+    new_order = 'N',
+    cancel_order = 'X',
+    replenish_order = 'R',
+    modify_order = 'M'
+};
+
+constexpr size_t header_size = 8;
+constexpr size_t new_order_size = 40;
+constexpr size_t cancel_order_size = 16;
+constexpr size_t replenish_order_size = 24;
+constexpr size_t modify_order_size = 32;
+constexpr size_t max_message_size = new_order_size;
+
+// size of a message of the given type, 0 if the type is unknown
+size_t message_size(std::uint8_t type);
+
+// Writes r to the front of out - returns the bytes written, 0 if out is too small or r cannot be sent,
+// i.e. unknown type, negative order id or quantity, or symbol id not resolved.
+size_t encode(const exchange::Request& r, std::span<std::byte> out);
+
+// Reads the message at the front of in into r - returns the bytes consumed, 0 if in is truncated or
+// the message is malformed. Engine order ids are int, so larger 64-bit ids are refused.
+size_t decode(std::span<const std::byte> in, exchange::Request& r);
+
+} // namespace binary_protocol
+
+#endif
@@ -0,0 +1,163 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "book_region.hpp"
+#include "order_record.hpp"
+
+namespace exchange
+{
+
+namespace
+{
+
+constexpr std::uint32_t magic = 0x42525845; // "EXRB"
+constexpr std::uint32_t version = 1;
+constexpr size_t header_size = 64;
+constexpr size_t symbol_size = 32;
+constexpr size_t max_symbol_length = 16;
+constexpr size_t page_size = 4096;
+
+// FNV-1a
+std::uint32_t checksum(const std::byte* p, size_t size, std::uint32_t hash = 2166136261u)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ std::to_integer<std::uint32_t>(p[i])) * 16777619u;
+    }
+    return hash;
+}
+
+} // anonymous namespace
+
+BookRegion::BookRegion(
+    const BookRegionOptions& options,
+    const ticker_rules::TickerRulesCPtr& ticker_rules,
+    const book_rules::BookRulesCPtr& book_rules
+)
+:
+orders_per_book_(options.orders_per_book)
+{
+    if (options.path.empty() || !ticker_rules)
+    {
+        throw std::runtime_error("A book region needs a path and listed symbols.");
+    }
+    if (orders_per_book_ == 0 || orders_per_book_ > (size_t(1) << 31))
+    {
+        throw std::runtime_error("A book region holds between 1 and 2^31 orders per book.");
+    }
+
+    // the static part of the region as this configuration lays it out
+    const size_t number_of_symbols = ticker_rules->number_of_symbols();
+    const size_t number_of_books = 2 * number_of_symbols;
+    std::string layout(header_size + number_of_symbols * symbol_size, '\0');
+    std::byte* p = reinterpret_cast<std::byte*>(layout.data());
+    Header& header = *reinterpret_cast<Header*>(p);
+    header.magic = magic;
+    header.version = version;
+    header.number_of_symbols = static_cast<std::uint32_t>(number_of_symbols);
+    header.record_size = static_cast<std::uint32_t>(order::OrderRecordPool::slot_size);
+    header.orders_per_book = orders_per_book_;
+    for (size_t id = 0; id < number_of_symbols; ++id)
+    {
+        const std::string& symbol = ticker_rules->symbol(static_cast<int>(id));
+        if (symbol.size() > max_symbol_length)
+        {
+            throw std::runtime_error("Symbol " + symbol + " is too long for a book region.");
+        }
+        std::byte* entry = p + header_size + id * symbol_size;
+        std::memcpy(entry, symbol.data(), symbol.size());
+        entry[16] = static_cast<std::byte>(symbol.size());
+        entry[17] = static_cast<std::byte>(book_rules ? book_rules->book_type(symbol) : order::order_book_type::heap);
+    }
+    header.checksum = checksum(p, offsetof(Header, checksum),
+        checksum(p + header_size, number_of_symbols * symbol_size));
+
+    cursors_offset_ = layout.size();
+    records_offset_ = (cursors_offset_ + number_of_books * sizeof(utils::PoolCursor) + page_size - 1) /
+        page_size * page_size;
+    size_ = records_offset_ + number_of_books * orders_per_book_ * order::OrderRecordPool::slot_size;
+
+    fd_ = ::open(options.path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0)
+    {
+        throw std::runtime_error("Cannot open book region " + options.path + ": " + std::strerror(errno) + ".");
+    }
+    struct stat st;
+    ::fstat(fd_, &st);
+    const bool sized = static_cast<size_t>(st.st_size) == size_;
+    // sparse - pages are only taken once records are written to them
+    if (!sized && ::ftruncate(fd_, static_cast<off_t>(size_)) != 0)
+    {
+        ::close(fd_);
+        throw std::runtime_error("Cannot size book region " + options.path + ": " + std::strerror(errno) + ".");
+    }
+    void* mapped = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mapped == MAP_FAILED)
+    {
+        ::close(fd_);
+        throw std::runtime_error("Cannot map book region " + options.path + ": " + std::strerror(errno) + ".");
+    }
+    data_ = static_cast<std::byte*>(mapped);
+    header_ = reinterpret_cast<Header*>(data_);
+
+    // the checksum is compared along with the layout it covers
+    const bool valid = sized && std::memcmp(data_, p, offsetof(Header, reserved)) == 0 &&
+        std::memcmp(data_ + header_size, p + header_size, layout.size() - header_size) == 0 &&
+        header_->state <= matching_state;
+    if (!valid)
+    {
+        std::memcpy(data_, p, layout.size());
+        reset();
+    }
+}
+
+BookRegion::~BookRegion()
+{
+    if (data_)
+    {
+        ::munmap(data_, size_);
+    }
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+}
+
+void BookRegion::reset()
+{
+    header_->state = closed_state;
+    header_->requests = 0;
+    header_->market_data_sequence = 0;
+    for (std::uint32_t id = 0; id < 2 * header_->number_of_symbols; ++id)
+    {
+        *cursor(id) = utils::PoolCursor{order::OrderRecordPool::null_handle, 0};
+    }
+}
+
+std::byte* BookRegion::records(std::uint32_t book_id) const
+{
+    return data_ + records_offset_ + book_id * orders_per_book_ * order::OrderRecordPool::slot_size;
+}
+
+utils::PoolCursor* BookRegion::cursor(std::uint32_t book_id) const
+{
+    return reinterpret_cast<utils::PoolCursor*>(data_ + cursors_offset_) + book_id;
+}
+
+void BookRegion::open()
+{
+    header_->requests = 0;
+    header_->state = open_state;
+}
+
+void BookRegion::close()
+{
+    header_->state = closed_state;
+}
+
+} // namespace exchange
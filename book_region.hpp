@@ -0,0 +1,131 @@
+#ifndef BOOK_REGION_HPP_
+#define BOOK_REGION_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include "book_rules.hpp"
+#include "slab_pool.hpp"
+#include "ticker_rules.hpp"
+
+namespace exchange
+{
+
+class BookRegion;
+typedef std::unique_ptr<BookRegion> BookRegionPtr;
+typedef std::unique_ptr<const BookRegion> BookRegionCPtr;
+
+struct BookRegionOptions
+{
+    // file the books live in, e.g. /dev/shm/<name> for POSIX shared memory - empty keeps them in the
+    // process
+    std::string path;
+    // order records per book, the region never grows
+    size_t orders_per_book = 1 << 20;
+};
+
+template <typename BasicJsonType>
+void from_json(const BasicJsonType& j, BookRegionOptions& o)
+{
+    const BookRegionOptions defaults;
+    o.path = j.value("path", defaults.path);
+    o.orders_per_book = j.value("orders_per_book", defaults.orders_per_book);
+}
+
+// Order books resident in a file mapped shared, so an exchange restarted after a crash attaches to the
+// books it left instead of rebuilding them. Per book the region holds the slab of order records, which
+// name each other by handle and so stay valid at any address, and where the slab's free list stands;
+// levels and order ids are rebuilt from the records in one pass. Little-endian:
+//
+//   header      0  u32  magic 'EXRB'   4  u32  version    8  u32  number of symbols    12  u32  record size
+//              16  u64  orders per book                  24  u32  checksum of bytes 0-23 and the symbols
+//              32  u64  requests matched since the open  40  u64  next market data sequence
+//              48  u8   state
+//   symbols    64  char[16] symbol, u8 symbol length, u8 book type, 14 reserved - 32 bytes each
+//   cursors        PoolCursor of every book, 8 bytes each, by book id
+//   records        page aligned, orders per book records of every book, by book id
+//
+// A crash of the process loses nothing written to the mapping; a crash of the machine does - the
+// journal covers that. A region of another layout, symbols or book types is emptied.
+class BookRegion
+{
+public:
+    enum region_state : std::uint8_t
+    {
+        closed_state,
+        open_state,
+        // a request is half matched
+        matching_state
+    };
+
+    BookRegion(
+        const BookRegionOptions& options,
+        const ticker_rules::TickerRulesCPtr& ticker_rules,
+        const book_rules::BookRulesCPtr& book_rules
+    );
+    ~BookRegion();
+
+    BookRegion(const BookRegion&) = delete;
+    BookRegion& operator=(const BookRegion&) = delete;
+
+    // an open day left between two requests by an earlier process
+    bool resumable() const { return header_->state == open_state; }
+    // forgets the books left in the region
+    void reset();
+
+    size_t orders_per_book() const { return orders_per_book_; }
+    std::byte* records(std::uint32_t book_id) const;
+    utils::PoolCursor* cursor(std::uint32_t book_id) const;
+
+    void open();
+    void close();
+    // around every matched request, ordered with the book writes in between
+    void begin_request()
+    {
+        header_->state = matching_state;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    }
+    void end_request()
+    {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        ++header_->requests;
+        header_->state = open_state;
+    }
+    std::uint64_t requests() const { return header_->requests; }
+
+    // of the market data published for the matched requests, 0 if never set
+    std::uint64_t market_data_sequence() const { return header_->market_data_sequence; }
+    void set_market_data_sequence(std::uint64_t sequence) { header_->market_data_sequence = sequence; }
+
+private:
+    struct Header
+    {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint32_t number_of_symbols;
+        std::uint32_t record_size;
+        std::uint64_t orders_per_book;
+        std::uint32_t checksum;
+        std::uint32_t reserved;
+        std::uint64_t requests;
+        std::uint64_t market_data_sequence;
+        std::uint8_t state;
+        std::uint8_t reserved_state[15];
+    };
+    static_assert(sizeof(Header) == 64, "The region header is 64 bytes.");
+
+    int fd_ = -1;
+    std::byte* data_ = nullptr;
+    size_t size_ = 0;
+    Header* header_ = nullptr;
+    size_t orders_per_book_ = 0;
+    size_t cursors_offset_ = 0;
+    size_t records_offset_ = 0;
+};
+
+} // namespace exchange
+
+#endif
@@ -0,0 +1,21 @@
+#include "book_rules.hpp"
+
+namespace book_rules
+{
+
+BookRules::BookRules(
+    order::order_book_type default_type,
+    const std::unordered_map<std::string, order::order_book_type>& symbol_types
+)
+:
+default_type_(default_type),
+symbol_types_(symbol_types)
+{}
+
+order::order_book_type BookRules::book_type(const std::string& symbol) const
+{
+    const auto found = symbol_types_.find(symbol);
+    return found == symbol_types_.end() ? default_type_ : found->second;
+}
+
+} // namespace book_rules
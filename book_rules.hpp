@@ -0,0 +1,59 @@
+#ifndef BOOK_RULES_H_
+#define BOOK_RULES_H_
+
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_map>
+#include "order_book.hpp"
+
+namespace book_rules
+{
+
+using json = nlohmann::json;
+
+class BookRules;
+typedef std::shared_ptr<BookRules> BookRulesPtr;
+typedef std::shared_ptr<const BookRules> BookRulesCPtr;
+
+// which order book implementation each symbol uses
+class BookRules
+{
+public:
+    BookRules() = default;
+    BookRules(
+        order::order_book_type default_type,
+        const std::unordered_map<std::string, order::order_book_type>& symbol_types
+    );
+
+    order::order_book_type book_type(const std::string& symbol) const;
+
+private:
+    // function for serialise
+    template <typename BasicJsonType>
+    friend void to_json(BasicJsonType& j, const BookRules& o);
+    template <typename BasicJsonType>
+    friend void from_json(const BasicJsonType& j, BookRules& o);
+
+    order::order_book_type default_type_ = order::order_book_type::heap;
+    std::unordered_map<std::string, order::order_book_type> symbol_types_;
+};
+
+template <typename BasicJsonType>
+void to_json(BasicJsonType& j, const BookRules& o)
+{
+    j = BasicJsonType{{"default", o.default_type_}, {"symbols", o.symbol_types_}};
+}
+
+template <typename BasicJsonType>
+void from_json(const BasicJsonType& j, BookRules& o)
+{
+    o = BookRules(
+        j.value("default", order::order_book_type::heap),
+        j.value("symbols", std::unordered_map<std::string, order::order_book_type>())
+    );
+}
+
+} // namespace book_rules
+
+#endif
@@ -0,0 +1,181 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "book_snapshot.hpp"
+#include "byte_order.hpp"
+
+namespace order
+{
+
+namespace
+{
+
+using utils::append_le;
+using utils::get_le;
+using utils::put_le;
+
+constexpr std::uint32_t magic = 0x4e535845; // "EXSN"
+constexpr std::uint32_t version = 2;
+constexpr size_t header_size = 32;
+constexpr size_t section_size = 40;
+constexpr size_t max_symbol_length = 16;
+
+} // anonymous namespace
+
+BookSnapshotWriter::BookSnapshotWriter()
+:
+buffer_(header_size, '\0')
+{
+}
+
+void BookSnapshotWriter::add_section(std::string_view symbol, order_side side, std::span<const RestingOrder> orders)
+{
+    if (orders.empty()) return;
+    if (symbol.size() > max_symbol_length)
+    {
+        throw std::runtime_error("Symbol " + std::string(symbol) + " is too long for a book snapshot.");
+    }
+
+    sections_.push_back(Section{buffer_.size(), orders.size(), side, std::string(symbol)});
+    buffer_.append(reinterpret_cast<const char*>(orders.data()), orders.size_bytes());
+}
+
+void BookSnapshotWriter::write(const std::string& file)
+{
+    const size_t table_offset = buffer_.size();
+    for (const auto& section : sections_)
+    {
+        append_le<std::uint64_t>(buffer_, section.offset);
+        append_le<std::uint64_t>(buffer_, section.number_of_orders);
+        append_le<std::uint8_t>(buffer_, section.side == order_side::bid ? 0 : 1);
+        append_le<std::uint8_t>(buffer_, static_cast<std::uint8_t>(section.symbol.size()));
+        buffer_.append(6, '\0');
+        buffer_ += section.symbol;
+        buffer_.append(max_symbol_length - section.symbol.size(), '\0');
+    }
+    std::byte* header = reinterpret_cast<std::byte*>(buffer_.data());
+    put_le<std::uint32_t>(header, magic);
+    put_le<std::uint32_t>(header + 4, version);
+    put_le<std::uint32_t>(header + 8, static_cast<std::uint32_t>(sections_.size()));
+    put_le<std::uint64_t>(header + 16, table_offset);
+
+    const int fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Cannot open book snapshot " + file + ": " + std::strerror(errno) + ".");
+    }
+    // one write unless the kernel takes less
+    for (size_t written = 0; written < buffer_.size();)
+    {
+        const ssize_t n = ::write(fd, buffer_.data() + written, buffer_.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("Cannot write book snapshot " + file + ": " + std::strerror(errno) + ".");
+        }
+        written += static_cast<size_t>(n);
+    }
+    ::close(fd);
+}
+
+bool BookSnapshot::is_snapshot(const std::string& file)
+{
+    const int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    std::byte header[4];
+    const bool found = ::read(fd, header, sizeof(header)) == sizeof(header) && get_le<std::uint32_t>(header) == magic;
+    ::close(fd);
+    return found;
+}
+
+BookSnapshot::BookSnapshot(const std::string& file)
+{
+    fd_ = ::open(file.c_str(), O_RDONLY);
+    if (fd_ < 0)
+    {
+        throw std::runtime_error("Cannot open book snapshot " + file + ": " + std::strerror(errno) + ".");
+    }
+    struct stat st;
+    ::fstat(fd_, &st);
+    size_ = static_cast<size_t>(st.st_size);
+    data_ = size_ < header_size ? MAP_FAILED : ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (data_ == MAP_FAILED)
+    {
+        data_ = nullptr;
+        ::close(fd_);
+        throw std::runtime_error("Cannot map book snapshot " + file + ".");
+    }
+
+    const std::byte* p = static_cast<const std::byte*>(data_);
+    const size_t number_of_sections = get_le<std::uint32_t>(p + 8);
+    const size_t table_offset = get_le<std::uint64_t>(p + 16);
+    bool valid = get_le<std::uint32_t>(p) == magic && get_le<std::uint32_t>(p + 4) == version &&
+        table_offset <= size_ && number_of_sections <= (size_ - table_offset) / section_size;
+    for (size_t i = 0; valid && i < number_of_sections; ++i)
+    {
+        const std::byte* section = p + table_offset + i * section_size;
+        const size_t offset = get_le<std::uint64_t>(section);
+        const size_t number_of_orders = get_le<std::uint64_t>(section + 8);
+        const size_t symbol_length = get_le<std::uint8_t>(section + 17);
+        valid = offset % alignof(RestingOrder) == 0 && offset >= header_size && offset <= table_offset &&
+            number_of_orders <= (table_offset - offset) / sizeof(RestingOrder) && symbol_length <= max_symbol_length;
+        if (!valid) break;
+
+        sections_.push_back(Section{
+            std::string_view(reinterpret_cast<const char*>(section + 24), symbol_length),
+            get_le<std::uint8_t>(section + 16) == 0 ? order_side::bid : order_side::ask,
+            std::span<const RestingOrder>(reinterpret_cast<const RestingOrder*>(p + offset), number_of_orders)
+        });
+    }
+    if (!valid)
+    {
+        unmap();
+        throw std::runtime_error("Malformed book snapshot " + file + ".");
+    }
+}
+
+BookSnapshot::~BookSnapshot()
+{
+    unmap();
+}
+
+void BookSnapshot::unmap()
+{
+    if (data_)
+    {
+        ::munmap(data_, size_);
+        data_ = nullptr;
+    }
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+void to_json_lines(const BookSnapshot& snapshot, std::ostream& out)
+{
+    for (const auto& section : snapshot.sections())
+    {
+        const std::string symbol(section.symbol);
+        for (const auto& o : section.orders)
+        {
+            const utils::Price4 price(o.price);
+            const auto tif = static_cast<time_in_force>(o.tif);
+            // symbol ids are not kept, the symbol is named instead
+            json j = o.is_iceberg() ?
+                json(IcebergOrder(o.time, o.order_id, tif, price, 0, section.side, o.quantity, o.hidden_quantity)) :
+                json(LimitOrder(o.time, o.order_id, o.quantity, tif, price, 0, section.side));
+            j["symbol"] = symbol;
+            out << j.dump() << "\n";
+        }
+    }
+}
+
+} // namespace order
@@ -0,0 +1,115 @@
+#ifndef BOOK_SNAPSHOT_HPP_
+#define BOOK_SNAPSHOT_HPP_
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "order.hpp"
+
+// Binary close order cache: the good till cancel orders left in every book at the end of the day, one
+// section per book, each in the priority order the book writes them. Little-endian:
+//
+//   header      0  u32  magic 'EXSN'   4  u32  version    8  u32  number of sections   12  u32  reserved
+//              16  u64  offset of the section table       24  u64  reserved
+//   orders     32  RestingOrder, 40 bytes each, section after section
+//   section     0  u64  offset of the first order          8  u64  number of orders
+//              16  u8   side (0 buy, 1 sell)               17  u8   symbol length      18  u8[6] reserved
+//              24  char[16] symbol
+//
+// The whole file is written at once and mapped to be read, orders are used in place.
+namespace order
+{
+
+// 0 price (Price4 unscaled)  8 order id  12 time  16 displayed quantity  20 hidden quantity
+// 24 displayed time  28 sequence  32 tif  33 order type (limit or iceberg)  34 reserved
+//
+// A book writes its orders in the priority order of their displayed parts, then the iceberg orders with
+// nothing displayed - the order of the hidden parts is kept by the sequences.
+struct RestingOrder
+{
+    std::int64_t price;
+    std::int32_t order_id;
+    // entry time, the time the hidden part of an iceberg order queues at
+    std::int32_t time;
+    std::int32_t quantity;
+    std::int32_t hidden_quantity;
+    // the displayed part of a replenished iceberg order queues again with its own time
+    std::int32_t displayed_time;
+    // order the orders of a section entered their book in
+    std::uint32_t sequence;
+    std::uint8_t tif;
+    std::uint8_t order_type;
+    std::uint8_t reserved[6];
+
+    bool is_iceberg() const { return order_type == order::order_type::iceberg; }
+};
+
+static_assert(sizeof(RestingOrder) == 40, "Resting orders are 40 bytes in a snapshot.");
+static_assert(std::endian::native == std::endian::little, "Snapshot orders are used in place on little-endian hosts.");
+
+// collects sections in memory and writes them as one file
+class BookSnapshotWriter
+{
+public:
+    BookSnapshotWriter();
+
+    // orders in priority order, as the book appended them - empty sections are left out
+    void add_section(std::string_view symbol, order_side side, std::span<const RestingOrder> orders);
+    // replaces the file with a single write
+    void write(const std::string& file);
+
+private:
+    struct Section
+    {
+        std::uint64_t offset;
+        std::uint64_t number_of_orders;
+        order_side side;
+        std::string symbol;
+    };
+
+    std::string buffer_;
+    std::vector<Section> sections_;
+};
+
+class BookSnapshot
+{
+public:
+    struct Section
+    {
+        std::string_view symbol;
+        order_side side;
+        // points into the mapped file
+        std::span<const RestingOrder> orders;
+    };
+
+    // false for anything else, e.g. a json lines close order cache or a missing file
+    static bool is_snapshot(const std::string& file);
+
+    explicit BookSnapshot(const std::string& file);
+    ~BookSnapshot();
+
+    BookSnapshot(const BookSnapshot&) = delete;
+    BookSnapshot& operator=(const BookSnapshot&) = delete;
+
+    const std::vector<Section>& sections() const { return sections_; }
+
+private:
+    void unmap();
+
+    int fd_ = -1;
+    void* data_ = nullptr;
+    size_t size_ = 0;
+    std::vector<Section> sections_;
+};
+
+// one json object per order, as the json close order cache had them
+void to_json_lines(const BookSnapshot& snapshot, std::ostream& out);
+
+} // namespace order
+
+#endif
@@ -0,0 +1,35 @@
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include "book_snapshot.hpp"
+
+// Converts a binary close order cache into the json lines it used to be written as, for debugging.
+// usage: book_snapshot_to_json book_snapshot_file [json_output_file]
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: book_snapshot_to_json book_snapshot_file [json_output_file]" << std::endl;
+        return 1;
+    }
+
+    std::ofstream outfile;
+    if (argc > 2)
+    {
+        outfile.open(argv[2]);
+    }
+    std::ostream& out = argc > 2 ? outfile : std::cout;
+
+    try
+    {
+        const order::BookSnapshot snapshot(argv[1]);
+        order::to_json_lines(snapshot, out);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,51 @@
+#ifndef BYTE_ORDER_HPP_
+#define BYTE_ORDER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+namespace utils
+{
+
+// Little-endian integer access with explicit byte order, so wire formats do not depend on the host.
+
+template <typename T>
+void put_le(std::byte* p, T value)
+{
+    typedef typename std::make_unsigned<T>::type U;
+    const U u = static_cast<U>(value);
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        p[i] = static_cast<std::byte>((u >> (8 * i)) & 0xff);
+    }
+}
+
+template <typename T>
+T get_le(const std::byte* p)
+{
+    typedef typename std::make_unsigned<T>::type U;
+    U u = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        u |= static_cast<U>(std::to_integer<std::uint8_t>(p[i])) << (8 * i);
+    }
+    return static_cast<T>(u);
+}
+
+// append to a byte buffer held in a string
+template <typename T>
+void append_le(std::string& out, T value)
+{
+    typedef typename std::make_unsigned<T>::type U;
+    const U u = static_cast<U>(value);
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        out.push_back(static_cast<char>((u >> (8 * i)) & 0xff));
+    }
+}
+
+} // namespace utils
+
+#endif
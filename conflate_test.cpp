@@ -0,0 +1,135 @@
+#include <iostream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+#include "book_rules.hpp"
+#include "event_arena.hpp"
+#include "matching_engine.hpp"
+#include "request.hpp"
+#include "size_rules.hpp"
+#include "ticker_rules.hpp"
+
+// Conflated bursts publish the total of every touched price level, whatever the book kind.
+// usage: conflate_test
+
+namespace
+{
+
+using json = nlohmann::json;
+
+struct Level
+{
+    order::order_side side;
+    trade_event::trade_action action;
+    int quantity;
+    long price;
+};
+
+std::string new_order(int order_id, const std::string& side, int quantity, const std::string& price)
+{
+    return "{\"time\": 1625787615, \"type\": \"NEW\", \"order_id\": " + std::to_string(order_id) +
+        ", \"symbol\": \"AAPL\", \"side\": \"" + side + "\", \"quantity\": " + std::to_string(quantity) +
+        ", \"limit_price\": \"" + price + "\", \"tif\": \"day\"}";
+}
+
+std::string cancel_order(int order_id)
+{
+    return "{\"time\": 1625787615, \"type\": \"CANCEL\", \"order_id\": " + std::to_string(order_id) + "}";
+}
+
+// levels of the depth updates of one conflated burst
+std::vector<Level> conflated_levels(const std::string& book_kind, const std::vector<std::string>& lines)
+{
+    const auto tick_size_rules = json::parse(R"([{"from_price": "0", "tick_size": "0.01"}])")
+        .get<size_rules::TickSizeRulesCPtr>();
+    const auto lot_size_rules = json::parse(R"([{"from_price": "0", "lot_size": "100"}])")
+        .get<size_rules::LotSizeRulesCPtr>();
+    const auto tickers = std::make_shared<const ticker_rules::TickerRules>(std::vector<std::string>{"AAPL"});
+    const auto books = json{{"default", book_kind}}.get<book_rules::BookRulesCPtr>();
+    exchange::MatchingEngine engine(tick_size_rules, lot_size_rules, tickers, books);
+
+    std::vector<exchange::Request> requests(lines.size());
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+        if (!exchange::RequestParser::parse(lines[i], requests[i]))
+        {
+            throw std::runtime_error("Cannot parse " + lines[i] + ".");
+        }
+    }
+    const trade_event::EventArena& events = engine.process_orders(requests, true);
+
+    std::vector<Level> levels;
+    const auto records = events.records();
+    for (size_t head = 0; head < records.size(); head += 1 + records[head].number_of_levels)
+    {
+        if (records[head].type != trade_event::depth_update_record) continue;
+        for (const auto& r : trade_event::event_records(records, head).subspan(1))
+        {
+            levels.push_back(Level{r.side, r.action, r.quantity, r.price.unscaled()});
+        }
+    }
+    return levels;
+}
+
+bool expect(
+    const std::string& name,
+    const std::vector<Level>& levels,
+    trade_event::trade_action action,
+    int quantity,
+    long price
+)
+{
+    if (levels.size() == 1 && levels[0].side == order::order_side::bid && levels[0].action == action &&
+        levels[0].quantity == quantity && levels[0].price == price)
+    {
+        return true;
+    }
+    std::cerr << name << ": expected one bid level of " << quantity << " at " << price << ", got";
+    for (const auto& l : levels)
+    {
+        std::cerr << " (" << (l.side == order::order_side::bid ? "bid " : "ask ") << l.quantity << " at " << l.price
+            << ")";
+    }
+    std::cerr << std::endl;
+    return false;
+}
+
+} // anonymous namespace
+
+int main()
+{
+    int failures = 0;
+    for (const std::string book_kind : {"heap", "price_level", "tick_ladder"})
+    {
+        // two orders joining one level
+        const auto joined = conflated_levels(book_kind, {
+            new_order(1, "BUY", 100, "10.01"),
+            new_order(2, "BUY", 200, "10.01")
+        });
+        if (!expect(book_kind + " two orders joining one level", joined, trade_event::trade_action::add_add, 300,
+            100100)) ++failures;
+
+        // one of them leaving it again
+        const auto cancelled = conflated_levels(book_kind, {
+            new_order(1, "BUY", 100, "10.01"),
+            new_order(2, "BUY", 200, "10.01"),
+            cancel_order(1)
+        });
+        if (!expect(book_kind + " one of two orders cancelled", cancelled, trade_event::trade_action::add_add, 200,
+            100100)) ++failures;
+
+        // both of them leaving it
+        const auto emptied = conflated_levels(book_kind, {
+            new_order(1, "BUY", 100, "10.01"),
+            new_order(2, "BUY", 200, "10.01"),
+            cancel_order(1),
+            cancel_order(2)
+        });
+        if (!expect(book_kind + " level emptied", emptied, trade_event::trade_action::delete_delete, 0, 100100))
+        {
+            ++failures;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -71,10 +71,12 @@ class EventBase
 {
 public:
     EventBase() = default;
-    EventBase(trade_event::trade_type type) : type_(type) {};
+    EventBase(trade_event::trade_type type, int symbol_id) : type_(type), symbol_id_(symbol_id) {};
 
     // type() is non-virtual for serialisation purpose
     trade_event::trade_type type() const { return type_; }
+    // interned symbol, not part of the json message
+    int symbol_id() const { return symbol_id_; }
     virtual bool empty() const { return true; }
     virtual json to_json() const 
     { 
@@ -89,6 +91,7 @@ private:
     friend void from_json(const BasicJsonType& j, EventBase& o);
 
     trade_event::trade_type type_;
+    int symbol_id_;
 };
 
 class TradeEvent : public EventBase
@@ -96,11 +99,12 @@ class TradeEvent : public EventBase
 public:
     TradeEvent() = default;
     TradeEvent(
+        int symbol_id,
         const utils::Price4& price,
         int quantity
     )
     :
-    EventBase(trade_type::trade),
+    EventBase(trade_type::trade, symbol_id),
     price_(price),
     quantity_(quantity)
     {}
@@ -161,11 +165,12 @@ class DepthUpdateEvent : public EventBase
 public:
     DepthUpdateEvent() = default;
     DepthUpdateEvent(
+        int symbol_id,
         const std::vector<OrderUpdateInfoCPtr>& bid_order_update_info,
         const std::vector<OrderUpdateInfoCPtr>& ask_order_update_info
     )
     :
-    EventBase(trade_type::depth_update),
+    EventBase(trade_type::depth_update, symbol_id),
     bid_order_update_info_(bid_order_update_info),
     ask_order_update_info_(ask_order_update_info)
     {}
@@ -208,16 +213,21 @@ public:
     MarketSnapEvent() = default;
     MarketSnapEvent(
         order::order_side side,
+        int symbol_id,
         const std::string& symbol,
         const std::vector<std::pair<utils::Price4, int>>& info
     )
     :
-    EventBase(trade_type::market_snap),
+    EventBase(trade_type::market_snap, symbol_id),
     side_(side),
     symbol_(symbol),
     info_(info)
     {}
 
+    order::order_side side() const { return side_; }
+    const std::string& symbol() const { return symbol_; }
+    const std::vector<std::pair<utils::Price4, int>>& info() const { return info_; }
+
     json to_json() const override
     { 
         return json(*this);
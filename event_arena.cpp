@@ -0,0 +1,340 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <stdexcept>
+#include "event_arena.hpp"
+
+namespace trade_event
+{
+
+namespace
+{
+
+void append_int(std::string& out, long value)
+{
+    char buffer[24];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+// same text as Price4::to_str(), quoted
+void append_price(std::string& out, const utils::Price4& price)
+{
+    long unit = 1;
+    for (int i = 0; i < utils::Price4::scale; ++i) unit *= 10;
+
+    const long unscaled = price.unscaled();
+    out += '"';
+    if (unscaled < 0) out += '-';
+    append_int(out, std::labs(unscaled / unit));
+    long decimal = std::labs(unscaled % unit);
+    if (decimal != 0)
+    {
+        out += '.';
+        // leading 0s, then the digits without trailing 0s
+        for (long digit = unit / 10; decimal < digit; digit /= 10) out += '0';
+        while (decimal % 10 == 0) decimal /= 10;
+        append_int(out, decimal);
+    }
+    out += '"';
+}
+
+void append_string(std::string& out, std::string_view s)
+{
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    for (const char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            out += "\\u00";
+            out += hex[(c >> 4) & 0xf];
+            out += hex[c & 0xf];
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+const char* action_name(trade_action action)
+{
+    switch (action)
+    {
+    case add_add: return "ADD";
+    case modify: return "MODIFY";
+    case delete_delete: return "DELETE";
+    default: throw std::runtime_error("Unknown depth update action.");
+    }
+}
+
+void append_levels(std::string& out, std::span<const EventRecord> levels, order::order_side side)
+{
+    bool first = true;
+    out += '[';
+    for (const auto& level : levels)
+    {
+        if (level.side != side) continue;
+        if (!first) out += ',';
+        first = false;
+        out += "{\"action\":\"";
+        out += action_name(level.action);
+        out += "\",\"price\":";
+        append_price(out, level.price);
+        out += ",\"quantity\":";
+        append_int(out, level.quantity);
+        out += '}';
+    }
+    out += ']';
+}
+
+} // anonymous namespace
+
+EventArena::EventArena()
+{
+    records_.reserve(initial_capacity);
+    staged_.reserve(initial_capacity);
+}
+
+void EventArena::clear()
+{
+    records_.clear();
+    staged_.clear();
+    last_event_ = 0;
+    has_previous_event_ = false;
+    number_of_events_ = 0;
+}
+
+void EventArena::rollback(const Mark& mark)
+{
+    records_.resize(mark.size);
+    staged_.clear();
+    last_event_ = mark.last_event;
+    has_previous_event_ = false;
+    number_of_events_ = mark.number_of_events;
+}
+
+void EventArena::pop_back()
+{
+    if (records_.empty()) return;
+
+    records_.resize(last_event_);
+    --number_of_events_;
+    if (has_previous_event_)
+    {
+        last_event_ = previous_event_;
+        has_previous_event_ = false;
+        return;
+    }
+    // rare - walk the heads to find the event before
+    last_event_ = 0;
+    for (size_t head = 0; head < records_.size(); head += 1 + records_[head].number_of_levels)
+    {
+        last_event_ = head;
+    }
+}
+
+void EventArena::add_head(record_type type, int symbol_id, order::order_side side)
+{
+    previous_event_ = last_event_;
+    has_previous_event_ = !records_.empty();
+    last_event_ = records_.size();
+    ++number_of_events_;
+    records_.push_back(EventRecord{type, side, add_add, symbol_id, 0, 0, utils::Price4(0)});
+}
+
+void EventArena::add_trade(int symbol_id, const utils::Price4& price, int quantity)
+{
+    add_head(trade_record, symbol_id, order::order_side::bid);
+    records_.back().quantity = quantity;
+    records_.back().price = price;
+}
+
+void EventArena::stage_level(
+    order::order_side side, const utils::Price4& price, int quantity, trade_action action)
+{
+    staged_.push_back(EventRecord{level_record, side, action, 0, quantity, 0, price});
+}
+
+void EventArena::add_staged(record_type type, int symbol_id, order::order_side side)
+{
+    add_head(type, symbol_id, side);
+    records_.back().number_of_levels = static_cast<std::uint32_t>(staged_.size());
+    for (auto& level : staged_)
+    {
+        level.symbol_id = symbol_id;
+    }
+    records_.insert(records_.end(), staged_.begin(), staged_.end());
+    staged_.clear();
+}
+
+void EventArena::add_depth_update(int symbol_id)
+{
+    add_staged(depth_update_record, symbol_id, order::order_side::bid);
+}
+
+void EventArena::add_market_snap(int symbol_id, order::order_side side)
+{
+    add_staged(market_snap_record, symbol_id, side);
+}
+
+void EventArena::merge_last_depth_update(size_t tail)
+{
+    const size_t head = last_event_;
+    if (tail >= head || records_[head].type != depth_update_record || records_[tail].type != depth_update_record ||
+        tail + 1 + records_[tail].number_of_levels != head)
+    {
+        throw std::runtime_error("Expect two consecutive depth updates to merge.");
+    }
+
+    const auto tail_levels = event_records(records_, tail).subspan(1);
+    const auto new_levels = event_records(records_, head).subspan(1);
+    for (const auto& a : tail_levels)
+    {
+        for (const auto& b : new_levels)
+        {
+            if (a.side == b.side)
+            {
+                throw std::runtime_error("Expect tail event and insertion event have differnt side.");
+            }
+        }
+    }
+
+    // drop the second head, its levels follow the first update's
+    records_[tail].number_of_levels += records_[head].number_of_levels;
+    records_.erase(records_.begin() + static_cast<std::ptrdiff_t>(head));
+    last_event_ = tail;
+    has_previous_event_ = false;
+    --number_of_events_;
+}
+
+void EventArena::conflate_depth_updates(size_t from, const LevelQuantity& level_quantity)
+{
+    // level records of every depth update, tagged with their symbol, in arrival order
+    conflated_.clear();
+    size_t kept = from;
+    size_t number_of_events = number_of_events_;
+    for (size_t head = from; head < records_.size();)
+    {
+        const size_t next = head + 1 + records_[head].number_of_levels;
+        if (records_[head].type == depth_update_record)
+        {
+            for (size_t i = head + 1; i < next; ++i)
+            {
+                conflated_.push_back(records_[i]);
+                conflated_.back().symbol_id = records_[head].symbol_id;
+            }
+            --number_of_events;
+        }
+        else
+        {
+            // other events move up over the removed depth updates
+            std::copy(records_.begin() + static_cast<std::ptrdiff_t>(head),
+                records_.begin() + static_cast<std::ptrdiff_t>(next),
+                records_.begin() + static_cast<std::ptrdiff_t>(kept));
+            last_event_ = kept;
+            kept += next - head;
+        }
+        head = next;
+    }
+    if (kept == from)
+    {
+        // rare - nothing but depth updates, walk the heads to find the event before
+        last_event_ = 0;
+        for (size_t head = 0; head < from; head += 1 + records_[head].number_of_levels)
+        {
+            last_event_ = head;
+        }
+    }
+    records_.resize(kept);
+    number_of_events_ = number_of_events;
+    has_previous_event_ = false;
+    if (conflated_.empty()) return;
+
+    // one record per level - stable sort keeps arrival order within a level
+    std::stable_sort(conflated_.begin(), conflated_.end(), [](const EventRecord& a, const EventRecord& b)
+    {
+        if (a.symbol_id != b.symbol_id) return a.symbol_id < b.symbol_id;
+        if (a.side != b.side) return a.side < b.side;
+        return a.price < b.price;
+    });
+    for (size_t i = 0; i < conflated_.size();)
+    {
+        const int symbol_id = conflated_[i].symbol_id;
+        add_head(depth_update_record, symbol_id, order::order_side::bid);
+        const size_t head = last_event_;
+        for (; i < conflated_.size() && conflated_[i].symbol_id == symbol_id; ++i)
+        {
+            const bool last_of_level = i + 1 == conflated_.size() || conflated_[i + 1].symbol_id != symbol_id ||
+                conflated_[i + 1].side != conflated_[i].side || !(conflated_[i + 1].price == conflated_[i].price);
+            if (!last_of_level) continue;
+            EventRecord level = conflated_[i];
+            level.quantity = level_quantity(symbol_id, level.side, level.price);
+            if (level.quantity == 0)
+            {
+                level.action = delete_delete;
+            }
+            else if (level.action == delete_delete)
+            {
+                level.action = add_add;
+            }
+            records_.push_back(level);
+            ++records_[head].number_of_levels;
+        }
+    }
+}
+
+void append_json(std::span<const EventRecord> event, std::string_view symbol, std::string& out)
+{
+    const EventRecord& head = event.front();
+    const auto levels = event.subspan(1);
+    // keys in the order nlohmann dumps them
+    switch (head.type)
+    {
+    case trade_record:
+        out += "{\"price\":";
+        append_price(out, head.price);
+        out += ",\"quantity\":";
+        append_int(out, head.quantity);
+        out += ",\"type\":\"TRADE\"}";
+        break;
+
+    case depth_update_record:
+        out += "{\"ask\":";
+        append_levels(out, levels, order::order_side::ask);
+        out += ",\"bid\":";
+        append_levels(out, levels, order::order_side::bid);
+        out += ",\"type\":\"DEPTH_UPDATE\"}";
+        break;
+
+    case market_snap_record:
+        out += "{\"prices\":[";
+        for (size_t i = 0; i < levels.size(); ++i)
+        {
+            if (i > 0) out += ',';
+            out += '[';
+            append_price(out, levels[i].price);
+            out += ',';
+            append_int(out, levels[i].quantity);
+            out += ']';
+        }
+        out += "],\"side\":";
+        out += head.side == order::order_side::bid ? "\"buy\"" : "\"sell\"";
+        out += ",\"symbol\":";
+        append_string(out, symbol);
+        out += '}';
+        break;
+
+    default:
+        throw std::runtime_error("Unknown event record type.");
+    }
+}
+
+} // namespace trade_event
@@ -0,0 +1,131 @@
+#ifndef EVENT_ARENA_HPP_
+#define EVENT_ARENA_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "event.hpp"
+#include "order.hpp"
+#include "price4.hpp"
+
+namespace trade_event
+{
+
+enum record_type : std::uint8_t
+{
+    trade_record,
+    depth_update_record,
+    market_snap_record,
+    // price level of the depth update or market snap before it
+    level_record
+};
+
+// One slot of the event arena. An event is a head record followed by number_of_levels level records.
+struct EventRecord
+{
+    record_type type;
+    // level records and market snaps
+    order::order_side side;
+    // depth update level records
+    trade_action action;
+    int symbol_id;
+    // trade and level records
+    int quantity;
+    // head records
+    std::uint32_t number_of_levels;
+    utils::Price4 price;
+};
+
+static_assert(std::is_trivially_copyable_v<EventRecord>, "event records are copied around as raw memory");
+
+// Contiguous buffer of tagged event records the order books append into, owned by the matching
+// engine and handed to the publisher by span. Clearing keeps the capacity, so once it has grown to
+// the largest request no more memory is allocated.
+class EventArena
+{
+public:
+    static constexpr size_t initial_capacity = 1024;
+
+    EventArena();
+
+    // position to roll back to, e.g. the start of one request of a batch
+    struct Mark
+    {
+        size_t size;
+        size_t last_event;
+        size_t number_of_events;
+    };
+
+    // reset per request or per batch
+    void clear();
+    Mark mark() const { return Mark{records_.size(), last_event_, number_of_events_}; }
+    // drops everything appended since the mark, staged levels too
+    void rollback(const Mark& mark);
+
+    bool empty() const { return records_.empty(); }
+    size_t size() const { return records_.size(); }
+    size_t number_of_events() const { return number_of_events_; }
+    std::span<const EventRecord> records() const { return records_; }
+
+    // head record of the last event and its index - only valid when not empty
+    const EventRecord& back() const { return records_[last_event_]; }
+    size_t back_index() const { return last_event_; }
+    // drop the last event
+    void pop_back();
+
+    void add_trade(int symbol_id, const utils::Price4& price, int quantity);
+
+    // Level changes are staged while the trades of a match are appended, then published after them
+    // as one depth update or market snap.
+    void stage_level(order::order_side side, const utils::Price4& price, int quantity, trade_action action);
+    bool has_staged_levels() const { return !staged_.empty(); }
+    // the staged levels, possibly none, become the levels of the event
+    void add_depth_update(int symbol_id);
+    void add_market_snap(int symbol_id, order::order_side side);
+
+    // Folds the last event, a depth update, into the depth update at tail that directly precedes it.
+    // Both updates have to be on different sides.
+    void merge_last_depth_update(size_t tail);
+
+    // displayed quantity a book holds at a price level, by symbol id, side and price
+    typedef std::function<int(int, order::order_side, const utils::Price4&)> LevelQuantity;
+
+    // Replaces the depth updates from record from on by one depth update per symbol, appended after
+    // the other events in symbol id order, with every price level they touched - bids then asks, in
+    // price order. A level carries its total after the burst, as level_quantity reports it, since the
+    // ADD of an insert only carries the quantity of the order. Trades and market snaps keep their order.
+    void conflate_depth_updates(size_t from, const LevelQuantity& level_quantity);
+
+private:
+    void add_head(record_type type, int symbol_id, order::order_side side);
+    void add_staged(record_type type, int symbol_id, order::order_side side);
+
+    std::vector<EventRecord> records_;
+    std::vector<EventRecord> staged_;
+    // scratch of conflate_depth_updates
+    std::vector<EventRecord> conflated_;
+    size_t last_event_ = 0;
+    // head of the event before the last one, while known
+    size_t previous_event_ = 0;
+    bool has_previous_event_ = false;
+    size_t number_of_events_ = 0;
+};
+
+// records of the event starting at head
+inline std::span<const EventRecord> event_records(std::span<const EventRecord> records, size_t head)
+{
+    return records.subspan(head, 1 + records[head].number_of_levels);
+}
+
+// Appends the event as the json line EventBase::to_json() would dump, without the newline. Market
+// snaps are the only events naming their symbol.
+void append_json(std::span<const EventRecord> event, std::string_view symbol, std::string& out);
+
+} // namespace trade_event
+
+#endif
@@ -1,7 +1,13 @@
+#include <cstdio>
 #include <exception>
 #include <fstream>
+#include <iostream>
 #include <nlohmann/json.hpp>
 #include <ostream>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "binary_protocol.hpp"
 #include "exchange.hpp"
 
 using json = nlohmann::json;
@@ -10,7 +16,17 @@ void create_rules(
     const std::string config_file, 
     size_rules::TickSizeRulesCPtr& ticker_size_rules,
     size_rules::LotSizeRulesCPtr& lot_size_rules,
-    ticker_rules::TickerRulesCPtr& ticker_rules
+    ticker_rules::TickerRulesCPtr& ticker_rules,
+    book_rules::BookRulesCPtr& book_rules,
+    exchange::PublisherOptions& publisher_options,
+    utils::PoolOptions& pool_options,
+    exchange::ShardingOptions& sharding_options,
+    exchange::PipelineOptions& pipeline_options,
+    exchange::JournalOptions& journal_options,
+    exchange::BookRegionOptions& book_region_options,
+    exchange::ReplicationOptions& replication_options,
+    exchange::OrderEntryOptions& order_entry_options,
+    utils::IoOptions& io_options
 )
 {
     std::ifstream infile(config_file);
@@ -34,23 +50,137 @@ void create_rules(
         {
             ticker_rules = j.at("symbols").get<ticker_rules::TickerRulesCPtr>();
         }
+
+        if (j.contains("order_books"))
+        {
+            book_rules = j.at("order_books").get<book_rules::BookRulesCPtr>();
+        }
+
+        if (j.contains("market_data"))
+        {
+            publisher_options = j.at("market_data").get<exchange::PublisherOptions>();
+        }
+
+        if (j.contains("order_pool"))
+        {
+            pool_options = j.at("order_pool").get<utils::PoolOptions>();
+        }
+
+        if (j.contains("sharding"))
+        {
+            sharding_options = j.at("sharding").get<exchange::ShardingOptions>();
+        }
+
+        if (j.contains("pipeline"))
+        {
+            pipeline_options = j.at("pipeline").get<exchange::PipelineOptions>();
+        }
+
+        if (j.contains("journal"))
+        {
+            journal_options = j.at("journal").get<exchange::JournalOptions>();
+        }
+
+        if (j.contains("book_region"))
+        {
+            book_region_options = j.at("book_region").get<exchange::BookRegionOptions>();
+        }
+
+        if (j.contains("replication"))
+        {
+            replication_options = j.at("replication").get<exchange::ReplicationOptions>();
+        }
+
+        if (j.contains("order_entry"))
+        {
+            order_entry_options = j.at("order_entry").get<exchange::OrderEntryOptions>();
+        }
+
+        if (j.contains("io"))
+        {
+            io_options = j.at("io").get<utils::IoOptions>();
+        }
     }
 }
 
-exchange::MarketDataPublisherCPtr create_market_data_publisher(
-    const std::string& event_publish_file
+exchange::MarketDataPublisherPtr create_market_data_publisher(
+    const std::string& event_publish_file,
+    const exchange::PublisherOptions& publisher_options,
+    const ticker_rules::TickerRulesCPtr& ticker_rules,
+    const utils::IoOptions& io_options
 )
 {
-    return std::make_unique<const exchange::MarketDataPublisher>(event_publish_file);
+    return std::make_unique<exchange::MarketDataPublisher>(event_publish_file, publisher_options, ticker_rules,
+        io_options);
 }
 
 exchange::MatchingEnginePtr create_matching_engine(
     const size_rules::TickSizeRulesCPtr& ticker_size_rules,
     const size_rules::LotSizeRulesCPtr& lot_size_rules,
-    const ticker_rules::TickerRulesCPtr& ticker_rules
+    const ticker_rules::TickerRulesCPtr& ticker_rules,
+    const book_rules::BookRulesCPtr& book_rules,
+    const utils::PoolOptions& pool_options
+)
+{
+    return std::make_unique<exchange::MatchingEngine>(
+        ticker_size_rules, lot_size_rules, ticker_rules, book_rules, pool_options);
+}
+
+exchange::ShardedEnginePtr create_sharded_engine(
+    const size_rules::TickSizeRulesCPtr& ticker_size_rules,
+    const size_rules::LotSizeRulesCPtr& lot_size_rules,
+    const ticker_rules::TickerRulesCPtr& ticker_rules,
+    const book_rules::BookRulesCPtr& book_rules,
+    const utils::PoolOptions& pool_options,
+    const exchange::ShardingOptions& sharding_options,
+    exchange::MarketDataPublisher& market_data_publisher
+)
+{
+    return std::make_unique<exchange::ShardedEngine>(
+        ticker_size_rules, lot_size_rules, ticker_rules, book_rules, pool_options, sharding_options,
+        market_data_publisher);
+}
+
+exchange::PipelinedEnginePtr create_pipelined_engine(
+    const size_rules::TickSizeRulesCPtr& ticker_size_rules,
+    const size_rules::LotSizeRulesCPtr& lot_size_rules,
+    const ticker_rules::TickerRulesCPtr& ticker_rules,
+    const book_rules::BookRulesCPtr& book_rules,
+    const utils::PoolOptions& pool_options,
+    const exchange::PipelineOptions& pipeline_options,
+    exchange::MarketDataPublisher& market_data_publisher
 )
 {
-    return std::make_unique<exchange::MatchingEngine>(ticker_size_rules, lot_size_rules, ticker_rules);
+    return std::make_unique<exchange::PipelinedEngine>(
+        ticker_size_rules, lot_size_rules, ticker_rules, book_rules, pool_options, pipeline_options,
+        market_data_publisher);
+}
+
+exchange::JournalPtr create_journal(const exchange::JournalOptions& journal_options)
+{
+    return std::make_unique<exchange::Journal>(journal_options);
+}
+
+exchange::BookRegionPtr create_book_region(
+    const exchange::BookRegionOptions& book_region_options,
+    const ticker_rules::TickerRulesCPtr& ticker_rules,
+    const book_rules::BookRulesCPtr& book_rules
+)
+{
+    return std::make_unique<exchange::BookRegion>(book_region_options, ticker_rules, book_rules);
+}
+
+exchange::JournalStreamPtr create_journal_stream(
+    const exchange::ReplicationOptions& replication_options,
+    bool day_open
+)
+{
+    return std::make_unique<exchange::JournalStream>(replication_options, day_open);
+}
+
+exchange::OrderEntryQueuePtr create_order_entry_queue(const exchange::OrderEntryOptions& order_entry_options)
+{
+    return std::make_unique<exchange::OrderEntryQueue>(order_entry_options);
 }
 
 namespace exchange
@@ -61,9 +191,91 @@ void Exchange::initialise(
     const std::string& event_publish_file
 )
 {
-    create_rules(config_file, ticker_size_rules_, lot_size_rules_, ticker_rules_);
-    matching_engine_ = create_matching_engine(ticker_size_rules_, lot_size_rules_, ticker_rules_);
-    market_data_publisher_ = create_market_data_publisher(event_publish_file);
+    PublisherOptions publisher_options;
+    utils::PoolOptions pool_options;
+    ShardingOptions sharding_options;
+    PipelineOptions pipeline_options;
+    JournalOptions journal_options;
+    BookRegionOptions book_region_options;
+    ReplicationOptions replication_options;
+    utils::IoOptions io_options;
+    create_rules(config_file, ticker_size_rules_, lot_size_rules_, ticker_rules_, book_rules_, publisher_options,
+        pool_options, sharding_options, pipeline_options, journal_options, book_region_options,
+        replication_options, order_entry_options_, io_options);
+    if (sharding_options.shards > 0 && pipeline_options.parsers > 0)
+    {
+        throw std::runtime_error("Sharding and pipelining cannot be combined.");
+    }
+    if (!book_region_options.path.empty() && (sharding_options.shards > 0 || pipeline_options.parsers > 0))
+    {
+        throw std::runtime_error("A book region needs the single matching engine.");
+    }
+    if (!book_region_options.path.empty() && ticker_rules_)
+    {
+        // checked before the region is created, which sizes its file and empties it
+        for (size_t symbol_id = 0; symbol_id < ticker_rules_->number_of_symbols(); ++symbol_id)
+        {
+            const std::string& symbol = ticker_rules_->symbol(static_cast<int>(symbol_id));
+            if (!book_rules_ || book_rules_->book_type(symbol) == order::order_book_type::heap)
+            {
+                throw std::runtime_error("A book region cannot keep the heap book of " + symbol + ".");
+            }
+        }
+    }
+    if (replication_options.role != no_replication && (sharding_options.shards > 0 || pipeline_options.parsers > 0))
+    {
+        throw std::runtime_error("Replication needs the single matching engine.");
+    }
+    if (replication_options.role == primary_role && journal_options.path.empty())
+    {
+        throw std::runtime_error("Replication streams the journal - the primary needs one.");
+    }
+    if (!journal_options.path.empty())
+    {
+        // journaled requests carry interned symbol ids
+        if (!ticker_rules_)
+        {
+            throw std::runtime_error("The journal needs listed symbols.");
+        }
+        journal_ = create_journal(journal_options);
+    }
+    if (replication_options.role != no_replication)
+    {
+        // a replica cannot catch up with a day the primary recovers
+        journal_stream_ = create_journal_stream(replication_options, journal_ &&
+            journal_->last_record() != no_record && journal_->last_record() != market_close_record);
+    }
+    market_data_publisher_ = create_market_data_publisher(
+        event_publish_file, publisher_options, ticker_rules_, io_options);
+    if (sharding_options.shards > 0)
+    {
+        sharded_engine_ = create_sharded_engine(ticker_size_rules_, lot_size_rules_, ticker_rules_, book_rules_,
+            pool_options, sharding_options, *market_data_publisher_);
+    }
+    else if (pipeline_options.parsers > 0)
+    {
+        pipelined_engine_ = create_pipelined_engine(ticker_size_rules_, lot_size_rules_, ticker_rules_, book_rules_,
+            pool_options, pipeline_options, *market_data_publisher_);
+    }
+    else
+    {
+        matching_engine_ = create_matching_engine(
+            ticker_size_rules_, lot_size_rules_, ticker_rules_, book_rules_, pool_options);
+    }
+    if (!book_region_options.path.empty())
+    {
+        book_region_ = create_book_region(book_region_options, ticker_rules_, book_rules_);
+        // the books may be behind the journal, whose tail is matched again on recover, never ahead of it
+        resumed_ = book_region_->resumable() && (!journal_ || (journal_->last_record() != no_record &&
+            journal_->last_record() != market_close_record &&
+            book_region_->requests() <= journal_->number_of_requests()));
+        matching_engine_->attach_region(*book_region_, resumed_);
+    }
+    // the last, so gateways only find a queue once the books are ready for their commands
+    if (!order_entry_options_.path.empty() && replication_options.role != replica_role)
+    {
+        order_entry_queue_ = create_order_entry_queue(order_entry_options_);
+    }
 }
 
 Exchange::Exchange(
@@ -77,21 +289,450 @@ close_order_cache_file_(close_order_cache_file)
     initialise(config_file, event_publish_file);
 }
 
-void Exchange::process_request(const std::string& r)
+Exchange::~Exchange()
 {
-    auto events = matching_engine_->process_order(r);
-    market_data_publisher_ ->publish(events);
+    wait_checkpoint();
 }
 
-void Exchange::market_open()
+void Exchange::process_request(std::string_view r)
+{
+    if (journal_)
+    {
+        // parsed here to be journaled before it is matched
+        Request request;
+        if (!RequestParser::parse(r, request))
+        {
+            std::cout << "Cannot parse request: " << r << std::endl;
+            return;
+        }
+        process_batch(std::span<const Request>(&request, 1), false);
+        return;
+    }
+    if (sharded_engine_)
+    {
+        sharded_engine_->process_order(r);
+        return;
+    }
+    if (pipelined_engine_)
+    {
+        pipelined_engine_->process_order(r);
+        return;
+    }
+    publish(matching_engine_->process_order(r));
+}
+
+void Exchange::process_request(std::span<const std::byte> r)
+{
+    process_batch(r);
+}
+
+void Exchange::process_batch(std::span<const std::string> requests, bool conflate)
+{
+    batch_.clear();
+    Request request;
+    for (const auto& s : requests)
+    {
+        if (!RequestParser::parse(s, request))
+        {
+            std::cout << "Cannot parse request: " << s << std::endl;
+            continue;
+        }
+        batch_.push_back(request);
+    }
+    process_batch(batch_, conflate);
+}
+
+void Exchange::process_batch(std::span<const std::byte> requests, bool conflate)
+{
+    batch_.clear();
+    Request request;
+    while (!requests.empty())
+    {
+        const size_t size = binary_protocol::decode(requests, request);
+        if (size == 0)
+        {
+            break;
+        }
+        batch_.push_back(request);
+        requests = requests.subspan(size);
+    }
+    process_batch(batch_, conflate);
+    if (!requests.empty())
+    {
+        // framing is lost past a bad message
+        std::cout << "Cannot decode binary request, dropping " << requests.size() << " bytes." << std::endl;
+    }
+}
+
+void Exchange::process_batch(std::span<const Request> requests, bool conflate)
+{
+    if (journal_)
+    {
+        requests = journal(requests, conflate);
+    }
+    match(requests, conflate);
+    if (journal_stream_ && journal_stream_->primary() && !requests.empty())
+    {
+        journal_stream_->published(event_checksum_);
+    }
+}
+
+std::span<const Request> Exchange::journal(std::span<const Request> requests, bool conflate)
+{
+    journaled_.clear();
+    for (const auto& r : requests)
+    {
+        Request& journaled = journaled_.emplace_back(r);
+        if ((r.type == new_request || r.type == modify_request) && r.symbol_id == Request::unresolved_symbol_id)
+        {
+            journaled.symbol_id = ticker_rules_->symbol_id(r.symbol());
+        }
+        // not matched either, so replaying the journal matches exactly what was matched
+        if (!Journal::accepts(journaled))
+        {
+            std::cout << "Cannot journal request of order " << r.order_id << "." << std::endl;
+            journaled_.pop_back();
+        }
+    }
+    // group commit - synced, as configured, before any of the batch is matched
+    journal_->append(journaled_, conflate);
+    journal_->commit();
+    if (journal_stream_ && journal_stream_->primary() && !journaled_.empty())
+    {
+        journal_stream_->append(journal_->last_frame());
+    }
+    return journaled_;
+}
+
+void Exchange::match(std::span<const Request> requests, bool conflate)
+{
+    // the sharded and pipelined engines batch on their own, and never conflate
+    if (sharded_engine_)
+    {
+        for (const auto& r : requests) sharded_engine_->process_order(r);
+        return;
+    }
+    if (pipelined_engine_)
+    {
+        for (const auto& r : requests) pipelined_engine_->process_order(r);
+        return;
+    }
+    publish(matching_engine_->process_orders(requests, conflate));
+}
+
+void Exchange::publish(const trade_event::EventArena& events)
 {
-    const auto events = matching_engine_->prev_open_setup(close_order_cache_file_);
     market_data_publisher_->publish(events);
+    if (journal_stream_)
+    {
+        event_checksum_ = JournalStream::checksum(event_checksum_, events);
+    }
+    if (book_region_)
+    {
+        book_region_->set_market_data_sequence(market_data_publisher_->next_sequence());
+    }
+}
+
+void Exchange::market_open()
+{
+    if (journal_)
+    {
+        if (journal_->last_record() != no_record)
+        {
+            throw std::runtime_error("The journal holds a day that was not closed - recover it first.");
+        }
+        journal_->append(market_open_record);
+        journal_->sync();
+    }
+    const bool streaming = journal_stream_ && journal_stream_->primary();
+    if (streaming)
+    {
+        journal_stream_->append(journal_->last_frame());
+    }
+    open_books();
+    if (streaming)
+    {
+        journal_stream_->published(event_checksum_);
+    }
+}
+
+void Exchange::open_books()
+{
+    if (sharded_engine_)
+    {
+        sharded_engine_->prev_open_setup(close_order_cache_file_);
+        return;
+    }
+    if (pipelined_engine_)
+    {
+        pipelined_engine_->prev_open_setup(close_order_cache_file_);
+        return;
+    }
+    publish(matching_engine_->prev_open_setup(close_order_cache_file_));
 }
 
 void Exchange::market_close()
 {
-    matching_engine_->eod_cleanup(close_order_cache_file_);
+    // no checkpoint of the day is left running past its close
+    wait_checkpoint();
+    if (!journal_)
+    {
+        close_books(close_order_cache_file_);
+        return;
+    }
+    // the close order cache of the previous day is replaced only once the close is journaled, so a
+    // crash before that recovers the day from it
+    close_books(close_order_cache_file_ + ".tmp");
+    journal_->append(market_close_record);
+    journal_->sync();
+    if (journal_stream_ && journal_stream_->primary())
+    {
+        journal_stream_->append(journal_->last_frame());
+        journal_stream_->published(event_checksum_);
+    }
+    finish_close();
+}
+
+bool Exchange::recover()
+{
+    if (resumed_)
+    {
+        // binary sequence numbers go on from the last one published before the restart
+        const std::uint64_t sequence = market_data_publisher_->next_sequence();
+        if (book_region_->market_data_sequence() > sequence)
+        {
+            market_data_publisher_->take_sequences(book_region_->market_data_sequence() - sequence);
+        }
+        if (!journal_)
+        {
+            return true;
+        }
+    }
+    if (!journal_ || journal_->last_record() == no_record)
+    {
+        return false;
+    }
+    if (journal_->last_record() == market_close_record)
+    {
+        // crashed while closing, after the close order cache was written
+        finish_close();
+        return false;
+    }
+
+    // the replayed events were published before the crash - only the binary sequence numbers move on
+    market_data_publisher_->mute(true);
+    // resumed books already matched the first requests of the day
+    journal_->replay([this](journal_record type, std::span<const Request> requests)
+    {
+        if (type == market_open_record && !resumed_)
+        {
+            open_books();
+        }
+        else if (type == requests_record)
+        {
+            match(requests, false);
+        }
+    }, resumed_ ? book_region_->requests() : 0);
+    if (sharded_engine_)
+    {
+        sharded_engine_->drain();
+    }
+    else if (pipelined_engine_)
+    {
+        pipelined_engine_->drain();
+    }
+    market_data_publisher_->mute(false);
+    return true;
+}
+
+void Exchange::standby()
+{
+    if (!journal_stream_ || journal_stream_->primary())
+    {
+        throw std::runtime_error("Only a replica stands by.");
+    }
+    JournalFrame frame;
+    std::span<const std::byte> data;
+    JournalStream::frame_state state;
+    while ((state = journal_stream_->next(data)) != JournalStream::primary_gone)
+    {
+        const size_t size = Journal::decode(data, frame);
+        if (size == 0)
+        {
+            throw std::runtime_error("Cannot decode frame " + std::to_string(journal_stream_->consumed_frames() + 1) +
+                " of the journal stream.");
+        }
+        journal_stream_->consume(size);
+        // the market data of the frames the primary published went out already
+        market_data_publisher_->mute(state == JournalStream::published_frame);
+        replicate(frame);
+        if (!journal_stream_->verify(event_checksum_))
+        {
+            throw std::runtime_error("The books of the replica differ from the primary's after frame " +
+                std::to_string(journal_stream_->consumed_frames()) + ".");
+        }
+    }
+    market_data_publisher_->mute(false);
+    journal_stream_.reset();
+    if (!order_entry_options_.path.empty())
+    {
+        order_entry_queue_ = create_order_entry_queue(order_entry_options_);
+    }
+}
+
+void Exchange::replicate(const JournalFrame& frame)
+{
+    switch (frame.type)
+    {
+    case market_open_record:
+        market_open();
+        break;
+    case requests_record:
+        process_batch(std::span<const Request>(frame.requests), frame.conflated);
+        break;
+    case market_close_record:
+        market_close();
+        break;
+    default:
+        break;
+    }
+}
+
+void Exchange::serve()
+{
+    if (!order_entry_queue_)
+    {
+        throw std::runtime_error("No order entry queue is configured.");
+    }
+    const OrderEntryOptions& options = order_entry_queue_->options();
+    while (!order_entry_queue_->drained())
+    {
+        batch_.clear();
+        if (order_entry_queue_->drain(batch_, options.batch_size) > 0)
+        {
+            process_batch(std::span<const Request>(batch_), options.conflate);
+        }
+    }
+}
+
+void Exchange::shut_down()
+{
+    if (order_entry_queue_)
+    {
+        order_entry_queue_->shut_down();
+    }
+}
+
+bool Exchange::checkpoint(const std::string& checkpoint_file)
+{
+    if (checkpoint_pid_ > 0)
+    {
+        if (::waitpid(checkpoint_pid_, nullptr, WNOHANG) == 0)
+        {
+            return false;
+        }
+        checkpoint_pid_ = 0;
+    }
+    // the forked copy has this thread only, so the engine threads must have nothing in flight
+    if (sharded_engine_)
+    {
+        sharded_engine_->drain();
+    }
+    else if (pipelined_engine_)
+    {
+        pipelined_engine_->drain();
+    }
+
+    const pid_t pid = ::fork();
+    if (pid < 0)
+    {
+        throw std::runtime_error("Cannot fork to write checkpoint " + checkpoint_file + ".");
+    }
+    if (pid == 0)
+    {
+        // the books are shared copy on write with the parent, which goes on matching - no destructors
+        // run and no buffered market data is flushed on the way out
+        int status = 0;
+        try
+        {
+            write_checkpoint(checkpoint_file);
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << e.what() << '\n';
+            status = 1;
+        }
+        ::_exit(status);
+    }
+    checkpoint_pid_ = pid;
+    return true;
+}
+
+size_t Exchange::number_of_events() const
+{
+    return market_data_publisher_ ? market_data_publisher_->number_of_events() : 0;
+}
+
+std::uint64_t Exchange::market_data_checksum() const
+{
+    return market_data_publisher_ ? market_data_publisher_->checksum() : 0;
+}
+
+void Exchange::write_checkpoint(const std::string& checkpoint_file)
+{
+    order::BookSnapshotWriter snapshot;
+    if (sharded_engine_)
+    {
+        sharded_engine_->checkpoint(snapshot);
+    }
+    else if (pipelined_engine_)
+    {
+        pipelined_engine_->checkpoint(snapshot);
+    }
+    else
+    {
+        matching_engine_->checkpoint(snapshot);
+    }
+    // readers never see a partial checkpoint
+    snapshot.write(checkpoint_file + ".tmp");
+    if (std::rename((checkpoint_file + ".tmp").c_str(), checkpoint_file.c_str()) != 0)
+    {
+        throw std::runtime_error("Cannot move checkpoint " + checkpoint_file + " into place.");
+    }
+}
+
+void Exchange::wait_checkpoint()
+{
+    if (checkpoint_pid_ > 0)
+    {
+        ::waitpid(checkpoint_pid_, nullptr, 0);
+        checkpoint_pid_ = 0;
+    }
+}
+
+void Exchange::finish_close()
+{
+    // fails if a crash came after the rename, which is fine
+    std::rename((close_order_cache_file_ + ".tmp").c_str(), close_order_cache_file_.c_str());
+    journal_->reset();
+}
+
+void Exchange::close_books(const std::string& close_order_cache_file)
+{
+    if (sharded_engine_)
+    {
+        // the sequencer has published the whole day once the shards are drained
+        sharded_engine_->eod_cleanup(close_order_cache_file);
+    }
+    else if (pipelined_engine_)
+    {
+        pipelined_engine_->eod_cleanup(close_order_cache_file);
+    }
+    else
+    {
+        matching_engine_->eod_cleanup(close_order_cache_file);
+    }
+    market_data_publisher_->sync();
 }
 
-} // namespace exchange
\ No newline at end of file
+} // namespace exchange
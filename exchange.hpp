@@ -1,11 +1,24 @@
 #ifndef EXCHANGE_H_
 #define EXCHANGE_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <span>
 #include <string>
+#include <string_view>
+#include <sys/types.h>
 #include <vector>
+#include "book_region.hpp"
+#include "book_rules.hpp"
+#include "journal.hpp"
+#include "journal_stream.hpp"
 #include "market_data_publisher.hpp"
 #include "matching_engine.hpp"
+#include "order_entry_queue.hpp"
+#include "pipelined_engine.hpp"
+#include "request.hpp"
+#include "sharded_engine.hpp"
 #include "size_rules.hpp"
 #include "ticker_rules.hpp"
 
@@ -24,29 +37,104 @@ public:
         const std::string& close_order_cache_file
     );
 
-    ~Exchange() = default;
+    // waits for a checkpoint still being written
+    ~Exchange();
 
-    void process_request(const std::string& r);
+    void process_request(std::string_view r);
+    // binary_protocol messages, back to back
+    void process_request(std::span<const std::byte> r);
+    // A burst of requests, e.g. one read from a socket or file, matched and published in one go -
+    // the same events as one request at a time. With conflate, the depth updates of the burst
+    // collapse into one per symbol with the total of every touched price level after the burst.
+    void process_batch(std::span<const std::string> requests, bool conflate = false);
+    // binary_protocol messages, back to back
+    void process_batch(std::span<const std::byte> requests, bool conflate = false);
+    // requests parsed already, e.g. by a gateway
+    void process_batch(std::span<const Request> requests, bool conflate = false);
     void market_open();
+    // also waits for the market data of the day to be written
     void market_close();
+    // After a crash, instead of market_open: rebuilds the books of the day left open in the journal by
+    // matching its requests again, without publishing their market data a second time. Books resumed
+    // from a book region only match the journal requests they had not matched. False if neither holds
+    // an open day.
+    bool recover();
+    // Hot standby, for an exchange configured as a replica: matches the frames the primary streams
+    // with its market data muted, comparing book checksums as the primary posts them, until the
+    // primary is gone. Then it matches and publishes what the primary left unpublished and returns
+    // promoted - market data goes on from the next sequence number and requests are taken from here.
+    void standby();
+    // Matches the commands gateway processes put on the order entry queue, busy polling it on the
+    // calling thread and taking up to batch_size commands at a time. Returns once the queue is shut
+    // down and every command taken is matched.
+    void serve();
+    // no more commands are taken by serve - safe from another thread or a signal handler
+    void shut_down();
+    // Writes every order resting now to a book snapshot from a forked copy of the process, so matching
+    // only stops for the fork. The sharded and pipelined engines are drained first. False while the
+    // previous checkpoint is still being written.
+    bool checkpoint(const std::string& checkpoint_file);
+
+    // events published so far, and the checksum of their market data with the checksum sink - see
+    // MarketDataPublisher
+    size_t number_of_events() const;
+    std::uint64_t market_data_checksum() const;
 
 private:
+    // appends the requests the journal accepts and returns them
+    std::span<const Request> journal(std::span<const Request> requests, bool conflate);
+    void match(std::span<const Request> requests, bool conflate);
+    // events of the matching engine, with the sequence the market data reached kept in the book region
+    void publish(const trade_event::EventArena& events);
+    // a frame streamed by the primary
+    void replicate(const JournalFrame& frame);
+    void open_books();
+    void close_books(const std::string& close_order_cache_file);
+    // moves the close order cache written for the journaled close into place, and drops the journal
+    void finish_close();
+    // runs in the forked copy
+    void write_checkpoint(const std::string& checkpoint_file);
+    void wait_checkpoint();
     void initialise(
         const std::string& config_file, 
         const std::string& event_publish_file
     );
 
     std::string close_order_cache_file_;
+    // requests of the current batch, reused between batches
+    std::vector<Request> batch_;
+    std::vector<Request> journaled_;
 
     // pointers to size rules
     size_rules::TickSizeRulesCPtr ticker_size_rules_;
     size_rules::LotSizeRulesCPtr lot_size_rules_;
     ticker_rules::TickerRulesCPtr ticker_rules_;
+    book_rules::BookRulesCPtr book_rules_;
 
+    // null unless the books are resident in a book region - outlives the matching engine
+    BookRegionPtr book_region_;
+    // the books of an open day were taken over from the region
+    bool resumed_ = false;
     // pointer to matching engine
     MatchingEnginePtr matching_engine_;
     // pointer to market data publisher
-    MarketDataPublisherCPtr market_data_publisher_;
+    MarketDataPublisherPtr market_data_publisher_;
+    // matches instead of matching_engine_ when sharding is configured - publishes through
+    // market_data_publisher_, so declared after it
+    ShardedEnginePtr sharded_engine_;
+    // same for the pipelined engine
+    PipelinedEnginePtr pipelined_engine_;
+    // null unless a journal path is configured
+    JournalPtr journal_;
+    // null unless replication is configured, dropped once a replica is promoted
+    JournalStreamPtr journal_stream_;
+    // null unless an order entry queue is configured - a replica creates it once promoted
+    OrderEntryOptions order_entry_options_;
+    OrderEntryQueuePtr order_entry_queue_;
+    // rolling checksum of the events published, while replicating
+    std::uint64_t event_checksum_ = JournalStream::initial_checksum;
+    // process writing the last checkpoint, 0 once reaped
+    pid_t checkpoint_pid_ = 0;
     
 };
 
@@ -0,0 +1,441 @@
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "book_rules.hpp"
+#include "event.hpp"
+#include "event_arena.hpp"
+#include "level_order_book.hpp"
+#include "matching_engine.hpp"
+#include "order.hpp"
+#include "order_book.hpp"
+#include "order_flow.hpp"
+#include "price4.hpp"
+#include "request.hpp"
+#include "serialise.hpp"
+#include "size_rules.hpp"
+#include "tick_ladder.hpp"
+#include "ticker_rules.hpp"
+
+// Microbenchmarks of the engine parts on the request path: order book insert, cancel and match at
+// several depths for every book, Price4 parse and format, the size rules checks, order creation from
+// json, event serialisation and whole requests through the matching engine. Every benchmark reports
+// its heap allocations per iteration next to the timings.
+// usage: exchange_bench [google benchmark flags, e.g. --benchmark_filter=OrderBook]
+
+namespace
+{
+
+size_t number_of_allocations = 0;
+
+} // anonymous namespace
+
+// replaced globally to count allocations - kept out of line so callers pair them with each other
+__attribute__((noinline)) void* operator new(size_t size)
+{
+    ++number_of_allocations;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+
+using json = nlohmann::json;
+
+const long tick = 100; // 0.01
+const long mid = 1000000; // 100.00
+// resting orders per price level of the order book benchmarks
+const int orders_per_level = 4;
+const std::vector<std::string> symbols{"AAPL", "IBM", "MSFT", "TSLA", "GOOG"};
+
+// Allocations of the timed part of a benchmark - paused along with the timing.
+class AllocationCount
+{
+public:
+    AllocationCount() : start_(number_of_allocations) {}
+
+    void pause() { counted_ += number_of_allocations - start_; }
+    void resume() { start_ = number_of_allocations; }
+
+    void report(benchmark::State& state)
+    {
+        pause();
+        state.counters["allocs"] = benchmark::Counter(static_cast<double>(counted_),
+            benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    size_t start_;
+    size_t counted_ = 0;
+};
+
+size_rules::TickSizeRulesCPtr create_tick_size_rules()
+{
+    const json j = json::parse(R"([
+        {"from_price": "0", "to_price": "1", "tick_size": "0.0001"},
+        {"from_price": "1", "to_price": "10", "tick_size": "0.001"},
+        {"from_price": "10", "tick_size": "0.01"}
+    ])");
+    return j.get<size_rules::TickSizeRulesCPtr>();
+}
+
+size_rules::LotSizeRulesCPtr create_lot_size_rules()
+{
+    const json j = json::parse(R"([
+        {"from_price": "0", "to_price": "1", "lot_size": "1000"},
+        {"from_price": "1", "to_price": "10", "lot_size": "500"},
+        {"from_price": "10", "lot_size": "100"}
+    ])");
+    return j.get<size_rules::LotSizeRulesCPtr>();
+}
+
+enum book_kind
+{
+    heap_book,
+    price_level_book,
+    tick_ladder_book
+};
+
+const char* book_name(long kind)
+{
+    return kind == heap_book ? "heap" : kind == price_level_book ? "price_level" : "tick_ladder";
+}
+
+order::OrderBookPtr create_book(long kind, order::order_side side)
+{
+    static const auto tick_size_rules = create_tick_size_rules();
+    const std::vector<order::LimitOrderPtr> no_orders;
+    const bool bid = side == order::order_side::bid;
+    switch (kind)
+    {
+    case heap_book:
+        if (bid) return std::make_unique<order::BidOrderBook>(side, 0, no_orders);
+        return std::make_unique<order::AskOrderBook>(side, 0, no_orders);
+
+    case price_level_book:
+        if (bid) return std::make_unique<order::BidLevelOrderBook>(side, 0, no_orders);
+        return std::make_unique<order::AskLevelOrderBook>(side, 0, no_orders);
+
+    default:
+        if (bid)
+        {
+            return std::make_unique<order::BidTickLadderOrderBook>(
+                side, 0, order::BidTickLadder(tick_size_rules), no_orders);
+        }
+        return std::make_unique<order::AskTickLadderOrderBook>(
+            side, 0, order::AskTickLadder(tick_size_rules), no_orders);
+    }
+}
+
+order::LimitOrderPtr create_bid(int order_id, long price)
+{
+    return std::make_shared<order::LimitOrder>(1625787615, order_id, 100, order::time_in_force::day,
+        utils::Price4(price), 0, order::order_side::bid);
+}
+
+// bid book of the given kind with orders_per_level orders at each of depth levels below the mid
+order::OrderBookPtr create_bid_book(long kind, long depth, int& next_id)
+{
+    order::OrderBookPtr book = create_book(kind, order::order_side::bid);
+    trade_event::EventArena events;
+    for (long level = 0; level < depth; ++level)
+    {
+        for (int i = 0; i < orders_per_level; ++i)
+        {
+            events.clear();
+            book->insert_order(create_bid(next_id++, mid - (level + 1) * tick), events);
+        }
+    }
+    return book;
+}
+
+// a bid joining the back of a level, cycling through the levels, and cancelled right away
+void BM_OrderBookInsertCancel(benchmark::State& state)
+{
+    const long depth = state.range(1);
+    int next_id = 0;
+    order::OrderBookPtr book = create_bid_book(state.range(0), depth, next_id);
+    const order::LimitOrderPtr o = create_bid(0, mid);
+    trade_event::EventArena events;
+    long level = 0;
+
+    AllocationCount allocations;
+    for (auto _ : state)
+    {
+        *o = order::LimitOrder(o->time(), next_id, 100, o->tif(), utils::Price4(mid - (level + 1) * tick), 0,
+            order::order_side::bid);
+        events.clear();
+        book->insert_order(o, events);
+        events.clear();
+        book->cancel_order(next_id++, events);
+        level = level + 1 == depth ? 0 : level + 1;
+    }
+    allocations.report(state);
+    state.SetLabel(book_name(state.range(0)));
+}
+
+// a sell taking the order at the front of the best level, which is refilled at its back
+void BM_OrderBookMatch(benchmark::State& state)
+{
+    int next_id = 0;
+    order::OrderBookPtr book = create_bid_book(state.range(0), state.range(1), next_id);
+    const order::LimitOrderPtr sell = std::make_shared<order::LimitOrder>(1625787615, -1, 100,
+        order::time_in_force::immediate_or_cancel, utils::Price4(mid - tick), 0, order::order_side::ask);
+    const order::OrderBasePtr aggressive = sell;
+    const order::LimitOrderPtr refill = create_bid(0, mid - tick);
+    trade_event::EventArena events;
+
+    AllocationCount allocations;
+    for (auto _ : state)
+    {
+        sell->set_quantity(100);
+        events.clear();
+        book->match_order(aggressive, events);
+        *refill = order::LimitOrder(refill->time(), next_id++, 100, order::time_in_force::day,
+            utils::Price4(mid - tick), 0, order::order_side::bid);
+        events.clear();
+        book->insert_order(refill, events);
+    }
+    allocations.report(state);
+    state.SetLabel(book_name(state.range(0)));
+}
+
+void book_arguments(benchmark::internal::Benchmark* b)
+{
+    for (long kind : {heap_book, price_level_book, tick_ladder_book})
+    {
+        for (long depth : {1, 16, 256, 4096})
+        {
+            b->Args({kind, depth});
+        }
+    }
+}
+
+BENCHMARK(BM_OrderBookInsertCancel)->Apply(book_arguments);
+BENCHMARK(BM_OrderBookMatch)->Apply(book_arguments);
+
+const std::vector<std::string_view> price_strings{"100.25", "0.0001", "12345.6789", "7", "99.9", "0.5"};
+
+void BM_Price4Parse(benchmark::State& state)
+{
+    utils::Price4 p;
+    size_t i = 0;
+
+    AllocationCount allocations;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(utils::Price4::parse(price_strings[i], p));
+        benchmark::DoNotOptimize(p);
+        i = i + 1 == price_strings.size() ? 0 : i + 1;
+    }
+    allocations.report(state);
+}
+BENCHMARK(BM_Price4Parse);
+
+void BM_Price4Format(benchmark::State& state)
+{
+    std::vector<utils::Price4> prices;
+    for (const std::string_view s : price_strings)
+    {
+        prices.push_back(utils::Price4(std::string(s)));
+    }
+    size_t i = 0;
+
+    AllocationCount allocations;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(prices[i].to_str());
+        i = i + 1 == prices.size() ? 0 : i + 1;
+    }
+    allocations.report(state);
+}
+BENCHMARK(BM_Price4Format);
+
+// prices in every band of the rules, on and off their tick
+std::vector<utils::Price4> rule_prices()
+{
+    return std::vector<utils::Price4>{utils::Price4(5000), utils::Price4(5001), utils::Price4(52000),
+        utils::Price4(52005), utils::Price4(1000000), utils::Price4(1000050), utils::Price4(25000000)};
+}
+
+void BM_TickSizeIsValid(benchmark::State& state)
+{
+    const size_rules::TickSizeRulesCPtr rules = create_tick_size_rules();
+    const std::vector<utils::Price4> prices = rule_prices();
+    size_t i = 0;
+
+    AllocationCount allocations;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(rules->is_valid(prices[i]));
+        i = i + 1 == prices.size() ? 0 : i + 1;
+    }
+    allocations.report(state);
+}
+BENCHMARK(BM_TickSizeIsValid);
+
+void BM_LotSizeLotType(benchmark::State& state)
+{
+    const size_rules::LotSizeRulesCPtr rules = create_lot_size_rules();
+    const std::vector<utils::Price4> prices = rule_prices();
+    const std::vector<int> lots{50, 100, 250, 500, 1000, 1500, 2000};
+    size_t i = 0;
+
+    AllocationCount allocations;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(rules->lot_type(prices[i], lots[i]));
+        i = i + 1 == prices.size() ? 0 : i + 1;
+    }
+    allocations.report(state);
+}
+BENCHMARK(BM_LotSizeLotType);
+
+void BM_OrderFactoryCreate(benchmark::State& state)
+{
+    const std::vector<const char*> orders{
+        R"({"time": 1625787615, "order_id": 1, "quantity": 300, "side": "buy", "tif": "day",
+            "limit_price": "100.25"})",
+        R"({"time": 1625787615, "order_id": 2, "quantity": 100, "side": "sell", "tif": "good_till_cancel",
+            "limit_price": "100.25", "display_quantity": 100, "hidden_quantity": 900})",
+        R"({"time": 1625787615, "order_id": 3, "quantity": 500, "side": "buy", "tif": "immediate_or_cancel"})"
+    };
+    const json j = json::parse(orders[state.range(0)]);
+
+    AllocationCount allocations;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(order::OrderFactory::create(j, 0));
+    }
+    allocations.report(state);
+    state.SetLabel(state.range(0) == 0 ? "limit" : state.range(0) == 1 ? "iceberg" : "market");
+}
+BENCHMARK(BM_OrderFactoryCreate)->DenseRange(0, 2);
+
+void BM_EventToJson(benchmark::State& state)
+{
+    trade_event::EventBaseCPtr event;
+    switch (state.range(0))
+    {
+    case 0:
+        event = std::make_shared<const trade_event::TradeEvent>(0, utils::Price4(mid), 300);
+        break;
+
+    case 1:
+    {
+        std::vector<trade_event::OrderUpdateInfoCPtr> bids;
+        std::vector<trade_event::OrderUpdateInfoCPtr> asks;
+        for (long level = 0; level < 3; ++level)
+        {
+            bids.push_back(std::make_shared<const trade_event::OrderUpdateInfo>(
+                utils::Price4(mid - (level + 1) * tick), 400, trade_event::trade_action::add_add));
+            asks.push_back(std::make_shared<const trade_event::OrderUpdateInfo>(
+                utils::Price4(mid + (level + 1) * tick), 200, trade_event::trade_action::modify));
+        }
+        event = std::make_shared<const trade_event::DepthUpdateEvent>(0, bids, asks);
+        break;
+    }
+
+    default:
+    {
+        std::vector<std::pair<utils::Price4, int>> info;
+        for (long level = 0; level < 10; ++level)
+        {
+            info.emplace_back(utils::Price4(mid - (level + 1) * tick), 100 * (level + 1));
+        }
+        event = std::make_shared<const trade_event::MarketSnapEvent>(order::order_side::bid, 0, "AAPL", info);
+        break;
+    }
+    }
+
+    AllocationCount allocations;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(event->to_json());
+    }
+    allocations.report(state);
+    state.SetLabel(state.range(0) == 0 ? "trade" : state.range(0) == 1 ? "depth_update" : "market_snap");
+}
+BENCHMARK(BM_EventToJson)->DenseRange(0, 2);
+
+// synthetic order flow over the symbols and rules of the engine, as json lines
+std::vector<std::string> create_request_lines(size_t number_of_requests, unsigned int seed)
+{
+    exchange::OrderFlowOptions options;
+    options.seed = seed;
+    exchange::OrderFlowGenerator generator(options, std::make_shared<const ticker_rules::TickerRules>(symbols),
+        create_tick_size_rules(), create_lot_size_rules());
+    std::vector<std::string> lines(number_of_requests);
+    for (std::string& line : lines)
+    {
+        exchange::append_json(generator.next(), line);
+    }
+    return lines;
+}
+
+exchange::MatchingEnginePtr create_engine()
+{
+    static const auto lot_size_rules = create_lot_size_rules();
+    static const auto tick_size_rules = create_tick_size_rules();
+    static const auto tickers = std::make_shared<const ticker_rules::TickerRules>(symbols);
+    static const auto books = json::parse(R"({"default": "price_level"})").get<book_rules::BookRulesCPtr>();
+    return std::make_unique<exchange::MatchingEngine>(tick_size_rules, lot_size_rules, tickers, books);
+}
+
+// Requests one at a time through a matching engine, as json lines or parsed up front. The engine
+// starts over from empty books, untimed, when the requests run out.
+void BM_MatchingEngineProcessOrder(benchmark::State& state)
+{
+    const bool parsed = state.range(0) != 0;
+    const std::vector<std::string> lines = create_request_lines(1 << 16, 42);
+    std::vector<exchange::Request> requests(lines.size());
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+        exchange::RequestParser::parse(lines[i], requests[i]);
+    }
+    exchange::MatchingEnginePtr engine = create_engine();
+    size_t i = 0;
+    size_t number_of_events = 0;
+
+    AllocationCount allocations;
+    for (auto _ : state)
+    {
+        if (i == lines.size())
+        {
+            state.PauseTiming();
+            allocations.pause();
+            engine = create_engine();
+            i = 0;
+            allocations.resume();
+            state.ResumeTiming();
+        }
+        const trade_event::EventArena& events = parsed ?
+            engine->process_order(requests[i]) : engine->process_order(std::string_view(lines[i]));
+        number_of_events += events.number_of_events();
+        ++i;
+    }
+    allocations.report(state);
+    state.counters["events"] = benchmark::Counter(static_cast<double>(number_of_events),
+        benchmark::Counter::kAvgIterations);
+    state.SetLabel(parsed ? "request" : "json");
+}
+BENCHMARK(BM_MatchingEngineProcessOrder)->DenseRange(0, 1);
+
+} // anonymous namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,93 @@
+#include <csignal>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include "exchange.hpp"
+#include "io_ring.hpp"
+#include "order_gateway.hpp"
+#include "utils.hpp"
+
+// Runs an exchange behind the TCP order entry gateway of its config. Recovers the day left open in
+// the journal or opens a new one, serves connections until SIGINT or SIGTERM, then acks what was read
+// and closes the day.
+// usage: exchange_gateway config_file market_data_file close_order_cache_file
+
+namespace
+{
+
+using json = nlohmann::json;
+
+exchange::OrderGateway* serving = nullptr;
+
+void shut_down(int)
+{
+    if (serving)
+    {
+        serving->shut_down();
+    }
+}
+
+void gateway_options(const std::string& config_file, exchange::GatewayOptions& options,
+    utils::IoOptions& io_options)
+{
+    std::ifstream in(config_file);
+    const json j = json::parse(in);
+    if (j.contains("gateway"))
+    {
+        options = j.at("gateway").get<exchange::GatewayOptions>();
+    }
+    if (j.contains("io"))
+    {
+        io_options = j.at("io").get<utils::IoOptions>();
+    }
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 4)
+    {
+        std::cerr << "usage: exchange_gateway config_file market_data_file close_order_cache_file" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        exchange::GatewayOptions options;
+        utils::IoOptions io_options;
+        gateway_options(argv[1], options, io_options);
+        // a socket per session, and some to spare for the journal and market data
+        const size_t open_files = utils::raise_open_files_limit(options.max_sessions + 64);
+        if (open_files < options.max_sessions + 64)
+        {
+            std::cerr << "Open files limited to " << open_files << ", fewer sessions will be accepted." << std::endl;
+        }
+
+        exchange::Exchange e(argv[1], argv[2], argv[3]);
+        if (!e.recover())
+        {
+            e.market_open();
+        }
+        exchange::OrderGateway gateway(e, options, io_options);
+        std::cerr << "Listening on " << options.address << ":" << gateway.port() << " with "
+            << (gateway.uses_io_uring() ? "io_uring" : "epoll") << std::endl;
+        serving = &gateway;
+        std::signal(SIGINT, shut_down);
+        std::signal(SIGTERM, shut_down);
+        gateway.run();
+        serving = nullptr;
+        e.market_close();
+
+        const exchange::GatewayStats& stats = gateway.stats();
+        std::cerr << stats.sessions << " sessions, " << stats.requests << " requests in " << stats.batches
+            << " batches, " << stats.rejected << " rejected, " << stats.system_calls << " system calls" << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "binary_protocol.hpp"
+#include "exchange.hpp"
+#include "request.hpp"
+
+// Replays a request file into an exchange - json lines, or binary_protocol messages back to back -
+// from a read only mapping, every request handed over in place. As fast as possible unless a speed is
+// given, then at the pace of the request times scaled by it. Reports messages and events per second
+// and the time each request took to hand over, which is its matching too unless the config shards or
+// pipelines the engine. The market_data block of the config picks the sink: a file, null to time the
+// engine alone, or checksum to encode without writing.
+// usage: exchange_replay config_file requests_file market_data_file close_order_cache_file [json|binary]
+//     [speed]
+
+namespace
+{
+
+using json = nlohmann::json;
+using clock_type = std::chrono::steady_clock;
+
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& file)
+    {
+        fd_ = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd_ < 0 || ::fstat(fd_, &st) != 0)
+        {
+            throw std::runtime_error("Cannot open request file " + file + ": " + std::strerror(errno) + ".");
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ == 0) return;
+        // read once front to back, faulted in up front so page faults are not timed
+        data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd_, 0);
+        if (data_ == MAP_FAILED)
+        {
+            data_ = nullptr;
+            ::close(fd_);
+            throw std::runtime_error("Cannot map request file " + file + ".");
+        }
+        ::madvise(data_, size_, MADV_SEQUENTIAL);
+    }
+
+    ~MappedFile()
+    {
+        if (data_)
+        {
+            ::munmap(data_, size_);
+        }
+        ::close(fd_);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view text() const { return std::string_view(static_cast<const char*>(data_), size_); }
+    std::span<const std::byte> bytes() const
+    {
+        return std::span<const std::byte>(static_cast<const std::byte*>(data_), size_);
+    }
+
+private:
+    int fd_ = -1;
+    void* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// the non empty lines, and their request times if paced
+void split_lines(std::string_view text, bool paced, std::vector<std::string_view>& lines,
+    std::vector<int>& times)
+{
+    exchange::Request r;
+    while (!text.empty())
+    {
+        const size_t end = std::min(text.find('\n'), text.size());
+        const std::string_view line = text.substr(0, end);
+        text.remove_prefix(std::min(end + 1, text.size()));
+        if (line.empty()) continue;
+
+        lines.push_back(line);
+        if (paced)
+        {
+            // unparseable requests keep the pace of the one before
+            times.push_back(exchange::RequestParser::parse(line, r) ? r.time : (times.empty() ? 0 : times.back()));
+        }
+    }
+}
+
+// the messages, and their request times if paced - false if one is malformed
+bool split_messages(std::span<const std::byte> bytes, bool paced,
+    std::vector<std::span<const std::byte>>& messages, std::vector<int>& times)
+{
+    exchange::Request r;
+    while (!bytes.empty())
+    {
+        const size_t size = binary_protocol::decode(bytes, r);
+        if (size == 0) return false;
+
+        messages.push_back(bytes.first(size));
+        if (paced)
+        {
+            times.push_back(r.time);
+        }
+        bytes = bytes.subspan(size);
+    }
+    return true;
+}
+
+// Hands every request to the exchange, timing each, and at the recorded pace if speed is not 0.
+// Returns the time from the first request handed over to the last.
+template <typename T>
+clock_type::duration replay(exchange::Exchange& e, const std::vector<T>& requests, const std::vector<int>& times,
+    double speed, std::vector<double>& latencies)
+{
+    latencies.reserve(requests.size());
+    const clock_type::time_point start = clock_type::now();
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+        if (speed > 0)
+        {
+            const clock_type::time_point due = start + std::chrono::duration_cast<clock_type::duration>(
+                std::chrono::duration<double>((times[i] - times.front()) / speed));
+            std::this_thread::sleep_until(due);
+        }
+        const clock_type::time_point before = clock_type::now();
+        e.process_request(requests[i]);
+        latencies.push_back(std::chrono::duration<double, std::nano>(clock_type::now() - before).count());
+    }
+    return clock_type::now() - start;
+}
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * static_cast<double>(sorted.size())))];
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 5)
+    {
+        std::cerr << "usage: exchange_replay config_file requests_file market_data_file close_order_cache_file "
+            "[json|binary] [speed]" << std::endl;
+        return 1;
+    }
+    const bool binary = argc > 5 && std::string(argv[5]) == "binary";
+    const double speed = argc > 6 ? std::max(std::strtod(argv[6], nullptr), 0.0) : 0;
+
+    try
+    {
+        std::ifstream config(argv[1]);
+        const json j = json::parse(config);
+        const exchange::PublisherOptions publisher_options = j.contains("market_data") ?
+            j.at("market_data").get<exchange::PublisherOptions>() : exchange::PublisherOptions();
+
+        const MappedFile file(argv[2]);
+        std::vector<std::string_view> lines;
+        std::vector<std::span<const std::byte>> messages;
+        std::vector<int> times;
+        if (!binary)
+        {
+            split_lines(file.text(), speed > 0, lines, times);
+        }
+        else if (!split_messages(file.bytes(), speed > 0, messages, times))
+        {
+            std::cerr << "Malformed binary request after " << messages.size() << " messages." << std::endl;
+            return 1;
+        }
+
+        exchange::Exchange e(argv[1], argv[3], argv[4]);
+        if (!e.recover())
+        {
+            e.market_open();
+        }
+        const size_t events_before = e.number_of_events();
+        std::vector<double> latencies;
+        const clock_type::duration elapsed = binary ?
+            replay(e, messages, times, speed, latencies) : replay(e, lines, times, speed, latencies);
+        const size_t number_of_events = e.number_of_events() - events_before;
+        const clock_type::time_point close_start = clock_type::now();
+        e.market_close();
+        const clock_type::duration close_elapsed = clock_type::now() - close_start;
+
+        std::sort(latencies.begin(), latencies.end());
+        const double seconds = std::chrono::duration<double>(elapsed).count();
+        std::cout << latencies.size() << " " << (binary ? "binary" : "json") << " requests, " << number_of_events
+            << " events in " << std::fixed << std::setprecision(3) << seconds << " s, market close "
+            << std::chrono::duration<double>(close_elapsed).count() << " s\n";
+        std::cout << std::setprecision(0) << latencies.size() / seconds << " messages/s, "
+            << number_of_events / seconds << " events/s\n";
+        std::cout << "request ns: p50 " << percentile(latencies, 0.5) << ", p90 " << percentile(latencies, 0.9)
+            << ", p99 " << percentile(latencies, 0.99) << ", p99.9 " << percentile(latencies, 0.999)
+            << ", max " << (latencies.empty() ? 0 : latencies.back()) << "\n";
+        if (publisher_options.sink == exchange::checksum_sink)
+        {
+            std::cout << "market data checksum " << std::hex << std::setw(16) << std::setfill('0')
+                << e.market_data_checksum() << std::dec << "\n";
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,41 @@
+#include <exception>
+#include <iostream>
+#include <string>
+#include "exchange.hpp"
+
+// Hot standby of an exchange on the same machine, configured with the replication role "replica" and
+// the stream path of the primary. Follows the primary until it is gone, then takes over and matches
+// the json requests read from standard input, one per line. A day left open at the end of the input
+// stays in the journal of the replica, for recover.
+// usage: exchange_replica config_file market_data_file close_order_cache_file
+
+int main(int argc, char** argv)
+{
+    if (argc < 4)
+    {
+        std::cerr << "usage: exchange_replica config_file market_data_file close_order_cache_file" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        exchange::Exchange e(argv[1], argv[2], argv[3]);
+        e.standby();
+        std::cerr << "The primary is gone, taking over." << std::endl;
+
+        std::string request;
+        while (std::getline(std::cin, request))
+        {
+            if (!request.empty())
+            {
+                e.process_request(request);
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include <csignal>
+#include <exception>
+#include <iostream>
+#include "exchange.hpp"
+
+// Runs an exchange fed by gateway processes through the order entry queue of its config. Recovers the
+// day left open in the journal or opens a new one, matches until SIGINT or SIGTERM, then drains the
+// queue and closes the day.
+// usage: exchange_server config_file market_data_file close_order_cache_file
+
+namespace
+{
+
+exchange::Exchange* serving = nullptr;
+
+void shut_down(int)
+{
+    if (serving)
+    {
+        serving->shut_down();
+    }
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 4)
+    {
+        std::cerr << "usage: exchange_server config_file market_data_file close_order_cache_file" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        exchange::Exchange e(argv[1], argv[2], argv[3]);
+        if (!e.recover())
+        {
+            e.market_open();
+        }
+        serving = &e;
+        std::signal(SIGINT, shut_down);
+        std::signal(SIGTERM, shut_down);
+        e.serve();
+        serving = nullptr;
+        e.market_close();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
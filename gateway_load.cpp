@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+#include "binary_protocol.hpp"
+#include "gateway_protocol.hpp"
+#include "order_gateway.hpp"
+#include "request.hpp"
+#include "utils.hpp"
+
+// Load for the order entry gateway: opens many loopback connections at once, each keeping in_flight
+// requests outstanding - resting orders a few ticks off the mid, each cancelled by the next request -
+// and reports the throughput and the round trip from sending a request to reading its ack.
+// usage: gateway_load config_file [connections] [requests_per_connection] [in_flight] [json|binary]
+
+namespace
+{
+
+using json = nlohmann::json;
+using clock_type = std::chrono::steady_clock;
+
+constexpr size_t max_request_size = 256;
+constexpr size_t max_frame_size = gateway_protocol::header_size + max_request_size;
+constexpr size_t receive_buffer_bytes = 4096;
+
+struct Connection
+{
+    int fd = -1;
+    size_t sent = 0;
+    size_t acked = 0;
+    // send time of the requests in flight, by sequence number
+    std::unique_ptr<clock_type::time_point[]> sent_at;
+    std::unique_ptr<std::byte[]> send_buffer;
+    size_t send_begin = 0;
+    size_t send_end = 0;
+    std::byte receive_buffer[receive_buffer_bytes];
+    size_t received = 0;
+};
+
+struct Load
+{
+    std::vector<std::string> symbols;
+    size_t requests_per_connection = 0;
+    size_t in_flight = 1;
+    bool binary = false;
+    std::vector<Connection> connections;
+    std::vector<double> round_trips;
+    size_t rejected = 0;
+    size_t out_of_order = 0;
+    size_t finished = 0;
+};
+
+// request i of the connection, framed into its send buffer
+void queue_request(Load& load, size_t id)
+{
+    Connection& c = load.connections[id];
+    const size_t i = c.sent;
+    const long tick = 100; // 0.01
+    const long mid = 1000000; // 100.00
+
+    exchange::Request r;
+    r.time = 1625787615;
+    // the ids of the connections do not overlap
+    r.order_id = static_cast<int>((id * load.requests_per_connection + i) / 2);
+    if (i % 2 == 0)
+    {
+        r.type = exchange::new_request;
+        r.symbol_id = static_cast<int>(i / 2 % load.symbols.size());
+        r.order_type = order::order_type::limit;
+        r.side = i / 2 % 4 < 2 ? order::order_side::bid : order::order_side::ask;
+        r.tif = order::time_in_force::day;
+        r.quantity = 100;
+        const long offset = static_cast<long>(1 + i / 2 % 5) * tick;
+        r.limit_price = utils::Price4(r.side == order::order_side::bid ? mid - offset : mid + offset);
+    }
+    else
+    {
+        r.type = exchange::cancel_request;
+    }
+
+    std::byte* frame = c.send_buffer.get() + c.send_end;
+    std::byte* payload = frame + gateway_protocol::header_size;
+    size_t size;
+    if (load.binary)
+    {
+        size = binary_protocol::encode(r, std::span<std::byte>(payload, max_request_size));
+    }
+    else
+    {
+        char* text = reinterpret_cast<char*>(payload);
+        const long price = r.limit_price.unscaled() / tick;
+        const int written = r.type == exchange::new_request ?
+            std::snprintf(text, max_request_size, "{\"time\": %d, \"type\": \"NEW\", \"order_id\": %d, "
+                "\"symbol\": \"%s\", \"side\": \"%s\", \"quantity\": %d, \"limit_price\": \"%ld.%02ld\", "
+                "\"tif\": \"day\"}", r.time, r.order_id, load.symbols[r.symbol_id].c_str(),
+                r.side == order::order_side::bid ? "buy" : "sell", r.quantity, price / 100, price % 100) :
+            std::snprintf(text, max_request_size, "{\"time\": %d, \"type\": \"CANCEL\", \"order_id\": %d}",
+                r.time, r.order_id);
+        size = static_cast<size_t>(written);
+    }
+    gateway_protocol::encode_header(load.binary ? gateway_protocol::binary_request : gateway_protocol::json_request,
+        size, std::span<std::byte>(frame, gateway_protocol::header_size));
+    c.send_end += gateway_protocol::header_size + size;
+    c.sent_at[i % load.in_flight] = clock_type::now();
+    ++c.sent;
+}
+
+// false if the gateway went away
+bool flush(Connection& c)
+{
+    while (c.send_begin < c.send_end)
+    {
+        const ssize_t n = ::send(c.fd, c.send_buffer.get() + c.send_begin, c.send_end - c.send_begin, MSG_NOSIGNAL);
+        if (n > 0)
+        {
+            c.send_begin += static_cast<size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+    c.send_begin = 0;
+    c.send_end = 0;
+    return true;
+}
+
+// tops the requests in flight up again
+bool send_requests(Load& load, size_t id)
+{
+    Connection& c = load.connections[id];
+    while (c.sent < load.requests_per_connection && c.sent - c.acked < load.in_flight)
+    {
+        queue_request(load, id);
+    }
+    return flush(c);
+}
+
+// false if the gateway went away
+bool receive_acks(Load& load, size_t id)
+{
+    Connection& c = load.connections[id];
+    for (;;)
+    {
+        const ssize_t n = ::recv(c.fd, c.receive_buffer + c.received, receive_buffer_bytes - c.received, 0);
+        if (n == 0) return false;
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        c.received += static_cast<size_t>(n);
+
+        const clock_type::time_point now = clock_type::now();
+        size_t parsed = 0;
+        gateway_protocol::FrameHeader header;
+        gateway_protocol::Ack ack;
+        while (c.received - parsed >= gateway_protocol::ack_frame_size)
+        {
+            const std::span<const std::byte> frame(c.receive_buffer + parsed, gateway_protocol::ack_frame_size);
+            gateway_protocol::decode_header(frame, header);
+            if (header.type != gateway_protocol::ack || header.payload_size != gateway_protocol::ack_size ||
+                !gateway_protocol::decode_ack(frame.subspan(gateway_protocol::header_size), ack))
+            {
+                std::cerr << "Bad frame from the gateway." << std::endl;
+                return false;
+            }
+            parsed += gateway_protocol::ack_frame_size;
+            if (ack.sequence != c.acked + 1) ++load.out_of_order;
+            if (ack.status != gateway_protocol::accepted) ++load.rejected;
+            load.round_trips.push_back(
+                std::chrono::duration<double, std::micro>(now - c.sent_at[c.acked % load.in_flight]).count());
+            ++c.acked;
+        }
+        std::memmove(c.receive_buffer, c.receive_buffer + parsed, c.received - parsed);
+        c.received -= parsed;
+
+        if (c.acked == load.requests_per_connection)
+        {
+            ++load.finished;
+            return true;
+        }
+        if (!send_requests(load, id)) return false;
+    }
+}
+
+int connect_to(const sockaddr_in& address)
+{
+    const int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        return -1;
+    }
+    const int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * static_cast<double>(sorted.size())))];
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: gateway_load config_file [connections] [requests_per_connection] [in_flight] "
+            "[json|binary]" << std::endl;
+        return 1;
+    }
+    std::ifstream config(argv[1]);
+    const json j = json::parse(config);
+    const exchange::GatewayOptions options = j.contains("gateway") ?
+        j.at("gateway").get<exchange::GatewayOptions>() : exchange::GatewayOptions();
+
+    Load load;
+    load.symbols = j.at("symbols").get<std::vector<std::string>>();
+    const size_t number_of_connections = argc > 2 ? std::max<size_t>(std::strtoul(argv[2], nullptr, 10), 1) : 2000;
+    load.requests_per_connection = argc > 3 ? std::max<size_t>(std::strtoul(argv[3], nullptr, 10), 1) : 500;
+    load.in_flight = argc > 4 ? std::max<size_t>(std::strtoul(argv[4], nullptr, 10), 1) : 1;
+    load.binary = argc > 5 && std::string(argv[5]) == "binary";
+    if (number_of_connections * load.requests_per_connection / 2 > static_cast<size_t>(INT_MAX))
+    {
+        std::cerr << "Too many requests for int order ids." << std::endl;
+        return 1;
+    }
+    if (utils::raise_open_files_limit(number_of_connections + 16) < number_of_connections + 16)
+    {
+        std::cerr << "Not enough open files for " << number_of_connections << " connections." << std::endl;
+        return 1;
+    }
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<std::uint16_t>(options.port));
+    if (::inet_pton(AF_INET, options.address.c_str(), &address.sin_addr) != 1)
+    {
+        std::cerr << "Gateway address " << options.address << " is not an IPv4 address." << std::endl;
+        return 1;
+    }
+
+    const int epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    load.connections.resize(number_of_connections);
+    for (size_t id = 0; id < number_of_connections; ++id)
+    {
+        Connection& c = load.connections[id];
+        c.fd = connect_to(address);
+        if (c.fd < 0)
+        {
+            std::cerr << "Cannot connect to " << options.address << ":" << options.port << " - "
+                << std::strerror(errno) << ", " << id << " connections open." << std::endl;
+            return 1;
+        }
+        c.sent_at = std::make_unique<clock_type::time_point[]>(load.in_flight);
+        c.send_buffer = std::make_unique<std::byte[]>(load.in_flight * max_frame_size);
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.u64 = id;
+        ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c.fd, &event);
+    }
+    load.round_trips.reserve(number_of_connections * load.requests_per_connection);
+
+    const auto start = clock_type::now();
+    for (size_t id = 0; id < number_of_connections; ++id)
+    {
+        send_requests(load, id);
+    }
+    std::vector<epoll_event> events(1024);
+    while (load.finished < number_of_connections)
+    {
+        const int n = ::epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), 5000);
+        if (n == 0)
+        {
+            std::cerr << "No acks for 5 s, " << load.finished << " connections finished." << std::endl;
+            return 1;
+        }
+        for (int i = 0; i < n; ++i)
+        {
+            const size_t id = events[i].data.u64;
+            Connection& c = load.connections[id];
+            if (c.acked == load.requests_per_connection) continue;
+            if (((events[i].events & EPOLLOUT) && !flush(c)) ||
+                ((events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) && !receive_acks(load, id)))
+            {
+                std::cerr << "Gateway closed connection " << id << " after " << c.acked << " acks." << std::endl;
+                return 1;
+            }
+        }
+    }
+    const auto end = clock_type::now();
+    for (auto& c : load.connections)
+    {
+        ::close(c.fd);
+    }
+    ::close(epoll_fd);
+
+    std::vector<double>& round_trips = load.round_trips;
+    std::sort(round_trips.begin(), round_trips.end());
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << number_of_connections << " connections, " << load.requests_per_connection << " "
+        << (load.binary ? "binary" : "json") << " requests each, " << load.in_flight << " in flight\n";
+    std::cout << std::fixed << std::setprecision(0) << round_trips.size() / seconds << " requests/s, "
+        << load.rejected << " rejected, " << load.out_of_order << " acks out of order\n";
+    std::cout << std::setprecision(1) << "round trip us: p50 " << percentile(round_trips, 0.5)
+        << ", p90 " << percentile(round_trips, 0.9) << ", p99 " << percentile(round_trips, 0.99)
+        << ", p99.9 " << percentile(round_trips, 0.999) << ", max " << (round_trips.empty() ? 0 : round_trips.back())
+        << "\n";
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include <algorithm>
+#include "byte_order.hpp"
+#include "gateway_protocol.hpp"
+
+namespace gateway_protocol
+{
+
+using utils::get_le;
+using utils::put_le;
+
+size_t encode_header(frame_type type, size_t payload_size, std::span<std::byte> out)
+{
+    if (out.size() < header_size || payload_size > max_payload_size) return 0;
+    put_le<std::uint16_t>(out.data(), static_cast<std::uint16_t>(payload_size));
+    put_le<std::uint8_t>(out.data() + 2, type);
+    put_le<std::uint8_t>(out.data() + 3, 0);
+    return header_size;
+}
+
+bool decode_header(std::span<const std::byte> in, FrameHeader& header)
+{
+    if (in.size() < header_size) return false;
+    header.payload_size = get_le<std::uint16_t>(in.data());
+    header.type = get_le<std::uint8_t>(in.data() + 2);
+    return true;
+}
+
+size_t encode_ack(const Ack& ack, std::span<std::byte> out)
+{
+    if (out.size() < ack_frame_size) return 0;
+    encode_header(gateway_protocol::ack, ack_size, out);
+    std::byte* p = out.data() + header_size;
+    std::fill(p, p + ack_size, std::byte{0});
+    put_le<std::uint8_t>(p, ack.status);
+    put_le<std::int32_t>(p + 4, ack.order_id);
+    put_le<std::uint64_t>(p + 8, ack.sequence);
+    return ack_frame_size;
+}
+
+bool decode_ack(std::span<const std::byte> payload, Ack& ack)
+{
+    if (payload.size() != ack_size) return false;
+    const std::uint8_t status = get_le<std::uint8_t>(payload.data());
+    if (status != accepted && status != rejected) return false;
+    ack.status = static_cast<ack_status>(status);
+    ack.order_id = get_le<std::int32_t>(payload.data() + 4);
+    ack.sequence = get_le<std::uint64_t>(payload.data() + 8);
+    return true;
+}
+
+} // namespace gateway_protocol
@@ -0,0 +1,69 @@
+#ifndef GATEWAY_PROTOCOL_HPP_
+#define GATEWAY_PROTOCOL_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// Framing of the order entry gateway connections. Every frame is a little-endian 4 byte header and
+// its payload:
+//
+//   header      0  u16  payload size    2  u8  frame type ('J', 'B' or 'A')    3  u8  reserved
+//   json        an order entry json request, as RequestParser takes it
+//   binary      one binary_protocol message
+//   ack         0  u8   status (0 accepted, 1 rejected)                        1  u8[3] reserved
+//               4  i32  order id (-1 when the request could not be read)
+//               8  u64  sequence number of the request on the connection, from 1
+//
+// Clients send json and binary frames, mixed as they like; the gateway answers every one of them with
+// an ack, in order, once the exchange has taken the request.
+namespace gateway_protocol
+{
+
+enum frame_type : std::uint8_t
+{
+    json_request = 'J',
+    binary_request = 'B',
+    ack = 'A'
+};
+
+enum ack_status : std::uint8_t
+{
+    // journaled if a journal is configured, and matched
+    accepted = 0,
+    // not a request, e.g. malformed json
+    rejected = 1
+};
+
+constexpr size_t header_size = 4;
+constexpr size_t max_payload_size = 0xffff;
+constexpr size_t ack_size = 16;
+constexpr size_t ack_frame_size = header_size + ack_size;
+
+struct FrameHeader
+{
+    size_t payload_size = 0;
+    std::uint8_t type = 0;
+};
+
+struct Ack
+{
+    ack_status status = accepted;
+    int order_id = -1;
+    std::uint64_t sequence = 0;
+};
+
+// Writes the header of a frame to the front of out - returns the bytes written, 0 if out is too
+// small or the payload too large.
+size_t encode_header(frame_type type, size_t payload_size, std::span<std::byte> out);
+// reads the header at the front of in - false if in is shorter than a header
+bool decode_header(std::span<const std::byte> in, FrameHeader& header);
+
+// the whole ack frame, header included - 0 if out is too small
+size_t encode_ack(const Ack& ack, std::span<std::byte> out);
+// the payload of an ack frame - false if it is not one
+bool decode_ack(std::span<const std::byte> payload, Ack& ack);
+
+} // namespace gateway_protocol
+
+#endif
@@ -0,0 +1,194 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <string>
+#include <vector>
+#include "order.hpp"
+#include "request.hpp"
+#include "ticker_rules.hpp"
+
+// Compares order entry decoding through a json DOM with the schema-specific request parser, on a mix
+// of limit, iceberg and market orders, cancels and replenishes. Counts heap allocations per message.
+// usage: ingress_bench [number_of_messages] [seed]
+
+namespace
+{
+
+size_t number_of_allocations = 0;
+
+} // anonymous namespace
+
+// replaced globally to count allocations - kept out of line so callers pair them with each other
+__attribute__((noinline)) void* operator new(size_t size)
+{
+    ++number_of_allocations;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+
+using json = nlohmann::json;
+
+const std::vector<std::string> symbols{"AAPL", "IBM", "MSFT", "TSLA", "GOOG"};
+
+std::vector<std::string> create_messages(size_t number_of_messages, unsigned int seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::uniform_int_distribution<int> lots(1, 10);
+    std::uniform_int_distribution<int> ticks(9900, 10100);
+    std::uniform_int_distribution<size_t> symbol(0, symbols.size() - 1);
+
+    std::vector<std::string> messages;
+    messages.reserve(number_of_messages);
+    int time = 1625787615;
+    for (int order_id = 0; messages.size() < number_of_messages; ++order_id)
+    {
+        const double r = uniform(gen);
+        const std::string id = std::to_string(order_id);
+        const std::string t = std::to_string(time + order_id / 100);
+        if (r < 0.15 && order_id > 0)
+        {
+            messages.push_back("{\"time\": " + t + ", \"type\": \"CANCEL\", \"order_id\": " +
+                std::to_string(order_id / 2) + "}");
+            continue;
+        }
+        if (r < 0.2 && order_id > 0)
+        {
+            messages.push_back("{\"time\": " + t + ", \"type\": \"REPLENISH\", \"order_id\": " +
+                std::to_string(order_id / 2) + ", \"quantity\": 100}");
+            continue;
+        }
+
+        const std::string head = "{\"time\": " + t + ", \"type\": \"NEW\", \"order_id\": " + id +
+            ", \"symbol\": \"" + symbols[symbol(gen)] + "\", \"side\": \"" + (uniform(gen) < 0.5 ? "buy" : "sell") + "\", ";
+        const int ticks_from_zero = ticks(gen);
+        const std::string price = std::to_string(ticks_from_zero / 100) + "." +
+            (ticks_from_zero % 100 < 10 ? "0" : "") + std::to_string(ticks_from_zero % 100);
+        if (r < 0.25)
+        {
+            messages.push_back(head + "\"quantity\": " + std::to_string(100 * lots(gen)) +
+                ", \"tif\": \"immediate_or_cancel\"}");
+        }
+        else if (r < 0.3)
+        {
+            messages.push_back(head + "\"display_quantity\": 100, \"hidden_quantity\": " +
+                std::to_string(100 * lots(gen)) + ", \"limit_price\": \"" + price + "\", \"tif\": \"day\"}");
+        }
+        else
+        {
+            messages.push_back(head + "\"quantity\": " + std::to_string(100 * lots(gen)) +
+                ", \"limit_price\": \"" + price + "\", \"tif\": \"good_till_cancel\"}");
+        }
+    }
+    return messages;
+}
+
+// decoding as the engine did before the request parser
+size_t decode_json(const std::vector<std::string>& messages, const ticker_rules::TickerRules& ticker_rules,
+    bool create)
+{
+    size_t checksum = 0;
+    for (const auto& s : messages)
+    {
+        const json j = json::parse(s);
+        if (j.at("type") == "NEW")
+        {
+            const int symbol_id = ticker_rules.symbol_id(j.at("symbol").get<std::string>());
+            if (create)
+            {
+                checksum += order::OrderFactory::create(j, symbol_id)->quantity();
+            }
+            else
+            {
+                checksum += symbol_id + j.at("order_id").get<int>();
+            }
+        }
+        else
+        {
+            checksum += j.at("order_id").get<int>();
+        }
+    }
+    return checksum;
+}
+
+size_t decode_request(const std::vector<std::string>& messages, const ticker_rules::TickerRules& ticker_rules,
+    bool create)
+{
+    size_t checksum = 0;
+    exchange::Request r;
+    for (const auto& s : messages)
+    {
+        if (!exchange::RequestParser::parse(s, r)) continue;
+        if (r.type == exchange::new_request)
+        {
+            const int symbol_id = ticker_rules.symbol_id(r.symbol());
+            if (create)
+            {
+                checksum += exchange::create_order(r, symbol_id)->quantity();
+            }
+            else
+            {
+                checksum += symbol_id + r.order_id;
+            }
+        }
+        else
+        {
+            checksum += r.order_id;
+        }
+    }
+    return checksum;
+}
+
+template <typename F>
+void run(const std::string& name, const std::vector<std::string>& messages, F f)
+{
+    const size_t allocations_before = number_of_allocations;
+    const auto start = std::chrono::steady_clock::now();
+    const size_t checksum = f();
+    const auto end = std::chrono::steady_clock::now();
+    const size_t allocations = number_of_allocations - allocations_before;
+
+    const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    std::cout << std::left << std::setw(22) << name
+        << std::right << std::setw(12) << std::fixed << std::setprecision(1) << ns / messages.size()
+        << std::setw(14) << std::setprecision(2) << static_cast<double>(allocations) / messages.size()
+        << std::setw(16) << checksum
+        << "\n";
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    const size_t number_of_messages = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const unsigned int seed = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 42;
+
+    const ticker_rules::TickerRules ticker_rules(symbols);
+    const auto messages = create_messages(number_of_messages, seed);
+
+    std::cout << number_of_messages << " messages, seed " << seed << "\n";
+    std::cout << std::left << std::setw(22) << "path" << std::right << std::setw(12) << "ns/msg"
+        << std::setw(14) << "allocs/msg" << std::setw(16) << "checksum" << "\n";
+    run("json decode", messages, [&]() { return decode_json(messages, ticker_rules, false); });
+    run("request decode", messages, [&]() { return decode_request(messages, ticker_rules, false); });
+    run("json decode+order", messages, [&]() { return decode_json(messages, ticker_rules, true); });
+    run("request decode+order", messages, [&]() { return decode_request(messages, ticker_rules, true); });
+    return 0;
+}
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "io_ring.hpp"
+
+namespace utils
+{
+
+namespace
+{
+
+int io_uring_setup(unsigned entries, io_uring_params& params)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+}
+
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int io_uring_register(int fd, unsigned op, const void* arg, unsigned number_of_args)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, op, arg, number_of_args));
+}
+
+std::byte* map(size_t size, int fd, off_t offset)
+{
+    void* p = fd >= 0 ?
+        ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset) :
+        ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    return p == MAP_FAILED ? nullptr : static_cast<std::byte*>(p);
+}
+
+std::string error_text()
+{
+    return std::strerror(errno);
+}
+
+} // anonymous namespace
+
+IoRing::IoRing(size_t entries)
+{
+    io_uring_params params{};
+    fd_ = io_uring_setup(static_cast<unsigned>(entries), params);
+    if (fd_ < 0)
+    {
+        throw std::runtime_error("Cannot set up an io_uring: " + error_text() + ".");
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP))
+    {
+        ::close(fd_);
+        throw std::runtime_error("The io_uring of this kernel is too old.");
+    }
+
+    // submission and completion rings share one mapping
+    rings_size_ = std::max<size_t>(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    rings_ = map(rings_size_, fd_, IORING_OFF_SQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    std::byte* sqes = map(sqes_size_, fd_, IORING_OFF_SQES);
+    if (!rings_ || !sqes)
+    {
+        const std::string error = error_text();
+        if (rings_) ::munmap(rings_, rings_size_);
+        if (sqes) ::munmap(sqes, sqes_size_);
+        ::close(fd_);
+        throw std::runtime_error("Cannot map an io_uring: " + error + ".");
+    }
+    sqes_ = reinterpret_cast<io_uring_sqe*>(sqes);
+    sq_entries_ = params.sq_entries;
+    sq_mask_ = *reinterpret_cast<unsigned*>(rings_ + params.sq_off.ring_mask);
+    sq_head_ = reinterpret_cast<unsigned*>(rings_ + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(rings_ + params.sq_off.tail);
+    sqe_tail_ = *sq_tail_;
+    cq_mask_ = *reinterpret_cast<unsigned*>(rings_ + params.cq_off.ring_mask);
+    cq_head_ = reinterpret_cast<unsigned*>(rings_ + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(rings_ + params.cq_off.tail);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(rings_ + params.cq_off.cqes);
+    // entry i of the submission queue is always sqe i
+    unsigned* array = reinterpret_cast<unsigned*>(rings_ + params.sq_off.array);
+    for (unsigned i = 0; i < sq_entries_; ++i)
+    {
+        array[i] = i;
+    }
+
+    constexpr size_t number_of_ops = 256;
+    const size_t probe_size = sizeof(io_uring_probe) + number_of_ops * sizeof(io_uring_probe_op);
+    std::unique_ptr<std::byte[]> probe_buffer(new std::byte[probe_size]());
+    io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(probe_buffer.get());
+    if (io_uring_register(fd_, IORING_REGISTER_PROBE, probe, number_of_ops) == 0)
+    {
+        for (size_t op = 0; op < probe->ops_len && op < number_of_ops; ++op)
+        {
+            supported_ops_.set(op, (probe->ops[op].flags & IO_URING_OP_SUPPORTED) != 0);
+        }
+    }
+}
+
+IoRing::~IoRing()
+{
+    if (provided_) ::munmap(provided_, provided_count_ * provided_size_);
+    ::munmap(sqes_, sqes_size_);
+    ::munmap(rings_, rings_size_);
+    ::close(fd_);
+}
+
+bool IoRing::enabled(const IoOptions& options, std::initializer_list<std::uint8_t> ops)
+{
+    if (options.backend == posix_io_backend) return false;
+    if (options.backend == io_uring_backend) return true;
+    try
+    {
+        const IoRing ring(2);
+        return std::all_of(ops.begin(), ops.end(), [&ring](std::uint8_t op) { return ring.supports(op); });
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+}
+
+io_uring_sqe& IoRing::prepare(std::uint8_t op, int fd, const void* addr, unsigned len, std::uint64_t offset,
+    std::uint64_t user_data)
+{
+    if (sqe_tail_ - std::atomic_ref<unsigned>(*sq_head_).load(std::memory_order_acquire) >= sq_entries_)
+    {
+        submit();
+    }
+    io_uring_sqe& sqe = sqes_[sqe_tail_ & sq_mask_];
+    ++sqe_tail_;
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = op;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<std::uint64_t>(addr);
+    sqe.len = len;
+    sqe.off = offset;
+    sqe.user_data = user_data;
+    return sqe;
+}
+
+void IoRing::submit(unsigned wait_for)
+{
+    std::atomic_ref<unsigned>(*sq_tail_).store(sqe_tail_, std::memory_order_release);
+    for (;;)
+    {
+        // the kernel consumed the entries up to its head
+        const unsigned to_submit = sqe_tail_ - std::atomic_ref<unsigned>(*sq_head_).load(std::memory_order_acquire);
+        if (to_submit == 0 && wait_for == 0) return;
+
+        ++system_calls_;
+        const int n = io_uring_enter(fd_, to_submit, wait_for, wait_for > 0 ? IORING_ENTER_GETEVENTS : 0);
+        if (n >= 0 && static_cast<unsigned>(n) == to_submit) return;
+        if (n >= 0 || errno == EINTR) continue;
+        // completions have to be reaped first
+        if (errno == EBUSY || errno == EAGAIN) return;
+        throw std::runtime_error("Cannot submit to an io_uring: " + error_text() + ".");
+    }
+}
+
+void IoRing::register_files(std::span<const int> fds)
+{
+    if (io_uring_register(fd_, IORING_REGISTER_FILES, fds.data(), static_cast<unsigned>(fds.size())) != 0)
+    {
+        throw std::runtime_error("Cannot register files with an io_uring: " + error_text() + ".");
+    }
+}
+
+void IoRing::provide_buffers(size_t count, size_t buffer_size)
+{
+    if (provided_ || count == 0 || count > 65536)
+    {
+        throw std::runtime_error("An io_uring takes one group of 1 to 65536 provided buffers.");
+    }
+    provided_count_ = count;
+    provided_size_ = buffer_size;
+    provided_ = map(count * buffer_size, -1, 0);
+    if (!provided_)
+    {
+        throw std::runtime_error("Cannot map buffers for an io_uring: " + error_text() + ".");
+    }
+    // all of them with one entry, their ids counting from 0
+    io_uring_sqe& sqe = prepare(IORING_OP_PROVIDE_BUFFERS, static_cast<int>(count), provided_,
+        static_cast<unsigned>(buffer_size), 0, 0);
+    sqe.buf_group = 0;
+    submit(1);
+    int result = 0;
+    complete([&result](const io_uring_cqe& cqe) { result = cqe.res; });
+    if (result < 0)
+    {
+        throw std::runtime_error("Cannot provide buffers to an io_uring: " + std::string(std::strerror(-result)) + ".");
+    }
+}
+
+void IoRing::recycle(std::uint16_t id)
+{
+    io_uring_sqe& sqe = prepare(IORING_OP_PROVIDE_BUFFERS, 1, provided_buffer(id),
+        static_cast<unsigned>(provided_size_), id, 0);
+    sqe.buf_group = 0;
+    sqe.flags = IOSQE_CQE_SKIP_SUCCESS;
+}
+
+} // namespace utils
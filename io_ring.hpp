@@ -0,0 +1,137 @@
+#ifndef IO_RING_HPP_
+#define IO_RING_HPP_
+
+#include <atomic>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <linux/io_uring.h>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <span>
+
+namespace utils
+{
+
+class IoRing;
+typedef std::unique_ptr<IoRing> IoRingPtr;
+typedef std::unique_ptr<const IoRing> IoRingCPtr;
+
+enum io_backend
+{
+    // io_uring where the kernel offers it, posix otherwise
+    auto_io_backend,
+    io_uring_backend,
+    // blocking writes and epoll
+    posix_io_backend
+};
+
+NLOHMANN_JSON_SERIALIZE_ENUM(
+    io_backend,
+    {
+        {auto_io_backend, "auto"},
+        {io_uring_backend, "io_uring"},
+        {posix_io_backend, "posix"}
+    }
+)
+
+struct IoOptions
+{
+    io_backend backend = auto_io_backend;
+    // submission queue entries of a ring, and buffers provided to the gateway receives
+    size_t ring_entries = 4096;
+};
+
+template <typename BasicJsonType>
+void from_json(const BasicJsonType& j, IoOptions& o)
+{
+    const IoOptions defaults;
+    o.backend = j.value("backend", defaults.backend);
+    o.ring_entries = j.value("ring_entries", defaults.ring_entries);
+}
+
+// An io_uring on the raw system calls, for one thread: entries are prepared in the submission queue
+// and go to the kernel together on submit, one system call however many there are, which also waits
+// for completions when asked to.
+class IoRing
+{
+public:
+    // throws if the kernel has no io_uring or it is not allowed
+    explicit IoRing(size_t entries);
+    ~IoRing();
+
+    IoRing(const IoRing&) = delete;
+    IoRing& operator=(const IoRing&) = delete;
+
+    // Whether to use io_uring with these options - posix never, io_uring always, auto if a ring can
+    // be set up with the ops given.
+    static bool enabled(const IoOptions& options, std::initializer_list<std::uint8_t> ops = {});
+    bool supports(std::uint8_t op) const { return supported_ops_.test(op); }
+
+    // Next submission queue entry, zeroed but for the fields given - the prepared entries are
+    // submitted first if the queue is full.
+    io_uring_sqe& prepare(std::uint8_t op, int fd, const void* addr, unsigned len, std::uint64_t offset,
+        std::uint64_t user_data);
+    // submits the prepared entries and waits for at least wait_for completions
+    void submit(unsigned wait_for = 0);
+    // calls f with every completion queued, returns how many there were
+    template <typename F>
+    size_t complete(F&& f);
+    // io_uring_enter calls so far
+    size_t system_calls() const { return system_calls_; }
+
+    // files used by index with IOSQE_FIXED_FILE
+    void register_files(std::span<const int> fds);
+
+    // Provides count buffers of buffer_size bytes, up to 65536, as buffer group 0 for ops that pick
+    // their buffer with IOSQE_BUFFER_SELECT, e.g. multishot receives.
+    void provide_buffers(size_t count, size_t buffer_size);
+    std::byte* provided_buffer(std::uint16_t id) const { return provided_ + size_t(id) * provided_size_; }
+    size_t provided_buffer_size() const { return provided_size_; }
+    // Hands a buffer back to the kernel once its data is used, with the next submission. It completes
+    // only if that fails, with user data 0.
+    void recycle(std::uint16_t id);
+
+private:
+    int fd_ = -1;
+    std::byte* rings_ = nullptr;
+    size_t rings_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned sq_mask_ = 0;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    // prepared up to here
+    unsigned sqe_tail_ = 0;
+    unsigned cq_mask_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+    std::bitset<256> supported_ops_;
+    size_t system_calls_ = 0;
+
+    // provided buffers, group 0
+    std::byte* provided_ = nullptr;
+    size_t provided_count_ = 0;
+    size_t provided_size_ = 0;
+};
+
+template <typename F>
+size_t IoRing::complete(F&& f)
+{
+    unsigned head = *cq_head_;
+    const unsigned tail = std::atomic_ref<unsigned>(*cq_tail_).load(std::memory_order_acquire);
+    const size_t n = tail - head;
+    for (; head != tail; ++head)
+    {
+        f(static_cast<const io_uring_cqe&>(cqes_[head & cq_mask_]));
+    }
+    std::atomic_ref<unsigned>(*cq_head_).store(head, std::memory_order_release);
+    return n;
+}
+
+} // namespace utils
+
+#endif
@@ -0,0 +1,391 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "binary_protocol.hpp"
+#include "byte_order.hpp"
+#include "journal.hpp"
+
+namespace exchange
+{
+
+namespace
+{
+
+using utils::get_le;
+using utils::put_le;
+
+constexpr std::uint32_t magic = 0x4e4a5845; // "EXJN"
+constexpr std::uint32_t version = 1;
+constexpr size_t segment_header_size = 16;
+constexpr size_t frame_header_size = 16;
+constexpr size_t min_segment_bytes = 4096;
+constexpr std::uint8_t conflated_flag = 1;
+
+size_t frame_size(size_t payload_bytes)
+{
+    return frame_header_size + (payload_bytes + 7) / 8 * 8;
+}
+
+// FNV-1a
+std::uint32_t checksum(const std::byte* p, size_t size, std::uint32_t hash = 2166136261u)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ std::to_integer<std::uint32_t>(p[i])) * 16777619u;
+    }
+    return hash;
+}
+
+bool file_exists(const std::string& path)
+{
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0;
+}
+
+// payload bytes of the valid frame at pos, or false
+bool valid_frame(std::span<const std::byte> segment, size_t pos, size_t& payload_bytes)
+{
+    if (pos + frame_header_size > segment.size()) return false;
+
+    const std::byte* frame = segment.data() + pos;
+    const std::uint8_t type = get_le<std::uint8_t>(frame + 4);
+    if (type != requests_record && type != market_open_record && type != market_close_record) return false;
+
+    payload_bytes = get_le<std::uint32_t>(frame);
+    if (payload_bytes > segment.size() - pos - frame_header_size) return false;
+
+    const std::uint32_t hash = checksum(frame, 12);
+    return get_le<std::uint32_t>(frame + 12) == checksum(frame + frame_header_size, payload_bytes, hash);
+}
+
+// the requests of a frame, sized to their number
+bool decode_requests(std::span<const std::byte> payload, std::vector<Request>& requests)
+{
+    for (auto& r : requests)
+    {
+        const size_t size = binary_protocol::decode(payload, r);
+        if (size == 0) return false;
+        payload = payload.subspan(size);
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+Journal::Journal(const JournalOptions& options)
+:
+options_(options)
+{
+    if (options_.path.empty() || options_.segment_bytes < min_segment_bytes)
+    {
+        throw std::runtime_error("Journal needs a path and segments of at least 4096 bytes.");
+    }
+
+    // appending resumes in the last segment, after its last valid frame
+    while (file_exists(segment_path(segment_number_ + 1)))
+    {
+        ++segment_number_;
+    }
+    const bool exists = file_exists(segment_path(segment_number_));
+    segment_ = open_segment(segment_number_, !exists);
+    for (std::uint32_t number = 0; number < segment_number_; ++number)
+    {
+        Segment segment = open_segment(number, false);
+        scan(segment, last_record_);
+        close_segment(segment);
+    }
+    end_ = scan(segment_, last_record_);
+    synced_ = end_;
+
+    // clear what is left of a torn frame, so it cannot be read back after the frames appended over it
+    const std::byte* rest = segment_.data + end_;
+    const size_t rest_size = std::min(frame_header_size, segment_.size - end_);
+    if (std::any_of(rest, rest + rest_size, [](std::byte b) { return b != std::byte{0}; }))
+    {
+        std::memset(segment_.data + end_, 0, segment_.size - end_);
+        sync();
+    }
+}
+
+Journal::~Journal()
+{
+    try
+    {
+        sync();
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+    }
+    close_segment(segment_);
+}
+
+bool Journal::accepts(const Request& r)
+{
+    std::byte message[binary_protocol::max_message_size];
+    return binary_protocol::encode(r, message) != 0;
+}
+
+void Journal::append(std::span<const Request> requests, bool conflated)
+{
+    if (requests.empty()) return;
+
+    // room for the largest messages, the frame takes what they really need
+    std::byte* frame = reserve(requests.size() * binary_protocol::max_message_size);
+    std::byte* payload = frame + frame_header_size;
+    size_t payload_bytes = 0;
+    for (const auto& r : requests)
+    {
+        const size_t size = binary_protocol::encode(
+            r, std::span<std::byte>(payload + payload_bytes, binary_protocol::max_message_size));
+        if (size == 0)
+        {
+            throw std::runtime_error("Cannot journal request of order " + std::to_string(r.order_id) + ".");
+        }
+        payload_bytes += size;
+    }
+    seal(frame, requests_record, conflated ? conflated_flag : 0, payload_bytes, requests.size());
+}
+
+void Journal::append(journal_record type)
+{
+    seal(reserve(0), type, 0, 0, 0);
+}
+
+std::span<const std::byte> Journal::last_frame() const
+{
+    return std::span<const std::byte>(segment_.data + end_ - last_frame_size_, last_frame_size_);
+}
+
+size_t Journal::decode(std::span<const std::byte> data, JournalFrame& frame)
+{
+    size_t payload_bytes = 0;
+    if (!valid_frame(data, 0, payload_bytes)) return 0;
+
+    frame.type = static_cast<journal_record>(get_le<std::uint8_t>(data.data() + 4));
+    frame.conflated = (get_le<std::uint8_t>(data.data() + 5) & conflated_flag) != 0;
+    frame.requests.resize(get_le<std::uint32_t>(data.data() + 8));
+    if (!decode_requests(data.subspan(frame_header_size, payload_bytes), frame.requests)) return 0;
+    return frame_size(payload_bytes);
+}
+
+void Journal::commit()
+{
+    if (end_ == synced_) return;
+
+    if (options_.sync_interval_us == 0 ||
+        std::chrono::steady_clock::now() - last_sync_ >= std::chrono::microseconds(options_.sync_interval_us))
+    {
+        sync();
+    }
+}
+
+void Journal::sync()
+{
+    if (end_ == synced_) return;
+
+    // msync wants a page aligned start
+    const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    const size_t start = synced_ / page * page;
+    if (::msync(segment_.data + start, end_ - start, MS_SYNC) != 0)
+    {
+        throw std::runtime_error("Cannot sync journal " + segment_path(segment_number_) + ": " +
+            std::strerror(errno) + ".");
+    }
+    synced_ = end_;
+    last_sync_ = std::chrono::steady_clock::now();
+}
+
+void Journal::replay(const std::function<void(journal_record, std::span<const Request>)>& f, size_t skip_requests)
+{
+    for (std::uint32_t number = 0; number <= segment_number_; ++number)
+    {
+        Segment segment = number == segment_number_ ? segment_ : open_segment(number, false);
+        const std::span<const std::byte> data(segment.data, segment.size);
+        size_t payload_bytes = 0;
+        for (size_t pos = segment_header_size; valid_frame(data, pos, payload_bytes);
+            pos += frame_size(payload_bytes))
+        {
+            const std::byte* frame = segment.data + pos;
+            const auto type = static_cast<journal_record>(get_le<std::uint8_t>(frame + 4));
+            const size_t number_of_requests = get_le<std::uint32_t>(frame + 8);
+            if (number_of_requests > 0 && skip_requests >= number_of_requests)
+            {
+                skip_requests -= number_of_requests;
+                continue;
+            }
+            replayed_.resize(number_of_requests);
+            if (!decode_requests(std::span<const std::byte>(frame + frame_header_size, payload_bytes), replayed_))
+            {
+                throw std::runtime_error("Cannot decode journal " + segment_path(number) + ".");
+            }
+            const size_t skipped = std::min(skip_requests, number_of_requests);
+            f(type, std::span<const Request>(replayed_).subspan(skipped));
+            skip_requests -= skipped;
+        }
+        if (number != segment_number_)
+        {
+            close_segment(segment);
+        }
+    }
+}
+
+size_t Journal::number_of_requests() const
+{
+    size_t number_of_requests = 0;
+    for (std::uint32_t number = 0; number <= segment_number_; ++number)
+    {
+        Segment segment = number == segment_number_ ? segment_ : open_segment(number, false);
+        const std::span<const std::byte> data(segment.data, segment.size);
+        size_t payload_bytes = 0;
+        for (size_t pos = segment_header_size; valid_frame(data, pos, payload_bytes);
+            pos += frame_size(payload_bytes))
+        {
+            number_of_requests += get_le<std::uint32_t>(segment.data + pos + 8);
+        }
+        if (number != segment_number_)
+        {
+            close_segment(segment);
+        }
+    }
+    return number_of_requests;
+}
+
+void Journal::reset()
+{
+    close_segment(segment_);
+    for (std::uint32_t number = 0; number <= segment_number_; ++number)
+    {
+        std::remove(segment_path(number).c_str());
+    }
+    segment_number_ = 0;
+    segment_ = open_segment(0, true);
+    end_ = segment_header_size;
+    synced_ = end_;
+    last_record_ = no_record;
+    last_frame_size_ = 0;
+}
+
+std::string Journal::segment_path(std::uint32_t number) const
+{
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), ".%06u", number);
+    return options_.path + suffix;
+}
+
+Journal::Segment Journal::open_segment(std::uint32_t number, bool create) const
+{
+    const std::string path = segment_path(number);
+    Segment segment;
+    segment.fd = ::open(path.c_str(), create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+    if (segment.fd < 0)
+    {
+        throw std::runtime_error("Cannot open journal " + path + ": " + std::strerror(errno) + ".");
+    }
+
+    // allocated up front, so appending never extends the file and syncing never writes metadata
+    if (create)
+    {
+        const int error = ::posix_fallocate(segment.fd, 0, static_cast<off_t>(options_.segment_bytes));
+        if (error != 0)
+        {
+            ::close(segment.fd);
+            throw std::runtime_error("Cannot allocate journal " + path + ": " + std::strerror(error) + ".");
+        }
+    }
+    struct stat st;
+    ::fstat(segment.fd, &st);
+    segment.size = static_cast<size_t>(st.st_size);
+
+    void* data = segment.size < min_segment_bytes ? MAP_FAILED :
+        ::mmap(nullptr, segment.size, PROT_READ | PROT_WRITE, MAP_SHARED, segment.fd, 0);
+    if (data == MAP_FAILED)
+    {
+        ::close(segment.fd);
+        throw std::runtime_error("Cannot map journal " + path + ".");
+    }
+    segment.data = static_cast<std::byte*>(data);
+
+    if (create)
+    {
+        put_le<std::uint32_t>(segment.data, magic);
+        put_le<std::uint32_t>(segment.data + 4, version);
+        put_le<std::uint32_t>(segment.data + 8, number);
+    }
+    else if (get_le<std::uint32_t>(segment.data) != magic || get_le<std::uint32_t>(segment.data + 4) != version ||
+        get_le<std::uint32_t>(segment.data + 8) != number)
+    {
+        close_segment(segment);
+        throw std::runtime_error("Not a journal segment " + path + ".");
+    }
+    return segment;
+}
+
+void Journal::close_segment(Segment& segment)
+{
+    if (segment.data)
+    {
+        ::munmap(segment.data, segment.size);
+    }
+    if (segment.fd >= 0)
+    {
+        ::close(segment.fd);
+    }
+    segment = Segment();
+}
+
+size_t Journal::scan(const Segment& segment, journal_record& last)
+{
+    const std::span<const std::byte> data(segment.data, segment.size);
+    size_t pos = segment_header_size;
+    size_t payload_bytes = 0;
+    while (valid_frame(data, pos, payload_bytes))
+    {
+        last = static_cast<journal_record>(get_le<std::uint8_t>(segment.data + pos + 4));
+        pos += frame_size(payload_bytes);
+    }
+    return pos;
+}
+
+std::byte* Journal::reserve(size_t payload_bytes)
+{
+    const size_t size = frame_size(payload_bytes);
+    if (size > segment_.size - segment_header_size)
+    {
+        throw std::runtime_error("Journal frame of " + std::to_string(size) + " bytes does not fit a segment.");
+    }
+    if (end_ + size > segment_.size)
+    {
+        // the full segment is synced before the next one takes appends
+        sync();
+        close_segment(segment_);
+        segment_ = open_segment(++segment_number_, true);
+        end_ = segment_header_size;
+        synced_ = end_;
+    }
+    return segment_.data + end_;
+}
+
+void Journal::seal(std::byte* frame, journal_record type, std::uint8_t flags, size_t payload_bytes,
+    size_t number_of_requests)
+{
+    put_le<std::uint32_t>(frame, static_cast<std::uint32_t>(payload_bytes));
+    put_le<std::uint8_t>(frame + 4, type);
+    put_le<std::uint8_t>(frame + 5, flags);
+    put_le<std::uint16_t>(frame + 6, 0);
+    put_le<std::uint32_t>(frame + 8, static_cast<std::uint32_t>(number_of_requests));
+    const std::uint32_t hash = checksum(frame, 12);
+    put_le<std::uint32_t>(frame + 12, checksum(frame + frame_header_size, payload_bytes, hash));
+    last_frame_size_ = frame_size(payload_bytes);
+    end_ += last_frame_size_;
+    last_record_ = type;
+}
+
+} // namespace exchange
@@ -0,0 +1,137 @@
+#ifndef JOURNAL_HPP_
+#define JOURNAL_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <span>
+#include <string>
+#include <vector>
+#include "request.hpp"
+
+namespace exchange
+{
+
+class Journal;
+typedef std::unique_ptr<Journal> JournalPtr;
+typedef std::unique_ptr<const Journal> JournalCPtr;
+
+struct JournalOptions
+{
+    // segments are <path>.000000, <path>.000001, ... - empty disables the journal
+    std::string path;
+    // every segment is preallocated and mapped whole, the next one is started when it is full
+    size_t segment_bytes = 1 << 26;
+    // group commit - 0 syncs once per batch, otherwise at most once per interval, checked on commit
+    long sync_interval_us = 0;
+};
+
+template <typename BasicJsonType>
+void from_json(const BasicJsonType& j, JournalOptions& o)
+{
+    const JournalOptions defaults;
+    o.path = j.value("path", defaults.path);
+    o.segment_bytes = j.value("segment_bytes", defaults.segment_bytes);
+    o.sync_interval_us = j.value("sync_interval_us", defaults.sync_interval_us);
+}
+
+enum journal_record : std::uint8_t
+{
+    no_record = 0,
+    // accepted requests of one batch, binary_protocol messages back to back
+    requests_record = 'Q',
+    market_open_record = 'O',
+    market_close_record = 'C'
+};
+
+// one frame, decoded
+struct JournalFrame
+{
+    journal_record type = no_record;
+    // the requests were matched with their depth updates conflated
+    bool conflated = false;
+    std::vector<Request> requests;
+};
+
+// Append-only binary journal of the accepted input of one trading day, written ahead of matching.
+// Every append is one frame in a memory-mapped segment file:
+//
+//   segment     0  u32  magic 'EXJN'   4  u32  version    8  u32  segment number   12  u32  reserved
+//   frame       0  u32  payload bytes  4  u8   record type 5  u8   flags      6  u8[2] reserved
+//               8  u32  number of requests                12  u32  checksum of bytes 0-11 and payload
+//              16  payload, padded to 8 bytes
+//
+// The only flag, bit 0, marks requests matched as one conflated batch. A frame is durable once a sync
+// covers it - a crash of the process alone loses nothing written to
+// the mapping. Reading stops at the first frame with a bad checksum, which is where appending resumes.
+class Journal
+{
+public:
+    explicit Journal(const JournalOptions& options);
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // false if the request cannot be journaled, e.g. a NEW or MODIFY whose symbol id is not resolved
+    static bool accepts(const Request& r);
+
+    // requests must be accepted
+    void append(std::span<const Request> requests, bool conflated = false);
+    void append(journal_record type);
+    // syncs what was appended since the last sync, if the sync interval is up
+    void commit();
+    void sync();
+
+    // type of the last frame, no_record for an empty journal
+    journal_record last_record() const { return last_record_; }
+    // bytes of the frame appended last, valid until the next append
+    std::span<const std::byte> last_frame() const;
+    // Decodes the frame at the start of data, e.g. one streamed to a replica. Returns its size, 0 if
+    // data does not start with a valid frame.
+    static size_t decode(std::span<const std::byte> data, JournalFrame& frame);
+    // Frames in append order, requests empty for market open and close. The first skip_requests
+    // requests are passed over without being decoded, frames left with none are not replayed.
+    void replay(const std::function<void(journal_record, std::span<const Request>)>& f, size_t skip_requests = 0);
+    // requests in all frames
+    size_t number_of_requests() const;
+    // deletes every segment - the day is over
+    void reset();
+
+private:
+    struct Segment
+    {
+        int fd = -1;
+        std::byte* data = nullptr;
+        size_t size = 0;
+    };
+
+    std::string segment_path(std::uint32_t number) const;
+    Segment open_segment(std::uint32_t number, bool create) const;
+    static void close_segment(Segment& segment);
+    // end of the valid frames of a segment, with the type of the last one
+    static size_t scan(const Segment& segment, journal_record& last);
+
+    std::byte* reserve(size_t payload_bytes);
+    void seal(std::byte* frame, journal_record type, std::uint8_t flags, size_t payload_bytes,
+        size_t number_of_requests);
+
+    JournalOptions options_;
+    // segment being appended to
+    Segment segment_;
+    std::uint32_t segment_number_ = 0;
+    size_t end_ = 0;
+    size_t synced_ = 0;
+    std::chrono::steady_clock::time_point last_sync_;
+    journal_record last_record_ = no_record;
+    size_t last_frame_size_ = 0;
+    // requests of the frame being replayed
+    std::vector<Request> replayed_;
+};
+
+} // namespace exchange
+
+#endif
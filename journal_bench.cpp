@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+#include "book_rules.hpp"
+#include "journal.hpp"
+#include "matching_engine.hpp"
+#include "request.hpp"
+#include "size_rules.hpp"
+#include "ticker_rules.hpp"
+
+// Cost of journaling a day of pre-parsed requests in batches, one sync per batch, and of replaying
+// the journal into a fresh matching engine as recovery would.
+// usage: journal_bench [number_of_requests] [batch_size] [path] [seed]
+
+namespace
+{
+
+using json = nlohmann::json;
+
+const std::vector<std::string> symbols{"AAPL", "IBM", "MSFT", "TSLA", "GOOG"};
+
+struct Rules
+{
+    size_rules::TickSizeRulesCPtr tick_size;
+    size_rules::LotSizeRulesCPtr lot_size;
+    ticker_rules::TickerRulesCPtr tickers;
+    book_rules::BookRulesCPtr books;
+};
+
+Rules create_rules()
+{
+    const json j = json::parse(R"({
+        "lot_size": [{"from_price": "1", "lot_size": "100"}],
+        "tick_size": [{"from_price": "0", "to_price": "1", "tick_size": "0.0001"}, {"from_price": "1", "tick_size": "0.01"}],
+        "order_books": {"default": "price_level"}
+    })");
+    Rules rules;
+    rules.lot_size = j.at("lot_size").get<size_rules::LotSizeRulesCPtr>();
+    rules.tick_size = j.at("tick_size").get<size_rules::TickSizeRulesCPtr>();
+    rules.books = j.at("order_books").get<book_rules::BookRulesCPtr>();
+    rules.tickers = std::make_shared<const ticker_rules::TickerRules>(symbols);
+    return rules;
+}
+
+// resting orders a few ticks around the mid, most cancelled, some crossing the spread - symbols are
+// interned ids, as the journal keeps them
+std::vector<exchange::Request> create_requests(size_t number_of_requests, unsigned int seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::geometric_distribution<int> distance_from_touch(0.35);
+    std::uniform_int_distribution<int> lots(1, 10);
+    std::uniform_int_distribution<int> symbol(0, static_cast<int>(symbols.size()) - 1);
+
+    const long tick = 100; // 0.01
+    const long mid = 1000000; // 100.00
+    std::vector<exchange::Request> requests;
+    requests.reserve(number_of_requests);
+    std::vector<int> live;
+    int next_id = 0;
+    int time = 1625787615;
+
+    while (requests.size() < number_of_requests)
+    {
+        exchange::Request r;
+        r.time = time;
+        const double u = uniform(gen);
+        if (u < 0.45 && !live.empty())
+        {
+            const size_t idx = static_cast<size_t>(uniform(gen) * live.size());
+            r.type = exchange::cancel_request;
+            r.order_id = live[idx];
+            requests.push_back(r);
+            live[idx] = live.back();
+            live.pop_back();
+            continue;
+        }
+
+        const bool aggressive = u > 0.95;
+        const long offset = aggressive ? -2 * tick : (distance_from_touch(gen) + 1) * tick;
+        r.type = exchange::new_request;
+        r.order_id = next_id;
+        r.symbol_id = symbol(gen);
+        r.order_type = order::order_type::limit;
+        r.side = uniform(gen) < 0.5 ? order::order_side::bid : order::order_side::ask;
+        r.tif = order::time_in_force::day;
+        r.quantity = 100 * lots(gen);
+        r.limit_price = utils::Price4(r.side == order::order_side::bid ? mid - offset : mid + offset);
+        requests.push_back(r);
+        if (!aggressive) live.push_back(next_id);
+        ++next_id;
+        if (next_id % 100 == 0) ++time;
+    }
+    return requests;
+}
+
+void report(const std::string& name, size_t number_of_requests, double ns)
+{
+    std::cout << std::left << std::setw(10) << name
+        << std::right << std::setw(12) << std::fixed << std::setprecision(1) << ns / number_of_requests
+        << std::setw(14) << std::setprecision(0) << number_of_requests / ns * 1e9
+        << std::setw(12) << std::setprecision(3) << ns / 1e9
+        << "\n";
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    const size_t number_of_requests = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const size_t batch_size = argc > 2 ? std::max<size_t>(std::strtoul(argv[2], nullptr, 10), 1) : 64;
+    exchange::JournalOptions options;
+    options.path = argc > 3 ? argv[3] : "journal_bench";
+    const unsigned int seed = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 42;
+
+    const Rules rules = create_rules();
+    const auto requests = create_requests(number_of_requests, seed);
+
+    std::cout << number_of_requests << " requests, batch size " << batch_size << ", seed " << seed << "\n";
+    std::cout << std::left << std::setw(10) << "stage" << std::right << std::setw(12) << "ns/req"
+        << std::setw(14) << "req/s" << std::setw(12) << "total s" << "\n";
+    {
+        exchange::Journal journal(options);
+        journal.reset();
+        const auto start = std::chrono::steady_clock::now();
+        journal.append(exchange::market_open_record);
+        for (size_t i = 0; i < requests.size(); i += batch_size)
+        {
+            journal.append(std::span<const exchange::Request>(requests).subspan(i,
+                std::min(batch_size, requests.size() - i)));
+            journal.commit();
+        }
+        const auto end = std::chrono::steady_clock::now();
+        report("append", number_of_requests, std::chrono::duration<double, std::nano>(end - start).count());
+    }
+
+    // a fresh journal and engine, as after a crash
+    exchange::Journal journal(options);
+    exchange::MatchingEngine engine(rules.tick_size, rules.lot_size, rules.tickers, rules.books);
+    size_t replayed = 0;
+    const auto start = std::chrono::steady_clock::now();
+    journal.replay([&](exchange::journal_record type, std::span<const exchange::Request> batch)
+    {
+        if (type != exchange::requests_record) return;
+        engine.process_orders(batch);
+        replayed += batch.size();
+    });
+    const auto end = std::chrono::steady_clock::now();
+    report("replay", replayed, std::chrono::duration<double, std::nano>(end - start).count());
+
+    journal.reset();
+    return 0;
+}
@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <initializer_list>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "byte_order.hpp"
+#include "journal_stream.hpp"
+#include "utils.hpp"
+
+namespace exchange
+{
+
+namespace
+{
+
+constexpr std::uint32_t magic = 0x53524a45; // "EJRS"
+constexpr std::uint32_t version = 1;
+constexpr size_t page_size = 4096;
+// in place of a frame's payload size, the rest of the ring is skipped
+constexpr std::uint32_t wrap_marker = 0xffffffff;
+// empty polls between two checks of the other side
+constexpr size_t spins_per_check = 4096;
+
+} // anonymous namespace
+
+JournalStream::JournalStream(const ReplicationOptions& options, bool day_open)
+:
+role_(options.role),
+path_(options.path)
+{
+    static_assert(sizeof(Header) <= page_size, "The stream header fits a page.");
+    if (role_ == no_replication || path_.empty())
+    {
+        throw std::runtime_error("A journal stream needs a role and a path.");
+    }
+
+    if (primary())
+    {
+        if (options.ring_bytes < page_size || (options.ring_bytes & (options.ring_bytes - 1)) != 0)
+        {
+            throw std::runtime_error("A journal stream ring is a power of two of at least 4096 bytes.");
+        }
+        // built aside and moved into place, so a replica never maps half a header - one still
+        // attached to the stream of an earlier primary keeps that one
+        const std::string tmp_path = path_ + ".tmp";
+        size_ = page_size + options.ring_bytes;
+        fd_ = ::open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0 || ::ftruncate(fd_, static_cast<off_t>(size_)) != 0)
+        {
+            if (fd_ >= 0)
+            {
+                ::close(fd_);
+            }
+            throw std::runtime_error("Cannot create journal stream " + path_ + ": " + std::strerror(errno) + ".");
+        }
+    }
+    else
+    {
+        fd_ = ::open(path_.c_str(), O_RDWR);
+        if (fd_ < 0)
+        {
+            throw std::runtime_error("Cannot open journal stream " + path_ + ": " + std::strerror(errno) +
+                " - start the primary first.");
+        }
+        struct stat st;
+        ::fstat(fd_, &st);
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ <= page_size)
+        {
+            ::close(fd_);
+            throw std::runtime_error("Not a journal stream " + path_ + ".");
+        }
+    }
+
+    void* mapped = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mapped == MAP_FAILED)
+    {
+        ::close(fd_);
+        throw std::runtime_error("Cannot map journal stream " + path_ + ": " + std::strerror(errno) + ".");
+    }
+    data_ = static_cast<std::byte*>(mapped);
+    ring_ = data_ + page_size;
+    mask_ = size_ - page_size - 1;
+
+    if (primary())
+    {
+        header_ = new (data_) Header{};
+        header_->magic = magic;
+        header_->version = version;
+        header_->ring_bytes = size_ - page_size;
+        header_->checksum_interval = options.checksum_interval;
+        header_->primary_pid = ::getpid();
+        header_->late = day_open;
+        if (std::rename((path_ + ".tmp").c_str(), path_.c_str()) != 0)
+        {
+            throw std::runtime_error("Cannot move journal stream " + path_ + " into place.");
+        }
+        return;
+    }
+
+    header_ = reinterpret_cast<Header*>(data_);
+    if (header_->magic != magic || header_->version != version || header_->ring_bytes != size_ - page_size)
+    {
+        throw std::runtime_error("Not a journal stream " + path_ + ".");
+    }
+    pid_t expected = 0;
+    if (!header_->replica_pid.compare_exchange_strong(expected, ::getpid()) &&
+        (utils::process_alive(expected) || !header_->replica_pid.compare_exchange_strong(expected, ::getpid())))
+    {
+        throw std::runtime_error("Journal stream " + path_ + " has a replica already.");
+    }
+    // pairs with the primary counting its first frame before it looks for a replica
+    if (header_->late || header_->written_frames.load() > 0)
+    {
+        header_->replica_pid = 0;
+        throw std::runtime_error("The primary of journal stream " + path_ +
+            " started the day before the replica attached - start the replica before the market opens.");
+    }
+}
+
+JournalStream::~JournalStream()
+{
+    if (header_)
+    {
+        if (primary())
+        {
+            header_->stopped = 1;
+        }
+        else
+        {
+            pid_t self = ::getpid();
+            header_->replica_pid.compare_exchange_strong(self, 0);
+        }
+    }
+    if (data_)
+    {
+        ::munmap(data_, size_);
+    }
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+}
+
+std::uint64_t JournalStream::checksum(std::uint64_t hash, const trade_event::EventArena& events)
+{
+    // FNV-1a over the fields, padding is not part of an event
+    for (const auto& r : events.records())
+    {
+        for (const std::uint64_t field : {std::uint64_t(r.type), std::uint64_t(r.side), std::uint64_t(r.action),
+            std::uint64_t(r.symbol_id), std::uint64_t(r.quantity), std::uint64_t(r.number_of_levels),
+            std::uint64_t(r.price.unscaled())})
+        {
+            hash = (hash ^ field) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+void JournalStream::append(std::span<const std::byte> frame)
+{
+    // the first frame settles whether a replica follows - counted before looking for one, see the
+    // replica attaching
+    if (header_->written_frames.fetch_add(1) == 0)
+    {
+        streaming_ = header_->replica_pid.load() != 0;
+    }
+    if (!streaming_) return;
+
+    const size_t ring_bytes = mask_ + 1;
+    if (frame.size() > ring_bytes / 2)
+    {
+        throw std::runtime_error("Journal frame of " + std::to_string(frame.size()) +
+            " bytes does not fit stream " + path_ + ".");
+    }
+    // frames are contiguous, the rest of the ring is skipped when the next one does not fit
+    const std::uint64_t write = header_->write_position.load(std::memory_order_relaxed);
+    const size_t offset = write & mask_;
+    const size_t skipped = offset + frame.size() > ring_bytes ? ring_bytes - offset : 0;
+    for (size_t spins = 1;
+        write + skipped + frame.size() - header_->read_position.load(std::memory_order_acquire) > ring_bytes;
+        ++spins)
+    {
+        if (spins % spins_per_check == 0 && !utils::process_alive(header_->replica_pid.load()))
+        {
+            detach_replica();
+            return;
+        }
+    }
+    if (skipped > 0)
+    {
+        utils::put_le<std::uint32_t>(ring_ + offset, wrap_marker);
+    }
+    std::memcpy(ring_ + ((write + skipped) & mask_), frame.data(), frame.size());
+    header_->write_position.store(write + skipped + frame.size(), std::memory_order_release);
+}
+
+void JournalStream::published(std::uint64_t event_checksum)
+{
+    if (!streaming_) return;
+
+    const std::uint64_t frames = header_->published_frames.load(std::memory_order_relaxed) + 1;
+    const std::uint64_t interval = header_->checksum_interval;
+    if (interval > 0 && frames % interval == 0)
+    {
+        // invalidated while it is rewritten - see verify
+        Checksum& posted = header_->checksums[frames / interval % number_of_checksums];
+        posted.frames.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        posted.checksum.store(event_checksum, std::memory_order_relaxed);
+        posted.frames.store(frames, std::memory_order_release);
+    }
+    header_->published_frames.store(frames, std::memory_order_release);
+}
+
+JournalStream::frame_state JournalStream::next(std::span<const std::byte>& frame)
+{
+    const size_t ring_bytes = mask_ + 1;
+    for (size_t spins = 1;; ++spins)
+    {
+        // looked at before the frames, so none written before the primary went is missed
+        const bool gone = spins % spins_per_check == 0 && !primary_alive();
+        const std::uint64_t write = header_->write_position.load(std::memory_order_acquire);
+        if (read_position_ == write)
+        {
+            if (gone) return primary_gone;
+            continue;
+        }
+        const size_t offset = read_position_ & mask_;
+        if (utils::get_le<std::uint32_t>(ring_ + offset) == wrap_marker)
+        {
+            read_position_ += ring_bytes - offset;
+            continue;
+        }
+        // the events of a frame are published by the primary, or by the replica once it is gone
+        const bool matched = header_->published_frames.load(std::memory_order_acquire) > consumed_frames_;
+        if (matched || gone)
+        {
+            frame = std::span<const std::byte>(ring_ + offset,
+                std::min<size_t>(write - read_position_, ring_bytes - offset));
+            return matched ? published_frame : unpublished_frame;
+        }
+    }
+}
+
+void JournalStream::consume(size_t frame_bytes)
+{
+    read_position_ += frame_bytes;
+    ++consumed_frames_;
+    header_->read_position.store(read_position_, std::memory_order_release);
+}
+
+bool JournalStream::verify(std::uint64_t event_checksum) const
+{
+    const std::uint64_t interval = header_->checksum_interval;
+    if (interval == 0 || consumed_frames_ % interval != 0) return true;
+
+    // skipped if the primary has moved on to another checksum in the slot, or never got to post it
+    const Checksum& posted = header_->checksums[consumed_frames_ / interval % number_of_checksums];
+    const std::uint64_t frames = posted.frames.load(std::memory_order_acquire);
+    const std::uint64_t checksum = posted.checksum.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (frames != consumed_frames_ || posted.frames.load(std::memory_order_relaxed) != frames) return true;
+    return checksum == event_checksum;
+}
+
+bool JournalStream::primary_alive() const
+{
+    return header_->stopped.load() == 0 && utils::process_alive(header_->primary_pid.load());
+}
+
+void JournalStream::detach_replica()
+{
+    header_->replica_pid = 0;
+    streaming_ = false;
+}
+
+} // namespace exchange
@@ -0,0 +1,163 @@
+#ifndef JOURNAL_STREAM_HPP_
+#define JOURNAL_STREAM_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <span>
+#include <string>
+#include <sys/types.h>
+#include "event_arena.hpp"
+
+namespace exchange
+{
+
+class JournalStream;
+typedef std::unique_ptr<JournalStream> JournalStreamPtr;
+typedef std::unique_ptr<const JournalStream> JournalStreamCPtr;
+
+enum replication_role
+{
+    // replication off
+    no_replication,
+    // journals and streams the frames
+    primary_role,
+    // matches the streamed frames until the primary is gone, then takes over
+    replica_role
+};
+
+NLOHMANN_JSON_SERIALIZE_ENUM(
+    replication_role,
+    {
+        {no_replication, "none"},
+        {primary_role, "primary"},
+        {replica_role, "replica"}
+    }
+)
+
+struct ReplicationOptions
+{
+    replication_role role = no_replication;
+    // file the stream lives in, e.g. /dev/shm/<name> for POSIX shared memory
+    std::string path;
+    // bytes of journal frames in flight to the replica, a power of two
+    size_t ring_bytes = 1 << 24;
+    // frames between two book checksums compared by the replica
+    size_t checksum_interval = 1024;
+};
+
+template <typename BasicJsonType>
+void from_json(const BasicJsonType& j, ReplicationOptions& o)
+{
+    const ReplicationOptions defaults;
+    o.role = j.value("role", defaults.role);
+    o.path = j.value("path", defaults.path);
+    o.ring_bytes = j.value("ring_bytes", defaults.ring_bytes);
+    o.checksum_interval = j.value("checksum_interval", defaults.checksum_interval);
+}
+
+// Streams the journal frames of a primary to one hot-standby replica on the same machine, through a
+// ring in a file both map shared. The primary appends every frame as it journals it and tells once it
+// has matched and published it; the replica matches a frame once the primary has published it, so its
+// muted market data stays in step, and matches the frames the primary never published as the new
+// primary. Every checksum_interval frames the primary posts a rolling checksum of its book changes -
+// the events matching produced - which the replica compares with its own.
+//
+// The primary creates a new stream when it starts, and streams to a replica only if the replica
+// attached before the first frame, i.e. before the market opens. A replica that stops reading holds
+// the primary up until the ring has room again, a replica that is gone is dropped.
+class JournalStream
+{
+public:
+    // of the next frame for the replica
+    enum frame_state
+    {
+        // the primary published its market data
+        published_frame,
+        // the primary is gone without publishing it
+        unpublished_frame,
+        // the primary is gone and every frame is read
+        primary_gone
+    };
+
+    // The primary creates the stream, with no replica allowed when the day is under way already, the
+    // replica attaches to it.
+    explicit JournalStream(const ReplicationOptions& options, bool day_open = false);
+    ~JournalStream();
+
+    JournalStream(const JournalStream&) = delete;
+    JournalStream& operator=(const JournalStream&) = delete;
+
+    bool primary() const { return role_ == primary_role; }
+
+    static constexpr std::uint64_t initial_checksum = 14695981039346656037ull;
+    // the rolling checksum after the events
+    static std::uint64_t checksum(std::uint64_t hash, const trade_event::EventArena& events);
+
+    // primary side - a frame as journaled, then its matching done with the checksum after it
+    void append(std::span<const std::byte> frame);
+    void published(std::uint64_t event_checksum);
+
+    // Replica side - waits for the next frame. The span starts with the frame and may run on past it,
+    // valid until the frame is consumed.
+    frame_state next(std::span<const std::byte>& frame);
+    void consume(size_t frame_bytes);
+    // false if the primary posted a different checksum after as many frames
+    bool verify(std::uint64_t event_checksum) const;
+    std::uint64_t consumed_frames() const { return consumed_frames_; }
+
+private:
+    static constexpr size_t cache_line_size = 64;
+    static constexpr size_t number_of_checksums = 16;
+
+    struct Checksum
+    {
+        std::atomic<std::uint64_t> frames;
+        std::atomic<std::uint64_t> checksum;
+    };
+
+    struct Header
+    {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint64_t ring_bytes;
+        std::uint64_t checksum_interval;
+        std::atomic<pid_t> primary_pid;
+        std::atomic<pid_t> replica_pid;
+        // set by a primary stopping on its own
+        std::atomic<std::uint32_t> stopped;
+        // no replica can attach, the primary started with the day under way
+        std::uint32_t late;
+        // primary side
+        alignas(cache_line_size) std::atomic<std::uint64_t> write_position;
+        std::atomic<std::uint64_t> written_frames;
+        alignas(cache_line_size) std::atomic<std::uint64_t> published_frames;
+        Checksum checksums[number_of_checksums];
+        // replica side
+        alignas(cache_line_size) std::atomic<std::uint64_t> read_position;
+    };
+
+    bool primary_alive() const;
+    // the replica is gone, frames are dropped from now on
+    void detach_replica();
+
+    replication_role role_;
+    std::string path_;
+    int fd_ = -1;
+    std::byte* data_ = nullptr;
+    size_t size_ = 0;
+    Header* header_ = nullptr;
+    std::byte* ring_ = nullptr;
+    size_t mask_ = 0;
+    // primary side, a replica is attached
+    bool streaming_ = false;
+    // replica side
+    std::uint64_t read_position_ = 0;
+    std::uint64_t consumed_frames_ = 0;
+};
+
+} // namespace exchange
+
+#endif
@@ -0,0 +1,689 @@
+#ifndef LEVEL_ORDER_BOOK_
+#define LEVEL_ORDER_BOOK_
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "book_snapshot.hpp"
+#include "event.hpp"
+#include "event_arena.hpp"
+#include "order.hpp"
+#include "order_book.hpp"
+#include "order_record.hpp"
+#include "price4.hpp"
+#include "slab_pool.hpp"
+
+namespace order
+{
+
+// Intrusive doubly-linked FIFO of one part of order records, linked through the records' handles -
+// records are owned by the order book's pool, not by the list. The list holds no pointers, so levels
+// can be moved freely.
+class LevelOrderList
+{
+public:
+    bool empty() const { return head_ == OrderRecordPool::null_handle; }
+    OrderRecordHandle front() const { return head_; }
+
+    void push_back(OrderRecordPool& pool, OrderRecordHandle handle, order_part part);
+    void erase(OrderRecordPool& pool, OrderRecordHandle handle, order_part part);
+    // takes over the records already linked from head on
+    void relink(const OrderRecordPool& pool, OrderRecordHandle head, order_part part);
+
+private:
+    OrderRecordHandle head_ = OrderRecordPool::null_handle;
+    OrderRecordHandle tail_ = OrderRecordPool::null_handle;
+};
+
+inline void LevelOrderList::push_back(OrderRecordPool& pool, OrderRecordHandle handle, order_part part)
+{
+    OrderRecord& record = pool[handle];
+    record.prev[part] = tail_;
+    record.next[part] = OrderRecordPool::null_handle;
+    if (tail_ != OrderRecordPool::null_handle)
+    {
+        pool[tail_].next[part] = handle;
+    }
+    else
+    {
+        head_ = handle;
+    }
+    tail_ = handle;
+}
+
+inline void LevelOrderList::erase(OrderRecordPool& pool, OrderRecordHandle handle, order_part part)
+{
+    OrderRecord& record = pool[handle];
+    const OrderRecordHandle prev = record.prev[part];
+    const OrderRecordHandle next = record.next[part];
+    if (prev != OrderRecordPool::null_handle) { pool[prev].next[part] = next; } else { head_ = next; }
+    if (next != OrderRecordPool::null_handle) { pool[next].prev[part] = prev; } else { tail_ = prev; }
+    record.prev[part] = OrderRecordPool::null_handle;
+    record.next[part] = OrderRecordPool::null_handle;
+}
+
+inline void LevelOrderList::relink(const OrderRecordPool& pool, OrderRecordHandle head, order_part part)
+{
+    head_ = tail_ = head;
+    while (pool[tail_].next[part] != OrderRecordPool::null_handle)
+    {
+        tail_ = pool[tail_].next[part];
+    }
+}
+
+struct PriceLevel
+{
+    utils::Price4 price;
+    // displayed quantity, published in depth updates
+    int quantity = 0;
+    int hidden_quantity = 0;
+    LevelOrderList orders;
+    // hidden parts of iceberg orders, matched after displayed orders at the same price
+    LevelOrderList hidden_orders;
+
+    bool empty() const { return orders.empty() && hidden_orders.empty(); }
+    LevelOrderList& orders_of(order_part part) { return part == hidden_part ? hidden_orders : orders; }
+    int& quantity_of(order_part part) { return part == hidden_part ? hidden_quantity : quantity; }
+};
+
+// Ordered set of price levels, best price first, with a hash index for direct access to existing levels.
+// Level references stay valid until the level is erased.
+template <typename Comparer>
+class PriceLevelMap
+{
+public:
+    bool empty() const { return levels_.empty(); }
+    size_t size() const { return levels_.size(); }
+
+    PriceLevel* best() { return levels_.empty() ? nullptr : &levels_.begin()->second; }
+    // the level has to exist
+    PriceLevel& find(const utils::Price4& price);
+    PriceLevel& find_or_create(const utils::Price4& price);
+    void erase(PriceLevel& level);
+    void clear();
+    // displayed quantity of the level, 0 without one
+    int quantity_at(const utils::Price4& price) const;
+
+    // visit levels in priority order
+    template <typename F>
+    void for_each(F f) const
+    {
+        for (const auto& kv : levels_) f(kv.second);
+    }
+
+private:
+    typedef std::map<utils::Price4, PriceLevel, Comparer> LevelMap;
+
+    LevelMap levels_;
+    // direct access to existing levels, so inserting at a known price skips the tree walk
+    std::unordered_map<long, typename LevelMap::iterator> level_index_;
+};
+
+template <typename Comparer>
+PriceLevel& PriceLevelMap<Comparer>::find(const utils::Price4& price)
+{
+    const auto found = level_index_.find(price.unscaled());
+    if (found == level_index_.end())
+    {
+        throw std::runtime_error("Inconsistent price levels information.");
+    }
+    return found->second->second;
+}
+
+template <typename Comparer>
+PriceLevel& PriceLevelMap<Comparer>::find_or_create(const utils::Price4& price)
+{
+    const auto found = level_index_.find(price.unscaled());
+    if (found != level_index_.end())
+    {
+        return found->second->second;
+    }
+
+    auto it = levels_.emplace(price, PriceLevel()).first;
+    it->second.price = price;
+    level_index_.emplace(price.unscaled(), it);
+    return it->second;
+}
+
+template <typename Comparer>
+void PriceLevelMap<Comparer>::erase(PriceLevel& level)
+{
+    const auto found = level_index_.find(level.price.unscaled());
+    if (found == level_index_.end())
+    {
+        throw std::runtime_error("Inconsistent price levels information.");
+    }
+    levels_.erase(found->second);
+    level_index_.erase(found);
+}
+
+template <typename Comparer>
+void PriceLevelMap<Comparer>::clear()
+{
+    levels_.clear();
+    level_index_.clear();
+}
+
+template <typename Comparer>
+int PriceLevelMap<Comparer>::quantity_at(const utils::Price4& price) const
+{
+    const auto found = level_index_.find(price.unscaled());
+    return found == level_index_.end() ? 0 : found->second->second.quantity;
+}
+
+// Order book keeping an ordered set of price levels, each holding FIFO queues of order records.
+// Cancel, fill and insert at an existing level are O(1); opening a new level costs whatever Levels charges.
+// Unlike OrderBook, time priority within a level is arrival order.
+template <typename Comparer, typename Levels = PriceLevelMap<Comparer>>
+class LevelOrderBook : public OrderBookBase
+{
+public:
+    LevelOrderBook() = default;
+    LevelOrderBook(
+        order_side side,
+        int symbol_id,
+        const std::vector<LimitOrderPtr>& orders,
+        const utils::PoolOptions& pool_options = utils::PoolOptions()
+    );
+    LevelOrderBook(
+        order_side side,
+        int symbol_id,
+        Levels&& levels,
+        const std::vector<LimitOrderPtr>& orders,
+        const utils::PoolOptions& pool_options = utils::PoolOptions()
+    );
+    LevelOrderBook(const LevelOrderBook&) = delete;
+    LevelOrderBook& operator=(const LevelOrderBook&) = delete;
+
+    void insert_order(const LimitOrderPtr& o, trade_event::EventArena& events) override;
+    void cancel_order(int order_id, trade_event::EventArena& events) override;
+    void match_order(const OrderBasePtr& o, trade_event::EventArena& events) override;
+    void replenish_order(int order_id, int quantity, int time, trade_event::EventArena& events) override;
+
+    size_t number_of_valid_orders() const override { return number_of_displayed_orders_; }
+    int displayed_quantity(const utils::Price4& price) const override { return price_levels_.quantity_at(price); }
+    bool contains(int order_id) const override { return order_records_.count(order_id) > 0; }
+    void for_each_order(const std::function<void(const RestingOrder&)>& visit) const override;
+    void restore(std::span<const RestingOrder> orders) override;
+    void get_price_levels(trade_event::EventArena& events) const override;
+    utils::PoolStats pool_stats() const override { return record_pool_.stats(); }
+    void prefetch_best() override
+    {
+        const PriceLevel* level = price_levels_.best();
+        if (level && !level->orders.empty()) __builtin_prefetch(&record_pool_[level->orders.front()]);
+    }
+    void use_record_memory(std::byte* memory, size_t capacity, utils::PoolCursor* cursor, bool adopt) override;
+
+private:
+    void initialise(const std::vector<LimitOrderPtr>& orders);
+    void insert_order(const LimitOrderPtr& o, int);
+    void add_part(PriceLevel& level, OrderRecordHandle handle, order_part part, int quantity);
+    void remove_part(PriceLevel& level, OrderRecordHandle handle, order_part part);
+    void erase_level_if_empty(PriceLevel& level);
+    void clear() override;
+
+    bool order_crossed(const OrderBaseCPtr& o, const utils::Price4& best_price) const;
+    void match_at_level(
+        PriceLevel& level,
+        int& quantity,
+        order_part part,
+        trade_event::EventArena& events
+    );
+
+    order_side side_;
+    int symbol_id_;
+    Levels price_levels_;
+    OrderRecordPool record_pool_;
+    std::unordered_map<int, OrderRecordHandle> order_records_;
+    size_t number_of_displayed_orders_ = 0;
+    std::uint32_t next_sequence_ = 0;
+};
+
+template <typename Comparer, typename Levels>
+LevelOrderBook<Comparer, Levels>::LevelOrderBook(
+    order_side side,
+    int symbol_id,
+    const std::vector<LimitOrderPtr>& orders,
+    const utils::PoolOptions& pool_options
+)
+:
+side_(side),
+symbol_id_(symbol_id),
+record_pool_(pool_options)
+{
+    initialise(orders);
+}
+
+template <typename Comparer, typename Levels>
+LevelOrderBook<Comparer, Levels>::LevelOrderBook(
+    order_side side,
+    int symbol_id,
+    Levels&& levels,
+    const std::vector<LimitOrderPtr>& orders,
+    const utils::PoolOptions& pool_options
+)
+:
+side_(side),
+symbol_id_(symbol_id),
+price_levels_(std::move(levels)),
+record_pool_(pool_options)
+{
+    initialise(orders);
+}
+
+template <typename Comparer, typename Levels>
+void LevelOrderBook<Comparer, Levels>::initialise(const std::vector<LimitOrderPtr>& orders)
+{
+    for (const auto& o : orders)
+    {
+        if (o->side() != side_)
+        {
+            throw std::runtime_error("Cannot create order book with order's side different from specified.");
+        }
+        if (o->symbol_id() != symbol_id_)
+        {
+            throw std::runtime_error("Cannot create order book with order's symbol different from specified.");
+        }
+        if (contains(o->order_id()))
+        {
+            throw std::runtime_error("Order id already exists in order book.");
+        }
+
+        insert_order(o, 1);
+    }
+}
+
+template <typename Comparer, typename Levels>
+void LevelOrderBook<Comparer, Levels>::add_part(
+    PriceLevel& level, OrderRecordHandle handle, order_part part, int quantity
+)
+{
+    OrderRecord& record = record_pool_[handle];
+    record.quantity[part] = quantity;
+    record.add_part(part);
+    level.orders_of(part).push_back(record_pool_, handle, part);
+    level.quantity_of(part) += quantity;
+    if (part == displayed_part) ++number_of_displayed_orders_;
+}
+
+template <typename Comparer, typename Levels>
+void LevelOrderBook<Comparer, Levels>::remove_part(PriceLevel& level, OrderRecordHandle handle, order_part part)
+{
+    OrderRecord& record = record_pool_[handle];
+    level.orders_of(part).erase(record_pool_, handle, part);
+    level.quantity_of(part) -= record.quantity[part];
+    record.remove_part(part);
+    if (part == displayed_part) --number_of_displayed_orders_;
+}
+
+template <typename Comparer, typename Levels>
+void LevelOrderBook<Comparer, Levels>::erase_level_if_empty(PriceLevel& level)
+{
+    if (!level.empty()) return;
+    price_levels_.erase(level);
+}
+
+template <typename Comparer, typename Levels>
+void LevelOrderBook<Comparer, Levels>::clear()
+{
+    record_pool_.clear();
+    price_levels_.clear();
+    order_records_.clear();
+    number_of_displayed_orders_ = 0;
+}
+
+template <typename Comparer, typename Levels>
+void LevelOrderBook<Comparer, Levels>::use_record_memory(
+    std::byte* memory, size_t capacity, utils::PoolCursor* cursor, bool adopt
+)
+{
+    if (!order_records_.empty())
+    {
+        throw std::runtime_error("Order records can only move while the order book is empty.");
+    }
+    record_pool_.use_memory(memory, capacity, cursor, adopt);
+    if (!adopt) return;
+
+    // Records carry their queue links, so a level queue is whatever follows the record of the level
+    // with no predecessor. Freed records have no parts.
+    for (OrderRecordHandle handle = 0; handle < record_pool_.used_slots(); ++handle)
+    {
+        const OrderRecord& record = record_pool_[handle];
+        if (!record.has_parts()) continue;
+
+        order_records_.emplace(record.order_id, handle);
+        next_sequence_ = std::max(next_sequence_, record.sequence + 1);
+        for (const order_part part : {displayed_part, hidden_part})
+        {
+            if (!record.has_part(part)) continue;
+
+            PriceLevel& level = price_levels_.find_or_create(record.price);
+            level.quantity_of(part) += record.quantity[part];
+            if (record.prev[part] == OrderRecordPool::null_handle)
+            {
+                level.orders_of(part).relink(record_pool_, handle, part);
+            }
+            if (part == displayed_part) ++number_of_displayed_orders_;
+        }
+    }
+}
+
+template <typename Comparer, typename Levels>
+void LevelOrderBook<Comparer, Levels>::insert_order(const LimitOrderPtr& o, int)
+{
+    const int order_id = o->order_id();
+    const int quantity = o->quantity();
+    int hidden_quantity = 0;
+    if (o->order_type() == order::order_type::iceberg)
+    {
+        IcebergOrderPtr iceberg_o = std::dynamic_pointer_cast<IcebergOrder>(o);
+        if (iceberg_o)
+        {
+            hidden_quantity = iceberg_o->hidden_quantity();
+        }
+    }
+
+    if (quantity <= 0 && hidden_quantity <= 0)
+    {
+        return;
+    }
+
+    PriceLevel& level = price_levels_.find_or_create(o->limit_price());
+    const OrderRecordHandle handle = create_record(record_pool_, *o, next_sequence_++);
+    if (quantity > 0)
+    {
+        add_part(level, handle, displayed_part, quantity);
+    }
+    if (hidden_quantity > 0)
+    {
+        add_part(level, handle, hidden_part, hidden_quantity);
+    }
+    order_records_[order_id] = handle;
+    update_order_index(order_id);
+}
+
+template <typename Comparer, typename Levels>
+void LevelOrderBook<Comparer, Levels>::insert_order(const LimitOrderPtr& o, trade_event::EventArena& events)
+{
+    if (o->side() != side_)
+    {
+        throw std::runtime_error("Cannot insert order with mismatch side.");
+    }
+    if (o->symbol_id() != symbol_id_)
+    {
+        throw std::runtime_error("Cannot insert order with mismatch symbol.");
+    }
+
+    if (contains(o->order_id()))
+    {
+        return;
+    }
+    insert_order(o, 1);
+
+    if (o->quantity() > 0)
+    {
+        events.stage_level(side_, o->limit_price(), o->quantity(), trade_event::trade_action::add_add);
+    }
+
+    events.add_depth_update(symbol_id_);
+}
+
+template <typename Comparer, typename Levels>
+void LevelOrderBook<Comparer, Levels>::cancel_order(int order_id, trade_event::EventArena& events)
+{
+    const auto found = order_records_.find(order_id);
+    if (found == order_records_.end())
+    {
+        return;
+    }
+    const OrderRecordHandle handle = found->second;
+    order_records_.erase(found);
+    update_order_index(order_id);
+
+    const OrderRecord& record = record_pool_[handle];
+    const bool has_displayed = record.has_displayed();
+    PriceLevel& level = price_levels_.find(record.price);
+    if (record.has_hidden())
+    {
+        remove_part(level, handle, hidden_part);
+        if (!has_displayed) erase_level_if_empty(level);
+    }
+    // same as OrderBook: nothing is published if there is no displayed part
+    if (!has_displayed)
+    {
+        record_pool_.free(handle);
+        return;
+    }
+
+    const utils::Price4 price = level.price;
+    remove_part(level, handle, displayed_part);
+    record_pool_.free(handle);
+    const int open_order_quantity = level.quantity;
+    erase_level_if_empty(level);
+
+    if (price.unscaled() > 0)
+    {
+        events.stage_level(side_, price, open_order_quantity, trade_event::trade_action::add_add);
+    }
+
+    events.add_depth_update(symbol_id_);
+}
+
+template <typename Comparer, typename Levels>
+void LevelOrderBook<Comparer, Levels>::replenish_order(
+    int order_id, int quantity, int time, trade_event::EventArena& events)
+{
+    const auto found = order_records_.find(order_id);
+    if (found == order_records_.end())
+    {
+        return;
+    }
+    const OrderRecordHandle handle = found->second;
+    OrderRecord& record = record_pool_[handle];
+    // replenish only works after displayed part full filled
+    if (record.has_displayed() || !record.has_hidden())
+    {
+        return;
+    }
+
+    PriceLevel& level = price_levels_.find(record.price);
+    const int exposed_quantity = std::min(quantity, record.quantity[hidden_part]);
+    record.quantity[hidden_part] -= exposed_quantity;
+    level.hidden_quantity -= exposed_quantity;
+
+    record.displayed_time = time;
+    add_part(level, handle, displayed_part, exposed_quantity);
+
+    if (record.quantity[hidden_part] == 0)
+    {
+        remove_part(level, handle, hidden_part);
+    }
+
+    events.stage_level(side_, level.price, exposed_quantity, trade_event::trade_action::add_add);
+    events.add_depth_update(symbol_id_);
+}
+
+template <typename Comparer, typename Levels>
+bool LevelOrderBook<Comparer, Levels>::order_crossed(const OrderBaseCPtr& o, const utils::Price4& best_price) const
+{
+    if (o->order_type() == order::order_type::market) return true;
+
+    const auto limited_o = std::dynamic_pointer_cast<const order::LimitOrder>(o);
+    if (!limited_o)
+    {
+        throw std::runtime_error("Cannot cast to LimitOrder when checking if orders cross.");
+    }
+
+    const auto& o_price = limited_o->limit_price();
+    return o->side() == order_side::bid ? best_price <= o_price : best_price >= o_price;
+}
+
+template <typename Comparer, typename Levels>
+void LevelOrderBook<Comparer, Levels>::match_at_level(
+    PriceLevel& level,
+    int& quantity,
+    order_part part,
+    trade_event::EventArena& events
+)
+{
+    LevelOrderList& orders = level.orders_of(part);
+    while (quantity > 0 && !orders.empty())
+    {
+        const OrderRecordHandle handle = orders.front();
+        OrderRecord& target_o = record_pool_[handle];
+        const int filled_quantity = std::min(target_o.quantity[part], quantity);
+        quantity -= filled_quantity;
+        target_o.quantity[part] -= filled_quantity;
+        level.quantity_of(part) -= filled_quantity;
+
+        events.add_trade(symbol_id_, level.price, filled_quantity);
+
+        if (target_o.quantity[part] == 0)
+        {
+            remove_part(level, handle, part);
+            // iceberg orders stay alive until both parts are gone
+            if (!target_o.has_parts())
+            {
+                const int target_o_id = target_o.order_id;
+                record_pool_.free(handle);
+                order_records_.erase(target_o_id);
+                update_order_index(target_o_id);
+            }
+        }
+    }
+}
+
+template <typename Comparer, typename Levels>
+void LevelOrderBook<Comparer, Levels>::match_order(const OrderBasePtr& o, trade_event::EventArena& events)
+{
+    if (o->side() == side_)
+    {
+        throw std::runtime_error("Cannot match order with the same side.");
+    }
+
+    if (price_levels_.empty() || !order_crossed(o, price_levels_.best()->price))
+    {
+        return;
+    }
+
+    // if o is iceberg order, so use total quantity
+    int quantity = o->total_quantity();
+    while (quantity > 0 && !price_levels_.empty())
+    {
+        PriceLevel& level = *price_levels_.best();
+        if (!order_crossed(o, level.price)) break;
+
+        // displayed orders first, then hidden parts of iceberg orders at the same price
+        const bool displayed_touched = !level.orders.empty();
+        match_at_level(level, quantity, displayed_part, events);
+        match_at_level(level, quantity, hidden_part, events);
+
+        if (displayed_touched)
+        {
+            // one update per touched level, reflecting the displayed quantity left after matching
+            events.stage_level(side_, level.price, level.quantity, level.quantity == 0 ?
+                trade_event::trade_action::delete_delete : trade_event::trade_action::modify);
+        }
+        erase_level_if_empty(level);
+    }
+
+    o->reduce_quantity(o->total_quantity() - quantity);
+
+    // level changes follow the trades
+    events.add_depth_update(symbol_id_);
+    // note: unfilled limit order will be inserted to other order book - handle outside through matching engine
+}
+
+template <typename Comparer, typename Levels>
+void LevelOrderBook<Comparer, Levels>::for_each_order(const std::function<void(const RestingOrder&)>& visit) const
+{
+    price_levels_.for_each([&](const PriceLevel& level)
+    {
+        const long price = level.price.unscaled();
+        const auto visit_record = [&](const OrderRecord& record)
+        {
+            visit(RestingOrder{price, record.order_id, record.time,
+                record.has_displayed() ? record.quantity[displayed_part] : 0,
+                record.has_hidden() ? record.quantity[hidden_part] : 0, record.displayed_time, record.sequence,
+                static_cast<std::uint8_t>(record.tif),
+                record.has_hidden() ? order::order_type::iceberg : order::order_type::limit, {}});
+        };
+        for (OrderRecordHandle handle = level.orders.front(); handle != OrderRecordPool::null_handle;
+            handle = record_pool_[handle].next[displayed_part])
+        {
+            visit_record(record_pool_[handle]);
+        }
+        // iceberg orders with their displayed part filled
+        for (OrderRecordHandle handle = level.hidden_orders.front(); handle != OrderRecordPool::null_handle;
+            handle = record_pool_[handle].next[hidden_part])
+        {
+            if (!record_pool_[handle].has_displayed()) visit_record(record_pool_[handle]);
+        }
+    });
+}
+
+template <typename Comparer, typename Levels>
+void LevelOrderBook<Comparer, Levels>::restore(std::span<const RestingOrder> orders)
+{
+    order_records_.reserve(order_records_.size() + orders.size());
+    // hidden parts queue in the order their orders entered the book, after the displayed parts are in
+    std::vector<std::pair<std::uint32_t, OrderRecordHandle>> hidden;
+    PriceLevel* level = nullptr;
+    for (const auto& o : orders)
+    {
+        if (contains(o.order_id) || (o.quantity <= 0 && o.hidden_quantity <= 0)) continue;
+
+        // orders of a level come together - only the first of them looks the level up
+        if (!level || level->price.unscaled() != o.price)
+        {
+            level = &price_levels_.find_or_create(utils::Price4(o.price));
+        }
+        const OrderRecordHandle handle = create_record(record_pool_, o, next_sequence_++);
+        if (o.quantity > 0)
+        {
+            add_part(*level, handle, displayed_part, o.quantity);
+        }
+        if (o.hidden_quantity > 0)
+        {
+            record_pool_[handle].quantity[hidden_part] = o.hidden_quantity;
+            hidden.emplace_back(o.sequence, handle);
+        }
+        order_records_.emplace(o.order_id, handle);
+    }
+
+    std::sort(hidden.begin(), hidden.end());
+    for (const auto& [sequence, handle] : hidden)
+    {
+        OrderRecord& record = record_pool_[handle];
+        // records keep sequences in the order of the hidden queues
+        record.sequence = next_sequence_++;
+        add_part(price_levels_.find(record.price), handle, hidden_part, record.quantity[hidden_part]);
+    }
+}
+
+template <typename Comparer, typename Levels>
+void LevelOrderBook<Comparer, Levels>::get_price_levels(trade_event::EventArena& events) const
+{
+    // levels are already kept in priority order
+    price_levels_.for_each([&](const PriceLevel& level)
+    {
+        if (level.quantity > 0)
+        {
+            events.stage_level(side_, level.price, level.quantity, trade_event::trade_action::add_add);
+        }
+    });
+    events.add_market_snap(symbol_id_, side_);
+}
+
+typedef LevelOrderBook<std::less<utils::Price4>> AskLevelOrderBook;
+typedef LevelOrderBook<std::greater<utils::Price4>> BidLevelOrderBook;
+
+} // namespace order
+
+#endif
@@ -4,7 +4,6 @@
 #include "exchange.hpp"
 #include "price4.hpp"
 #include "order.hpp"
-#include "singleton.hpp"
 #include "size_rules.hpp"
 #include "ticker_rules.hpp"
 
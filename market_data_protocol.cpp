@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <stdexcept>
+#include "byte_order.hpp"
+#include "market_data_protocol.hpp"
+
+namespace market_data_protocol
+{
+
+namespace
+{
+
+constexpr size_t symbol_directory_size = header_size + 4 + max_symbol_length;
+constexpr size_t trade_size = header_size + 16;
+constexpr size_t depth_update_fixed_size = header_size + 16;
+constexpr size_t depth_level_size = 16;
+constexpr size_t market_snap_fixed_size = header_size + 8;
+constexpr size_t market_snap_level_size = 12;
+
+void append_header(
+    std::string& out, size_t length, message_type type, std::uint8_t side, std::uint64_t sequence)
+{
+    utils::append_le<std::uint32_t>(out, static_cast<std::uint32_t>(length));
+    utils::append_le<std::uint8_t>(out, type);
+    utils::append_le<std::uint8_t>(out, side);
+    utils::append_le<std::uint16_t>(out, 0);
+    utils::append_le<std::uint64_t>(out, sequence);
+}
+
+void append_levels(std::string& out, std::span<const trade_event::EventRecord> levels, order::order_side side)
+{
+    for (const auto& level : levels)
+    {
+        if (level.side != side) continue;
+        utils::append_le<std::int64_t>(out, level.price.unscaled());
+        utils::append_le<std::int32_t>(out, level.quantity);
+        utils::append_le<std::uint8_t>(out, static_cast<std::uint8_t>(level.action));
+        out.append(3, '\0');
+    }
+}
+
+std::vector<trade_event::OrderUpdateInfoCPtr> read_levels(const std::byte* p, size_t number_of_levels)
+{
+    std::vector<trade_event::OrderUpdateInfoCPtr> levels;
+    levels.reserve(number_of_levels);
+    for (size_t i = 0; i < number_of_levels; ++i, p += depth_level_size)
+    {
+        const std::uint8_t action = utils::get_le<std::uint8_t>(p + 12);
+        if (action > trade_event::trade_action::delete_delete)
+        {
+            throw std::runtime_error("Unknown depth update action.");
+        }
+        levels.push_back(std::make_shared<const trade_event::OrderUpdateInfo>(
+            utils::Price4(static_cast<long>(utils::get_le<std::int64_t>(p))),
+            utils::get_le<std::int32_t>(p + 8),
+            static_cast<trade_event::trade_action>(action)));
+    }
+    return levels;
+}
+
+} // anonymous namespace
+
+void encode_symbol_directory(int symbol_id, std::string_view symbol, std::uint64_t sequence, std::string& out)
+{
+    if (symbol.size() > max_symbol_length)
+    {
+        throw std::runtime_error("Symbol too long for market data symbol directory.");
+    }
+    append_header(out, symbol_directory_size, symbol_directory, 0, sequence);
+    utils::append_le<std::uint32_t>(out, static_cast<std::uint32_t>(symbol_id));
+    out.append(symbol);
+    out.append(max_symbol_length - symbol.size(), '\0');
+}
+
+void encode(std::span<const trade_event::EventRecord> event, std::uint64_t sequence, std::string& out)
+{
+    const trade_event::EventRecord& head = event.front();
+    const auto levels = event.subspan(1);
+    switch (head.type)
+    {
+    case trade_event::trade_record:
+        append_header(out, trade_size, trade, 0, sequence);
+        utils::append_le<std::uint32_t>(out, static_cast<std::uint32_t>(head.symbol_id));
+        utils::append_le<std::int32_t>(out, head.quantity);
+        utils::append_le<std::int64_t>(out, head.price.unscaled());
+        break;
+
+    case trade_event::depth_update_record:
+    {
+        // levels of a merged update are grouped by side on the wire
+        const size_t number_of_bids = static_cast<size_t>(std::count_if(levels.begin(), levels.end(),
+            [](const trade_event::EventRecord& level) { return level.side == order::order_side::bid; }));
+        append_header(out, depth_update_fixed_size + depth_level_size * levels.size(), depth_update, 0, sequence);
+        utils::append_le<std::uint32_t>(out, static_cast<std::uint32_t>(head.symbol_id));
+        utils::append_le<std::uint32_t>(out, static_cast<std::uint32_t>(number_of_bids));
+        utils::append_le<std::uint32_t>(out, static_cast<std::uint32_t>(levels.size() - number_of_bids));
+        utils::append_le<std::uint32_t>(out, 0);
+        append_levels(out, levels, order::order_side::bid);
+        append_levels(out, levels, order::order_side::ask);
+        break;
+    }
+
+    case trade_event::market_snap_record:
+        append_header(out, market_snap_fixed_size + market_snap_level_size * levels.size(), market_snap,
+            head.side == order::order_side::bid ? 0 : 1, sequence);
+        utils::append_le<std::uint32_t>(out, static_cast<std::uint32_t>(head.symbol_id));
+        utils::append_le<std::uint32_t>(out, static_cast<std::uint32_t>(levels.size()));
+        for (const auto& level : levels)
+        {
+            utils::append_le<std::int64_t>(out, level.price.unscaled());
+            utils::append_le<std::int32_t>(out, level.quantity);
+        }
+        break;
+
+    default:
+        throw std::runtime_error("Unknown event type for market data encoding.");
+    }
+}
+
+const std::string& Decoder::symbol(int symbol_id) const
+{
+    static const std::string unknown;
+    if (symbol_id < 0 || static_cast<size_t>(symbol_id) >= symbols_.size()) return unknown;
+    return symbols_[symbol_id];
+}
+
+size_t Decoder::decode(
+    std::span<const std::byte> in, trade_event::EventBaseCPtr& event, std::uint64_t& sequence)
+{
+    event = nullptr;
+    if (in.size() < header_size + 4) return 0;
+
+    const std::byte* p = in.data();
+    const size_t length = utils::get_le<std::uint32_t>(p);
+    const std::uint8_t type = utils::get_le<std::uint8_t>(p + 4);
+    const std::uint8_t side = utils::get_le<std::uint8_t>(p + 5);
+    if (length < header_size + 4 || in.size() < length) return 0;
+    sequence = utils::get_le<std::uint64_t>(p + 8);
+    const std::uint32_t symbol_id = utils::get_le<std::uint32_t>(p + 16);
+
+    try
+    {
+        switch (type)
+        {
+        case symbol_directory:
+        {
+            // ids are dense - refuse ids that would blow up the table
+            if (length != symbol_directory_size || symbol_id > (1u << 24)) return 0;
+            const char* name = reinterpret_cast<const char*>(p + 20);
+            size_t name_length = 0;
+            while (name_length < max_symbol_length && name[name_length] != '\0') ++name_length;
+            if (symbols_.size() <= symbol_id) symbols_.resize(symbol_id + 1);
+            symbols_[symbol_id].assign(name, name_length);
+            break;
+        }
+
+        case trade:
+            if (length != trade_size) return 0;
+            event = std::make_shared<const trade_event::TradeEvent>(
+                static_cast<int>(symbol_id),
+                utils::Price4(static_cast<long>(utils::get_le<std::int64_t>(p + 24))),
+                utils::get_le<std::int32_t>(p + 20));
+            break;
+
+        case depth_update:
+        {
+            if (length < depth_update_fixed_size) return 0;
+            const size_t number_of_bids = utils::get_le<std::uint32_t>(p + 20);
+            const size_t number_of_asks = utils::get_le<std::uint32_t>(p + 24);
+            if (length != depth_update_fixed_size + depth_level_size * (number_of_bids + number_of_asks)) return 0;
+            const std::byte* levels = p + depth_update_fixed_size;
+            event = std::make_shared<const trade_event::DepthUpdateEvent>(
+                static_cast<int>(symbol_id),
+                read_levels(levels, number_of_bids),
+                read_levels(levels + depth_level_size * number_of_bids, number_of_asks));
+            break;
+        }
+
+        case market_snap:
+        {
+            if (length < market_snap_fixed_size || side > 1) return 0;
+            const size_t number_of_levels = utils::get_le<std::uint32_t>(p + 20);
+            if (length != market_snap_fixed_size + market_snap_level_size * number_of_levels) return 0;
+            std::vector<std::pair<utils::Price4, int>> levels;
+            levels.reserve(number_of_levels);
+            for (const std::byte* level = p + market_snap_fixed_size; levels.size() < number_of_levels;
+                level += market_snap_level_size)
+            {
+                levels.emplace_back(utils::Price4(static_cast<long>(utils::get_le<std::int64_t>(level))),
+                    utils::get_le<std::int32_t>(level + 8));
+            }
+            event = std::make_shared<const trade_event::MarketSnapEvent>(
+                side == 0 ? order::order_side::bid : order::order_side::ask,
+                static_cast<int>(symbol_id), symbol(static_cast<int>(symbol_id)), levels);
+            break;
+        }
+
+        default:
+            return 0;
+        }
+    }
+    catch (const std::exception&)
+    {
+        // unknown depth update action
+        return 0;
+    }
+    return length;
+}
+
+bool to_json_lines(std::istream& in, std::ostream& out)
+{
+    Decoder decoder;
+    std::string message;
+    trade_event::EventBaseCPtr event;
+    std::uint64_t sequence;
+    while (true)
+    {
+        std::byte length_bytes[4];
+        in.read(reinterpret_cast<char*>(length_bytes), sizeof(length_bytes));
+        if (in.gcount() == 0) return true;
+        if (in.gcount() != sizeof(length_bytes)) return false;
+
+        const size_t length = utils::get_le<std::uint32_t>(length_bytes);
+        if (length < header_size + 4) return false;
+        message.resize(length);
+        std::copy(length_bytes, length_bytes + 4, reinterpret_cast<std::byte*>(message.data()));
+        in.read(message.data() + 4, static_cast<std::streamsize>(length - 4));
+        if (static_cast<size_t>(in.gcount()) != length - 4) return false;
+
+        const std::span<const std::byte> bytes(reinterpret_cast<const std::byte*>(message.data()), length);
+        if (decoder.decode(bytes, event, sequence) != length) return false;
+        if (event)
+        {
+            out << event->to_json() << "\n";
+        }
+    }
+}
+
+} // namespace market_data_protocol
@@ -0,0 +1,71 @@
+#ifndef MARKET_DATA_PROTOCOL_HPP_
+#define MARKET_DATA_PROTOCOL_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "event.hpp"
+#include "event_arena.hpp"
+
+// Binary market data, ITCH style: a stream of length-prefixed, sequenced messages, little-endian like
+// the order entry protocol. Prices are Price4 unscaled units and symbols are interned ids; a symbol
+// directory message names every id at the start of each publishing session.
+//
+//   header            0  u32  message length incl. header
+//                     4  u8   message type ('R', 'P', 'D' or 'S')
+//                     5  u8   side (market snap only, 0 buy, 1 sell)
+//                     6  u16  reserved
+//                     8  u64  sequence number
+//   symbol directory 16  u32  symbol id      20  char[16]  symbol, NUL padded
+//   trade            16  u32  symbol id      20  u32  quantity       24  i64  price
+//   depth update     16  u32  symbol id      20  u32  bid levels     24  u32  ask levels    28  u32 reserved
+//                    32  bid then ask levels, 16 bytes each: i64 price, i32 quantity, u8 action, 3 reserved
+//   market snap      16  u32  symbol id      20  u32  levels
+//                    24  levels, 12 bytes each: i64 price, i32 quantity
+namespace market_data_protocol
+{
+
+enum message_type : std::uint8_t
+{
+    symbol_directory = 'R',
+    trade = 'P',
+    depth_update = 'D',
+    market_snap = 'S'
+};
+
+constexpr size_t header_size = 16;
+constexpr size_t max_symbol_length = 16;
+
+// append a message to out
+void encode_symbol_directory(int symbol_id, std::string_view symbol, std::uint64_t sequence, std::string& out);
+// the records of one event - see trade_event::event_records
+void encode(std::span<const trade_event::EventRecord> event, std::uint64_t sequence, std::string& out);
+
+// Decodes a message stream back into events, remembering symbol directory messages so market snaps
+// get their symbol name.
+class Decoder
+{
+public:
+    // Reads the message at the front of in - returns the bytes consumed, 0 if in is truncated or the
+    // message is malformed. event is null after a symbol directory message.
+    size_t decode(std::span<const std::byte> in, trade_event::EventBaseCPtr& event, std::uint64_t& sequence);
+
+    // empty if the id was not in a symbol directory message
+    const std::string& symbol(int symbol_id) const;
+
+private:
+    std::vector<std::string> symbols_;
+};
+
+// Converts a binary stream into the json lines of the json publisher - false if the stream ends in
+// the middle of a message or holds a malformed one.
+bool to_json_lines(std::istream& in, std::ostream& out);
+
+} // namespace market_data_protocol
+
+#endif
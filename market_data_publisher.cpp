@@ -1,29 +1,367 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "market_data_protocol.hpp"
 #include "market_data_publisher.hpp"
 
 namespace exchange
 {
     std::ostream& MarketDataPublisher::publish(
-        std::ostream& os, const std::vector<trade_event::EventBaseCPtr>& events
+        std::ostream& os, const trade_event::EventArena& events
     ) const
     {
-        for (const auto& e : events)
+        const auto records = events.records();
+        std::string line;
+        for (size_t head = 0; head < records.size(); head += 1 + records[head].number_of_levels)
         {
-            os << e->to_json() << "\n";
+            line.clear();
+            append_json(trade_event::event_records(records, head), line);
+            os << line << "\n";
         }
         return os;
     }
 
-void MarketDataPublisher::publish(const std::vector<trade_event::EventBaseCPtr>& events) const
+void MarketDataPublisher::append_json(std::span<const trade_event::EventRecord> event, std::string& out) const
 {
-    std::ofstream f(market_data_state_file_, std::ios::app);
-    for (const auto& e : events)
+    static const std::string no_symbol;
+    const trade_event::EventRecord& head = event.front();
+    const bool named = head.type == trade_event::market_snap_record && ticker_rules_;
+    trade_event::append_json(event, named ? ticker_rules_->symbol(head.symbol_id) : no_symbol, out);
+}
+
+MarketDataPublisher::MarketDataPublisher(
+    const std::string& market_data_state_file,
+    const PublisherOptions& options,
+    const ticker_rules::TickerRulesCPtr& ticker_rules,
+    const utils::IoOptions& io_options
+)
+:
+market_data_state_file_(market_data_state_file),
+options_(options),
+ticker_rules_(ticker_rules),
+full_buffers_(std::make_unique<utils::SpscQueue<std::string>>(options.queue_capacity)),
+free_buffers_(std::make_unique<utils::SpscQueue<std::string>>(options.queue_capacity))
+{
+    if (options_.sink != file_sink)
+    {
+        // nothing to open
+    }
+    else if (utils::IoRing::enabled(io_options, {IORING_OP_WRITE}))
+    {
+        // appended at explicit offsets, from the size the file has now
+        fd_ = ::open(market_data_state_file_.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        struct stat st;
+        if (fd_ < 0 || ::fstat(fd_, &st) != 0)
+        {
+            throw std::runtime_error("Cannot open market data file " + market_data_state_file_ + ": " +
+                std::strerror(errno) + ".");
+        }
+        file_size_ = static_cast<std::uint64_t>(st.st_size);
+        ring_ = std::make_unique<utils::IoRing>(std::max<size_t>(options_.queue_capacity, 2));
+        ring_->register_files(std::span<const int>(&fd_, 1));
+    }
+    else
+    {
+        // unbuffered - the writer thread hands whole buffers to the OS
+        file_.rdbuf()->pubsetbuf(nullptr, 0);
+        file_.open(market_data_state_file_, std::ios::app | std::ios::binary);
+        if (!file_.good())
+        {
+            throw std::runtime_error("Cannot open market data file " + market_data_state_file_ + ".");
+        }
+    }
+    buffer_.reserve(options_.flush_bytes);
+    if (options_.format == market_data_format::binary && ticker_rules)
+    {
+        for (size_t id = 0; id < ticker_rules->number_of_symbols(); ++id)
+        {
+            market_data_protocol::encode_symbol_directory(
+                static_cast<int>(id), ticker_rules->symbol(static_cast<int>(id)), sequence_++, buffer_);
+        }
+        buffer_start_ = std::chrono::steady_clock::now();
+    }
+    if (options_.sink == file_sink)
+    {
+        writer_ = std::thread(ring_ ? &MarketDataPublisher::submit_loop : &MarketDataPublisher::write_loop, this);
+    }
+}
+
+MarketDataPublisher::~MarketDataPublisher()
+{
+    if (!writer_.joinable()) return;
+
+    // a failed write was reported by sync already, or is on the error stream
+    hand_off();
+    wait_written();
+    stopping_.store(true, std::memory_order_release);
+    number_of_pushed_.fetch_add(1, std::memory_order_release);
+    number_of_pushed_.notify_one();
+    writer_.join();
+    ring_.reset();
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+}
+
+void MarketDataPublisher::publish(const trade_event::EventArena& events)
+{
+    publish(events.records());
+}
+
+void MarketDataPublisher::publish(std::span<const trade_event::EventRecord> records)
+{
+    if (records.empty() || !has_sink()) return;
+
+    size_t number_of_events = 0;
+    for (size_t head = 0; head < records.size(); head += 1 + records[head].number_of_levels)
+    {
+        ++number_of_events;
+    }
+    const std::uint64_t sequence = take_sequences(number_of_events);
+    if (muted_ || options_.sink == null_sink) return;
+
+    if (buffer_.empty())
+    {
+        buffer_start_ = std::chrono::steady_clock::now();
+    }
+    encode(records, sequence, buffer_);
+    flush_if_due();
+}
+
+std::uint64_t MarketDataPublisher::take_sequences(size_t number_of_events)
+{
+    const std::uint64_t first = sequence_;
+    if (!muted_)
+    {
+        number_of_events_ += number_of_events;
+    }
+    if (options_.format == market_data_format::binary)
+    {
+        sequence_ += number_of_events;
+    }
+    return first;
+}
+
+std::uint64_t MarketDataPublisher::encode(
+    std::span<const trade_event::EventRecord> records, std::uint64_t sequence, std::string& out
+) const
+{
+    for (size_t head = 0; head < records.size(); head += 1 + records[head].number_of_levels)
+    {
+        const auto event = trade_event::event_records(records, head);
+        if (options_.format == market_data_format::binary)
+        {
+            market_data_protocol::encode(event, sequence++, out);
+        }
+        else
+        {
+            append_json(event, out);
+            out += '\n';
+        }
+    }
+    return sequence;
+}
+
+void MarketDataPublisher::publish_encoded(std::string_view encoded)
+{
+    if (encoded.empty() || !has_sink() || muted_ || options_.sink == null_sink) return;
+
+    if (buffer_.empty())
+    {
+        buffer_start_ = std::chrono::steady_clock::now();
+    }
+    buffer_ += encoded;
+    flush_if_due();
+}
+
+void MarketDataPublisher::flush_if_due()
+{
+    if (buffer_.size() >= options_.flush_bytes)
+    {
+        hand_off();
+    }
+    else if (options_.flush_age_us > 0 &&
+        std::chrono::steady_clock::now() - buffer_start_ >= std::chrono::microseconds(options_.flush_age_us))
+    {
+        hand_off();
+    }
+}
+
+void MarketDataPublisher::hand_off()
+{
+    if (buffer_.empty()) return;
+
+    if (options_.sink != file_sink)
+    {
+        if (options_.sink == checksum_sink)
+        {
+            for (const char c : buffer_)
+            {
+                checksum_ = (checksum_ ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+            }
+        }
+        buffer_.clear();
+        return;
+    }
+
+    // back pressure - market data is never dropped
+    while (!full_buffers_->try_push(std::move(buffer_)))
+    {
+        std::this_thread::yield();
+    }
+    ++number_of_handed_off_;
+    number_of_pushed_.fetch_add(1, std::memory_order_release);
+    number_of_pushed_.notify_one();
+
+    if (!free_buffers_->try_pop(buffer_))
+    {
+        buffer_ = std::string();
+        buffer_.reserve(options_.flush_bytes);
+    }
+}
+
+void MarketDataPublisher::sync()
+{
+    if (!has_sink()) return;
+
+    hand_off();
+    if (!writer_.joinable()) return;
+
+    wait_written();
+    if (failed_.load(std::memory_order_acquire))
+    {
+        throw std::runtime_error("Cannot write market data file " + market_data_state_file_ + ".");
+    }
+}
+
+void MarketDataPublisher::wait_written()
+{
+    size_t written = number_of_written_.load(std::memory_order_acquire);
+    while (written != number_of_handed_off_)
     {
-        f << e->to_json() << "\n";
-        // std::cout << e->to_json() << std::endl; // write to cout for debug purpose
+        number_of_written_.wait(written, std::memory_order_acquire);
+        written = number_of_written_.load(std::memory_order_acquire);
+    }
+}
+
+void MarketDataPublisher::write_loop()
+{
+    std::string buffer;
+    while (true)
+    {
+        const size_t pushed = number_of_pushed_.load(std::memory_order_acquire);
+        if (!full_buffers_->try_pop(buffer))
+        {
+            if (stopping_.load(std::memory_order_acquire)) break;
+            number_of_pushed_.wait(pushed, std::memory_order_acquire);
+            continue;
+        }
+
+        // nothing goes after a failed write, which would leave a hole in the file
+        if (!failed_.load(std::memory_order_relaxed))
+        {
+            file_.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            if (!file_.good())
+            {
+                std::cerr << "Cannot write market data file " << market_data_state_file_ << "." << std::endl;
+                failed_.store(true, std::memory_order_release);
+            }
+        }
+        buffer.clear();
+        // back to the matching thread for reuse - kept here if the free queue is full
+        free_buffers_->try_push(std::move(buffer));
+
+        number_of_written_.fetch_add(1, std::memory_order_release);
+        number_of_written_.notify_all();
+    }
+}
+
+void MarketDataPublisher::submit_loop()
+{
+    std::vector<std::string> batch(options_.queue_capacity);
+    // file offset and bytes written so far of every buffer of the batch
+    std::vector<std::uint64_t> offsets(batch.size());
+    std::vector<size_t> written(batch.size());
+    while (true)
+    {
+        const size_t pushed = number_of_pushed_.load(std::memory_order_acquire);
+        size_t number_of_buffers = 0;
+        while (number_of_buffers < batch.size() && full_buffers_->try_pop(batch[number_of_buffers]))
+        {
+            offsets[number_of_buffers] = file_size_;
+            written[number_of_buffers] = 0;
+            file_size_ += batch[number_of_buffers].size();
+            ++number_of_buffers;
+        }
+        if (number_of_buffers == 0)
+        {
+            if (stopping_.load(std::memory_order_acquire)) break;
+            number_of_pushed_.wait(pushed, std::memory_order_acquire);
+            continue;
+        }
+
+        // Every buffer waiting goes in one submission, linked so they are written in order and a crash
+        // leaves no hole. A short write cancels the writes after it, so what is left of them goes again
+        // until everything is written or a write fails outright - nothing goes after that.
+        bool failed = failed_.load(std::memory_order_relaxed);
+        while (!failed)
+        {
+            unsigned number_of_writes = 0;
+            io_uring_sqe* last = nullptr;
+            for (size_t i = 0; i < number_of_buffers; ++i)
+            {
+                const std::string& buffer = batch[i];
+                if (written[i] == buffer.size()) continue;
+
+                last = &ring_->prepare(IORING_OP_WRITE, 0, buffer.data() + written[i],
+                    static_cast<unsigned>(buffer.size() - written[i]), offsets[i] + written[i], i);
+                last->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+                ++number_of_writes;
+            }
+            if (number_of_writes == 0) break;
+            last->flags &= ~IOSQE_IO_LINK;
+
+            size_t completed = 0;
+            ring_->submit(number_of_writes);
+            while (completed < number_of_writes)
+            {
+                completed += ring_->complete([&](const io_uring_cqe& cqe) {
+                    if (cqe.res > 0)
+                    {
+                        written[cqe.user_data] += static_cast<size_t>(cqe.res);
+                    }
+                    else if (cqe.res == 0 || (cqe.res != -ECANCELED && cqe.res != -EINTR && cqe.res != -EAGAIN))
+                    {
+                        failed = true;
+                    }
+                });
+                if (completed < number_of_writes)
+                {
+                    ring_->submit(1);
+                }
+            }
+        }
+        if (failed && !failed_.load(std::memory_order_relaxed))
+        {
+            std::cerr << "Cannot write market data file " << market_data_state_file_ << "." << std::endl;
+            failed_.store(true, std::memory_order_release);
+        }
+
+        for (size_t i = 0; i < number_of_buffers; ++i)
+        {
+            batch[i].clear();
+            free_buffers_->try_push(std::move(batch[i]));
+        }
+        number_of_written_.fetch_add(number_of_buffers, std::memory_order_release);
+        number_of_written_.notify_all();
     }
-    f.close();
 }
 
 } // namespace exchange
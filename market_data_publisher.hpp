@@ -1,35 +1,184 @@
 #ifndef MARKET_DATA_PUBLISHER_
 #define MARKET_DATA_PUBLISHER_
 
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <nlohmann/json.hpp>
 #include <ostream>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
-#include "event.hpp"
+#include "event_arena.hpp"
+#include "io_ring.hpp"
+#include "spsc_queue.hpp"
+#include "ticker_rules.hpp"
 
 namespace exchange
 {
 
+using json = nlohmann::json;
+
 class MarketDataPublisher;
 typedef std::unique_ptr<MarketDataPublisher> MarketDataPublisherPtr;
 typedef std::unique_ptr<const MarketDataPublisher> MarketDataPublisherCPtr;
 
+enum market_data_format
+{
+    // one json object per line
+    json_lines,
+    // market_data_protocol messages
+    binary
+};
+
+NLOHMANN_JSON_SERIALIZE_ENUM(
+    market_data_format,
+    {
+        {json_lines, "json"},
+        {binary, "binary"}
+    }
+)
+
+enum market_data_sink
+{
+    // the market data file, through the writer thread
+    file_sink,
+    // events are numbered and dropped without being encoded, e.g. to time matching alone
+    null_sink,
+    // events are encoded and folded into a checksum instead of being written
+    checksum_sink
+};
+
+NLOHMANN_JSON_SERIALIZE_ENUM(
+    market_data_sink,
+    {
+        {file_sink, "file"},
+        {null_sink, "null"},
+        {checksum_sink, "checksum"}
+    }
+)
+
+// when buffered events are handed to the writer thread - whichever limit is hit first, on publish
+struct PublisherOptions
+{
+    market_data_format format = json_lines;
+    market_data_sink sink = file_sink;
+    // size of the buffer filled by the matching thread
+    size_t flush_bytes = 1 << 16;
+    // Age of the oldest buffered event, 0 to disable it. Only checked on publish, so no time bound:
+    // after the last event of a burst, buffered events wait for the next publish, a sync or the close.
+    long flush_age_us = 1000;
+    // buffers in flight to the writer thread
+    size_t queue_capacity = 64;
+};
+
+template <typename BasicJsonType>
+void from_json(const BasicJsonType& j, PublisherOptions& o)
+{
+    const PublisherOptions defaults;
+    o.format = j.value("format", defaults.format);
+    o.sink = j.value("sink", defaults.sink);
+    o.flush_bytes = j.value("flush_bytes", defaults.flush_bytes);
+    o.flush_age_us = j.value("flush_age_us", defaults.flush_age_us);
+    o.queue_capacity = j.value("queue_capacity", defaults.queue_capacity);
+}
+
+// Appends events to the market data file. Events are serialised into an in-memory buffer on the
+// calling (matching) thread; full or aged buffers go through a lock-free queue to a writer thread that
+// owns the open file, so publishing never blocks on file I/O unless the queue is full. With io_uring
+// the writer thread writes every buffer waiting in the queue with one system call.
 class MarketDataPublisher
 {
 public:
     MarketDataPublisher() = default;
+    // binary publishers name the listed symbols in a symbol directory first, json market snaps name
+    // their symbol
     MarketDataPublisher(
-        const std::string& market_data_state_file
-    )
-    :
-    market_data_state_file_(market_data_state_file)
-    {}
+        const std::string& market_data_state_file,
+        const PublisherOptions& options = PublisherOptions(),
+        const ticker_rules::TickerRulesCPtr& ticker_rules = ticker_rules::TickerRulesCPtr(),
+        const utils::IoOptions& io_options = utils::IoOptions()
+    );
+    ~MarketDataPublisher();
+
+    MarketDataPublisher(const MarketDataPublisher&) = delete;
+    MarketDataPublisher& operator=(const MarketDataPublisher&) = delete;
+
+    void publish(const trade_event::EventArena& events);
+    // whole events, e.g. the records of one request taken from an arena
+    void publish(std::span<const trade_event::EventRecord> records);
+    // Publishing split up for serialiser threads: sequence numbers are taken in publishing order,
+    // encoding is thread safe, and encoded events are appended in sequence order. Everything but
+    // encode belongs to one thread at a time.
+    std::uint64_t take_sequences(size_t number_of_events);
+    // returns the sequence number after the last event
+    std::uint64_t encode(std::span<const trade_event::EventRecord> records, std::uint64_t sequence,
+        std::string& out) const;
+    void publish_encoded(std::string_view encoded);
+    // sequence number the next binary message takes
+    std::uint64_t next_sequence() const { return sequence_; }
 
-    void publish(const std::vector<trade_event::EventBaseCPtr>& events) const;
     // write to standard output for test purpose
-    std::ostream& publish(std::ostream& os, const std::vector<trade_event::EventBaseCPtr>& events) const;
+    std::ostream& publish(std::ostream& os, const trade_event::EventArena& events) const;
+
+    // Returns once everything published so far is written to the file - throws if any of it could not
+    // be, in which case nothing after the failed write was written either.
+    void sync();
+
+    // Muted publishers drop events but still number them, e.g. while replaying events that were
+    // published before. Only changed while nothing is being published.
+    void mute(bool muted) { muted_ = muted; }
+
+    // events published so far, muted ones aside
+    size_t number_of_events() const { return number_of_events_; }
+    // FNV-1a of what a checksum sink took - the bytes a file sink would have written, once synced
+    std::uint64_t checksum() const { return checksum_; }
 
 private:
+    // a file, or a sink that needs none - default constructed publishers have neither
+    bool has_sink() const { return writer_.joinable() || options_.sink != file_sink; }
+    void flush_if_due();
+    void hand_off();
+    // waits for the writer thread to take every buffer handed off
+    void wait_written();
+    void write_loop();
+    // write_loop on io_uring
+    void submit_loop();
+    void append_json(std::span<const trade_event::EventRecord> event, std::string& out) const;
+
     std::string market_data_state_file_;
+    PublisherOptions options_;
+    ticker_rules::TickerRulesCPtr ticker_rules_;
+
+    // matching (or serialising) thread side
+    std::string buffer_;
+    std::chrono::steady_clock::time_point buffer_start_;
+    // sequence number of the next binary message
+    std::uint64_t sequence_ = 1;
+    size_t number_of_handed_off_ = 0;
+    bool muted_ = false;
+    size_t number_of_events_ = 0;
+    std::uint64_t checksum_ = 14695981039346656037ull;
+
+    // full buffers to the writer thread, emptied ones back for reuse
+    std::unique_ptr<utils::SpscQueue<std::string>> full_buffers_;
+    std::unique_ptr<utils::SpscQueue<std::string>> free_buffers_;
+    // bumped on every hand off, so the idle writer thread can wait on it
+    std::atomic<size_t> number_of_pushed_{0};
+    std::atomic<size_t> number_of_written_{0};
+    std::atomic<bool> stopping_{false};
+    // set by the writer thread once a write failed, from then on buffers are dropped
+    std::atomic<bool> failed_{false};
+
+    // writer thread side, the file is written through the ring if there is one
+    std::ofstream file_;
+    utils::IoRingPtr ring_;
+    int fd_ = -1;
+    std::uint64_t file_size_ = 0;
+    std::thread writer_;
 };
 
 } // namespace exchange
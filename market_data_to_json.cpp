@@ -0,0 +1,36 @@
+#include <fstream>
+#include <iostream>
+#include "market_data_protocol.hpp"
+
+// Converts a binary market data file into the json lines the json publisher writes, for debugging.
+// usage: market_data_to_json binary_market_data_file [json_output_file]
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: market_data_to_json binary_market_data_file [json_output_file]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream infile(argv[1], std::ios::binary);
+    if (!infile.good())
+    {
+        std::cerr << "Cannot open " << argv[1] << "." << std::endl;
+        return 1;
+    }
+
+    std::ofstream outfile;
+    if (argc > 2)
+    {
+        outfile.open(argv[2]);
+    }
+    std::ostream& out = argc > 2 ? outfile : std::cout;
+
+    if (!market_data_protocol::to_json_lines(infile, out))
+    {
+        std::cerr << "Malformed or truncated market data in " << argv[1] << "." << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,22 +1,28 @@
 #include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
 #include <exception>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <utility>
 #include <vector>
+#include "level_order_book.hpp"
 #include "matching_engine.hpp"
 #include "order.hpp"
 #include "price4.hpp"
+#include "tick_ladder.hpp"
 #include "ticker_rules.hpp"
 
 namespace exchange
 {
 
-inline std::string create_book_key(const std::string& symbol, order::order_side side)
+// each symbol owns a bid and an ask book, next to each other in the book table
+inline std::uint32_t book_id(int symbol_id, order::order_side side)
 {
-    return symbol + "&" + std::to_string(side);
+    return 2 * static_cast<std::uint32_t>(symbol_id) + (side == order::order_side::bid ? 0 : 1);
 }
 
 bool MatchingEngine::validate_order(const order::OrderBasePtr& o) const
@@ -24,141 +30,307 @@ bool MatchingEngine::validate_order(const order::OrderBasePtr& o) const
     return o->quantity() > 0;
 }
 
-bool MatchingEngine::validate_order(const json& j) const
+bool MatchingEngine::validate_order(const Request& r, int symbol_id) const
 {
-    const std::string symbol = j.value("symbol", "AAPL");
-    const int quantity = j.contains("quantity") ? j.at("quantity").get<int>() : 
-        (j.value("display_quantity", 0) + j.value("hidden_quantity", 0));
+    return validator_.validate(r, symbol_id);
+}
 
-    // remove invalid symbol
-    if (!ticker_rules_->is_valid(symbol))
+bool MatchingEngine::validate_order(const std::string& o) const
+{
+    Request r;
+    if (!RequestParser::parse(o, r) || r.type != new_request)
     {
         return false;
     }
-    // remove zero quantity
-    if (quantity == 0)
+    return validate_order(r, resolve_symbol_id(r));
+}
+
+order::OrderBookPtr MatchingEngine::create_order_book(int symbol_id, order::order_side side) const
+{
+    const order::order_book_type type = book_rules_ ? 
+        book_rules_->book_type(ticker_rules_->symbol(symbol_id)) : order::order_book_type::heap;
+    const bool is_bid = side == order::order_side::bid;
+    const std::vector<order::LimitOrderPtr> orders;
+
+    switch (type)
     {
-        return false;
+    case order::order_book_type::price_level:
+        if (is_bid) return std::make_unique<order::BidLevelOrderBook>(side, symbol_id, orders, pool_options_);
+        return std::make_unique<order::AskLevelOrderBook>(side, symbol_id, orders, pool_options_);
+
+    case order::order_book_type::tick_ladder:
+        if (is_bid) return std::make_unique<order::BidTickLadderOrderBook>(
+            side, symbol_id, order::BidTickLadder(ticker_size_rules_), orders, pool_options_);
+        return std::make_unique<order::AskTickLadderOrderBook>(
+            side, symbol_id, order::AskTickLadder(ticker_size_rules_), orders, pool_options_);
+
+    case order::order_book_type::heap:
+        if (is_bid) return std::make_unique<order::BidOrderBook>(side, symbol_id, orders, pool_options_);
+        return std::make_unique<order::AskOrderBook>(side, symbol_id, orders, pool_options_);
+
+    default:
+        throw std::runtime_error("Unknown order book type.");
     }
+}
 
-    // if limit order
-    if (j.contains("limit_price"))
+void MatchingEngine::create_order_books(const std::vector<bool>& owned_symbols)
+{
+    if (!ticker_rules_) return;
+
+    const size_t number_of_symbols = ticker_rules_->number_of_symbols();
+    order_books_.reserve(2 * number_of_symbols);
+    for (size_t symbol_id = 0; symbol_id < number_of_symbols; ++symbol_id)
     {
-        const utils::Price4 limit_price = j.value("limit_price", utils::Price4(0));
-        if (!ticker_size_rules_->is_valid(limit_price) || 
-            !(lot_size_rules_->lot_type(limit_price, quantity) == size_rules::lot_types::round_lot))
+        const bool owned = owned_symbols.empty() || (symbol_id < owned_symbols.size() && owned_symbols[symbol_id]);
+        for (const auto side : {order::order_side::bid, order::order_side::ask})
         {
-            return false;
+            if (!owned)
+            {
+                order_books_.emplace_back();
+                continue;
+            }
+            order::OrderBookPtr book = create_order_book(static_cast<int>(symbol_id), side);
+            book->attach_order_index(&order_index_, static_cast<std::uint32_t>(order_books_.size()));
+            order_books_.push_back(std::move(book));
         }
     }
-
-    return true;
 }
 
-bool MatchingEngine::validate_order(const std::string& o) const
+void MatchingEngine::insert_order(order::LimitOrderPtr& o)
 {
-    auto j = json::parse(o);
-    return validate_order(j);
-}
+    const std::uint32_t id = book_id(o->symbol_id(), o->side());
 
-std::vector<trade_event::EventBaseCPtr> MatchingEngine::insert_order(order::LimitOrderPtr& o)
-{
-    const auto& order_book_key = create_book_key(o->symbol(), o->side());
-    if (!order_books_.count(order_book_key))
+    // order ids are unique across books - the index holds one location per id
+    const order::OrderLocation* location = order_index_.find(o->order_id());
+    if (location && location->book != id)
     {
-        if (o->side() == order::order_side::bid)
-        {
-            order_books_[order_book_key] = std::make_unique<order::BidOrderBook>(
-                o->side(), std::vector<order::LimitOrderPtr>());
-        }
-        else
-        {
-            order_books_[order_book_key] = std::make_unique<order::AskOrderBook>(
-                o->side(), std::vector<order::LimitOrderPtr>());
-        }
+        return;
     }
 
-    auto msg = order_books_[order_book_key]->insert_order(o);
-    return std::vector<trade_event::EventBaseCPtr>(1, msg);
+    order_books_[id]->insert_order(o, events_);
 }
 
 MatchingEngine::MatchingEngine(
     const size_rules::TickSizeRulesCPtr& ticker_size_rules,
     const size_rules::LotSizeRulesCPtr& lot_size_rules,
-    const ticker_rules::TickerRulesCPtr& ticker_rules
+    const ticker_rules::TickerRulesCPtr& ticker_rules,
+    const book_rules::BookRulesCPtr& book_rules,
+    const utils::PoolOptions& pool_options,
+    const std::vector<bool>& owned_symbols
 )
 :
 ticker_size_rules_(ticker_size_rules),
 lot_size_rules_(lot_size_rules),
-ticker_rules_(ticker_rules)
-{}
+ticker_rules_(ticker_rules),
+book_rules_(book_rules),
+pool_options_(pool_options),
+validator_(ticker_size_rules, lot_size_rules, ticker_rules)
+{
+    create_order_books(owned_symbols);
+}
 
-std::vector<trade_event::EventBaseCPtr> MatchingEngine::cancel_order(int order_id)
+void MatchingEngine::cancel_order(int order_id)
 {
-    std::vector<trade_event::EventBaseCPtr> msgs;
-    msgs.reserve(1);
-    for (auto it = order_books_.begin(); it != order_books_.end(); ++it)
+    const order::OrderLocation* location = order_index_.find(order_id);
+    if (!location)
     {
-        auto msg = it->second->cancel_order(order_id);
-        if (msg)
-        {
-            msgs.push_back(msg);
-        }
+        return;
     }
-    return msgs;
+
+    order_books_[location->book]->cancel_order(order_id, events_);
 }
 
-std::vector<trade_event::EventBaseCPtr> MatchingEngine::replenish_order(int order_id, int quantity)
+void MatchingEngine::replenish_order(int order_id, int quantity, int time)
 {
-    std::vector<trade_event::EventBaseCPtr> msgs;
-    msgs.reserve(1);
-    for (auto it = order_books_.begin(); it != order_books_.end(); ++it)
-    {
-        const std::string& key = it->first;
-        const std::string symbol = key.substr(0, key.find("&"));
-        auto msg = it->second->replenish_order(order_id, quantity, symbol);
-        if (msg)
-        {
-            msgs.push_back(msg);
-        }
+    const order::OrderLocation* location = order_index_.find(order_id);
+    if (!location)
+    {
+        return;
     }
-    return msgs;
+
+    order_books_[location->book]->replenish_order(order_id, quantity, time, events_);
 }
 
-std::vector<trade_event::EventBaseCPtr> MatchingEngine::match_order(order::OrderBasePtr& o)
+void MatchingEngine::match_order(order::OrderBasePtr& o)
 {
     const order::order_side book_side = o->side() == order::order_side::bid ?
         order::order_side::ask : order::order_side::bid;
 
-    std::vector<trade_event::EventBaseCPtr> msgs;
-    const std::string book_key = create_book_key(o->symbol(), book_side);
-    if (order_books_.count(book_key))
+    order_books_[book_id(o->symbol_id(), book_side)]->match_order(o, events_);
+}
+
+void MatchingEngine::attach_region(BookRegion& region, bool resume)
+{
+    if (!resume)
+    {
+        region.reset();
+    }
+    for (std::uint32_t id = 0; id < order_books_.size(); ++id)
     {
-        auto& order_book = order_books_[book_key];
-        auto msg = order_book->match_order(o);
-        msgs.insert(msgs.begin(), msg.begin(), msg.end());
+        if (!order_books_[id]) continue;
+
+        order_books_[id]->use_record_memory(region.records(id), region.orders_per_book(), region.cursor(id), resume);
+        order_books_[id]->for_each_order([this, id](const order::RestingOrder& o)
+        {
+            order_index_.insert(o.order_id, order::OrderLocation{id});
+        });
     }
-    return msgs;
+    region_ = &region;
+}
+
+bool MatchingEngine::owns_symbol(int symbol_id) const
+{
+    return symbol_id >= 0 && 2 * static_cast<size_t>(symbol_id) < order_books_.size() &&
+        order_books_[book_id(symbol_id, order::order_side::bid)] != nullptr;
+}
+
+utils::PoolStats MatchingEngine::pool_stats(int symbol_id, order::order_side side) const
+{
+    if (!owns_symbol(symbol_id))
+    {
+        throw std::runtime_error("Symbol is not matched by this engine.");
+    }
+    return order_books_[book_id(symbol_id, side)]->pool_stats();
 }
 
 void MatchingEngine::eod_cleanup(const std::string& close_order_cache_file)
 {
-    std::ofstream ofile(close_order_cache_file);
-    for (auto it = order_books_.begin(); it != order_books_.end(); ++it)
+    order::BookSnapshotWriter snapshot;
+    eod_cleanup(snapshot);
+    snapshot.write(close_order_cache_file);
+}
+
+void MatchingEngine::eod_cleanup(order::BookSnapshotWriter& snapshot)
+{
+    // a close cut short leaves nothing to resume
+    if (region_)
     {
-        const auto& curr_book = it->second;
-        const auto eod_orders = curr_book->get_eod_orders();
-        for (const auto& o : eod_orders)
-        {
-            ofile << o << "\n";
-        } 
+        region_->close();
+    }
+    std::vector<order::RestingOrder> orders;
+    for (size_t id = 0; id < order_books_.size(); ++id)
+    {
+        const auto& curr_book = order_books_[id];
+        if (!curr_book) continue;
+
+        orders.clear();
+        curr_book->get_eod_orders(orders);
+        snapshot.add_section(ticker_rules_->symbol(static_cast<int>(id / 2)),
+            id % 2 == 0 ? order::order_side::bid : order::order_side::ask, orders);
+    }
+    order_index_.clear();
+}
+
+void MatchingEngine::checkpoint(order::BookSnapshotWriter& snapshot) const
+{
+    std::vector<order::RestingOrder> orders;
+    for (size_t id = 0; id < order_books_.size(); ++id)
+    {
+        const auto& curr_book = order_books_[id];
+        if (!curr_book) continue;
+
+        orders.clear();
+        curr_book->for_each_order([&orders](const order::RestingOrder& o) { orders.push_back(o); });
+        snapshot.add_section(ticker_rules_->symbol(static_cast<int>(id / 2)),
+            id % 2 == 0 ? order::order_side::bid : order::order_side::ask, orders);
     }
 }
 
-std::vector<trade_event::EventBaseCPtr> MatchingEngine::prev_open_setup(
+const trade_event::EventArena& MatchingEngine::prev_open_setup(
     const std::string& close_order_cache_file
 )
 {
+    events_.clear();
+    if (order::BookSnapshot::is_snapshot(close_order_cache_file))
+    {
+        restore(order::BookSnapshot(close_order_cache_file));
+    }
+    else
+    {
+        load_json_orders(close_order_cache_file);
+    }
+
+    if (region_)
+    {
+        region_->open();
+    }
+
+    // only the snapshots are published, not the depth updates of the reloaded orders
+    events_.clear();
+    for (const auto& book : order_books_)
+    {
+        // every owned symbol has books - only snapshot the ones holding orders
+        if (!book || book->number_of_valid_orders() == 0) continue;
+
+        book->get_price_levels(events_);
+    }
+    return events_;
+}
+
+void MatchingEngine::restore(const order::BookSnapshot& snapshot)
+{
+    std::vector<std::vector<std::span<const order::RestingOrder>>> sections(order_books_.size());
+    std::vector<std::uint32_t> books;
+    for (const auto& section : snapshot.sections())
+    {
+        const int symbol_id = ticker_rules_->symbol_id(section.symbol);
+        if (symbol_id == ticker_rules::TickerRules::invalid_symbol_id)
+        {
+            std::cerr << "Unknown symbol in close order cache." << '\n';
+            continue;
+        }
+        if (!owns_symbol(symbol_id))
+        {
+            continue;
+        }
+        const std::uint32_t id = book_id(symbol_id, section.side);
+        if (sections[id].empty()) books.push_back(id);
+        sections[id].push_back(section.orders);
+    }
+
+    // books share nothing but the order index, which is filled once they are all restored
+    std::atomic<size_t> next_book{0};
+    const auto restore_books = [&]()
+    {
+        for (size_t i = next_book++; i < books.size(); i = next_book++)
+        {
+            for (const auto& orders : sections[books[i]])
+            {
+                order_books_[books[i]]->restore(orders);
+            }
+        }
+    };
+    const size_t number_of_threads = std::min<size_t>(books.size(), std::thread::hardware_concurrency());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < number_of_threads; ++i)
+    {
+        threads.emplace_back(restore_books);
+    }
+    restore_books();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    for (const std::uint32_t id : books)
+    {
+        for (const auto& orders : sections[id])
+        {
+            for (const auto& o : orders)
+            {
+                // order ids are unique across books - the first book keeps the id
+                if (!order_index_.find(o.order_id) && order_books_[id]->contains(o.order_id))
+                {
+                    order_index_.insert(o.order_id, order::OrderLocation{id});
+                }
+            }
+        }
+    }
+}
+
+void MatchingEngine::load_json_orders(const std::string& close_order_cache_file)
+{
+    // close order caches written before they were binary snapshots
     std::ifstream infile(close_order_cache_file);
     std::string butter;
     while (std::getline(infile, butter))
@@ -168,7 +340,16 @@ std::vector<trade_event::EventBaseCPtr> MatchingEngine::prev_open_setup(
             const json j = json::parse(butter);
             try
             {
-                order::OrderBasePtr base_o = order::OrderFactory::create(j);
+                const int symbol_id = ticker_rules_->symbol_id(j.at("symbol").get<std::string>());
+                if (symbol_id == ticker_rules::TickerRules::invalid_symbol_id)
+                {
+                    throw std::runtime_error("Unknown symbol in close order cache.");
+                }
+                if (!owns_symbol(symbol_id))
+                {
+                    continue;
+                }
+                order::OrderBasePtr base_o = order::OrderFactory::create(j, symbol_id);
                 order::LimitOrderPtr o = std::dynamic_pointer_cast<order::LimitOrder>(base_o);
                 insert_order(o);
             }
@@ -178,102 +359,188 @@ std::vector<trade_event::EventBaseCPtr> MatchingEngine::prev_open_setup(
             }
         }
     }
+}
 
-    std::vector<trade_event::EventBaseCPtr> info;
-    const size_t num_books = order_books_.size();
-    info.reserve(num_books);
-    for (const auto& [key, book] : order_books_)
-    {   
-        const auto event = book->get_price_levels(key.substr(0, key.find("&")));
-        info.push_back(event);
-    }
-    return info;
+int MatchingEngine::resolve_symbol_id(const Request& r) const
+{
+    const int symbol_id = r.symbol_id == Request::unresolved_symbol_id ?
+        ticker_rules_->symbol_id(r.symbol()) : r.symbol_id;
+    // symbols matched by other engines are as good as unlisted
+    return owns_symbol(symbol_id) ? symbol_id : ticker_rules::TickerRules::invalid_symbol_id;
 }
 
-void update_events(
-    std::vector<trade_event::EventBaseCPtr>& events, 
-    const std::vector<trade_event::EventBaseCPtr>& insertion_event
-)
+void MatchingEngine::new_order(const Request& r, int symbol_id, bool validated)
 {
-    if (insertion_event.size() != 1)
+    if (!validated && !validate_order(r, symbol_id))
     {
-        throw std::runtime_error("Expect insertion_event has lenght 1.");
+        return;
     }
-    if (!events.empty() && events.back()->type() == trade_event::trade_type::depth_update)
+
+    order::OrderBasePtr o = create_order(r, symbol_id);
+    const size_t matched_from = events_.size();
+    match_order(o);
+    // there is corner case for iceberg order
+    if (o->order_type() != order::order_type::market && o->total_quantity() > 0)
     {
-        if (events.back()->empty())
+        // a crossing order ends its events with the depth update of the book it matched against
+        bool crossed = events_.size() > matched_from;
+        const size_t tail = events_.back_index();
+        if (crossed && events_.back().number_of_levels == 0)
         {
-            events.pop_back();
-            if (insertion_event[0])
-                events.push_back(insertion_event[0]);
+            events_.pop_back();
+            crossed = false;
         }
-        else
+
+        order::LimitOrderPtr limit_o = std::dynamic_pointer_cast<order::LimitOrder>(o);
+        const size_t inserted_from = events_.size();
+        insert_order(limit_o);
+        // publish both sides in one depth update
+        if (crossed && events_.size() > inserted_from)
         {
-            trade_event::DepthUpdateEventCPtr tail_event = std::dynamic_pointer_cast<const trade_event::DepthUpdateEvent>(events.back());
-            trade_event::DepthUpdateEventCPtr new_event = std::dynamic_pointer_cast<const trade_event::DepthUpdateEvent>(insertion_event[0]);
-            if ((!tail_event->bid_order_update_info().empty() && !new_event->bid_order_update_info().empty()) ||
-                (!tail_event->ask_order_update_info().empty() && !new_event->ask_order_update_info().empty())
-            )
-            {
-                throw std::runtime_error("Expect tail event and insertion event have differnt side.");
-            }
-            trade_event::EventBaseCPtr merged_event = std::make_shared<trade_event::DepthUpdateEvent>(
-                tail_event->bid_order_update_info().empty() ? new_event->bid_order_update_info() : tail_event->bid_order_update_info(),
-                tail_event->ask_order_update_info().empty() ? new_event->ask_order_update_info() : tail_event->ask_order_update_info()
-            );
-            events.pop_back();
-            events.push_back(merged_event);
+            events_.merge_last_depth_update(tail);
         }
     }
-    else
-    {   
-        if (insertion_event[0]) events.push_back(insertion_event[0]);
+}
+
+void MatchingEngine::modify_order(const Request& r, int symbol_id, bool validated)
+{
+    // the replacement has to be valid and stay on the book of the resting order, otherwise the
+    // resting order is left untouched
+    const order::OrderLocation* location = order_index_.find(r.order_id);
+    if (!location || (!validated && !validate_order(r, symbol_id)) || location->book != book_id(symbol_id, r.side))
+    {
+        return;
+    }
+
+    // cancel-replace - the replacement loses time priority and may trade on arrival
+    cancel_order(r.order_id);
+    new_order(r, symbol_id, validated);
+}
+
+const trade_event::EventArena& MatchingEngine::process_order(std::string_view s)
+{
+    Request r;
+    if (!RequestParser::parse(s, r))
+    {
+        std::cout << "Cannot parse request: " << s << std::endl;
+        events_.clear();
+        return events_;
     }
+    return process_order(r);
 }
 
-std::vector<trade_event::EventBaseCPtr> MatchingEngine::process_order(const std::string& s)
+const trade_event::EventArena& MatchingEngine::process_order(const Request& r)
 {
-    std::vector<trade_event::EventBaseCPtr> events;
-    try
+    return process_order(r, false);
+}
+
+const trade_event::EventArena& MatchingEngine::process_validated_order(const Request& r)
+{
+    return process_order(r, true);
+}
+
+const trade_event::EventArena& MatchingEngine::process_order(const Request& r, bool validated)
+{
+    events_.clear();
+    append_order(r, validated);
+    return events_;
+}
+
+const trade_event::EventArena& MatchingEngine::process_orders(std::span<const Request> requests, bool conflate)
+{
+    events_.clear();
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+        if (i + 1 < requests.size())
+        {
+            prefetch_book(requests[i + 1]);
+        }
+        append_order(requests[i], false);
+    }
+    if (conflate)
+    {
+        events_.conflate_depth_updates(0, [this](int symbol_id, order::order_side side, const utils::Price4& price)
+        {
+            return order_books_[book_id(symbol_id, side)]->displayed_quantity(price);
+        });
+    }
+    return events_;
+}
+
+void MatchingEngine::prefetch_book(const Request& r)
+{
+    order::OrderBookBase* book = nullptr;
+    switch (r.type)
+    {
+    case cancel_request:
+    case replenish_request:
+    {
+        const order::OrderLocation* location = order_index_.find(r.order_id);
+        if (location) book = order_books_[location->book].get();
+        break;
+    }
+
+    case new_request:
+    case modify_request:
+    {
+        // a new order matches against the other side first
+        const int symbol_id = resolve_symbol_id(r);
+        if (symbol_id == ticker_rules::TickerRules::invalid_symbol_id) break;
+        book = order_books_[book_id(symbol_id, r.side == order::order_side::bid ?
+            order::order_side::ask : order::order_side::bid)].get();
+        break;
+    }
+
+    default:
+        break;
+    }
+    if (book)
     {
-        json j = json::parse(s);
+        book->prefetch_best();
+    }
+}
 
-        if (j.contains("type"))
+void MatchingEngine::append_order(const Request& r, bool validated)
+{
+    if (region_)
+    {
+        region_->begin_request();
+    }
+    const trade_event::EventArena::Mark mark = events_.mark();
+    try
+    {
+        switch (r.type)
         {
-            if (j.at("type") == "CANCEL")
-            {
-                events = cancel_order(j.at("order_id").template get<int>());
-            }
-            else if (j.at("type") == "REPLENISH")
-            {
-                events = replenish_order(
-                    j.at("order_id").template get<int>(), 
-                    j.at("quantity").template get<int>()
-                );
-            }
-            else if (j.at("type") == "NEW")
-            {
-                if (validate_order(j))
-                {
-                    order::OrderBasePtr o = order::OrderFactory::create(j);
-                    events = match_order(o);
-                    // there is corner case for iceberg order
-                    if (o->order_type() != order::order_type::market && o->total_quantity() > 0)
-                    {
-                        order::LimitOrderPtr limit_o = std::dynamic_pointer_cast<order::LimitOrder>(o);
-                        auto insertion_event = insert_order(limit_o);
-                        update_events(events, insertion_event);
-                    }
-                }
-            }
+        case cancel_request:
+            cancel_order(r.order_id);
+            break;
+
+        case replenish_request:
+            replenish_order(r.order_id, r.quantity, r.time);
+            break;
+
+        case new_request:
+            new_order(r, validated ? r.symbol_id : resolve_symbol_id(r), validated);
+            break;
+
+        case modify_request:
+            modify_order(r, validated ? r.symbol_id : resolve_symbol_id(r), validated);
+            break;
+
+        default:
+            break;
         }
     }
     catch (std::exception& e)
     {
         std::cout << e.what() << std::endl;
+        // nothing of a failed request is published
+        events_.rollback(mark);
+    }
+    if (region_)
+    {
+        region_->end_request();
     }
-
-    return events;
 }
 
 } // namespace exchange
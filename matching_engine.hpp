@@ -3,17 +3,28 @@
 
 #include <memory>
 #include <nlohmann/json.hpp>
+#include <ostream>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <queue>
+#include <span>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
+#include "book_region.hpp"
+#include "book_rules.hpp"
+#include "book_snapshot.hpp"
 #include "event.hpp"
+#include "event_arena.hpp"
 #include "order.hpp"
 #include "order_book.hpp"
+#include "order_index.hpp"
+#include "request.hpp"
+#include "request_validator.hpp"
 #include "size_rules.hpp"
+#include "slab_pool.hpp"
 #include "ticker_rules.hpp"
 
 namespace exchange
@@ -32,36 +43,90 @@ public:
     MatchingEngine(
         const size_rules::TickSizeRulesCPtr& ticker_size_rules,
         const size_rules::LotSizeRulesCPtr& lot_size_rules,
-        const ticker_rules::TickerRulesCPtr& ticker_rules
+        const ticker_rules::TickerRulesCPtr& ticker_rules,
+        const book_rules::BookRulesCPtr& book_rules = book_rules::BookRulesCPtr(),
+        const utils::PoolOptions& pool_options = utils::PoolOptions(),
+        // symbols this engine matches, by symbol id - every listed symbol if empty
+        const std::vector<bool>& owned_symbols = std::vector<bool>()
     );
 
-    std::vector<trade_event::EventBaseCPtr> process_order(const std::string& s);
-    std::vector<trade_event::EventBaseCPtr> process_order(order::OrderBasePtr& o);
+    // the events of the request, valid until the next call
+    const trade_event::EventArena& process_order(std::string_view s);
+    const trade_event::EventArena& process_order(const Request& r);
+    // NEW and MODIFY requests already passed a RequestValidator over the same rules, with their
+    // symbol_id resolved
+    const trade_event::EventArena& process_validated_order(const Request& r);
+    // The events of a burst of requests, the same as processing them one at a time. With conflate,
+    // the depth updates of the burst collapse into one per symbol carrying the total of every touched
+    // price level after the burst, after the trades - see EventArena::conflate_depth_updates.
+    const trade_event::EventArena& process_orders(std::span<const Request> requests, bool conflate = false);
 
-    std::vector<trade_event::EventBaseCPtr> prev_open_setup(const std::string& close_order_cache_file);
+    // Orders of symbols the engine does not match are skipped. Binary snapshots are restored in bulk,
+    // one thread per book up to the number of cores; json lines caches order by order.
+    const trade_event::EventArena& prev_open_setup(const std::string& close_order_cache_file);
+    // writes a binary snapshot
     void eod_cleanup(const std::string& close_order_cache_file);
+    // adds the sections of its books, for one snapshot over several engines
+    void eod_cleanup(order::BookSnapshotWriter& snapshot);
+    // adds the sections of every order resting now, day orders included, and leaves the books as they are
+    void checkpoint(order::BookSnapshotWriter& snapshot) const;
+
+    // Moves every book into the region, before any order. With resume, the books left there are taken
+    // over and the order index is rebuilt from them, otherwise the region is emptied. From then on the
+    // region follows the open, the close and every matched request.
+    void attach_region(BookRegion& region, bool resume);
+
+    bool owns_symbol(int symbol_id) const;
+    // order record pool of a book, for sizing pools per symbol
+    utils::PoolStats pool_stats(int symbol_id, order::order_side side) const;
+    const order::OrderIndex& order_index() const { return order_index_; }
 
 private:
     void initialise(const std::vector<order::OrderBaseCPtr>& orders);
+    void restore(const order::BookSnapshot& snapshot);
+    void load_json_orders(const std::string& close_order_cache_file);
+    const trade_event::EventArena& process_order(const Request& r, bool validated);
+    // appends the events of the request - a failed request appends none
+    void append_order(const Request& r, bool validated);
+    // warms the book the request is going to match against
+    void prefetch_book(const Request& r);
 
-    bool validate_order(const json& j) const;
+    bool validate_order(const Request& r, int symbol_id) const;
     bool validate_order(const std::string& o) const;
     bool validate_order(const order::OrderBasePtr& o) const;
 
-    std::vector<trade_event::EventBaseCPtr> cancel_order(int order_id);
-    std::vector<trade_event::EventBaseCPtr> insert_order(order::LimitOrderPtr& o);
-    std::vector<trade_event::EventBaseCPtr> match_order(order::OrderBasePtr& o);
-    std::vector<trade_event::EventBaseCPtr> replenish_order(int order_id, int quantity);
+    void create_order_books(const std::vector<bool>& owned_symbols);
+    order::OrderBookPtr create_order_book(int symbol_id, order::order_side side) const;
+
+    // interned id of the request symbol, invalid_symbol_id if it is not listed or not owned
+    int resolve_symbol_id(const Request& r) const;
 
-    void eod_cleanup(const std::string& file_name, bool is_hidden);
-    std::vector<trade_event::EventBaseCPtr> prev_open_setup(
-        const std::string& file_name, bool is_hidden);
+    // append their events to events_ - validated requests skip the rules check
+    void new_order(const Request& r, int symbol_id, bool validated = false);
+    void modify_order(const Request& r, int symbol_id, bool validated = false);
+    void cancel_order(int order_id);
+    void insert_order(order::LimitOrderPtr& o);
+    void match_order(order::OrderBasePtr& o);
+    void replenish_order(int order_id, int quantity, int time);
 
-    std::unordered_map<std::string, order::OrderBookPtr> order_books_;
+    // bid and ask book of every listed symbol, indexed by 2 * symbol id + side - null for symbols
+    // the engine does not match
+    std::vector<order::OrderBookPtr> order_books_;
+    // book of every resting order, so cancel and replenish go straight to it
+    order::OrderIndex order_index_;
     // pointers to size rules
     size_rules::TickSizeRulesCPtr ticker_size_rules_;
     size_rules::LotSizeRulesCPtr lot_size_rules_;
     ticker_rules::TickerRulesCPtr ticker_rules_;
+    // order book implementation per symbol - heap book if not specified
+    book_rules::BookRulesCPtr book_rules_;
+    // slab sizing of the books with order node pools
+    utils::PoolOptions pool_options_;
+    RequestValidator validator_;
+    // events of the current request, reused so steady state processing does not allocate
+    trade_event::EventArena events_;
+    // null unless the books live in a region
+    BookRegion* region_ = nullptr;
 };
 
 } // namespace exchange
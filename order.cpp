@@ -12,7 +12,7 @@ int OrderBase::reduce_quantity(int filled_quantity)
 bool OrderBase::operator==(const OrderBase& a) const
 {
     return (time_ == a.time_ && order_id_ == a.order_id_ && 
-        quantity_ == a.quantity_ && symbol_ == a.symbol_ && 
+        quantity_ == a.quantity_ && symbol_id_ == a.symbol_id_ && 
         side_ == a.side_ && tif_ == a.tif_);
 }
 
@@ -23,7 +23,7 @@ bool LimitOrder::operator==(const LimitOrder& a) const
 
 bool operator<(const LimitOrder& a, const LimitOrder& b)
 {
-    if (a.symbol() != b.symbol())
+    if (a.symbol_id() != b.symbol_id())
     {
         throw std::runtime_error("Comparison operator only supports limit orders on the same underlier.");
     }
@@ -51,11 +51,11 @@ MarketOrder::MarketOrder(
     int order_id,
     double quantity,
     order::time_in_force tif,
-    const std::string& symbol,
+    int symbol_id,
     order::order_side side
 )
 :
-OrderBase(time, order_id, quantity, symbol, side, tif)
+OrderBase(time, order_id, quantity, symbol_id, side, tif)
 {
     initialise();
 }
@@ -86,13 +86,13 @@ IcebergOrder::IcebergOrder(
     int order_id,
     order::time_in_force tif,
     const utils::Price4& limit_price, 
-    const std::string& symbol,
+    int symbol_id,
     order::order_side side,
     double display_quantity,
     double hidden_quantity
 )
 :
-LimitOrder(time, order_id, display_quantity, tif, limit_price, symbol, side),
+LimitOrder(time, order_id, display_quantity, tif, limit_price, symbol_id, side),
 hidden_quantity_(hidden_quantity)
 {
     initialise();
@@ -105,7 +105,7 @@ IcebergOrder::IcebergOrder(
 :
 LimitOrder(
     hidden_o->time(), hidden_o->order_id(), display_o ? display_o->quantity() : 0, hidden_o->tif(), 
-    hidden_o->limit_price(), hidden_o->symbol(), hidden_o->side()
+    hidden_o->limit_price(), hidden_o->symbol_id(), hidden_o->side()
     ),
 hidden_quantity_(hidden_o->quantity())
 {
@@ -120,10 +120,10 @@ bool IcebergOrder::operator==(const IcebergOrder& a) const
 std::vector<LimitOrderPtr> IcebergOrder::split_order() const
 {
     LimitOrderPtr displayed_o = quantity() > 0 ? std::make_shared<LimitOrder>(
-        time(), order_id(), quantity(), tif(), limit_price(), symbol(), side()
+        time(), order_id(), quantity(), tif(), limit_price(), symbol_id(), side()
         ) : LimitOrderPtr();
     LimitOrderPtr hidden_o = std::make_shared<LimitOrder>(
-        time(), order_id(), hidden_quantity_, tif(), limit_price(), symbol(), side());
+        time(), order_id(), hidden_quantity_, tif(), limit_price(), symbol_id(), side());
 
     return std::vector<LimitOrderPtr>{displayed_o, hidden_o};
 }
@@ -150,22 +150,27 @@ int IcebergOrder::reduce_quantity(int filled_quantity)
     return quantity();
 }
 
-OrderBasePtr OrderFactory::create(const json& j)
+OrderBasePtr OrderFactory::create(const json& j, int symbol_id)
 {
+    OrderBasePtr o;
     if (j.contains("limit_price"))
     {
         // limit order or iceberg order
         if (j.contains("hidden_quantity"))
         {
-            return std::make_shared<IcebergOrder>(j.get<IcebergOrder>());
+            o = std::make_shared<IcebergOrder>(j.get<IcebergOrder>());
         }
         else
         {
-            return std::make_shared<LimitOrder>(j.get<LimitOrder>());
+            o = std::make_shared<LimitOrder>(j.get<LimitOrder>());
         }
     }
-    
-    return std::make_shared<MarketOrder>(j.get<MarketOrder>());
+    else
+    {
+        o = std::make_shared<MarketOrder>(j.get<MarketOrder>());
+    }
+    o->set_symbol_id(symbol_id);
+    return o;
 }
 
 } // namespace order
\ No newline at end of file
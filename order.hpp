@@ -92,7 +92,7 @@ public:
         int time, 
         int order_id, 
         int quantity,
-        const std::string& symbol,
+        int symbol_id,
         order::order_side side,
         order::time_in_force tif
     ) 
@@ -100,7 +100,7 @@ public:
     time_(time), 
     order_id_(order_id),
     quantity_(quantity),
-    symbol_(symbol),
+    symbol_id_(symbol_id),
     side_(side),
     tif_(tif)
     {}
@@ -114,11 +114,12 @@ public:
     virtual json to_json() const { return json(*this); }
 
     void set_quantity(int quantity) { quantity_ = quantity; }
+    // symbol is interned by ticker_rules::TickerRules, it is not part of the serialised order
+    void set_symbol_id(int symbol_id) { symbol_id_ = symbol_id; }
     int time() const { return time_; }
     int order_id() const { return order_id_; }
     int quantity() const { return quantity_; }
-    //stock::stock_symbol symbol() const { return symbol_; }
-    std::string symbol() const { return symbol_; }
+    int symbol_id() const { return symbol_id_; }
     order::order_side side() const { return side_; }
     order::time_in_force tif() const { return tif_; }
 
@@ -134,7 +135,7 @@ private:
     int time_;
     int order_id_;
     double quantity_;
-    std::string symbol_;
+    int symbol_id_;
     order::order_side side_;
     order::time_in_force tif_;
 };
@@ -149,11 +150,11 @@ public:
         double quantity,
         order::time_in_force tif,
         const utils::Price4& limit_price,
-        const std::string& symbol,
+        int symbol_id,
         order::order_side side
     ) 
     : 
-    OrderBase(time, order_id, quantity, symbol, side, tif),
+    OrderBase(time, order_id, quantity, symbol_id, side, tif),
     limit_price_(limit_price)
     {};
 
@@ -187,7 +188,7 @@ public:
         int order_id,
         double quantity,
         order::time_in_force tif,
-        const std::string& symbol,
+        int symbol_id,
         order::order_side side
     );
 
@@ -217,7 +218,7 @@ public:
         int order_id,
         order::time_in_force tif,
         const utils::Price4& limit_price, 
-        const std::string& symbol,
+        int symbol_id,
         order::order_side side,
         double display_quantity,
         double hidden_quantity
@@ -257,7 +258,8 @@ private:
 class OrderFactory
 {
 public:
-    static OrderBasePtr create(const json& j);
+    // symbol_id of the interned "symbol" field
+    static OrderBasePtr create(const json& j, int symbol_id);
 };
 
 // function for serialisation
@@ -265,7 +267,7 @@ template <typename BasicJsonType>
 void to_json(BasicJsonType& j, const OrderBase& o)
 {
     j = BasicJsonType{{"time", o.time_}, {"order_id", o.order_id_}, {"quantity", o.quantity_}, 
-        {"symbol", o.symbol_}, {"side", o.side_}, {"tif", o.tif_}};
+        {"side", o.side_}, {"tif", o.tif_}};
 }
 
 template <typename BasicJsonType>
@@ -274,7 +276,6 @@ void from_json(const BasicJsonType& j, OrderBase& o)
     j.at("time").get_to(o.time_);
     j.at("order_id").get_to(o.order_id_);
     j.at("quantity").get_to(o.quantity_);
-    j.at("symbol").get_to(o.symbol_);
     j.at("side").get_to(o.side_);
     j.at("tif").get_to(o.tif_);
 }
@@ -1,16 +1,25 @@
 #ifndef ORDER_BOOK_
 #define ORDER_BOOK_
 
+#include <algorithm>
+#include <cstddef>
+#include <functional>
 #include <memory>
 #include <queue>
+#include <span>
+#include <stdexcept>
 #include <unordered_map>
-#include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include "book_snapshot.hpp"
 #include "event.hpp"
+#include "event_arena.hpp"
 #include "order.hpp"
+#include "order_index.hpp"
+#include "order_record.hpp"
 #include "price4.hpp"
-#include "utils.hpp"
+#include "slab_pool.hpp"
 
 namespace order
 {
@@ -21,26 +30,104 @@ class OrderBookBase;
 typedef std::unique_ptr<OrderBookBase> OrderBookPtr;
 typedef std::unique_ptr<const OrderBookBase> OrderBookCPtr;
 
+enum order_book_type
+{
+    heap,
+    price_level,
+    tick_ladder
+};
+
+NLOHMANN_JSON_SERIALIZE_ENUM(
+    order_book_type,
+    {
+        {heap, "heap"},
+        {price_level, "price_level"},
+        {tick_ladder, "tick_ladder"}
+    }
+)
+
 class OrderBookBase
 {
 public:
-    virtual trade_event::EventBaseCPtr insert_order(const LimitOrderPtr& o) = 0;
-    virtual trade_event::EventBaseCPtr cancel_order(int order_id) = 0;
-    virtual std::vector<trade_event::EventBaseCPtr> match_order(const OrderBasePtr& o) = 0;
-    virtual trade_event::EventBaseCPtr replenish_order(
-        int order_id, int quantity, const std::string& symbol) = 0;
+    // events are appended to the arena - nothing is appended if the order is rejected
+    virtual void insert_order(const LimitOrderPtr& o, trade_event::EventArena& events) = 0;
+    virtual void cancel_order(int order_id, trade_event::EventArena& events) = 0;
+    virtual void match_order(const OrderBasePtr& o, trade_event::EventArena& events) = 0;
+    // the displayed part queues again at the request time, so replaying the requests rebuilds the same book
+    virtual void replenish_order(int order_id, int quantity, int time, trade_event::EventArena& events) = 0;
+
+    virtual ~OrderBookBase() {}
 
     virtual size_t number_of_valid_orders() const = 0;
-    virtual const std::unordered_set<int>& valid_ids() const = 0;
-    virtual std::vector<std::string> get_eod_orders() = 0;
-    virtual trade_event::EventBaseCPtr get_price_levels(const std::string& symbol) const = 0;
+    // displayed quantity resting at the price, 0 if none
+    virtual int displayed_quantity(const utils::Price4& price) const = 0;
+    // true while any part of the order (displayed or hidden) rests in the book
+    virtual bool contains(int order_id) const = 0;
+    // Visits every resting order once without changing the book: in the priority order of the displayed
+    // parts, then the iceberg orders with nothing displayed.
+    virtual void for_each_order(const std::function<void(const RestingOrder&)>& visit) const = 0;
+    // appends the good till cancel orders in priority order and empties the book
+    void get_eod_orders(std::vector<RestingOrder>& orders)
+    {
+        for_each_order([&orders](const RestingOrder& o)
+        {
+            if (o.tif == order::time_in_force::good_till_cancel) orders.push_back(o);
+        });
+        clear();
+    }
+    // Bulk load of orders as get_eod_orders appended them, with no order objects or events. The order
+    // index is left to the caller, so books of different symbols can be restored at the same time.
+    virtual void restore(std::span<const RestingOrder> orders) = 0;
+    virtual void get_price_levels(trade_event::EventArena& events) const = 0;
+    // books allocating orders from the general heap report empty stats
+    virtual utils::PoolStats pool_stats() const { return utils::PoolStats(); }
+    // hint ahead of a request that is about to use the book: the order a match would start from
+    virtual void prefetch_best() {}
+    // Keeps the order records in memory owned by the caller, e.g. a book region that outlives the
+    // process - only while the book is empty. With adopt, the orders a book over the same memory left
+    // there are taken over and the book rebuilt around them; the order index is left to the caller.
+    virtual void use_record_memory(std::byte*, size_t, utils::PoolCursor*, bool)
+    {
+        throw std::runtime_error("The order book cannot keep its orders in a book region.");
+    }
+
+    // keep a shared order index in step with the orders resting in this book
+    void attach_order_index(OrderIndex* order_index, std::uint32_t book_id)
+    {
+        order_index_ = order_index;
+        book_id_ = book_id;
+    }
+
+protected:
+    // drops every order without events - the order index is left to the caller
+    virtual void clear() = 0;
+    // call whenever an order enters or leaves the book
+    void update_order_index(int order_id)
+    {
+        if (!order_index_) return;
+        if (contains(order_id))
+        {
+            order_index_->insert(order_id, OrderLocation{book_id_});
+        }
+        else
+        {
+            order_index_->erase(order_id);
+        }
+    }
+
+private:
+    OrderIndex* order_index_ = nullptr;
+    std::uint32_t book_id_ = OrderLocation::no_book;
 };
 
-struct OrderInfo
+// entry of the displayed or hidden queue - carries its sort keys so sifting never touches the record
+struct OrderQueueEntry
 {
     utils::Price4 price;
-    int quantity;
-    time_in_force tif;
+    int time;
+    // sequence of the record when the entry was pushed
+    std::uint32_t sequence;
+    OrderRecordHandle handle;
 };
 
 template <typename Comparer>
@@ -50,99 +137,125 @@ public:
     OrderBook() = default;
     OrderBook(
         order_side side, 
-        const std::vector<LimitOrderPtr>& orders
+        int symbol_id,
+        const std::vector<LimitOrderPtr>& orders,
+        const utils::PoolOptions& pool_options = utils::PoolOptions()
     );
+    OrderBook(const OrderBook&) = delete;
+    OrderBook& operator=(const OrderBook&) = delete;
 
-    trade_event::EventBaseCPtr insert_order(const LimitOrderPtr& o) override;
-    trade_event::EventBaseCPtr cancel_order(int order_id) override;
+    void insert_order(const LimitOrderPtr& o, trade_event::EventArena& events) override;
+    void cancel_order(int order_id, trade_event::EventArena& events) override;
     // one may match LimitOrder, MarketOrder etc. If limit order, there can be unfilled part left
-    std::vector<trade_event::EventBaseCPtr> match_order(const OrderBasePtr& o) override;
-    trade_event::EventBaseCPtr replenish_order(
-        int order_id, int quantity, const std::string& symbol) override;
+    void match_order(const OrderBasePtr& o, trade_event::EventArena& events) override;
+    void replenish_order(int order_id, int quantity, int time, trade_event::EventArena& events) override;
 
-    size_t number_of_valid_orders() const override { return valid_ids_.size(); }
-    const std::unordered_set<int>& valid_ids() const override { return valid_ids_; }
-    // not const function because all orders are poped out
-    std::vector<std::string> get_eod_orders() override;
-    trade_event::EventBaseCPtr get_price_levels(const std::string& symbol) const override;
+    size_t number_of_valid_orders() const override { return number_of_displayed_orders_; }
+    int displayed_quantity(const utils::Price4& price) const override
+    {
+        const auto found = price_levels_.find(price);
+        return found == price_levels_.end() ? 0 : found->second;
+    }
+    bool contains(int order_id) const override { return order_records_.count(order_id) > 0; }
+    void for_each_order(const std::function<void(const RestingOrder&)>& visit) const override;
+    void restore(std::span<const RestingOrder> orders) override;
+    void get_price_levels(trade_event::EventArena& events) const override;
+    utils::PoolStats pool_stats() const override { return record_pool_.stats(); }
+    void prefetch_best() override
+    {
+        if (!order_queue_.empty()) __builtin_prefetch(&record_pool_[order_queue_.top().handle]);
+    }
 
 private:
+    typedef std::priority_queue<OrderQueueEntry, std::vector<OrderQueueEntry>, Comparer> OrderQueue;
+
     void insert_order(const LimitOrderPtr& o, int);
-    std::vector<trade_event::EventBaseCPtr> match_order(
-        const utils::Price4& limit_price, 
-        int& quantity
-    );
+    void clear() override;
+    void add_displayed(OrderRecordHandle handle, int quantity, int time);
+    void release_record(typename std::unordered_map<int, OrderRecordHandle>::iterator found);
+    // Entries are left in the queues when their part leaves the book and skipped once they surface.
+    // Freed records keep their sequence, and the part flag is cleared before a record is freed.
+    bool is_live(const OrderQueueEntry& entry, order_part part) const
+    {
+        const OrderRecord& record = record_pool_[entry.handle];
+        return record.sequence == entry.sequence && record.has_part(part);
+    }
     void match_at_given_price(
         const utils::Price4& price_level,
         int& quantity,
-        std::priority_queue<LimitOrderPtr, std::vector<LimitOrderPtr>, Comparer>& order_queue,
-        std::unordered_set<int>& valid_ids,
-        std::unordered_map<int, OrderInfo>& order_info,
-        bool public_queue,
-        std::vector<trade_event::EventBaseCPtr>& trade_events,
-        std::vector<trade_event::OrderUpdateInfoCPtr>& updates
+        OrderQueue& order_queue,
+        order_part part,
+        trade_event::EventArena& events
     );
 
     void initialise(const std::vector<LimitOrderPtr>& orders);
-    bool order_crossed(
-        const OrderBaseCPtr& o, 
-        const std::priority_queue<LimitOrderPtr, std::vector<LimitOrderPtr>, Comparer>& order_queue
-    ) const;
+    bool order_crossed(const OrderBaseCPtr& o, const OrderQueue& order_queue) const;
     utils::Price4 get_best_price() const;
     void quantity_of_best_price(
         const utils::Price4& trade_price,
         trade_event::trade_action action,
-        std::vector<trade_event::OrderUpdateInfoCPtr>& updates
+        trade_event::EventArena& events
     );
-    trade_event::DepthUpdateEventPtr enssemble_depth_update_events(
-        const std::vector<trade_event::OrderUpdateInfoCPtr>& updates);
 
     order_side side_;
-    std::priority_queue<LimitOrderPtr, std::vector<LimitOrderPtr>, Comparer> order_queue_;
-    std::priority_queue<LimitOrderPtr, std::vector<LimitOrderPtr>, Comparer> hidden_queue_;
-    std::unordered_set<int> valid_ids_;
-    std::unordered_set<int> hidden_valid_ids_;
+    int symbol_id_;
+    OrderRecordPool record_pool_;
+    // every order with a displayed or hidden part in the book
+    std::unordered_map<int, OrderRecordHandle> order_records_;
+    OrderQueue order_queue_;
+    OrderQueue hidden_queue_;
     std::unordered_map<const utils::Price4, int> price_levels_;
-    std::unordered_map<int, OrderInfo> order_info_;
-    //only used replenish iceberg order
-    std::unordered_map<int, OrderInfo> hidden_order_info_;
+    size_t number_of_displayed_orders_ = 0;
+    std::uint32_t next_sequence_ = 0;
 };
 
+template <typename Comparer>
+void OrderBook<Comparer>::add_displayed(OrderRecordHandle handle, int quantity, int time)
+{
+    OrderRecord& record = record_pool_[handle];
+    record.quantity[displayed_part] = quantity;
+    record.displayed_time = time;
+    record.add_part(displayed_part);
+    order_queue_.push(OrderQueueEntry{record.price, time, record.sequence, handle});
+    price_levels_[record.price] += quantity;
+    ++number_of_displayed_orders_;
+}
+
+template <typename Comparer>
+void OrderBook<Comparer>::release_record(typename std::unordered_map<int, OrderRecordHandle>::iterator found)
+{
+    const int order_id = found->first;
+    record_pool_[found->second].parts = 0;
+    record_pool_.free(found->second);
+    order_records_.erase(found);
+    update_order_index(order_id);
+}
+
 template <typename Comparer>
 void OrderBook<Comparer>::insert_order(const LimitOrderPtr& o, int)
 {
     const int order_id = o->order_id();
-    const auto& limit_price = o->limit_price();
-    const int quantity = o->quantity();
-    const time_in_force tif = o->tif();
+    const bool is_limit = o->order_type() == order::order_type::limit;
+    const IcebergOrderPtr iceberg_o = is_limit ? IcebergOrderPtr() : std::dynamic_pointer_cast<IcebergOrder>(o);
+    if (!is_limit && !iceberg_o)
+    {
+        return;
+    }
 
-    if (o->order_type() == order::order_type::limit)
+    const OrderRecordHandle handle = create_record(record_pool_, *o, next_sequence_++);
+    if (is_limit || o->quantity() > 0)
     {
-        order_queue_.push(o);
-        valid_ids_.insert(order_id);
-        price_levels_[limit_price] += quantity;
+        add_displayed(handle, o->quantity(), o->time());
     }
-    else
+    if (iceberg_o)
     {
-        IcebergOrderPtr iceberg_o = std::dynamic_pointer_cast<IcebergOrder>(o);
-        if (iceberg_o)
-        {
-            const auto splitted_orders = iceberg_o->split_order();
-            const auto& displayed_o = splitted_orders[0];
-
-            if (quantity > 0)
-            {
-                order_queue_.push(displayed_o);
-                valid_ids_.insert(order_id);
-                price_levels_[limit_price] += quantity;
-            }
-
-            hidden_queue_.push(splitted_orders[1]);
-            hidden_valid_ids_.insert(order_id);
-            hidden_order_info_[order_id] = OrderInfo{limit_price, iceberg_o->hidden_quantity(), tif};
-        }
+        OrderRecord& record = record_pool_[handle];
+        record.quantity[hidden_part] = iceberg_o->hidden_quantity();
+        record.add_part(hidden_part);
+        hidden_queue_.push(OrderQueueEntry{record.price, record.time, record.sequence, handle});
     }
-    order_info_[order_id] = OrderInfo{limit_price, quantity, tif};
+    order_records_[order_id] = handle;
+    update_order_index(order_id);
 }
 
 template <typename Comparer>
@@ -154,7 +267,11 @@ void OrderBook<Comparer>::initialise(const std::vector<LimitOrderPtr>& orders)
         {
             throw std::runtime_error("Cannot create order book with order's side different from specified.");
         }
-        if (valid_ids_.count(o->order_id()))
+        if (o->symbol_id() != symbol_id_)
+        {
+            throw std::runtime_error("Cannot create order book with order's symbol different from specified.");
+        }
+        if (contains(o->order_id()))
         {
             throw std::runtime_error("Order id already exists in order book.");
         }
@@ -166,10 +283,14 @@ void OrderBook<Comparer>::initialise(const std::vector<LimitOrderPtr>& orders)
 template <typename Comparer>
 OrderBook<Comparer>::OrderBook(
     order_side side, 
-    const std::vector<LimitOrderPtr>& orders
+    int symbol_id,
+    const std::vector<LimitOrderPtr>& orders,
+    const utils::PoolOptions& pool_options
 )
 :
-side_(side)
+side_(side),
+symbol_id_(symbol_id),
+record_pool_(pool_options)
 {
     initialise(orders);
 }
@@ -178,119 +299,115 @@ template <typename Comparer>
 void OrderBook<Comparer>::quantity_of_best_price(
     const utils::Price4& trade_price,
     trade_event::trade_action action,
-    std::vector<trade_event::OrderUpdateInfoCPtr>& updates
+    trade_event::EventArena& events
 )
 {
     const int open_order_quantity = price_levels_[trade_price];
-    updates.emplace_back(
-        std::make_shared<trade_event::OrderUpdateInfo>(trade_price, open_order_quantity, action)
-    );
-}
-
-template <typename Comparer>
-trade_event::DepthUpdateEventPtr OrderBook<Comparer>::enssemble_depth_update_events(
-    const std::vector<trade_event::OrderUpdateInfoCPtr>& updates
-)
-{
-    if (side_ == order_side::bid)
-    {
-        return std::make_shared<trade_event::DepthUpdateEvent>(updates, std::vector<trade_event::OrderUpdateInfoCPtr>());
-    }
-    return std::make_shared<trade_event::DepthUpdateEvent>(std::vector<trade_event::OrderUpdateInfoCPtr>(), updates);
+    events.stage_level(side_, trade_price, open_order_quantity, action);
 }
 
 template <typename Comparer>
-trade_event::EventBaseCPtr OrderBook<Comparer>::insert_order(const LimitOrderPtr& o)
+void OrderBook<Comparer>::insert_order(const LimitOrderPtr& o, trade_event::EventArena& events)
 {
     if (o->side() != side_)
     {
         throw std::runtime_error("Cannot insert order with mismatch side.");
     }
+    if (o->symbol_id() != symbol_id_)
+    {
+        throw std::runtime_error("Cannot insert order with mismatch symbol.");
+    }
 
-    if (valid_ids_.count(o->order_id()))
+    if (contains(o->order_id()))
     {
-        return nullptr;
+        return;
     }
     insert_order(o, 1);
 
-    std::vector<trade_event::OrderUpdateInfoCPtr> updates;
     if (o->quantity() > 0)
     {
-        updates.emplace_back(
-            std::make_unique<trade_event::OrderUpdateInfo>(
-                o->limit_price(), o->quantity(), trade_event::trade_action::add_add)
-        );
+        events.stage_level(side_, o->limit_price(), o->quantity(), trade_event::trade_action::add_add);
     } 
 
-    return enssemble_depth_update_events(updates);
+    events.add_depth_update(symbol_id_);
 }
 
 template <typename Comparer>
-trade_event::EventBaseCPtr OrderBook<Comparer>::cancel_order(int order_id)
+void OrderBook<Comparer>::cancel_order(int order_id, trade_event::EventArena& events)
 {
-    if (hidden_valid_ids_.count(order_id))
+    const auto found = order_records_.find(order_id);
+    if (found == order_records_.end())
     {
-        hidden_valid_ids_.erase(order_id);
+        update_order_index(order_id);
+        return;
     }
-    
-    if (!valid_ids_.count(order_id))
+
+    OrderRecord& record = record_pool_[found->second];
+    record.remove_part(hidden_part);
+    if (!record.has_displayed())
     {
-        return nullptr;
+        release_record(found);
+        return;
     }
-    valid_ids_.erase(order_id);
+    record.remove_part(displayed_part);
+    --number_of_displayed_orders_;
+
+    const utils::Price4 trade_price = record.price;
+    const int quantity = record.quantity[displayed_part];
+    release_record(found);
 
-    const utils::Price4 trade_price = order_info_[order_id].price;
-    const int quantity = order_info_[order_id].quantity;
     if (!price_levels_.count(trade_price))
     {
         throw std::runtime_error("Inconsistent price levels information.");
     }
     price_levels_[trade_price] -= quantity;
 
-    std::vector<trade_event::OrderUpdateInfoCPtr> updates;
     if (trade_price.unscaled() > 0)
     {
-        quantity_of_best_price(trade_price, trade_event::trade_action::add_add, updates);
+        quantity_of_best_price(trade_price, trade_event::trade_action::add_add, events);
     }
 
-    return enssemble_depth_update_events(updates);
+    events.add_depth_update(symbol_id_);
 }
 
 template <typename Comparer>
-trade_event::EventBaseCPtr OrderBook<Comparer>::replenish_order(
-    int order_id, int quantity, const std::string& symbol
-)
+void OrderBook<Comparer>::replenish_order(int order_id, int quantity, int time, trade_event::EventArena& events)
 {
-    if (valid_ids_.count(order_id) && order_info_[order_id].quantity > 0)
+    const auto found = order_records_.find(order_id);
+    if (found == order_records_.end())
     {
-        // replenish only works after displayed part full filled
-        return nullptr;
+        return;
     }
-    if (!hidden_valid_ids_.count(order_id) || hidden_order_info_[order_id].quantity == 0)
+    OrderRecord& record = record_pool_[found->second];
+    // replenish only works after displayed part full filled - an order still displaying an empty part
+    // is not inserted again either
+    if (record.has_displayed())
     {
-        return nullptr;
+        return;
     }
-    const int exposed_quantity = std::min(quantity, hidden_order_info_[order_id].quantity);
-    hidden_order_info_[order_id].quantity -= exposed_quantity;
-    
-    const OrderInfo& info = hidden_order_info_[order_id];
-    LimitOrderPtr o = std::make_shared<LimitOrder>(
-        utils::get_epoch_time(), 
-        order_id, 
-        quantity,
-        info.tif,
-        info.price,
-        symbol,
-        side_
-    );
-    return insert_order(o);
+    if (!record.has_hidden() || record.quantity[hidden_part] == 0)
+    {
+        return;
+    }
+    const int exposed_quantity = std::min(quantity, record.quantity[hidden_part]);
+    record.quantity[hidden_part] -= exposed_quantity;
+    add_displayed(found->second, exposed_quantity, time);
+    // its entry in the hidden queue is dropped when reached
+    if (record.quantity[hidden_part] == 0)
+    {
+        record.remove_part(hidden_part);
+    }
+
+    if (exposed_quantity > 0)
+    {
+        events.stage_level(side_, record.price, exposed_quantity, trade_event::trade_action::add_add);
+    }
+
+    events.add_depth_update(symbol_id_);
 }
 
 template <typename Comparer>
-bool OrderBook<Comparer>::order_crossed(
-    const OrderBaseCPtr& o,
-    const std::priority_queue<LimitOrderPtr, std::vector<LimitOrderPtr>, Comparer>& order_queue
-) const
+bool OrderBook<Comparer>::order_crossed(const OrderBaseCPtr& o, const OrderQueue& order_queue) const
 {
     if (o->side() == side_ || order_queue.empty()) return false;
     if (o->order_type() == order::order_type::market) return true;
@@ -302,7 +419,7 @@ bool OrderBook<Comparer>::order_crossed(
     }
 
     const auto& o_price = limited_o->limit_price();
-    const auto& best_price_in_book = order_queue.top()->limit_price();
+    const auto& best_price_in_book = order_queue.top().price;
     const bool crossed = o->side() == order_side::bid ? best_price_in_book <= o_price : 
         best_price_in_book >= o_price;
 
@@ -318,55 +435,50 @@ utils::Price4 OrderBook<Comparer>::get_best_price() const
     }
     if (order_queue_.empty())
     {
-        return hidden_queue_.top()->limit_price();
+        return hidden_queue_.top().price;
     }
     if (hidden_queue_.empty())
     {
-        return order_queue_.top()->limit_price();
+        return order_queue_.top().price;
     }
-    return std::min(order_queue_.top()->limit_price(), hidden_queue_.top()->limit_price());
+    return std::min(order_queue_.top().price, hidden_queue_.top().price);
 }
 
 template <typename Comparer>
 void OrderBook<Comparer>::match_at_given_price(
     const utils::Price4& price_level,
     int& quantity,
-    std::priority_queue<LimitOrderPtr, std::vector<LimitOrderPtr>, Comparer>& order_queue,
-    std::unordered_set<int>& valid_ids,
-    std::unordered_map<int, OrderInfo>& order_info,
-    bool public_queue,
-    std::vector<trade_event::EventBaseCPtr>& trade_events,
-    std::vector<trade_event::OrderUpdateInfoCPtr>& updates
+    OrderQueue& order_queue,
+    order_part part,
+    trade_event::EventArena& events
 )
 {
     // see if the logic can be simplified
-    if (order_queue.empty() || quantity == 0 || price_level != order_queue.top()->limit_price())
+    if (order_queue.empty() || quantity == 0 || price_level != order_queue.top().price)
     {
         return;
     }
     
+    const bool public_queue = part == displayed_part;
     utils::Price4 prev_trade_price(0);
     while (quantity > 0 && !order_queue.empty())
     {
-        const auto& target_o = order_queue.top();
-        const int target_o_id = target_o->order_id();
+        const OrderQueueEntry target = order_queue.top();
         // if order not valid, skip it
-        if (!valid_ids.count(target_o_id))
+        if (!is_live(target, part))
         {
             order_queue.pop();
             continue;
         }
         // if the current price level is exhausted, stop iteration
-        if (target_o->limit_price() != price_level) break;
+        if (target.price != price_level) break;
 
-        const int target_o_qty = order_info[target_o_id].quantity;
-        const int full_filled_quantity = std::min(target_o_qty, quantity);
+        OrderRecord& target_o = record_pool_[target.handle];
+        const int full_filled_quantity = std::min(target_o.quantity[part], quantity);
         quantity -= full_filled_quantity;
-        order_info[target_o_id].quantity -= full_filled_quantity;
-        // quantity on order level is redundant
-        target_o->set_quantity(order_info[target_o_id].quantity);
+        target_o.quantity[part] -= full_filled_quantity;
 
-        const utils::Price4 trade_price = target_o->limit_price();
+        const utils::Price4 trade_price = target.price;
         
         if (public_queue)
         {
@@ -377,48 +489,49 @@ void OrderBook<Comparer>::match_at_given_price(
             }
         }
         
-        trade_events.emplace_back(
-            std::make_shared<trade_event::TradeEvent>(trade_price, full_filled_quantity)
-        );
+        events.add_trade(symbol_id_, trade_price, full_filled_quantity);
 
-        if (target_o->quantity() == 0)
+        if (target_o.quantity[part] == 0)
         {
             order_queue.pop();
-            valid_ids.erase(target_o_id);
-            order_info.erase(target_o_id);
+            target_o.remove_part(part);
+            if (public_queue)
+            {
+                --number_of_displayed_orders_;
+            }
+            // iceberg orders stay until both parts are gone
+            if (!target_o.has_parts())
+            {
+                release_record(order_records_.find(target_o.order_id));
+            }
 
             if (public_queue)
             {
                 // need to remove redundent updates (i.e. same limit price)
-                if (updates.empty() || trade_price != prev_trade_price)
+                if (!events.has_staged_levels() || trade_price != prev_trade_price)
                 {
-                    updates.emplace_back(
-                        std::make_shared<trade_event::OrderUpdateInfo>(
-                            trade_price, 0, trade_event::trade_action::delete_delete)
-                    );
+                    events.stage_level(side_, trade_price, 0, trade_event::trade_action::delete_delete);
                 }
             }
         }
         else if (public_queue)
         {
-            quantity_of_best_price(trade_price, trade_event::trade_action::modify, updates);
+            quantity_of_best_price(trade_price, trade_event::trade_action::modify, events);
         }
         prev_trade_price = trade_price;
     }
 }
 
 template <typename Comparer>
-std::vector<trade_event::EventBaseCPtr> OrderBook<Comparer>::match_order(const OrderBasePtr& o)
+void OrderBook<Comparer>::match_order(const OrderBasePtr& o, trade_event::EventArena& events)
 {
     if (o->side() == side_)
     {
         throw std::runtime_error("Cannot match order with the same side.");
     }
 
-    std::vector<trade_event::EventBaseCPtr> trade_events;
-    std::vector<trade_event::OrderUpdateInfoCPtr> updates;
     bool order_cross = order_crossed(o, order_queue_) || order_crossed(o, hidden_queue_);
-    if (!order_cross) { return trade_events; }
+    if (!order_cross) { return; }
 
     utils::Price4 curr_price = get_best_price();
     // if o is iceberg order, so use total quantity
@@ -427,15 +540,10 @@ std::vector<trade_event::EventBaseCPtr> OrderBook<Comparer>::match_order(const O
     while (order_cross && quantity > 0)
     {
         // public queue
-        match_at_given_price(
-                curr_price, quantity, order_queue_, valid_ids_, order_info_, true, trade_events, updates
-            );
+        match_at_given_price(curr_price, quantity, order_queue_, displayed_part, events);
 
         // hidden queue
-        match_at_given_price(
-            curr_price, quantity, hidden_queue_, hidden_valid_ids_, hidden_order_info_, false, trade_events, 
-            updates
-        );
+        match_at_given_price(curr_price, quantity, hidden_queue_, hidden_part, events);
 
         curr_price = get_best_price();
         order_cross = order_crossed(o, order_queue_) || order_crossed(o, hidden_queue_);
@@ -456,59 +564,84 @@ std::vector<trade_event::EventBaseCPtr> OrderBook<Comparer>::match_order(const O
         o->set_quantity(quantity);
     }
 
-    trade_events.emplace_back(enssemble_depth_update_events(updates));
+    // level changes follow the trades
+    events.add_depth_update(symbol_id_);
     // note: unfilled limit order will be inserted to other order book - handle outside through matching engine
-    return trade_events;
 }
 
 template <typename Comparer>
-std::vector<std::string> OrderBook<Comparer>::get_eod_orders()
+void OrderBook<Comparer>::for_each_order(const std::function<void(const RestingOrder&)>& visit) const
 {
-    std::vector<std::string> orders; 
-    orders.reserve(valid_ids_.size());
+    // the queues are heaps - a copy is popped instead, which costs a copy of the entries but leaves the
+    // book as it is
+    const auto visit_record = [&visit](const OrderRecord& record)
+    {
+        visit(RestingOrder{record.price.unscaled(), record.order_id, record.time,
+            record.has_displayed() ? record.quantity[displayed_part] : 0,
+            record.has_hidden() ? record.quantity[hidden_part] : 0, record.displayed_time, record.sequence,
+            static_cast<std::uint8_t>(record.tif),
+            record.has_hidden() ? order::order_type::iceberg : order::order_type::limit, {}});
+    };
+    OrderQueue order_queue(order_queue_);
+    while (!order_queue.empty())
+    {
+        if (is_live(order_queue.top(), displayed_part)) visit_record(record_pool_[order_queue.top().handle]);
+        order_queue.pop();
+    }
 
-    std::unordered_map<int, LimitOrderPtr> cache;
-    while (!order_queue_.empty())
+    // iceberg orders with their displayed part filled
+    OrderQueue hidden_queue(hidden_queue_);
+    while (!hidden_queue.empty())
     {
-        const auto& curr_o = order_queue_.top();
-        const int order_id = curr_o->order_id();
-        if (curr_o->tif() == order::time_in_force::good_till_cancel && valid_ids_.count(order_id))
-        {
-            // cache in order to put iceberg order back
-            if (hidden_valid_ids_.count(order_id))
-            {
-                cache[order_id] = curr_o;
-            }
-            else
-            {
-                orders.emplace_back(json(curr_o).dump());
-            } 
-        }
-        order_queue_.pop();
+        const OrderRecord& record = record_pool_[hidden_queue.top().handle];
+        if (is_live(hidden_queue.top(), hidden_part) && !record.has_displayed()) visit_record(record);
+        hidden_queue.pop();
+    }
+}
+
+template <typename Comparer>
+void OrderBook<Comparer>::clear()
+{
+    order_queue_ = OrderQueue();
+    hidden_queue_ = OrderQueue();
+    order_records_.clear();
+    record_pool_.clear();
+    price_levels_.clear();
+    number_of_displayed_orders_ = 0;
+}
+
+template <typename Comparer>
+void OrderBook<Comparer>::restore(std::span<const RestingOrder> orders)
+{
+    order_records_.reserve(order_records_.size() + orders.size());
+    // records take sequences in the order their orders entered the book
+    std::vector<std::pair<std::uint32_t, const RestingOrder*>> by_sequence;
+    by_sequence.reserve(orders.size());
+    for (const auto& o : orders)
+    {
+        by_sequence.emplace_back(o.sequence, &o);
     }
-    valid_ids_.clear();
+    std::stable_sort(by_sequence.begin(), by_sequence.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
 
-    while (!hidden_queue_.empty())
+    for (const auto& [sequence, o] : by_sequence)
     {
-        const auto& curr_o = hidden_queue_.top();
-        const int order_id = curr_o->order_id();
-        if (curr_o->tif() == order::time_in_force::good_till_cancel && hidden_valid_ids_.count(order_id))
+        if (contains(o->order_id)) continue;
+
+        const OrderRecordHandle handle = create_record(record_pool_, *o, next_sequence_++);
+        if (!o->is_iceberg() || o->quantity > 0)
+        {
+            add_displayed(handle, o->quantity, o->displayed_time);
+        }
+        if (o->is_iceberg())
         {
-            const LimitOrderCPtr display_o = cache.count(order_id) ? cache[order_id] : LimitOrderCPtr();
-            auto iceberg_o = std::make_shared<order::IcebergOrder>(display_o, curr_o);
-            iceberg_o->set_hidden_quantity(hidden_order_info_[order_id].quantity);
-            orders.emplace_back(json(iceberg_o).dump());
+            OrderRecord& record = record_pool_[handle];
+            record.quantity[hidden_part] = o->hidden_quantity;
+            record.add_part(hidden_part);
+            hidden_queue_.push(OrderQueueEntry{record.price, record.time, record.sequence, handle});
         }
-        hidden_queue_.pop();
+        order_records_.emplace(o->order_id, handle);
     }
-    hidden_valid_ids_.clear();
-    hidden_order_info_.clear();
-
-    // also clear other cached information
-    price_levels_.clear();
-    order_info_.clear();
-
-    return orders;
 }
 
 namespace
@@ -531,9 +664,7 @@ struct PriceInfoGreaterThan
 } // anonymous namespace
 
 template <typename Comparer>
-trade_event::EventBaseCPtr OrderBook<Comparer>::get_price_levels(
-    const std::string& symbol
-) const
+void OrderBook<Comparer>::get_price_levels(trade_event::EventArena& events) const
 {
     std::vector<std::pair<utils::Price4, int>> info; 
     info.reserve(price_levels_.size());
@@ -549,25 +680,27 @@ trade_event::EventBaseCPtr OrderBook<Comparer>::get_price_levels(
     {
         std::sort(info.begin(), info.end(), PriceInfoLessThan());
     }
-    
-    return std::make_shared<trade_event::MarketSnapEvent>(side_, symbol, info);
+
+    for (const auto& level : info)
+    {
+        events.stage_level(side_, level.first, level.second, trade_event::trade_action::add_add);
+    }
+    events.add_market_snap(symbol_id_, side_);
 }
 
 struct Less
 {
-    bool operator()(const LimitOrderPtr& a, const LimitOrderPtr& b) const
+    bool operator()(const OrderQueueEntry& a, const OrderQueueEntry& b) const
     {
-        return (a->limit_price() < b->limit_price()) || (
-            a->limit_price() == b->limit_price() && a->time() > b->time());
+        return (a.price < b.price) || (a.price == b.price && a.time > b.time);
     }
 };
 
 struct Greater
 {
-    bool operator()(const LimitOrderPtr& a, const LimitOrderPtr& b) const
+    bool operator()(const OrderQueueEntry& a, const OrderQueueEntry& b) const
     {
-        return (a->limit_price() > b->limit_price()) || (
-            a->limit_price() == b->limit_price() && a->time() > b->time());
+        return (a.price > b.price) || (a.price == b.price && a.time > b.time);
     }
 };
 
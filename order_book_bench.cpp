@@ -0,0 +1,218 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "event_arena.hpp"
+#include "level_order_book.hpp"
+#include "order.hpp"
+#include "order_book.hpp"
+#include "price4.hpp"
+#include "size_rules.hpp"
+#include "slab_pool.hpp"
+#include "tick_ladder.hpp"
+
+// Compares order book implementations on a tightly clustered workload: prices within a few ticks of a
+// slowly drifting mid, most new orders cancelled before they trade, and a small share of aggressive orders.
+// Also reports the order record pools, to size them per symbol.
+// usage: order_book_bench [number_of_operations] [seed] [huge_pages 0|1]
+
+namespace
+{
+
+enum class op_type
+{
+    insert,
+    cancel,
+    match
+};
+
+struct Operation
+{
+    op_type type;
+    order::order_side side;
+    int order_id;
+    order::LimitOrderPtr o;
+};
+
+std::vector<Operation> create_workload(size_t number_of_operations, unsigned int seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::geometric_distribution<int> distance_from_touch(0.35);
+    std::uniform_int_distribution<int> lots(1, 10);
+
+    // resting orders per side the flow hovers around
+    const size_t target_depth = 2000;
+    const long tick = 100; // 0.01
+    long mid = 1000000; // 100.00
+    std::vector<Operation> operations;
+    operations.reserve(number_of_operations);
+    std::vector<std::pair<int, order::order_side>> live;
+    int next_id = 0;
+    int time = 0;
+
+    while (operations.size() < number_of_operations)
+    {
+        ++time;
+        if (uniform(gen) < 0.01)
+        {
+            mid += uniform(gen) < 0.5 ? -tick : tick;
+        }
+
+        const double r = uniform(gen);
+        const double cancel_share = live.size() > 2 * target_depth ? 0.55 : 0.45;
+        if (r < cancel_share && !live.empty())
+        {
+            // cancel a random resting order - most orders die this way
+            const size_t idx = static_cast<size_t>(uniform(gen) * live.size());
+            operations.push_back(Operation{op_type::cancel, live[idx].second, live[idx].first, nullptr});
+            live[idx] = live.back();
+            live.pop_back();
+            continue;
+        }
+
+        const order::order_side side = uniform(gen) < 0.5 ? order::order_side::bid : order::order_side::ask;
+        const bool aggressive = r > 0.95;
+        const long offset = aggressive ? -2 * tick : (distance_from_touch(gen) + 1) * tick;
+        const long price = side == order::order_side::bid ? mid - offset : mid + offset;
+        auto o = std::make_shared<order::LimitOrder>(
+            time, next_id, 100 * lots(gen), order::time_in_force::day, utils::Price4(price), 0, side);
+
+        operations.push_back(Operation{aggressive ? op_type::match : op_type::insert, side, next_id, o});
+        if (!aggressive) live.emplace_back(next_id, side);
+        ++next_id;
+    }
+    return operations;
+}
+
+struct BookPair
+{
+    std::string name;
+    order::OrderBookPtr bid;
+    order::OrderBookPtr ask;
+};
+
+void run_workload(BookPair& books, const std::vector<Operation>& operations)
+{
+    // fresh copies - matching mutates orders
+    std::vector<order::LimitOrderPtr> orders(operations.size());
+    for (size_t i = 0; i < operations.size(); ++i)
+    {
+        if (operations[i].o) orders[i] = std::make_shared<order::LimitOrder>(*operations[i].o);
+    }
+
+    size_t number_of_events = 0;
+    trade_event::EventArena events;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < operations.size(); ++i)
+    {
+        const Operation& op = operations[i];
+        auto& own_book = op.side == order::order_side::bid ? books.bid : books.ask;
+        auto& other_book = op.side == order::order_side::bid ? books.ask : books.bid;
+        // reset per operation, like the matching engine does per request
+        events.clear();
+        switch (op.type)
+        {
+        case op_type::cancel:
+            own_book->cancel_order(op.order_id, events);
+            break;
+
+        case op_type::match:
+        {
+            const order::OrderBasePtr o = orders[i];
+            other_book->match_order(o, events);
+            if (o->quantity() > 0) own_book->insert_order(orders[i], events);
+            break;
+        }
+
+        case op_type::insert:
+            own_book->insert_order(orders[i], events);
+            break;
+        }
+        number_of_events += events.number_of_events();
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    std::cout << std::left << std::setw(14) << books.name
+        << std::right << std::setw(12) << std::fixed << std::setprecision(1) << ns / operations.size()
+        << std::setw(14) << number_of_events
+        << std::setw(12) << books.bid->number_of_valid_orders() + books.ask->number_of_valid_orders()
+        << "\n";
+}
+
+void report_pools(const BookPair& books)
+{
+    for (const auto* book : {books.bid.get(), books.ask.get()})
+    {
+        const utils::PoolStats stats = book->pool_stats();
+        if (stats.slot_size == 0) continue;
+
+        // slot is the cost of a resting order, reserved / peak how well the slabs are sized
+        std::cout << std::left << std::setw(14) << books.name + (book == books.bid.get() ? " bid" : " ask")
+            << std::right << std::setw(8) << stats.slot_size
+            << std::setw(10) << stats.live
+            << std::setw(10) << stats.peak
+            << std::setw(8) << stats.slabs
+            << std::setw(8) << stats.huge_page_slabs
+            << std::setw(12) << stats.reserved_bytes / 1024
+            << std::setw(14) << std::setprecision(1)
+            << (stats.peak ? static_cast<double>(stats.reserved_bytes) / stats.peak : 0.0)
+            << std::setw(12) << stats.allocations
+            << "\n";
+    }
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    const size_t number_of_operations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const unsigned int seed = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 42;
+    utils::PoolOptions pool_options;
+    pool_options.huge_pages = argc > 3 && std::strtoul(argv[3], nullptr, 10) != 0;
+
+    const auto tick_size_rules = std::make_shared<const size_rules::TickSizeRules>(
+        std::vector<size_rules::SingleTickSizeRule>{
+            size_rules::SingleTickSizeRule(utils::Price4(0), utils::Price4(10000), utils::Price4(1)),
+            size_rules::SingleTickSizeRule(utils::Price4(10000), std::nullopt, utils::Price4(100))
+        }
+    );
+    const auto operations = create_workload(number_of_operations, seed);
+    const std::vector<order::LimitOrderPtr> no_orders;
+
+    std::vector<BookPair> books;
+    books.push_back(BookPair{"heap",
+        std::make_unique<order::BidOrderBook>(order::order_side::bid, 0, no_orders, pool_options),
+        std::make_unique<order::AskOrderBook>(order::order_side::ask, 0, no_orders, pool_options)});
+    books.push_back(BookPair{"price_level",
+        std::make_unique<order::BidLevelOrderBook>(order::order_side::bid, 0, no_orders, pool_options),
+        std::make_unique<order::AskLevelOrderBook>(order::order_side::ask, 0, no_orders, pool_options)});
+    books.push_back(BookPair{"tick_ladder",
+        std::make_unique<order::BidTickLadderOrderBook>(
+            order::order_side::bid, 0, order::BidTickLadder(tick_size_rules), no_orders, pool_options),
+        std::make_unique<order::AskTickLadderOrderBook>(
+            order::order_side::ask, 0, order::AskTickLadder(tick_size_rules), no_orders, pool_options)});
+
+    std::cout << number_of_operations << " operations, seed " << seed << "\n";
+    std::cout << std::left << std::setw(14) << "book" << std::right << std::setw(12) << "ns/op"
+        << std::setw(14) << "events" << std::setw(12) << "resting" << "\n";
+    for (auto& pair : books)
+    {
+        run_workload(pair, operations);
+    }
+
+    std::cout << "\norder record pools\n" << std::left << std::setw(14) << "book" << std::right
+        << std::setw(8) << "slot" << std::setw(10) << "live" << std::setw(10) << "peak"
+        << std::setw(8) << "slabs" << std::setw(8) << "huge" << std::setw(12) << "reserved KB"
+        << std::setw(14) << "reserved/peak" << std::setw(12) << "allocs" << "\n";
+    for (const auto& pair : books)
+    {
+        report_pools(pair);
+    }
+    return 0;
+}
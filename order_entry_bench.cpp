@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "book_rules.hpp"
+#include "matching_engine.hpp"
+#include "order_entry_queue.hpp"
+#include "request.hpp"
+#include "size_rules.hpp"
+#include "ticker_rules.hpp"
+
+// Fan in through the order entry queue: gateway processes, forked from this one, each send their
+// commands as fast as the queue takes them while the engine thread drains and matches them in batches.
+// Gateways retry a full queue, so overflows show how often the engine fell behind.
+// usage: order_entry_bench [gateways] [commands_per_gateway] [batch_size] [path]
+
+namespace
+{
+
+using json = nlohmann::json;
+
+const std::vector<std::string> symbols{"AAPL", "IBM", "MSFT", "TSLA", "GOOG"};
+
+struct Rules
+{
+    size_rules::TickSizeRulesCPtr tick_size;
+    size_rules::LotSizeRulesCPtr lot_size;
+    ticker_rules::TickerRulesCPtr tickers;
+    book_rules::BookRulesCPtr books;
+};
+
+Rules create_rules()
+{
+    const json j = json::parse(R"({
+        "lot_size": [{"from_price": "1", "lot_size": "100"}],
+        "tick_size": [{"from_price": "0", "to_price": "1", "tick_size": "0.0001"}, {"from_price": "1", "tick_size": "0.01"}],
+        "order_books": {"default": "price_level"}
+    })");
+    Rules rules;
+    rules.lot_size = j.at("lot_size").get<size_rules::LotSizeRulesCPtr>();
+    rules.tick_size = j.at("tick_size").get<size_rules::TickSizeRulesCPtr>();
+    rules.books = j.at("order_books").get<book_rules::BookRulesCPtr>();
+    rules.tickers = std::make_shared<const ticker_rules::TickerRules>(symbols);
+    return rules;
+}
+
+// resting orders a few ticks off the mid, each cancelled by the next command - order ids do not
+// overlap between gateways
+void run_gateway(const std::string& path, int gateway, size_t number_of_commands)
+{
+    exchange::OrderEntrySession session(path);
+    const long tick = 100; // 0.01
+    const long mid = 1000000; // 100.00
+    const int first_id = gateway * static_cast<int>(number_of_commands);
+    for (size_t i = 0; i < number_of_commands; ++i)
+    {
+        exchange::Request r;
+        r.time = 1625787615;
+        r.order_id = first_id + static_cast<int>(i / 2);
+        if (i % 2 == 0)
+        {
+            r.type = exchange::new_request;
+            r.symbol_id = static_cast<int>(i / 2 % symbols.size());
+            r.order_type = order::order_type::limit;
+            r.side = i / 2 % 4 < 2 ? order::order_side::bid : order::order_side::ask;
+            r.tif = order::time_in_force::day;
+            r.quantity = 100;
+            const long offset = static_cast<long>(1 + i / 2 % 5) * tick;
+            r.limit_price = utils::Price4(r.side == order::order_side::bid ? mid - offset : mid + offset);
+        }
+        else
+        {
+            r.type = exchange::cancel_request;
+        }
+        exchange::OrderEntrySession::send_status status;
+        // backs off, giving the engine its core, or at least the cache lines it drains, back
+        while ((status = session.send(r)) == exchange::OrderEntrySession::queue_full)
+        {
+            std::this_thread::yield();
+        }
+        if (status != exchange::OrderEntrySession::sent)
+        {
+            std::cerr << "gateway " << gateway << " stopped at command " << i << std::endl;
+            return;
+        }
+    }
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    const int gateways = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 4;
+    const size_t commands_per_gateway = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000000;
+    exchange::OrderEntryOptions options;
+    options.batch_size = argc > 3 ? std::max<size_t>(std::strtoul(argv[3], nullptr, 10), 1) : 64;
+    options.path = argc > 4 ? argv[4] : "/dev/shm/order_entry_bench";
+    options.max_sessions = static_cast<size_t>(gateways);
+
+    const Rules rules = create_rules();
+    exchange::OrderEntryQueue queue(options);
+    exchange::MatchingEngine engine(rules.tick_size, rules.lot_size, rules.tickers, rules.books);
+
+    std::vector<pid_t> children;
+    for (int gateway = 0; gateway < gateways; ++gateway)
+    {
+        const pid_t pid = ::fork();
+        if (pid == 0)
+        {
+            run_gateway(options.path, gateway, commands_per_gateway);
+            ::_exit(0);
+        }
+        children.push_back(pid);
+    }
+
+    const size_t number_of_commands = gateways * commands_per_gateway;
+    std::vector<exchange::Request> batch;
+    size_t drained = 0;
+    size_t batches = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (drained < number_of_commands)
+    {
+        batch.clear();
+        if (queue.drain(batch, options.batch_size) == 0) continue;
+
+        // timed from the first command in
+        if (drained == 0) start = std::chrono::steady_clock::now();
+        engine.process_orders(batch);
+        drained += batch.size();
+        ++batches;
+    }
+    const auto end = std::chrono::steady_clock::now();
+    for (const pid_t pid : children)
+    {
+        ::waitpid(pid, nullptr, 0);
+    }
+    queue.shut_down();
+
+    const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    std::cout << gateways << " gateways, " << commands_per_gateway << " commands each, batch size "
+        << options.batch_size << "\n";
+    std::cout << std::fixed << std::setprecision(1) << ns / drained << " ns/command, "
+        << std::setprecision(0) << drained / ns * 1e9 << " commands/s, "
+        << std::setprecision(1) << double(drained) / batches << " commands/batch\n";
+    std::cout << std::left << std::setw(10) << "session" << std::right << std::setw(12) << "sent"
+        << std::setw(12) << "received" << std::setw(12) << "overflows" << std::setw(8) << "gaps" << "\n";
+    for (const auto& s : queue.session_stats())
+    {
+        std::cout << std::left << std::setw(10) << s.session_id << std::right << std::setw(12) << s.sent
+            << std::setw(12) << s.received << std::setw(12) << s.overflows << std::setw(8) << s.gaps << "\n";
+    }
+    return 0;
+}
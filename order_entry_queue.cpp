@@ -0,0 +1,327 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "order_entry_queue.hpp"
+#include "utils.hpp"
+
+namespace exchange
+{
+
+namespace
+{
+
+constexpr std::uint32_t magic = 0x514f5845; // "EXOQ"
+constexpr std::uint32_t version = 1;
+constexpr size_t page_size = 4096;
+constexpr size_t max_sessions = 4096;
+
+size_t round_up(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+} // anonymous namespace
+
+OrderEntryQueue::OrderEntryQueue(const OrderEntryOptions& options)
+:
+options_(options)
+{
+    if (options_.path.empty() || options_.max_sessions == 0 || options_.max_sessions > max_sessions ||
+        options_.batch_size == 0)
+    {
+        throw std::runtime_error("An order entry queue needs a path, 1 to 4096 sessions and batches of 1 or more.");
+    }
+    size_t slots = 2;
+    while (slots < options_.slots) slots <<= 1;
+    options_.slots = slots;
+    mask_ = slots - 1;
+
+    // built aside and moved into place, so a gateway never maps half a queue - one still attached to the
+    // queue of an earlier engine keeps that one
+    const std::string tmp_path = options_.path + ".tmp";
+    mapping_ = map(tmp_path, page_size + round_up(options_.max_sessions * sizeof(Session), page_size) +
+        slots * sizeof(Slot));
+    Header* header = new (mapping_.data) Header{};
+    header->magic = magic;
+    header->version = version;
+    header->slots = slots;
+    header->max_sessions = options_.max_sessions;
+    header->engine_pid = ::getpid();
+    locate(mapping_);
+    for (size_t id = 0; id < options_.max_sessions; ++id)
+    {
+        new (&mapping_.sessions[id]) Session{};
+    }
+    // slot i takes command i, then i + slots once the engine drained it
+    for (size_t i = 0; i < slots; ++i)
+    {
+        new (&mapping_.slots[i]) Slot{};
+        mapping_.slots[i].turn.store(i, std::memory_order_relaxed);
+    }
+    if (std::rename(tmp_path.c_str(), options_.path.c_str()) != 0)
+    {
+        unmap(mapping_);
+        throw std::runtime_error("Cannot move order entry queue " + options_.path + " into place.");
+    }
+    cursors_.resize(options_.max_sessions);
+}
+
+OrderEntryQueue::~OrderEntryQueue()
+{
+    // gateways still attached see the engine gone
+    if (mapping_.header)
+    {
+        shut_down();
+    }
+    unmap(mapping_);
+}
+
+size_t OrderEntryQueue::drain(std::vector<Request>& requests, size_t max_requests)
+{
+    size_t number_of_requests = 0;
+    for (size_t taken = 0; taken < max_requests; ++taken)
+    {
+        Slot& slot = mapping_.slots[head_ & mask_];
+        if (slot.turn.load(std::memory_order_acquire) != head_ + 1) break;
+
+        if (slot.session_id < cursors_.size())
+        {
+            // a new generation is a new gateway in the session, numbering from 1 again
+            SessionCursor& cursor = cursors_[slot.session_id];
+            Session& session = mapping_.sessions[slot.session_id];
+            if (cursor.generation != slot.generation)
+            {
+                cursor = SessionCursor{slot.generation, 1};
+                session.received.store(0, std::memory_order_relaxed);
+                session.gaps.store(0, std::memory_order_relaxed);
+            }
+            // the engine is the only writer of its counters
+            if (slot.sequence > cursor.next_sequence)
+            {
+                const std::uint64_t gaps = slot.sequence - cursor.next_sequence;
+                session.gaps.store(session.gaps.load(std::memory_order_relaxed) + gaps, std::memory_order_relaxed);
+            }
+            cursor.next_sequence = slot.sequence + 1;
+            const std::uint64_t received = session.received.load(std::memory_order_relaxed) + 1;
+            session.received.store(received, std::memory_order_relaxed);
+        }
+
+        Request& r = requests.emplace_back();
+        if (binary_protocol::decode(std::span<const std::byte>(slot.message), r) == 0)
+        {
+            std::cout << "Cannot decode binary request of session " << slot.session_id << "." << std::endl;
+            requests.pop_back();
+        }
+        else
+        {
+            ++number_of_requests;
+        }
+        // free for the command of the next round
+        slot.turn.store(head_ + mask_ + 1, std::memory_order_release);
+        ++head_;
+    }
+    mapping_.header->head.store(head_, std::memory_order_relaxed);
+    return number_of_requests;
+}
+
+void OrderEntryQueue::shut_down()
+{
+    mapping_.header->tail.fetch_or(shut_down_bit);
+}
+
+bool OrderEntryQueue::drained() const
+{
+    const std::uint64_t tail = mapping_.header->tail.load(std::memory_order_acquire);
+    return (tail & shut_down_bit) != 0 && head_ == (tail & ~shut_down_bit);
+}
+
+std::vector<OrderEntrySessionStats> OrderEntryQueue::session_stats() const
+{
+    std::vector<OrderEntrySessionStats> stats;
+    for (size_t id = 0; id < options_.max_sessions; ++id)
+    {
+        const Session& session = mapping_.sessions[id];
+        const pid_t pid = session.pid.load(std::memory_order_relaxed);
+        if (pid == 0 && session.sent.load(std::memory_order_relaxed) == 0) continue;
+
+        OrderEntrySessionStats& s = stats.emplace_back();
+        s.session_id = static_cast<std::uint32_t>(id);
+        s.pid = pid;
+        s.sent = session.sent.load(std::memory_order_relaxed);
+        s.overflows = session.overflows.load(std::memory_order_relaxed);
+        s.received = session.received.load(std::memory_order_relaxed);
+        s.gaps = session.gaps.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+OrderEntryQueue::Mapping OrderEntryQueue::map(const std::string& path, size_t size)
+{
+    Mapping mapping;
+    const bool create = size > 0;
+    mapping.fd = ::open(path.c_str(), create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+    if (mapping.fd < 0)
+    {
+        throw std::runtime_error("Cannot open order entry queue " + path + ": " + std::strerror(errno) + ".");
+    }
+    if (create && ::ftruncate(mapping.fd, static_cast<off_t>(size)) != 0)
+    {
+        ::close(mapping.fd);
+        throw std::runtime_error("Cannot size order entry queue " + path + ": " + std::strerror(errno) + ".");
+    }
+    if (!create)
+    {
+        struct stat st;
+        ::fstat(mapping.fd, &st);
+        size = static_cast<size_t>(st.st_size);
+    }
+    void* data = size < page_size ? MAP_FAILED :
+        ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, mapping.fd, 0);
+    if (data == MAP_FAILED)
+    {
+        ::close(mapping.fd);
+        throw std::runtime_error("Cannot map order entry queue " + path + ".");
+    }
+    mapping.data = static_cast<std::byte*>(data);
+    mapping.size = size;
+    mapping.header = reinterpret_cast<Header*>(mapping.data);
+    return mapping;
+}
+
+void OrderEntryQueue::unmap(Mapping& mapping)
+{
+    if (mapping.data)
+    {
+        ::munmap(mapping.data, mapping.size);
+    }
+    if (mapping.fd >= 0)
+    {
+        ::close(mapping.fd);
+    }
+    mapping = Mapping();
+}
+
+void OrderEntryQueue::locate(Mapping& mapping)
+{
+    const Header& header = *mapping.header;
+    const size_t sessions_size = round_up(header.max_sessions * sizeof(Session), page_size);
+    if (header.magic != magic || header.version != version || header.max_sessions > max_sessions ||
+        header.slots == 0 || (header.slots & (header.slots - 1)) != 0 ||
+        mapping.size != page_size + sessions_size + header.slots * sizeof(Slot))
+    {
+        throw std::runtime_error("Not an order entry queue.");
+    }
+    mapping.sessions = reinterpret_cast<Session*>(mapping.data + page_size);
+    mapping.slots = reinterpret_cast<Slot*>(mapping.data + page_size + sessions_size);
+}
+
+OrderEntrySession::OrderEntrySession(const std::string& path)
+{
+    mapping_ = OrderEntryQueue::map(path, 0);
+    try
+    {
+        OrderEntryQueue::locate(mapping_);
+    }
+    catch (const std::exception&)
+    {
+        OrderEntryQueue::unmap(mapping_);
+        throw std::runtime_error("Not an order entry queue " + path + ".");
+    }
+    mask_ = mapping_.header->slots - 1;
+
+    const pid_t self = ::getpid();
+    for (size_t id = 0; id < mapping_.header->max_sessions && !session_; ++id)
+    {
+        OrderEntryQueue::Session& session = mapping_.sessions[id];
+        pid_t pid = session.pid.load();
+        if ((pid == 0 || !utils::process_alive(pid)) && session.pid.compare_exchange_strong(pid, self))
+        {
+            session_ = &session;
+            session_id_ = static_cast<std::uint32_t>(id);
+        }
+    }
+    if (!session_)
+    {
+        OrderEntryQueue::unmap(mapping_);
+        throw std::runtime_error("No free session on order entry queue " + path + ".");
+    }
+    generation_ = session_->generation.load() + 1;
+    session_->generation.store(generation_);
+    session_->sent.store(0, std::memory_order_relaxed);
+    session_->overflows.store(0, std::memory_order_relaxed);
+}
+
+OrderEntrySession::~OrderEntrySession()
+{
+    if (session_)
+    {
+        session_->pid.store(0);
+    }
+    OrderEntryQueue::unmap(mapping_);
+}
+
+OrderEntrySession::send_status OrderEntrySession::send(const Request& r)
+{
+    std::byte message[binary_protocol::max_message_size];
+    const size_t size = binary_protocol::encode(r, message);
+    if (size == 0) return not_encodable;
+    return send(std::span<const std::byte>(message, size));
+}
+
+OrderEntrySession::send_status OrderEntrySession::send(std::span<const std::byte> message)
+{
+    if (message.empty() || message.size() != binary_protocol::message_size(std::to_integer<std::uint8_t>(message[0])))
+    {
+        return not_encodable;
+    }
+
+    std::atomic<std::uint64_t>& tail = mapping_.header->tail;
+    std::uint64_t position = tail.load(std::memory_order_relaxed);
+    OrderEntryQueue::Slot* slot;
+    for (;;)
+    {
+        if (position & OrderEntryQueue::shut_down_bit) return queue_shut_down;
+
+        slot = &mapping_.slots[position & mask_];
+        const std::int64_t lap = static_cast<std::int64_t>(slot->turn.load(std::memory_order_acquire) - position);
+        if (lap == 0)
+        {
+            // fails and reloads if another gateway claimed it first, or the engine shut down
+            if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+        }
+        else if (lap < 0)
+        {
+            // the command of the previous round is still there
+            session_->overflows.store(session_->overflows.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+            return queue_full;
+        }
+        else
+        {
+            position = tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->session_id = session_id_;
+    slot->generation = generation_;
+    slot->sequence = ++sequence_;
+    std::memcpy(slot->message, message.data(), message.size());
+    slot->turn.store(position + 1, std::memory_order_release);
+    session_->sent.store(sequence_, std::memory_order_relaxed);
+    return sent;
+}
+
+bool OrderEntrySession::engine_gone() const
+{
+    return (mapping_.header->tail.load(std::memory_order_relaxed) & OrderEntryQueue::shut_down_bit) != 0 ||
+        !utils::process_alive(mapping_.header->engine_pid);
+}
+
+} // namespace exchange
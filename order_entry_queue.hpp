@@ -0,0 +1,216 @@
+#ifndef ORDER_ENTRY_QUEUE_HPP_
+#define ORDER_ENTRY_QUEUE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <span>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+#include "binary_protocol.hpp"
+#include "request.hpp"
+
+namespace exchange
+{
+
+class OrderEntryQueue;
+typedef std::unique_ptr<OrderEntryQueue> OrderEntryQueuePtr;
+typedef std::unique_ptr<const OrderEntryQueue> OrderEntryQueueCPtr;
+
+class OrderEntrySession;
+typedef std::unique_ptr<OrderEntrySession> OrderEntrySessionPtr;
+typedef std::unique_ptr<const OrderEntrySession> OrderEntrySessionCPtr;
+
+struct OrderEntryOptions
+{
+    // file the queue lives in, e.g. /dev/shm/<name> for POSIX shared memory - empty disables it
+    std::string path;
+    // commands in flight, rounded up to a power of two
+    size_t slots = 1 << 16;
+    // gateway processes attached at once
+    size_t max_sessions = 64;
+    // commands drained and matched as one batch at most, 1 matches them one at a time
+    size_t batch_size = 64;
+    // collapse the depth updates of a batch - see Exchange::process_batch
+    bool conflate = false;
+};
+
+template <typename BasicJsonType>
+void from_json(const BasicJsonType& j, OrderEntryOptions& o)
+{
+    const OrderEntryOptions defaults;
+    o.path = j.value("path", defaults.path);
+    o.slots = j.value("slots", defaults.slots);
+    o.max_sessions = j.value("max_sessions", defaults.max_sessions);
+    o.batch_size = j.value("batch_size", defaults.batch_size);
+    o.conflate = j.value("conflate", defaults.conflate);
+}
+
+// counters of one gateway session, for monitoring
+struct OrderEntrySessionStats
+{
+    std::uint32_t session_id = 0;
+    pid_t pid = 0;
+    // commands put on the queue, the sequence number of the last one
+    std::uint64_t sent = 0;
+    // commands refused because the queue was full
+    std::uint64_t overflows = 0;
+    // commands drained by the engine
+    std::uint64_t received = 0;
+    // sequence numbers the engine never saw
+    std::uint64_t gaps = 0;
+};
+
+// Lock-free queue in a file mapped shared, from any number of gateway processes to the engine thread
+// (MPSC). Every slot holds one binary_protocol command and a cache line:
+//
+//   slot        0  u64  turn           8  u32  session id     12  u32  session generation
+//              16  u64  sequence number of the command in its session
+//              24  u8[40] binary_protocol message
+//
+// A gateway claims the next slot by compare and swap on the shared tail and hands it over by bumping
+// the slot's turn; the engine busy-polls the turn of the slot at its head, so gateways never wait for
+// each other or the engine, and a full queue is refused rather than waited on. Each session numbers
+// its commands, the engine counts the numbers it never saw.
+//
+// Shutdown is a bit set in the tail by the engine: no command is claimed after it, and the engine
+// drains every command claimed before it. A gateway that dies between claiming a slot and handing it
+// over holds the engine up at that slot.
+class OrderEntryQueue
+{
+public:
+    // creates the queue, replacing one left by an earlier engine
+    explicit OrderEntryQueue(const OrderEntryOptions& options);
+    ~OrderEntryQueue();
+
+    OrderEntryQueue(const OrderEntryQueue&) = delete;
+    OrderEntryQueue& operator=(const OrderEntryQueue&) = delete;
+
+    const OrderEntryOptions& options() const { return options_; }
+
+    // Engine side - appends up to max_requests commands waiting in the queue, without waiting for
+    // more. Returns the number appended.
+    size_t drain(std::vector<Request>& requests, size_t max_requests);
+    // no more commands are taken, safe from another thread or a signal handler
+    void shut_down();
+    // shut down and every command taken drained
+    bool drained() const;
+
+    std::vector<OrderEntrySessionStats> session_stats() const;
+
+private:
+    friend class OrderEntrySession;
+
+    static constexpr size_t cache_line_size = 64;
+    static constexpr std::uint64_t shut_down_bit = std::uint64_t(1) << 63;
+
+    struct Slot
+    {
+        std::atomic<std::uint64_t> turn;
+        std::uint32_t session_id;
+        std::uint32_t generation;
+        std::uint64_t sequence;
+        std::byte message[binary_protocol::max_message_size];
+    };
+    static_assert(sizeof(Slot) == cache_line_size, "A slot is one cache line.");
+
+    struct Session
+    {
+        // written by the gateway, 0 while the session is free
+        alignas(cache_line_size) std::atomic<pid_t> pid;
+        std::atomic<std::uint32_t> generation;
+        std::atomic<std::uint64_t> sent;
+        std::atomic<std::uint64_t> overflows;
+        // written by the engine
+        alignas(cache_line_size) std::atomic<std::uint64_t> received;
+        std::atomic<std::uint64_t> gaps;
+    };
+
+    struct Header
+    {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint64_t slots;
+        std::uint64_t max_sessions;
+        pid_t engine_pid;
+        // claimed by the gateways, with the shut down bit
+        alignas(cache_line_size) std::atomic<std::uint64_t> tail;
+        // drained by the engine
+        alignas(cache_line_size) std::atomic<std::uint64_t> head;
+    };
+
+    // where the engine is with a session
+    struct SessionCursor
+    {
+        std::uint32_t generation = 0;
+        std::uint64_t next_sequence = 1;
+    };
+
+    // maps a queue, of the given size when it is created
+    struct Mapping
+    {
+        int fd = -1;
+        std::byte* data = nullptr;
+        size_t size = 0;
+        Header* header = nullptr;
+        Session* sessions = nullptr;
+        Slot* slots = nullptr;
+    };
+    static Mapping map(const std::string& path, size_t size);
+    static void unmap(Mapping& mapping);
+    static void locate(Mapping& mapping);
+
+    OrderEntryOptions options_;
+    Mapping mapping_;
+    size_t mask_ = 0;
+    std::uint64_t head_ = 0;
+    std::vector<SessionCursor> cursors_;
+};
+
+// A gateway's end of the order entry queue: attaches to the queue an engine created and sends
+// commands tagged with its session id and sequence numbers. Belongs to one thread.
+class OrderEntrySession
+{
+public:
+    enum send_status
+    {
+        sent,
+        // counted as an overflow of the session
+        queue_full,
+        queue_shut_down,
+        // the request has no binary_protocol message, e.g. its symbol id is not resolved
+        not_encodable
+    };
+
+    // takes a free session, or one of a process that is gone
+    explicit OrderEntrySession(const std::string& path);
+    ~OrderEntrySession();
+
+    OrderEntrySession(const OrderEntrySession&) = delete;
+    OrderEntrySession& operator=(const OrderEntrySession&) = delete;
+
+    std::uint32_t session_id() const { return session_id_; }
+    // sequence number of the last command sent
+    std::uint64_t sequence() const { return sequence_; }
+
+    send_status send(const Request& r);
+    // one binary_protocol message
+    send_status send(std::span<const std::byte> message);
+    // the engine shut the queue down or its process is gone - a new engine creates a new queue
+    bool engine_gone() const;
+
+private:
+    OrderEntryQueue::Mapping mapping_;
+    OrderEntryQueue::Session* session_ = nullptr;
+    std::uint32_t session_id_ = 0;
+    std::uint32_t generation_ = 0;
+    size_t mask_ = 0;
+    std::uint64_t sequence_ = 0;
+};
+
+} // namespace exchange
+
+#endif
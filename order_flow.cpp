@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include "order_flow.hpp"
+
+namespace exchange
+{
+
+namespace
+{
+
+std::vector<double> zipf_weights(size_t number_of_symbols, double exponent)
+{
+    std::vector<double> weights(number_of_symbols);
+    for (size_t k = 0; k < number_of_symbols; ++k)
+    {
+        weights[k] = 1 / std::pow(static_cast<double>(k + 1), exponent);
+    }
+    return weights;
+}
+
+order::order_side opposite(order::order_side side)
+{
+    return side == order::order_side::bid ? order::order_side::ask : order::order_side::bid;
+}
+
+} // anonymous namespace
+
+OrderFlowGenerator::OrderFlowGenerator(
+    const OrderFlowOptions& options,
+    const ticker_rules::TickerRulesCPtr& ticker_rules,
+    const size_rules::TickSizeRulesCPtr& ticker_size_rules,
+    const size_rules::LotSizeRulesCPtr& lot_size_rules
+)
+:
+options_(options),
+ticker_rules_(ticker_rules),
+ticker_size_rules_(ticker_size_rules),
+lot_size_rules_(lot_size_rules),
+gen_(options.seed),
+uniform_(0.0, 1.0),
+distance_from_touch_(options.touch_decay)
+{
+    if (!ticker_rules_ || ticker_rules_->number_of_symbols() == 0)
+    {
+        throw std::runtime_error("Order flow needs at least one symbol.");
+    }
+    for (size_t i = 0; i < ticker_rules_->number_of_symbols(); ++i)
+    {
+        if (ticker_rules_->symbol(static_cast<int>(i)).size() > Request::max_symbol_length)
+        {
+            throw std::runtime_error("Order flow symbols are at most 15 characters.");
+        }
+    }
+    const std::vector<double> weights = zipf_weights(ticker_rules_->number_of_symbols(), options_.zipf_exponent);
+    symbol_ = std::discrete_distribution<int>(weights.begin(), weights.end());
+
+    long mid = options_.mid_price.unscaled();
+    const long tick = tick_at(mid);
+    if (tick > 0)
+    {
+        mid -= mid % tick;
+    }
+    if (tick <= 0 || tick_at(mid) <= 0 || lot_at(mid) <= 0)
+    {
+        throw std::runtime_error("No tick or lot size rule for the order flow mid price.");
+    }
+    flows_.resize(ticker_rules_->number_of_symbols(), SymbolFlow{mid, {}});
+
+    if (options_.burst_rate > 0)
+    {
+        burst_start_ = std::exponential_distribution<double>(options_.burst_rate)(gen_);
+    }
+}
+
+const Request& OrderFlowGenerator::next()
+{
+    advance_time();
+    const int symbol_id = symbol_(gen_);
+    SymbolFlow& flow = flows_[symbol_id];
+    if (uniform_(gen_) < options_.mid_move)
+    {
+        move_mid(flow, uniform_(gen_) < 0.5 ? -1 : 1);
+    }
+
+    request_ = Request();
+    request_.time = options_.start_time + static_cast<int>(now_);
+    const double r = uniform_(gen_);
+    if (r < options_.cancel_ratio && !flow.live.empty())
+    {
+        cancel_order(symbol_id);
+    }
+    else if (r < options_.cancel_ratio + options_.modify_ratio && !flow.live.empty())
+    {
+        modify_order(symbol_id);
+    }
+    else
+    {
+        new_order(symbol_id);
+    }
+    return request_;
+}
+
+void OrderFlowGenerator::advance_time()
+{
+    for (;;)
+    {
+        const bool bursting = now_ < burst_end_;
+        const double rate = options_.arrival_rate * (bursting ? options_.burst_multiplier : 1);
+        const double wait = std::exponential_distribution<double>(rate)(gen_);
+        // arrivals are memoryless, so drawing again where the rate changes keeps them Poisson
+        const double change = bursting ? burst_end_ : burst_start_;
+        if (options_.burst_rate <= 0 || now_ + wait < change)
+        {
+            now_ += wait;
+            return;
+        }
+
+        now_ = change;
+        if (bursting)
+        {
+            burst_start_ = now_ + std::exponential_distribution<double>(options_.burst_rate)(gen_);
+        }
+        else
+        {
+            // the whole market leans the same way
+            burst_end_ = now_ + options_.burst_seconds;
+            burst_side_ = random_side();
+            ++stats_.bursts;
+        }
+    }
+}
+
+void OrderFlowGenerator::new_order(int symbol_id)
+{
+    SymbolFlow& flow = flows_[symbol_id];
+    const bool bursting = now_ < burst_end_;
+    request_.type = new_request;
+    request_.order_id = next_order_id_++;
+    request_.side = !bursting ? random_side() :
+        uniform_(gen_) < options_.burst_side_share ? burst_side_ : opposite(burst_side_);
+    request_.tif = order::time_in_force::day;
+    set_symbol(symbol_id);
+    ++stats_.new_orders;
+
+    const bool buy = request_.side == order::order_side::bid;
+    const double r = uniform_(gen_);
+    if (r < options_.market_ratio + options_.aggressive_ratio)
+    {
+        // left out of the live orders, they mostly trade
+        if (r < options_.market_ratio)
+        {
+            request_.order_type = order::order_type::market;
+            request_.tif = order::time_in_force::immediate_or_cancel;
+            request_.quantity = lot_at(flow.mid) * random_lots();
+            ++stats_.market_orders;
+        }
+        else
+        {
+            request_.order_type = order::order_type::limit;
+            request_.limit_price = utils::Price4(price_near_mid(flow.mid, buy ? 2 : -2));
+            request_.quantity = lot_at(request_.limit_price.unscaled()) * random_lots();
+            ++stats_.aggressive_orders;
+        }
+        if (bursting && request_.side == burst_side_)
+        {
+            move_mid(flow, buy ? 1 : -1);
+        }
+        return;
+    }
+
+    const long ticks = 1 + distance_from_touch_(gen_);
+    const long price = price_near_mid(flow.mid, buy ? -ticks : ticks);
+    const int lot = lot_at(price);
+    request_.limit_price = utils::Price4(price);
+    if (r < options_.market_ratio + options_.aggressive_ratio + options_.iceberg_ratio)
+    {
+        request_.order_type = order::order_type::iceberg;
+        request_.quantity = lot;
+        request_.hidden_quantity = lot * random_lots();
+        ++stats_.iceberg_orders;
+    }
+    else
+    {
+        request_.order_type = order::order_type::limit;
+        request_.quantity = lot * random_lots();
+    }
+    flow.live.push_back(LiveOrder{request_.order_id, request_.side});
+}
+
+void OrderFlowGenerator::cancel_order(int symbol_id)
+{
+    std::vector<LiveOrder>& live = flows_[symbol_id].live;
+    const size_t i = std::uniform_int_distribution<size_t>(0, live.size() - 1)(gen_);
+    request_.type = cancel_request;
+    request_.order_id = live[i].order_id;
+    live[i] = live.back();
+    live.pop_back();
+    ++stats_.cancels;
+}
+
+void OrderFlowGenerator::modify_order(int symbol_id)
+{
+    const SymbolFlow& flow = flows_[symbol_id];
+    const LiveOrder& o = flow.live[std::uniform_int_distribution<size_t>(0, flow.live.size() - 1)(gen_)];
+    // a new price and size on the same book
+    const long ticks = 1 + distance_from_touch_(gen_);
+    const long price = price_near_mid(flow.mid, o.side == order::order_side::bid ? -ticks : ticks);
+    request_.type = modify_request;
+    request_.order_id = o.order_id;
+    request_.order_type = order::order_type::limit;
+    request_.side = o.side;
+    request_.tif = order::time_in_force::day;
+    request_.limit_price = utils::Price4(price);
+    request_.quantity = lot_at(price) * random_lots();
+    set_symbol(symbol_id);
+    ++stats_.modifies;
+}
+
+void OrderFlowGenerator::move_mid(SymbolFlow& flow, int direction) const
+{
+    flow.mid = price_near_mid(flow.mid, direction);
+}
+
+long OrderFlowGenerator::price_near_mid(long mid, long ticks) const
+{
+    const long price = mid + ticks * tick_at(mid);
+    const long tick = tick_at(price);
+    if (tick <= 0)
+    {
+        return mid;
+    }
+    const long off_grid = price % tick;
+    const long snapped = off_grid == 0 ? price : ticks < 0 ? price - off_grid : price - off_grid + tick;
+    const long snapped_tick = tick_at(snapped);
+    if (snapped_tick <= 0 || snapped % snapped_tick != 0 || lot_at(snapped) <= 0)
+    {
+        return mid;
+    }
+    return snapped;
+}
+
+long OrderFlowGenerator::tick_at(long price) const
+{
+    if (!ticker_size_rules_ || !ticker_size_rules_->has_rules())
+    {
+        // any price is on the grid - trade in cents
+        return 100;
+    }
+    try
+    {
+        return ticker_size_rules_->find_size(utils::Price4(price)).unscaled();
+    }
+    catch (const std::runtime_error&)
+    {
+        return 0;
+    }
+}
+
+int OrderFlowGenerator::lot_at(long price) const
+{
+    if (!lot_size_rules_ || !lot_size_rules_->has_rules())
+    {
+        return 1;
+    }
+    try
+    {
+        return lot_size_rules_->find_size(utils::Price4(price));
+    }
+    catch (const std::runtime_error&)
+    {
+        return 0;
+    }
+}
+
+int OrderFlowGenerator::random_lots()
+{
+    return std::uniform_int_distribution<int>(1, std::max(options_.max_lots, 1))(gen_);
+}
+
+order::order_side OrderFlowGenerator::random_side()
+{
+    return uniform_(gen_) < 0.5 ? order::order_side::bid : order::order_side::ask;
+}
+
+void OrderFlowGenerator::set_symbol(int symbol_id)
+{
+    const std::string& symbol = ticker_rules_->symbol(symbol_id);
+    request_.symbol_id = symbol_id;
+    request_.symbol_length = static_cast<std::uint8_t>(symbol.size());
+    std::memcpy(request_.symbol_data, symbol.data(), symbol.size());
+}
+
+} // namespace exchange
@@ -0,0 +1,163 @@
+#ifndef ORDER_FLOW_HPP_
+#define ORDER_FLOW_HPP_
+
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <vector>
+#include "order.hpp"
+#include "price4.hpp"
+#include "request.hpp"
+#include "size_rules.hpp"
+#include "ticker_rules.hpp"
+
+namespace exchange
+{
+
+class OrderFlowGenerator;
+typedef std::unique_ptr<OrderFlowGenerator> OrderFlowGeneratorPtr;
+typedef std::unique_ptr<const OrderFlowGenerator> OrderFlowGeneratorCPtr;
+
+// shape of synthetic order flow - shares are of the requests of a symbol
+struct OrderFlowOptions
+{
+    unsigned int seed = 42;
+    // time of the first request, in seconds
+    int start_time = 1625787615;
+    // requests per second over all symbols, outside bursts
+    double arrival_rate = 10000;
+    // symbol k of the symbols config, from 1, gets a share of the arrivals proportional to 1 / k^s
+    double zipf_exponent = 1;
+    // every symbol starts with its mid here, moved onto the tick grid
+    utils::Price4 mid_price = utils::Price4(1000000);
+    // chance of the mid moving a tick on a request of its symbol
+    double mid_move = 0.01;
+    // passive orders rest 1 + k ticks off the mid, k geometric with this parameter
+    double touch_decay = 0.35;
+    // new orders are 1 to max_lots round lots
+    int max_lots = 10;
+    double cancel_ratio = 0.4;
+    double modify_ratio = 0.1;
+    // new orders crossing the spread - market orders, or limit orders a few ticks through the mid
+    double market_ratio = 0.02;
+    double aggressive_ratio = 0.05;
+    // new orders resting as icebergs displaying one lot
+    double iceberg_ratio = 0.05;
+    // Bursts start at this rate per second, 0 for none, and last burst_seconds. Every symbol's arrivals
+    // speed up by burst_multiplier, new orders lean to one side of the market with burst_side_share of
+    // them, and their aggressive orders push the mid that way.
+    double burst_rate = 0;
+    double burst_seconds = 0.5;
+    double burst_multiplier = 10;
+    double burst_side_share = 0.8;
+};
+
+template <typename BasicJsonType>
+void from_json(const BasicJsonType& j, OrderFlowOptions& o)
+{
+    const OrderFlowOptions defaults;
+    o.seed = j.value("seed", defaults.seed);
+    o.start_time = j.value("start_time", defaults.start_time);
+    o.arrival_rate = j.value("arrival_rate", defaults.arrival_rate);
+    o.zipf_exponent = j.value("zipf_exponent", defaults.zipf_exponent);
+    o.mid_price = j.value("mid_price", defaults.mid_price);
+    o.mid_move = j.value("mid_move", defaults.mid_move);
+    o.touch_decay = j.value("touch_decay", defaults.touch_decay);
+    o.max_lots = j.value("max_lots", defaults.max_lots);
+    o.cancel_ratio = j.value("cancel_ratio", defaults.cancel_ratio);
+    o.modify_ratio = j.value("modify_ratio", defaults.modify_ratio);
+    o.market_ratio = j.value("market_ratio", defaults.market_ratio);
+    o.aggressive_ratio = j.value("aggressive_ratio", defaults.aggressive_ratio);
+    o.iceberg_ratio = j.value("iceberg_ratio", defaults.iceberg_ratio);
+    o.burst_rate = j.value("burst_rate", defaults.burst_rate);
+    o.burst_seconds = j.value("burst_seconds", defaults.burst_seconds);
+    o.burst_multiplier = j.value("burst_multiplier", defaults.burst_multiplier);
+    o.burst_side_share = j.value("burst_side_share", defaults.burst_side_share);
+}
+
+// requests generated so far, by kind
+struct OrderFlowStats
+{
+    size_t new_orders = 0;
+    size_t market_orders = 0;
+    size_t aggressive_orders = 0;
+    size_t iceberg_orders = 0;
+    size_t cancels = 0;
+    size_t modifies = 0;
+    size_t bursts = 0;
+};
+
+// Seeded synthetic order flow over the listed symbols - the same options, rules and symbols give the
+// same requests. Each symbol is a Poisson process of its Zipf share of the arrival rate. Limit prices
+// cluster near a randomly walking mid on the tick grid of the tick size rules, sizes are round lots of
+// the lot size rules, and cancels and modifies pick a random order the generator sent and believes
+// resting - one that traded meanwhile is rejected by the engine, as it would be for a real client.
+class OrderFlowGenerator
+{
+public:
+    // throws if there are no symbols or the mid price has no tick or lot size rule
+    OrderFlowGenerator(
+        const OrderFlowOptions& options,
+        const ticker_rules::TickerRulesCPtr& ticker_rules,
+        const size_rules::TickSizeRulesCPtr& ticker_size_rules,
+        const size_rules::LotSizeRulesCPtr& lot_size_rules
+    );
+
+    // The next request, valid until the next call. Requests carrying a symbol have its text and its
+    // symbol id.
+    const Request& next();
+    const OrderFlowStats& stats() const { return stats_; }
+
+private:
+    struct LiveOrder
+    {
+        int order_id;
+        order::order_side side;
+    };
+
+    struct SymbolFlow
+    {
+        // unscaled, always on the tick grid
+        long mid;
+        std::vector<LiveOrder> live;
+    };
+
+    // moves time on to the next arrival, starting and ending bursts on the way
+    void advance_time();
+    void new_order(int symbol_id);
+    void cancel_order(int symbol_id);
+    void modify_order(int symbol_id);
+    void move_mid(SymbolFlow& flow, int direction) const;
+
+    // Price ticks away from the mid, towards the bid for negative ticks, snapped onto the grid of its
+    // own tick size band away from the mid - the mid if the price has no rule.
+    long price_near_mid(long mid, long ticks) const;
+    // 0 if the price has no rule
+    long tick_at(long price) const;
+    int lot_at(long price) const;
+    int random_lots();
+    order::order_side random_side();
+    void set_symbol(int symbol_id);
+
+    OrderFlowOptions options_;
+    ticker_rules::TickerRulesCPtr ticker_rules_;
+    size_rules::TickSizeRulesCPtr ticker_size_rules_;
+    size_rules::LotSizeRulesCPtr lot_size_rules_;
+    std::mt19937_64 gen_;
+    std::uniform_real_distribution<double> uniform_;
+    std::discrete_distribution<int> symbol_;
+    std::geometric_distribution<int> distance_from_touch_;
+    std::vector<SymbolFlow> flows_;
+    // seconds since the start
+    double now_ = 0;
+    double burst_start_ = 0;
+    double burst_end_ = 0;
+    order::order_side burst_side_ = order::order_side::bid;
+    int next_order_id_ = 0;
+    Request request_;
+    OrderFlowStats stats_;
+};
+
+} // namespace exchange
+
+#endif
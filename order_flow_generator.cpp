@@ -0,0 +1,111 @@
+#include <array>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <span>
+#include <string>
+#include "binary_protocol.hpp"
+#include "order_flow.hpp"
+#include "request.hpp"
+#include "serialise.hpp"
+#include "size_rules.hpp"
+#include "ticker_rules.hpp"
+
+// Writes synthetic order flow over the symbols, tick and lot size rules of a config, shaped by its
+// order_flow block: json lines like a requests file, or binary_protocol messages back to back, e.g.
+// for exchange_replay or gateway load. The seed of the block can be given on the command line instead.
+// usage: order_flow_generator config_file requests_file number_of_requests [json|binary] [seed]
+
+namespace
+{
+
+using json = nlohmann::json;
+
+// written out once this much is buffered
+constexpr size_t write_bytes = 1 << 16;
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 4)
+    {
+        std::cerr << "usage: order_flow_generator config_file requests_file number_of_requests [json|binary] [seed]"
+            << std::endl;
+        return 1;
+    }
+    const size_t number_of_requests = std::strtoul(argv[3], nullptr, 10);
+    const bool binary = argc > 4 && std::string(argv[4]) == "binary";
+
+    try
+    {
+        std::ifstream config(argv[1]);
+        const json j = json::parse(config);
+        exchange::OrderFlowOptions options = j.contains("order_flow") ?
+            j.at("order_flow").get<exchange::OrderFlowOptions>() : exchange::OrderFlowOptions();
+        if (argc > 5)
+        {
+            options.seed = static_cast<unsigned int>(std::strtoul(argv[5], nullptr, 10));
+        }
+        const auto tickers = j.at("symbols").get<ticker_rules::TickerRulesCPtr>();
+        const auto tick_size_rules = j.contains("tick_size") ?
+            j.at("tick_size").get<size_rules::TickSizeRulesCPtr>() : size_rules::TickSizeRulesCPtr();
+        const auto lot_size_rules = j.contains("lot_size") ?
+            j.at("lot_size").get<size_rules::LotSizeRulesCPtr>() : size_rules::LotSizeRulesCPtr();
+        exchange::OrderFlowGenerator generator(options, tickers, tick_size_rules, lot_size_rules);
+
+        std::ofstream out(argv[2], std::ios::binary);
+        if (!out)
+        {
+            std::cerr << "Cannot open " << argv[2] << "." << std::endl;
+            return 1;
+        }
+        std::string buffer;
+        buffer.reserve(write_bytes + 256);
+        std::array<std::byte, binary_protocol::max_message_size> message;
+        int first_time = 0;
+        int last_time = 0;
+        for (size_t i = 0; i < number_of_requests; ++i)
+        {
+            const exchange::Request& r = generator.next();
+            if (i == 0) first_time = r.time;
+            last_time = r.time;
+            if (binary)
+            {
+                const size_t size = binary_protocol::encode(r, message);
+                buffer.append(reinterpret_cast<const char*>(message.data()), size);
+            }
+            else
+            {
+                exchange::append_json(r, buffer);
+                buffer += '\n';
+            }
+            if (buffer.size() >= write_bytes)
+            {
+                out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                buffer.clear();
+            }
+        }
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        out.close();
+        if (!out)
+        {
+            std::cerr << "Cannot write " << argv[2] << "." << std::endl;
+            return 1;
+        }
+
+        const exchange::OrderFlowStats& stats = generator.stats();
+        std::cerr << number_of_requests << " requests over " << last_time - first_time << " s, seed " << options.seed
+            << ": " << stats.new_orders << " new (" << stats.market_orders << " market, " << stats.aggressive_orders
+            << " aggressive, " << stats.iceberg_orders << " iceberg), " << stats.cancels << " cancels, "
+            << stats.modifies << " modifies, " << stats.bursts << " bursts" << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
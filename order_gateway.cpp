@@ -0,0 +1,772 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <string_view>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "binary_protocol.hpp"
+#include "order_gateway.hpp"
+
+namespace exchange
+{
+
+namespace
+{
+
+// epoll tags, sessions are tagged from first_session_tag on by their slot
+constexpr std::uint64_t listen_tag = 0;
+constexpr std::uint64_t wake_tag = 1;
+constexpr std::uint64_t first_session_tag = 2;
+constexpr int max_events = 256;
+
+// io_uring user data - what completed in the top byte, and for sessions the slot with its generation
+enum completion_kind : std::uint64_t
+{
+    accept_completion = 1,
+    wake_completion,
+    receive_completion,
+    send_completion,
+    cancel_completion
+};
+constexpr size_t provided_buffer_size = 4096;
+
+std::uint64_t user_data(completion_kind kind, std::uint32_t generation = 0, size_t id = 0)
+{
+    return (std::uint64_t(kind) << 56) | (std::uint64_t(generation & 0xffffff) << 32) | std::uint32_t(id);
+}
+
+void close_fd(int& fd)
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+} // anonymous namespace
+
+OrderGateway::OrderGateway(Exchange& exchange, const GatewayOptions& options, const utils::IoOptions& io_options)
+:
+exchange_(exchange),
+options_(options)
+{
+    if (options_.max_sessions == 0 || options_.batch_size == 0 ||
+        options_.receive_buffer_bytes < gateway_protocol::header_size + binary_protocol::max_message_size ||
+        options_.send_buffer_bytes < gateway_protocol::ack_frame_size)
+    {
+        throw std::runtime_error("A gateway needs sessions, batches of 1 or more and buffers of a frame at least.");
+    }
+    // send zero copy came with the kernel that has multishot receives too
+    if (utils::IoRing::enabled(io_options, {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND, IORING_OP_READ,
+        IORING_OP_ASYNC_CANCEL, IORING_OP_PROVIDE_BUFFERS, IORING_OP_SEND_ZC}))
+    {
+        ring_ = std::make_unique<utils::IoRing>(io_options.ring_entries);
+        ring_->provide_buffers(io_options.ring_entries, provided_buffer_size);
+        received_next_.resize(io_options.ring_entries, -1);
+        received_length_.resize(io_options.ring_entries);
+        received_offset_.resize(io_options.ring_entries);
+    }
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<std::uint16_t>(options_.port));
+    if (::inet_pton(AF_INET, options_.address.c_str(), &address.sin_addr) != 1)
+    {
+        throw std::runtime_error("Gateway address " + options_.address + " is not an IPv4 address.");
+    }
+
+    const int one = 1;
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event listen_event{};
+    listen_event.events = EPOLLIN | EPOLLET;
+    listen_event.data.u64 = listen_tag;
+    epoll_event wake_event{};
+    wake_event.events = EPOLLIN;
+    wake_event.data.u64 = wake_tag;
+    if (listen_fd_ < 0 || epoll_fd_ < 0 || wake_fd_ < 0 ||
+        ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+        // acks go out as soon as they are written, accepted connections take it from here
+        ::setsockopt(listen_fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) != 0 ||
+        ::bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listen_fd_, SOMAXCONN) != 0 ||
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &listen_event) != 0 ||
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &wake_event) != 0)
+    {
+        const std::string error = std::strerror(errno);
+        close_fd(listen_fd_);
+        close_fd(epoll_fd_);
+        close_fd(wake_fd_);
+        throw std::runtime_error("Cannot listen on " + options_.address + ":" + std::to_string(options_.port) +
+            ": " + error + ".");
+    }
+    batch_.reserve(options_.batch_size);
+}
+
+OrderGateway::~OrderGateway()
+{
+    for (auto& session : sessions_)
+    {
+        close_fd(session.fd);
+    }
+    close_fd(listen_fd_);
+    close_fd(epoll_fd_);
+    close_fd(wake_fd_);
+}
+
+void OrderGateway::run()
+{
+    if (ring_)
+    {
+        run_ring();
+    }
+    else
+    {
+        run_epoll();
+    }
+}
+
+void OrderGateway::run_epoll()
+{
+    epoll_event events[max_events];
+    bool stopping = false;
+    bool resumable = false;
+    while (!stopping)
+    {
+        // no waiting while a held session can read on
+        const int n = ::epoll_wait(epoll_fd_, events, max_events, resumable ? 0 : -1);
+        ++stats_.system_calls;
+        if (n < 0 && errno != EINTR)
+        {
+            throw std::runtime_error(std::string("Gateway cannot wait for its connections: ") +
+                std::strerror(errno) + ".");
+        }
+        for (int i = 0; i < n; ++i)
+        {
+            const std::uint64_t tag = events[i].data.u64;
+            if (tag == listen_tag)
+            {
+                accept_sessions();
+            }
+            else if (tag == wake_tag)
+            {
+                stopping = true;
+            }
+            else
+            {
+                const size_t id = tag - first_session_tag;
+                if (events[i].events & EPOLLOUT)
+                {
+                    flush(id);
+                }
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                {
+                    receive(id);
+                }
+            }
+        }
+
+        resume_held();
+        forward();
+        for (const size_t id : dirty_)
+        {
+            sessions_[id].dirty = false;
+            flush(id);
+        }
+        dirty_.clear();
+        for (const size_t id : closing_)
+        {
+            close_session(id);
+        }
+        closing_.clear();
+
+        resumable = false;
+        for (const size_t id : held_)
+        {
+            resumable = resumable || has_ack_room(sessions_[id]);
+        }
+    }
+
+    // what was read before the shutdown is still taken and acked
+    forward();
+    for (const size_t id : dirty_)
+    {
+        flush(id);
+    }
+    dirty_.clear();
+    for (size_t id = 0; id < sessions_.size(); ++id)
+    {
+        if (sessions_[id].fd >= 0)
+        {
+            close_session(id);
+        }
+    }
+    close_fd(listen_fd_);
+}
+
+void OrderGateway::run_ring()
+{
+    arm_accept();
+    ring_->prepare(IORING_OP_READ, wake_fd_, &wake_value_, sizeof(wake_value_), 0, user_data(wake_completion));
+    bool stopping = false;
+    bool resumable = false;
+    while (!stopping)
+    {
+        // what was prepared in the last pass goes with the wait for the next completions
+        ring_->submit(resumable ? 0 : 1);
+        ring_->complete([this, &stopping](const io_uring_cqe& cqe) { stopping = complete(cqe) || stopping; });
+
+        resume_held();
+        forward();
+        for (const size_t id : dirty_)
+        {
+            sessions_[id].dirty = false;
+            flush(id);
+        }
+        dirty_.clear();
+        for (const size_t id : closing_)
+        {
+            close_session(id);
+        }
+        closing_.clear();
+
+        // receives ended for want of buffers or while held start again once they can go on
+        std::swap(rearm_, rearming_);
+        for (const size_t id : rearming_)
+        {
+            Session& session = sessions_[id];
+            if (session.fd < 0 || session.receiving || session.eof || session.closing) continue;
+            if (session.held || received_buffers_ == received_next_.size())
+            {
+                rearm_.push_back(id);
+                continue;
+            }
+            arm_receive(id);
+        }
+        rearming_.clear();
+
+        resumable = false;
+        for (const size_t id : held_)
+        {
+            resumable = resumable || has_ack_room(sessions_[id]);
+        }
+    }
+
+    // what was read before the shutdown is still taken and acked, as far as the sockets take the acks
+    // without waiting
+    forward();
+    for (const size_t id : dirty_)
+    {
+        flush(id);
+    }
+    dirty_.clear();
+    do
+    {
+        ring_->submit();
+    }
+    while (ring_->complete([this](const io_uring_cqe& cqe)
+    {
+        if (cqe.user_data >> 56 == send_completion)
+        {
+            complete(cqe);
+        }
+        else if (cqe.flags & IORING_CQE_F_BUFFER)
+        {
+            ring_->recycle(static_cast<std::uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+        }
+    }) > 0);
+    for (size_t id = 0; id < sessions_.size(); ++id)
+    {
+        if (sessions_[id].fd >= 0)
+        {
+            close_session(id);
+        }
+    }
+    close_fd(listen_fd_);
+    stats_.system_calls += ring_->system_calls();
+}
+
+void OrderGateway::shut_down()
+{
+    const std::uint64_t one = 1;
+    [[maybe_unused]] const ssize_t written = ::write(wake_fd_, &one, sizeof(one));
+}
+
+int OrderGateway::port() const
+{
+    sockaddr_in address{};
+    socklen_t size = sizeof(address);
+    if (listen_fd_ < 0 || ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &size) != 0)
+    {
+        return options_.port;
+    }
+    return ntohs(address.sin_port);
+}
+
+void OrderGateway::accept_sessions()
+{
+    for (;;)
+    {
+        const int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        ++stats_.system_calls;
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                // e.g. out of file descriptors - the connection waits for the next one to come
+                std::cout << "Cannot accept gateway connection: " << std::strerror(errno) << "." << std::endl;
+            }
+            return;
+        }
+        open_session(fd);
+    }
+}
+
+bool OrderGateway::open_session(int fd)
+{
+    if (free_sessions_.empty() && sessions_.size() >= options_.max_sessions)
+    {
+        ::close(fd);
+        ++stats_.system_calls;
+        return false;
+    }
+
+    size_t id;
+    if (free_sessions_.empty())
+    {
+        id = sessions_.size();
+        sessions_.emplace_back();
+    }
+    else
+    {
+        id = free_sessions_.back();
+        free_sessions_.pop_back();
+    }
+    Session& session = sessions_[id];
+    if (!session.receive_buffer)
+    {
+        session.receive_buffer = std::make_unique<std::byte[]>(options_.receive_buffer_bytes);
+        session.send_buffer = std::make_unique<std::byte[]>(options_.send_buffer_bytes);
+    }
+    session.fd = fd;
+    ++stats_.sessions;
+
+    if (ring_)
+    {
+        arm_receive(id);
+        return true;
+    }
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.u64 = first_session_tag + id;
+    ++stats_.system_calls;
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0)
+    {
+        --stats_.sessions;
+        close_session(id);
+        return false;
+    }
+    return true;
+}
+
+void OrderGateway::receive(size_t id)
+{
+    Session& session = sessions_[id];
+    if (session.fd < 0 || session.held || session.closing) return;
+
+    std::byte* buffer = session.receive_buffer.get();
+    for (;;)
+    {
+        parse(id);
+        if (session.held || session.closing) return;
+
+        // the partial frame left over moves to the front
+        if (session.parsed > 0)
+        {
+            std::memmove(buffer, buffer + session.parsed, session.received - session.parsed);
+            session.received -= session.parsed;
+            session.parsed = 0;
+        }
+        const ssize_t n = ring_ ?
+            take_received(session, buffer + session.received, options_.receive_buffer_bytes - session.received) :
+            (++stats_.system_calls, ::recv(session.fd, buffer + session.received,
+                options_.receive_buffer_bytes - session.received, 0));
+        if (n > 0)
+        {
+            session.received += static_cast<size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        // closed by the client or broken - what it sent is still forwarded
+        drop(id);
+        return;
+    }
+}
+
+ssize_t OrderGateway::take_received(Session& session, std::byte* to, size_t size)
+{
+    if (session.received_head < 0)
+    {
+        if (session.eof) return 0;
+        errno = EAGAIN;
+        return -1;
+    }
+    const std::uint16_t buffer_id = static_cast<std::uint16_t>(session.received_head);
+    const size_t n = std::min<size_t>(size, received_length_[buffer_id] - received_offset_[buffer_id]);
+    std::memcpy(to, ring_->provided_buffer(buffer_id) + received_offset_[buffer_id], n);
+    received_offset_[buffer_id] += static_cast<std::uint32_t>(n);
+    if (received_offset_[buffer_id] == received_length_[buffer_id])
+    {
+        session.received_head = received_next_[buffer_id];
+        if (session.received_head < 0)
+        {
+            session.received_tail = -1;
+        }
+        ring_->recycle(buffer_id);
+        --received_buffers_;
+    }
+    return static_cast<ssize_t>(n);
+}
+
+void OrderGateway::resume_held()
+{
+    // sessions held for room in their send buffer read on once their acks went out
+    std::swap(held_, resuming_);
+    for (const size_t id : resuming_)
+    {
+        Session& session = sessions_[id];
+        if (!session.held || session.closing) continue;
+        if (!has_ack_room(session))
+        {
+            held_.push_back(id);
+            continue;
+        }
+        session.held = false;
+        receive(id);
+    }
+    resuming_.clear();
+}
+
+void OrderGateway::parse(size_t id)
+{
+    Session& session = sessions_[id];
+    while (session.received - session.parsed >= gateway_protocol::header_size)
+    {
+        const std::span<const std::byte> in(session.receive_buffer.get() + session.parsed,
+            session.received - session.parsed);
+        gateway_protocol::FrameHeader header;
+        gateway_protocol::decode_header(in, header);
+        const size_t frame_size = gateway_protocol::header_size + header.payload_size;
+        if (frame_size > options_.receive_buffer_bytes ||
+            (header.type != gateway_protocol::json_request && header.type != gateway_protocol::binary_request))
+        {
+            // framing is lost
+            std::cout << "Bad frame on gateway session " << id << ", closing it." << std::endl;
+            drop(id);
+            return;
+        }
+        if (in.size() < frame_size) return;
+        if (!has_ack_room(session))
+        {
+            session.held = true;
+            held_.push_back(id);
+            if (ring_ && session.receiving)
+            {
+                // buffers are not taken up by a session that does not read on
+                ring_->prepare(IORING_OP_ASYNC_CANCEL, -1,
+                    reinterpret_cast<const void*>(user_data(receive_completion, session.generation, id)), 0, 0,
+                    user_data(cancel_completion));
+            }
+            return;
+        }
+
+        const std::span<const std::byte> payload = in.subspan(gateway_protocol::header_size, header.payload_size);
+        Request& r = batch_.emplace_back();
+        const bool parsed = header.type == gateway_protocol::json_request ?
+            RequestParser::parse(std::string_view(reinterpret_cast<const char*>(payload.data()), payload.size()), r) :
+            binary_protocol::decode(payload, r) == payload.size();
+        PendingAck& pending = acks_.emplace_back();
+        pending.session = id;
+        pending.ack.sequence = ++session.sequence;
+        if (parsed)
+        {
+            pending.ack.order_id = r.order_id;
+        }
+        else
+        {
+            batch_.pop_back();
+            pending.ack.status = gateway_protocol::rejected;
+            ++stats_.rejected;
+        }
+        ++session.pending_acks;
+        session.parsed += frame_size;
+
+        if (batch_.size() >= options_.batch_size)
+        {
+            forward();
+        }
+    }
+}
+
+bool OrderGateway::has_ack_room(const Session& session) const
+{
+    // the bytes of a send in flight do not move
+    const size_t used = session.sending ? session.send_end : session.send_end - session.send_begin;
+    return used + (session.pending_acks + 1) * gateway_protocol::ack_frame_size <= options_.send_buffer_bytes;
+}
+
+void OrderGateway::forward()
+{
+    if (!batch_.empty())
+    {
+        exchange_.process_batch(std::span<const Request>(batch_), options_.conflate);
+        stats_.requests += batch_.size();
+        ++stats_.batches;
+        batch_.clear();
+    }
+    for (const auto& pending : acks_)
+    {
+        Session& session = sessions_[pending.session];
+        --session.pending_acks;
+        if (session.closing) continue;
+
+        std::byte* buffer = session.send_buffer.get();
+        if (session.send_end + gateway_protocol::ack_frame_size > options_.send_buffer_bytes && !session.sending)
+        {
+            std::memmove(buffer, buffer + session.send_begin, session.send_end - session.send_begin);
+            session.send_end -= session.send_begin;
+            session.send_begin = 0;
+        }
+        session.send_end += gateway_protocol::encode_ack(pending.ack,
+            std::span<std::byte>(buffer + session.send_end, options_.send_buffer_bytes - session.send_end));
+        if (!session.dirty)
+        {
+            session.dirty = true;
+            dirty_.push_back(pending.session);
+        }
+    }
+    acks_.clear();
+}
+
+void OrderGateway::flush(size_t id)
+{
+    Session& session = sessions_[id];
+    if (session.fd < 0 || session.closing) return;
+
+    if (ring_)
+    {
+        // the rest goes once the send in flight completes
+        if (session.sending || session.send_begin == session.send_end) return;
+        session.sending = true;
+        io_uring_sqe& sqe = ring_->prepare(IORING_OP_SEND, session.fd, session.send_buffer.get() + session.send_begin,
+            static_cast<unsigned>(session.send_end - session.send_begin), 0,
+            user_data(send_completion, session.generation, id));
+        sqe.msg_flags = MSG_NOSIGNAL;
+        return;
+    }
+    while (session.send_begin < session.send_end)
+    {
+        const ssize_t n = ::send(session.fd, session.send_buffer.get() + session.send_begin,
+            session.send_end - session.send_begin, MSG_NOSIGNAL);
+        ++stats_.system_calls;
+        if (n > 0)
+        {
+            session.send_begin += static_cast<size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        // the rest goes once the socket is writable again
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        drop(id);
+        return;
+    }
+    session.send_begin = 0;
+    session.send_end = 0;
+}
+
+void OrderGateway::drop(size_t id)
+{
+    Session& session = sessions_[id];
+    if (!session.closing)
+    {
+        session.closing = true;
+        closing_.push_back(id);
+    }
+}
+
+void OrderGateway::close_session(size_t id)
+{
+    // the buffers stay with the slot for the next connection
+    Session& session = sessions_[id];
+    if (ring_ && session.fd >= 0)
+    {
+        // operations in flight end with the connection, not with the descriptor
+        ::shutdown(session.fd, SHUT_RDWR);
+        ++stats_.system_calls;
+        while (session.received_head >= 0)
+        {
+            const std::uint16_t buffer_id = static_cast<std::uint16_t>(session.received_head);
+            session.received_head = received_next_[buffer_id];
+            ring_->recycle(buffer_id);
+            --received_buffers_;
+        }
+        session.received_tail = -1;
+        ++session.generation;
+        session.receiving = false;
+        session.sending = false;
+        session.eof = false;
+        if (accept_starved_)
+        {
+            accept_starved_ = false;
+            arm_accept();
+        }
+    }
+    if (session.fd >= 0)
+    {
+        ++stats_.system_calls;
+    }
+    close_fd(session.fd);
+    session.received = 0;
+    session.parsed = 0;
+    session.send_begin = 0;
+    session.send_end = 0;
+    session.pending_acks = 0;
+    session.sequence = 0;
+    session.held = false;
+    session.dirty = false;
+    session.closing = false;
+    free_sessions_.push_back(id);
+}
+
+void OrderGateway::arm_accept()
+{
+    io_uring_sqe& sqe = ring_->prepare(IORING_OP_ACCEPT, listen_fd_, nullptr, 0, 0, user_data(accept_completion));
+    sqe.ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe.accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+}
+
+void OrderGateway::arm_receive(size_t id)
+{
+    Session& session = sessions_[id];
+    session.receiving = true;
+    io_uring_sqe& sqe = ring_->prepare(IORING_OP_RECV, session.fd, nullptr, 0, 0,
+        user_data(receive_completion, session.generation, id));
+    sqe.ioprio = IORING_RECV_MULTISHOT;
+    sqe.flags = IOSQE_BUFFER_SELECT;
+    sqe.buf_group = 0;
+}
+
+bool OrderGateway::complete(const io_uring_cqe& cqe)
+{
+    const completion_kind kind = static_cast<completion_kind>(cqe.user_data >> 56);
+    const bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+    if (kind == wake_completion)
+    {
+        return true;
+    }
+    // a buffer that could not be recycled is lost to the receives
+    if (kind == cancel_completion || cqe.user_data == 0)
+    {
+        return false;
+    }
+    if (kind == accept_completion)
+    {
+        if (cqe.res >= 0)
+        {
+            open_session(cqe.res);
+        }
+        else if (cqe.res != -ECONNABORTED && cqe.res != -EINTR)
+        {
+            std::cout << "Cannot accept gateway connection: " << std::strerror(-cqe.res) << "." << std::endl;
+        }
+        if (!more)
+        {
+            if (cqe.res == -EMFILE || cqe.res == -ENFILE)
+            {
+                accept_starved_ = true;
+            }
+            else
+            {
+                arm_accept();
+            }
+        }
+        return false;
+    }
+
+    const size_t id = static_cast<std::uint32_t>(cqe.user_data);
+    Session& session = sessions_[id];
+    const bool stale = session.fd < 0 || ((cqe.user_data >> 32) & 0xffffff) != (session.generation & 0xffffff);
+    if (kind == send_completion)
+    {
+        if (stale) return false;
+        session.sending = false;
+        if (cqe.res <= 0)
+        {
+            drop(id);
+            return false;
+        }
+        session.send_begin += static_cast<size_t>(cqe.res);
+        if (session.send_begin == session.send_end)
+        {
+            session.send_begin = 0;
+            session.send_end = 0;
+        }
+        flush(id);
+        return false;
+    }
+
+    // a receive
+    if (cqe.flags & IORING_CQE_F_BUFFER)
+    {
+        const std::uint16_t buffer_id = static_cast<std::uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        if (stale || cqe.res <= 0)
+        {
+            ring_->recycle(buffer_id);
+        }
+        else
+        {
+            received_length_[buffer_id] = static_cast<std::uint32_t>(cqe.res);
+            received_offset_[buffer_id] = 0;
+            received_next_[buffer_id] = -1;
+            if (session.received_tail >= 0)
+            {
+                received_next_[session.received_tail] = buffer_id;
+            }
+            else
+            {
+                session.received_head = buffer_id;
+            }
+            session.received_tail = buffer_id;
+            ++received_buffers_;
+        }
+    }
+    if (stale) return false;
+    if (!more)
+    {
+        session.receiving = false;
+        if (cqe.res == -ENOBUFS || cqe.res == -ECANCELED || cqe.res > 0)
+        {
+            rearm_.push_back(id);
+        }
+        else
+        {
+            // closed by the client or broken - what it sent is still forwarded
+            session.eof = true;
+        }
+    }
+    receive(id);
+    return false;
+}
+
+} // namespace exchange
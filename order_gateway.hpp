@@ -0,0 +1,192 @@
+#ifndef ORDER_GATEWAY_HPP_
+#define ORDER_GATEWAY_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+#include "exchange.hpp"
+#include "gateway_protocol.hpp"
+#include "io_ring.hpp"
+#include "request.hpp"
+
+namespace exchange
+{
+
+class OrderGateway;
+typedef std::unique_ptr<OrderGateway> OrderGatewayPtr;
+typedef std::unique_ptr<const OrderGateway> OrderGatewayCPtr;
+
+struct GatewayOptions
+{
+    // loopback unless configured otherwise
+    std::string address = "127.0.0.1";
+    int port = 9001;
+    // connections open at once, more are closed as they come
+    size_t max_sessions = 16384;
+    // partial frames held per connection, a frame larger than this closes it
+    size_t receive_buffer_bytes = 16384;
+    // acks held for a connection that does not read them - it is not read from while they fill this
+    size_t send_buffer_bytes = 16384;
+    // requests forwarded to the exchange as one batch at most
+    size_t batch_size = 256;
+    // collapse the depth updates of a batch - see Exchange::process_batch
+    bool conflate = false;
+};
+
+template <typename BasicJsonType>
+void from_json(const BasicJsonType& j, GatewayOptions& o)
+{
+    const GatewayOptions defaults;
+    o.address = j.value("address", defaults.address);
+    o.port = j.value("port", defaults.port);
+    o.max_sessions = j.value("max_sessions", defaults.max_sessions);
+    o.receive_buffer_bytes = j.value("receive_buffer_bytes", defaults.receive_buffer_bytes);
+    o.send_buffer_bytes = j.value("send_buffer_bytes", defaults.send_buffer_bytes);
+    o.batch_size = j.value("batch_size", defaults.batch_size);
+    o.conflate = j.value("conflate", defaults.conflate);
+}
+
+struct GatewayStats
+{
+    size_t sessions = 0;
+    size_t requests = 0;
+    size_t rejected = 0;
+    size_t batches = 0;
+    // made by the gateway loop, a ring submission counting once however many operations it takes
+    size_t system_calls = 0;
+};
+
+// TCP order entry gateway in front of an exchange, on the calling thread: non-blocking sockets on
+// one edge-triggered epoll loop. Every connection is a session framed by gateway_protocol, with its
+// receive and send buffers allocated once per session slot and reused by later connections. The
+// requests read in one pass over the ready connections go to the exchange as batches of up to
+// batch_size, then every request is acked on its connection.
+//
+// With io_uring the loop is one submission per pass instead: connections come from a multishot
+// accept, their bytes from a multishot receive into buffers the ring picks from a pool it shares with
+// the gateway, and acks go out as one send in flight per session.
+class OrderGateway
+{
+public:
+    // listens on the configured address right away
+    OrderGateway(Exchange& exchange, const GatewayOptions& options,
+        const utils::IoOptions& io_options = utils::IoOptions());
+    ~OrderGateway();
+
+    OrderGateway(const OrderGateway&) = delete;
+    OrderGateway& operator=(const OrderGateway&) = delete;
+
+    // Serves connections until shut down, then forwards what was read and acks it as far as the
+    // connections take the acks.
+    void run();
+    // safe from another thread or a signal handler
+    void shut_down();
+
+    // the port listened on, the one the system picked if configured as 0
+    int port() const;
+    const GatewayStats& stats() const { return stats_; }
+    bool uses_io_uring() const { return ring_ != nullptr; }
+
+private:
+    struct Session
+    {
+        int fd = -1;
+        std::unique_ptr<std::byte[]> receive_buffer;
+        // bytes read, of which the frames before parsed are done with
+        size_t received = 0;
+        size_t parsed = 0;
+        std::unique_ptr<std::byte[]> send_buffer;
+        size_t send_begin = 0;
+        size_t send_end = 0;
+        // requests read and not acked yet, their acks have room in the send buffer
+        size_t pending_acks = 0;
+        // sequence number of the last request read
+        std::uint64_t sequence = 0;
+        // waiting for room in the send buffer to read on
+        bool held = false;
+        bool dirty = false;
+        bool closing = false;
+
+        // io_uring only - completions of an earlier connection in the slot carry an older generation
+        std::uint32_t generation = 0;
+        bool receiving = false;
+        bool sending = false;
+        // closed by the client, once the bytes received are taken
+        bool eof = false;
+        // provided buffers received and not taken yet, oldest first
+        int received_head = -1;
+        int received_tail = -1;
+    };
+
+    // ack of a request of the current batch
+    struct PendingAck
+    {
+        size_t session;
+        gateway_protocol::Ack ack;
+    };
+
+    void run_epoll();
+    void run_ring();
+    void accept_sessions();
+    // a slot for a connection accepted, false if there is none
+    bool open_session(int fd);
+    // reads and parses until the socket is drained, the session is held or it closes
+    void receive(size_t id);
+    // like recv, from the provided buffers received for the session
+    ssize_t take_received(Session& session, std::byte* to, size_t size);
+    // held sessions with room for their acks again read on
+    void resume_held();
+    // the complete frames read so far
+    void parse(size_t id);
+    bool has_ack_room(const Session& session) const;
+    // the batch to the exchange and its acks to the send buffers
+    void forward();
+    // sends the acks in the send buffer as far as the socket takes them
+    void flush(size_t id);
+    // closed once the requests it sent are forwarded
+    void drop(size_t id);
+    void close_session(size_t id);
+
+    void arm_accept();
+    void arm_receive(size_t id);
+    // handles a completion, true once shut down
+    bool complete(const io_uring_cqe& cqe);
+
+    Exchange& exchange_;
+    GatewayOptions options_;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    // written by shut_down
+    int wake_fd_ = -1;
+    std::vector<Session> sessions_;
+    std::vector<size_t> free_sessions_;
+    // sessions with acks to send, held or closing, each once
+    std::vector<size_t> dirty_;
+    std::vector<size_t> held_;
+    std::vector<size_t> resuming_;
+    std::vector<size_t> closing_;
+    std::vector<Request> batch_;
+    std::vector<PendingAck> acks_;
+    GatewayStats stats_;
+
+    utils::IoRingPtr ring_;
+    // provided buffers received and not taken yet are chained by buffer id
+    std::vector<int> received_next_;
+    std::vector<std::uint32_t> received_length_;
+    std::vector<std::uint32_t> received_offset_;
+    size_t received_buffers_ = 0;
+    // sessions whose multishot receive ended while they could not read on
+    std::vector<size_t> rearm_;
+    std::vector<size_t> rearming_;
+    // out of file descriptors - accepting again once a session closes
+    bool accept_starved_ = false;
+    std::uint64_t wake_value_ = 0;
+};
+
+} // namespace exchange
+
+#endif
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include "order_index.hpp"
+
+namespace order
+{
+
+bool OrderIndex::grow_dense(int order_id)
+{
+    if (order_id < 0) return false;
+
+    const size_t required_size = static_cast<size_t>(order_id) + 1;
+    // only grow for ids close to the ones already seen, so a single huge id cannot blow up the table
+    const size_t new_size = std::max(required_size, std::max(dense_.size() * 2, size_t(1024)));
+    if (required_size > std::max(dense_.size() * 2, size_t(1024)) || new_size > max_dense_size)
+    {
+        return false;
+    }
+
+    dense_.resize(new_size);
+    // move sparse entries now covered by the dense table
+    for (auto it = sparse_.begin(); it != sparse_.end();)
+    {
+        if (it->first >= 0 && static_cast<size_t>(it->first) < dense_.size())
+        {
+            dense_[it->first] = it->second;
+            it = sparse_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    return true;
+}
+
+void OrderIndex::insert(int order_id, const OrderLocation& location)
+{
+    if (order_id >= 0 && (static_cast<size_t>(order_id) < dense_.size() || grow_dense(order_id)))
+    {
+        OrderLocation& slot = dense_[order_id];
+        if (!slot.valid()) ++size_;
+        slot = location;
+        return;
+    }
+
+    const auto inserted = sparse_.insert_or_assign(order_id, location);
+    if (inserted.second) ++size_;
+}
+
+void OrderIndex::erase(int order_id)
+{
+    if (order_id >= 0 && static_cast<size_t>(order_id) < dense_.size())
+    {
+        OrderLocation& slot = dense_[order_id];
+        if (slot.valid()) --size_;
+        slot = OrderLocation();
+        return;
+    }
+    size_ -= sparse_.erase(order_id);
+}
+
+void OrderIndex::clear()
+{
+    std::fill(dense_.begin(), dense_.end(), OrderLocation());
+    sparse_.clear();
+    size_ = 0;
+}
+
+} // namespace order
@@ -0,0 +1,76 @@
+#ifndef ORDER_INDEX_H_
+#define ORDER_INDEX_H_
+
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace order
+{
+
+// where a resting order lives
+struct OrderLocation
+{
+    static const std::uint32_t no_book = std::numeric_limits<std::uint32_t>::max();
+
+    std::uint32_t book = no_book;
+
+    bool valid() const { return book != no_book; }
+};
+
+// Order id -> location of every resting order. Ids handed out sequentially are stored in a flat
+// vector indexed by id; anything far outside the dense range falls back to a hash map.
+class OrderIndex
+{
+public:
+    // upper bound on the dense table, 4 bytes per slot
+    static const size_t max_dense_size = size_t(1) << 28;
+
+    OrderIndex() = default;
+
+    const OrderLocation* find(int order_id) const;
+    void insert(int order_id, const OrderLocation& location);
+    void erase(int order_id);
+    void clear();
+
+    size_t size() const { return size_; }
+
+    // visit every (order id, location)
+    template <typename F>
+    void for_each(F f) const;
+
+private:
+    bool grow_dense(int order_id);
+
+    std::vector<OrderLocation> dense_;
+    std::unordered_map<int, OrderLocation> sparse_;
+    size_t size_ = 0;
+};
+
+inline const OrderLocation* OrderIndex::find(int order_id) const
+{
+    if (order_id >= 0 && static_cast<size_t>(order_id) < dense_.size())
+    {
+        const OrderLocation& location = dense_[order_id];
+        return location.valid() ? &location : nullptr;
+    }
+    if (sparse_.empty()) return nullptr;
+
+    const auto found = sparse_.find(order_id);
+    return found == sparse_.end() ? nullptr : &found->second;
+}
+
+template <typename F>
+void OrderIndex::for_each(F f) const
+{
+    for (size_t order_id = 0; order_id < dense_.size(); ++order_id)
+    {
+        if (dense_[order_id].valid()) f(static_cast<int>(order_id), dense_[order_id]);
+    }
+    for (const auto& kv : sparse_) f(kv.first, kv.second);
+}
+
+} // namespace order
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef ORDER_RECORD_
+#define ORDER_RECORD_
+
+#include <cstdint>
+
+#include "book_snapshot.hpp"
+#include "order.hpp"
+#include "price4.hpp"
+#include "slab_pool.hpp"
+
+namespace order
+{
+
+enum order_part : std::uint8_t
+{
+    displayed_part,
+    // hidden part of an iceberg order
+    hidden_part
+};
+
+// The state of one resting order, kept once per book: the id index, the book's queues and its price
+// levels all name the record by pool handle. Both parts of an iceberg order live in the same record,
+// so a fill reads and writes a single cache line.
+struct OrderRecord
+{
+    typedef std::uint32_t Handle;
+
+    static constexpr std::uint8_t part_flag(order_part part) { return std::uint8_t(1) << part; }
+
+    bool has_part(order_part part) const { return (parts & part_flag(part)) != 0; }
+    bool has_displayed() const { return has_part(displayed_part); }
+    bool has_hidden() const { return has_part(hidden_part); }
+    bool has_parts() const { return parts != 0; }
+    void add_part(order_part part) { parts |= part_flag(part); }
+    void remove_part(order_part part) { parts &= ~part_flag(part); }
+
+    utils::Price4 price;
+    int order_id;
+    // the displayed part of a replenished iceberg order queues again with its own time
+    int time;
+    int displayed_time;
+    // remaining quantity of each part
+    int quantity[2];
+    // unique per order inserted into the book - tells apart orders that reused a freed record
+    std::uint32_t sequence;
+    // links of each part in its price level queue, level books only
+    Handle prev[2];
+    Handle next[2];
+    time_in_force tif;
+    // part_flag bits of the parts resting in the book
+    std::uint8_t parts;
+};
+
+static_assert(sizeof(OrderRecord) <= 64, "An order record fits in one cache line.");
+
+typedef utils::SlabPool<OrderRecord> OrderRecordPool;
+typedef OrderRecord::Handle OrderRecordHandle;
+
+// new record of the order with no parts resting yet
+inline OrderRecordHandle create_record(OrderRecordPool& pool, const LimitOrder& o, std::uint32_t sequence)
+{
+    const OrderRecordHandle handle = pool.allocate();
+    OrderRecord& record = pool[handle];
+    record.price = o.limit_price();
+    record.order_id = o.order_id();
+    record.time = o.time();
+    record.displayed_time = o.time();
+    record.sequence = sequence;
+    record.tif = o.tif();
+    record.prev[displayed_part] = record.next[displayed_part] = OrderRecordPool::null_handle;
+    record.prev[hidden_part] = record.next[hidden_part] = OrderRecordPool::null_handle;
+    return handle;
+}
+
+// same for an order restored from a snapshot
+inline OrderRecordHandle create_record(OrderRecordPool& pool, const RestingOrder& o, std::uint32_t sequence)
+{
+    const OrderRecordHandle handle = pool.allocate();
+    OrderRecord& record = pool[handle];
+    record.price = utils::Price4(o.price);
+    record.order_id = o.order_id;
+    record.time = o.time;
+    record.displayed_time = o.displayed_time;
+    record.sequence = sequence;
+    record.tif = static_cast<time_in_force>(o.tif);
+    record.prev[displayed_part] = record.next[displayed_part] = OrderRecordPool::null_handle;
+    record.prev[hidden_part] = record.next[hidden_part] = OrderRecordPool::null_handle;
+    return handle;
+}
+
+} // namespace order
+
+#endif
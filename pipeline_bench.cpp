@@ -0,0 +1,168 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <string>
+#include <vector>
+#include "book_rules.hpp"
+#include "market_data_publisher.hpp"
+#include "matching_engine.hpp"
+#include "pipelined_engine.hpp"
+#include "serialise.hpp"
+#include "size_rules.hpp"
+#include "ticker_rules.hpp"
+
+// Throughput of json requests through the matching engine on the calling thread against the pipelined
+// engine, publishing json market data to /dev/null, and where the pipeline spends its time per stage.
+// usage: pipeline_bench [number_of_requests] [parsers] [serialisers] [batch_size] [seed]
+
+namespace
+{
+
+using json = nlohmann::json;
+
+const std::vector<std::string> symbols{"AAPL", "IBM", "MSFT", "TSLA", "GOOG"};
+
+// resting orders a few ticks around the mid, most cancelled, some crossing the spread
+std::vector<std::string> create_requests(size_t number_of_requests, unsigned int seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::geometric_distribution<int> distance_from_touch(0.35);
+    std::uniform_int_distribution<int> lots(1, 10);
+    std::uniform_int_distribution<size_t> symbol(0, symbols.size() - 1);
+
+    std::vector<std::string> requests;
+    requests.reserve(number_of_requests);
+    std::vector<int> live;
+    const int mid = 10000; // 100.00
+    int time = 1625787615;
+    for (int order_id = 0; requests.size() < number_of_requests; ++order_id)
+    {
+        if (order_id % 100 == 0) ++time;
+        const double r = uniform(gen);
+        if (r < 0.45 && !live.empty())
+        {
+            const size_t idx = static_cast<size_t>(uniform(gen) * live.size());
+            requests.push_back("{\"time\": " + std::to_string(time) + ", \"type\": \"CANCEL\", \"order_id\": " +
+                std::to_string(live[idx]) + "}");
+            live[idx] = live.back();
+            live.pop_back();
+            continue;
+        }
+
+        const bool buy = uniform(gen) < 0.5;
+        const bool aggressive = r > 0.95;
+        const int offset = aggressive ? -2 : distance_from_touch(gen) + 1;
+        const int cents = buy ? mid - offset : mid + offset;
+        const std::string price = std::to_string(cents / 100) + "." + (cents % 100 < 10 ? "0" : "") +
+            std::to_string(cents % 100);
+        requests.push_back("{\"time\": " + std::to_string(time) + ", \"type\": \"NEW\", \"order_id\": " +
+            std::to_string(order_id) + ", \"symbol\": \"" + symbols[symbol(gen)] + "\", \"side\": \"" +
+            (buy ? "buy" : "sell") + "\", \"quantity\": " + std::to_string(100 * lots(gen)) +
+            ", \"limit_price\": \"" + price + "\", \"tif\": \"day\"}");
+        if (!aggressive) live.push_back(order_id);
+    }
+    return requests;
+}
+
+struct Rules
+{
+    size_rules::TickSizeRulesCPtr tick_size;
+    size_rules::LotSizeRulesCPtr lot_size;
+    ticker_rules::TickerRulesCPtr tickers;
+    book_rules::BookRulesCPtr books;
+};
+
+Rules create_rules()
+{
+    const json j = json::parse(R"({
+        "lot_size": [{"from_price": "1", "lot_size": "100"}],
+        "tick_size": [{"from_price": "0", "to_price": "1", "tick_size": "0.0001"}, {"from_price": "1", "tick_size": "0.01"}],
+        "order_books": {"default": "price_level"}
+    })");
+    Rules rules;
+    rules.lot_size = j.at("lot_size").get<size_rules::LotSizeRulesCPtr>();
+    rules.tick_size = j.at("tick_size").get<size_rules::TickSizeRulesCPtr>();
+    rules.books = j.at("order_books").get<book_rules::BookRulesCPtr>();
+    rules.tickers = std::make_shared<const ticker_rules::TickerRules>(symbols);
+    return rules;
+}
+
+void report(const std::string& name, size_t number_of_requests, double ns)
+{
+    std::cout << std::left << std::setw(22) << name
+        << std::right << std::setw(12) << std::fixed << std::setprecision(1) << ns / number_of_requests
+        << std::setw(14) << std::setprecision(0) << number_of_requests / ns * 1e9
+        << "\n";
+}
+
+void report(const std::string& name, const exchange::StageLatency& latency)
+{
+    const double batches = latency.batches ? static_cast<double>(latency.batches) : 1.0;
+    const double requests = latency.requests ? static_cast<double>(latency.requests) : 1.0;
+    std::cout << std::left << std::setw(12) << name
+        << std::right << std::setw(10) << latency.batches
+        << std::setw(14) << std::fixed << std::setprecision(1) << latency.queued.count() / batches / 1000
+        << std::setw(14) << latency.max_queued.count() / 1000.0
+        << std::setw(14) << latency.busy.count() / requests
+        << std::setw(14) << latency.max_busy.count() / 1000.0
+        << "\n";
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    const size_t number_of_requests = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    exchange::PipelineOptions options;
+    options.parsers = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2;
+    options.serialisers = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 2;
+    options.batch_size = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : options.batch_size;
+    const unsigned int seed = argc > 5 ? std::strtoul(argv[5], nullptr, 10) : 42;
+
+    const Rules rules = create_rules();
+    const auto requests = create_requests(number_of_requests, seed);
+
+    std::cout << number_of_requests << " requests, " << options.parsers << " parsers, " << options.serialisers
+        << " serialisers, batch size " << options.batch_size << ", seed " << seed << "\n";
+    std::cout << std::left << std::setw(22) << "engine" << std::right << std::setw(12) << "ns/req"
+        << std::setw(14) << "req/s" << "\n";
+    {
+        exchange::MarketDataPublisher publisher("/dev/null", exchange::PublisherOptions(), rules.tickers);
+        exchange::MatchingEngine engine(rules.tick_size, rules.lot_size, rules.tickers, rules.books);
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto& r : requests)
+        {
+            publisher.publish(engine.process_order(r));
+        }
+        publisher.sync();
+        const auto end = std::chrono::steady_clock::now();
+        report("single thread", number_of_requests, std::chrono::duration<double, std::nano>(end - start).count());
+    }
+
+    exchange::MarketDataPublisher publisher("/dev/null", exchange::PublisherOptions(), rules.tickers);
+    exchange::PipelinedEngine engine(rules.tick_size, rules.lot_size, rules.tickers, rules.books,
+        utils::PoolOptions(), options, publisher);
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto& r : requests)
+    {
+        engine.process_order(r);
+    }
+    engine.drain();
+    publisher.sync();
+    const auto end = std::chrono::steady_clock::now();
+    report("pipeline", number_of_requests, std::chrono::duration<double, std::nano>(end - start).count());
+
+    // queued per batch, busy per request
+    std::cout << "\n" << std::left << std::setw(12) << "stage" << std::right << std::setw(10) << "batches"
+        << std::setw(14) << "queued us" << std::setw(14) << "max queued us" << std::setw(14) << "busy ns/req"
+        << std::setw(14) << "max busy us" << "\n";
+    report("parse", engine.latency(exchange::parse_stage));
+    report("match", engine.latency(exchange::match_stage));
+    report("serialise", engine.latency(exchange::serialise_stage));
+    return 0;
+}
@@ -0,0 +1,359 @@
+#include <algorithm>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include "pipelined_engine.hpp"
+
+namespace exchange
+{
+
+void StageLatency::add(
+    size_t number_of_requests, std::chrono::nanoseconds batch_queued, std::chrono::nanoseconds batch_busy
+)
+{
+    ++batches;
+    requests += number_of_requests;
+    queued += batch_queued;
+    max_queued = std::max(max_queued, batch_queued);
+    busy += batch_busy;
+    max_busy = std::max(max_busy, batch_busy);
+}
+
+StageLatency& StageLatency::operator+=(const StageLatency& other)
+{
+    batches += other.batches;
+    requests += other.requests;
+    queued += other.queued;
+    max_queued = std::max(max_queued, other.max_queued);
+    busy += other.busy;
+    max_busy = std::max(max_busy, other.max_busy);
+    return *this;
+}
+
+PipelinedEngine::Parser::Parser(size_t queue_capacity)
+:
+requests(queue_capacity),
+parsed(queue_capacity),
+free_batches(queue_capacity)
+{
+}
+
+PipelinedEngine::Serialiser::Serialiser(size_t queue_capacity)
+:
+events(queue_capacity),
+free_batches(queue_capacity)
+{
+}
+
+PipelinedEngine::PipelinedEngine(
+    const size_rules::TickSizeRulesCPtr& ticker_size_rules,
+    const size_rules::LotSizeRulesCPtr& lot_size_rules,
+    const ticker_rules::TickerRulesCPtr& ticker_rules,
+    const book_rules::BookRulesCPtr& book_rules,
+    const utils::PoolOptions& pool_options,
+    const PipelineOptions& options,
+    MarketDataPublisher& market_data_publisher
+)
+:
+validator_(ticker_size_rules, lot_size_rules, ticker_rules),
+options_(options),
+engine_(ticker_size_rules, lot_size_rules, ticker_rules, book_rules, pool_options),
+market_data_publisher_(market_data_publisher)
+{
+    if (options_.parsers == 0 || options_.serialisers == 0 || !ticker_rules)
+    {
+        throw std::runtime_error("Pipeline needs parser and serialiser threads and listed symbols.");
+    }
+    options_.batch_size = std::max<size_t>(options_.batch_size, 1);
+
+    for (size_t i = 0; i < options_.parsers; ++i)
+    {
+        parsers_.push_back(std::make_unique<Parser>(options_.queue_capacity));
+    }
+    for (size_t i = 0; i < options_.serialisers; ++i)
+    {
+        serialisers_.push_back(std::make_unique<Serialiser>(options_.queue_capacity));
+    }
+    for (auto& parser : parsers_)
+    {
+        parser->thread = std::thread(&PipelinedEngine::parse_loop, this, std::ref(*parser));
+    }
+    for (size_t i = 0; i < serialisers_.size(); ++i)
+    {
+        serialisers_[i]->thread = std::thread(&PipelinedEngine::serialise_loop, this, i);
+    }
+    matcher_ = std::thread(&PipelinedEngine::match_loop, this);
+}
+
+PipelinedEngine::~PipelinedEngine()
+{
+    drain();
+    stopping_.store(true, std::memory_order_release);
+    for (auto& parser : parsers_)
+    {
+        parser->number_of_requests.fetch_add(1, std::memory_order_release);
+        parser->number_of_requests.notify_one();
+        parser->number_of_parsed.fetch_add(1, std::memory_order_release);
+        parser->number_of_parsed.notify_one();
+        parser->thread.join();
+    }
+    matcher_.join();
+    for (auto& serialiser : serialisers_)
+    {
+        serialiser->number_of_events.fetch_add(1, std::memory_order_release);
+        serialiser->number_of_events.notify_one();
+        serialiser->thread.join();
+    }
+}
+
+PipelinedEngine::RequestBatch& PipelinedEngine::next_slot()
+{
+    if (batch_.requests.size() == batch_.size)
+    {
+        batch_.texts.resize(options_.batch_size);
+        batch_.decoded.resize(options_.batch_size);
+        batch_.requests.resize(options_.batch_size);
+    }
+    return batch_;
+}
+
+void PipelinedEngine::process_order(std::string_view s)
+{
+    RequestBatch& batch = next_slot();
+    // the text buffer is reused, so steady state batching does not allocate
+    batch.texts[batch.size].assign(s);
+    batch.decoded[batch.size] = false;
+    if (++batch.size == options_.batch_size)
+    {
+        hand_off();
+    }
+}
+
+void PipelinedEngine::process_order(const Request& r)
+{
+    RequestBatch& batch = next_slot();
+    batch.requests[batch.size] = r;
+    batch.decoded[batch.size] = true;
+    if (++batch.size == options_.batch_size)
+    {
+        hand_off();
+    }
+}
+
+void PipelinedEngine::hand_off()
+{
+    if (batch_.size == 0) return;
+
+    Parser& parser = *parsers_[next_parser_];
+    batch_.handed_off = std::chrono::steady_clock::now();
+    // back pressure - requests are never dropped
+    while (!parser.requests.try_push(std::move(batch_)))
+    {
+        std::this_thread::yield();
+    }
+    parser.number_of_requests.fetch_add(1, std::memory_order_release);
+    parser.number_of_requests.notify_one();
+    ++number_of_handed_off_;
+
+    // the matcher takes batches back in the same order
+    next_parser_ = (next_parser_ + 1) % parsers_.size();
+    if (!parsers_[next_parser_]->free_batches.try_pop(batch_))
+    {
+        batch_ = RequestBatch();
+    }
+    batch_.size = 0;
+}
+
+void PipelinedEngine::drain()
+{
+    hand_off();
+    size_t published = number_of_published_.load(std::memory_order_acquire);
+    while (published != number_of_handed_off_)
+    {
+        number_of_published_.wait(published, std::memory_order_acquire);
+        published = number_of_published_.load(std::memory_order_acquire);
+    }
+}
+
+void PipelinedEngine::prev_open_setup(const std::string& close_order_cache_file)
+{
+    // pipeline threads are idle until the next batch is handed off
+    drain();
+    market_data_publisher_.publish(engine_.prev_open_setup(close_order_cache_file));
+}
+
+void PipelinedEngine::eod_cleanup(const std::string& close_order_cache_file)
+{
+    drain();
+    engine_.eod_cleanup(close_order_cache_file);
+}
+
+StageLatency PipelinedEngine::latency(pipeline_stage stage) const
+{
+    StageLatency total;
+    switch (stage)
+    {
+    case parse_stage:
+        for (const auto& parser : parsers_) total += parser->latency;
+        break;
+
+    case match_stage:
+        total = match_latency_;
+        break;
+
+    case serialise_stage:
+        for (const auto& serialiser : serialisers_) total += serialiser->latency;
+        break;
+    }
+    return total;
+}
+
+void PipelinedEngine::parse(RequestBatch& batch) const
+{
+    for (size_t i = 0; i < batch.size; ++i)
+    {
+        Request& r = batch.requests[i];
+        if (!batch.decoded[i] && !RequestParser::parse(batch.texts[i], r))
+        {
+            std::cout << "Cannot parse request: " << batch.texts[i] << std::endl;
+            r.type = unknown_request;
+            continue;
+        }
+        if (r.type != new_request && r.type != modify_request) continue;
+
+        // the matcher only sees listed symbols with valid prices and round lots
+        const int symbol_id = validator_.resolve_symbol_id(r);
+        if (validator_.validate(r, symbol_id))
+        {
+            r.symbol_id = symbol_id;
+        }
+        else
+        {
+            r.type = unknown_request;
+        }
+    }
+}
+
+void PipelinedEngine::parse_loop(Parser& parser)
+{
+    RequestBatch batch;
+    while (true)
+    {
+        const size_t pushed = parser.number_of_requests.load(std::memory_order_acquire);
+        if (!parser.requests.try_pop(batch))
+        {
+            if (stopping_.load(std::memory_order_acquire)) break;
+            parser.number_of_requests.wait(pushed, std::memory_order_acquire);
+            continue;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        parse(batch);
+        const auto end = std::chrono::steady_clock::now();
+        parser.latency.add(batch.size, start - batch.handed_off, end - start);
+
+        batch.handed_off = end;
+        while (!parser.parsed.try_push(std::move(batch)))
+        {
+            std::this_thread::yield();
+        }
+        parser.number_of_parsed.fetch_add(1, std::memory_order_release);
+        parser.number_of_parsed.notify_one();
+    }
+}
+
+void PipelinedEngine::match_loop()
+{
+    RequestBatch batch;
+    EventBatch events;
+    size_t batch_number = 0;
+    while (true)
+    {
+        Parser& parser = *parsers_[batch_number % parsers_.size()];
+        const size_t parsed = parser.number_of_parsed.load(std::memory_order_acquire);
+        if (!parser.parsed.try_pop(batch))
+        {
+            if (stopping_.load(std::memory_order_acquire)) break;
+            parser.number_of_parsed.wait(parsed, std::memory_order_acquire);
+            continue;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        Serialiser& serialiser = *serialisers_[batch_number % serialisers_.size()];
+        if (!serialiser.free_batches.try_pop(events))
+        {
+            events = EventBatch();
+        }
+        size_t events_in_batch = 0;
+        for (size_t i = 0; i < batch.size; ++i)
+        {
+            const auto& arena = engine_.process_validated_order(batch.requests[i]);
+            const auto records = arena.records();
+            events.records.insert(events.records.end(), records.begin(), records.end());
+            events_in_batch += arena.number_of_events();
+        }
+        events.number_of_requests = batch.size;
+        events.sequence = market_data_publisher_.take_sequences(events_in_batch);
+
+        const auto end = std::chrono::steady_clock::now();
+        match_latency_.add(batch.size, start - batch.handed_off, end - start);
+        // back to the calling thread for reuse - dropped if the free queue is full
+        parser.free_batches.try_push(std::move(batch));
+
+        events.handed_off = end;
+        while (!serialiser.events.try_push(std::move(events)))
+        {
+            std::this_thread::yield();
+        }
+        serialiser.number_of_events.fetch_add(1, std::memory_order_release);
+        serialiser.number_of_events.notify_one();
+        ++batch_number;
+    }
+}
+
+void PipelinedEngine::serialise_loop(size_t index)
+{
+    Serialiser& serialiser = *serialisers_[index];
+    EventBatch events;
+    std::string encoded;
+    // the matcher deals batches round robin
+    size_t batch_number = index;
+    while (true)
+    {
+        const size_t pushed = serialiser.number_of_events.load(std::memory_order_acquire);
+        if (!serialiser.events.try_pop(events))
+        {
+            if (stopping_.load(std::memory_order_acquire)) break;
+            serialiser.number_of_events.wait(pushed, std::memory_order_acquire);
+            continue;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        encoded.clear();
+        market_data_publisher_.encode(events.records, events.sequence, encoded);
+
+        const auto encoded_at = std::chrono::steady_clock::now();
+
+        // wait for the batches before this one to be published - not counted as busy
+        size_t published = number_of_published_.load(std::memory_order_acquire);
+        while (published != batch_number)
+        {
+            number_of_published_.wait(published, std::memory_order_acquire);
+            published = number_of_published_.load(std::memory_order_acquire);
+        }
+        const auto turn_at = std::chrono::steady_clock::now();
+        market_data_publisher_.publish_encoded(encoded);
+        serialiser.latency.add(events.number_of_requests, start - events.handed_off,
+            (encoded_at - start) + (std::chrono::steady_clock::now() - turn_at));
+
+        events.records.clear();
+        // back to the matcher for reuse - dropped if the free queue is full
+        serialiser.free_batches.try_push(std::move(events));
+        batch_number += serialisers_.size();
+
+        number_of_published_.fetch_add(1, std::memory_order_release);
+        number_of_published_.notify_all();
+    }
+}
+
+} // namespace exchange
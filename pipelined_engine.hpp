@@ -0,0 +1,196 @@
+#ifndef PIPELINED_ENGINE_HPP_
+#define PIPELINED_ENGINE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "book_rules.hpp"
+#include "event_arena.hpp"
+#include "market_data_publisher.hpp"
+#include "matching_engine.hpp"
+#include "request.hpp"
+#include "request_validator.hpp"
+#include "size_rules.hpp"
+#include "slab_pool.hpp"
+#include "spsc_queue.hpp"
+#include "ticker_rules.hpp"
+
+namespace exchange
+{
+
+class PipelinedEngine;
+typedef std::unique_ptr<PipelinedEngine> PipelinedEnginePtr;
+typedef std::unique_ptr<const PipelinedEngine> PipelinedEngineCPtr;
+
+struct PipelineOptions
+{
+    // parse and validate threads - 0 runs every stage on the calling thread
+    size_t parsers = 0;
+    // event encoding threads
+    size_t serialisers = 1;
+    // requests handed to a parser at once - a partial batch waits for more requests or a drain
+    size_t batch_size = 64;
+    // batches in flight between two threads
+    size_t queue_capacity = 64;
+};
+
+template <typename BasicJsonType>
+void from_json(const BasicJsonType& j, PipelineOptions& o)
+{
+    const PipelineOptions defaults;
+    o.parsers = j.value("parsers", defaults.parsers);
+    o.serialisers = j.value("serialisers", defaults.serialisers);
+    o.batch_size = j.value("batch_size", defaults.batch_size);
+    o.queue_capacity = j.value("queue_capacity", defaults.queue_capacity);
+}
+
+enum pipeline_stage
+{
+    parse_stage,
+    match_stage,
+    serialise_stage
+};
+
+// latency of the batches that went through one stage, over all its threads
+struct StageLatency
+{
+    size_t batches = 0;
+    size_t requests = 0;
+    // from hand off by the previous stage until the stage picked the batch up
+    std::chrono::nanoseconds queued{0};
+    std::chrono::nanoseconds max_queued{0};
+    // spent on the batch by the stage
+    std::chrono::nanoseconds busy{0};
+    std::chrono::nanoseconds max_busy{0};
+
+    void add(size_t number_of_requests, std::chrono::nanoseconds batch_queued, std::chrono::nanoseconds batch_busy);
+    StageLatency& operator+=(const StageLatency& other);
+};
+
+// Runs a request through parse/validate, match and serialise stages on their own threads, joined by
+// bounded lock-free queues that block the previous stage when full. The calling thread hands raw
+// requests round robin to the parser threads, which check them against the immutable rules; the one
+// matcher thread takes the validated requests back in the same round robin order, so requests are
+// matched in arrival order; serialiser threads encode the events of a batch each and append them to
+// the market data in batch order.
+class PipelinedEngine
+{
+public:
+    PipelinedEngine(
+        const size_rules::TickSizeRulesCPtr& ticker_size_rules,
+        const size_rules::LotSizeRulesCPtr& lot_size_rules,
+        const ticker_rules::TickerRulesCPtr& ticker_rules,
+        const book_rules::BookRulesCPtr& book_rules,
+        const utils::PoolOptions& pool_options,
+        const PipelineOptions& options,
+        MarketDataPublisher& market_data_publisher
+    );
+    ~PipelinedEngine();
+
+    PipelinedEngine(const PipelinedEngine&) = delete;
+    PipelinedEngine& operator=(const PipelinedEngine&) = delete;
+
+    // events are published by the serialiser threads
+    void process_order(std::string_view s);
+    // decoded requests skip parsing, not validation
+    void process_order(const Request& r);
+
+    // both wait for the queued requests, then run the engine on the calling thread
+    void prev_open_setup(const std::string& close_order_cache_file);
+    void eod_cleanup(const std::string& close_order_cache_file);
+
+    // returns once the events of every request handed in are published
+    void drain();
+    // reads the books on the calling thread - only consistent once drained
+    void checkpoint(order::BookSnapshotWriter& snapshot) const { engine_.checkpoint(snapshot); }
+
+    // only consistent once drained
+    StageLatency latency(pipeline_stage stage) const;
+
+private:
+    // consecutive requests, raw text in, validated requests out
+    struct RequestBatch
+    {
+        size_t size = 0;
+        std::vector<std::string> texts;
+        // requests decoded by the caller have no text to parse
+        std::vector<char> decoded;
+        // unknown_request for anything that failed to parse or validate
+        std::vector<Request> requests;
+        std::chrono::steady_clock::time_point handed_off;
+    };
+
+    // events of the requests of one request batch
+    struct EventBatch
+    {
+        std::vector<trade_event::EventRecord> records;
+        size_t number_of_requests = 0;
+        // binary sequence number of the first event
+        std::uint64_t sequence = 0;
+        std::chrono::steady_clock::time_point handed_off;
+    };
+
+    struct Parser
+    {
+        explicit Parser(size_t queue_capacity);
+
+        // from the calling thread, to the matcher thread, and emptied ones back to the calling thread
+        utils::SpscQueue<RequestBatch> requests;
+        utils::SpscQueue<RequestBatch> parsed;
+        utils::SpscQueue<RequestBatch> free_batches;
+        std::atomic<size_t> number_of_requests{0};
+        std::atomic<size_t> number_of_parsed{0};
+        StageLatency latency;
+        std::thread thread;
+    };
+
+    struct Serialiser
+    {
+        explicit Serialiser(size_t queue_capacity);
+
+        // from the matcher thread, and encoded ones back to it
+        utils::SpscQueue<EventBatch> events;
+        utils::SpscQueue<EventBatch> free_batches;
+        std::atomic<size_t> number_of_events{0};
+        StageLatency latency;
+        std::thread thread;
+    };
+
+    RequestBatch& next_slot();
+    void hand_off();
+
+    void parse_loop(Parser& parser);
+    void parse(RequestBatch& batch) const;
+    void match_loop();
+    void serialise_loop(size_t index);
+
+    RequestValidator validator_;
+    PipelineOptions options_;
+    MatchingEngine engine_;
+    MarketDataPublisher& market_data_publisher_;
+    std::vector<std::unique_ptr<Parser>> parsers_;
+    std::vector<std::unique_ptr<Serialiser>> serialisers_;
+
+    // calling thread side
+    RequestBatch batch_;
+    size_t next_parser_ = 0;
+    size_t number_of_handed_off_ = 0;
+
+    // matcher thread side
+    StageLatency match_latency_;
+
+    // batches whose events are published, in batch order - serialisers wait for their turn on it
+    std::atomic<size_t> number_of_published_{0};
+    std::atomic<bool> stopping_{false};
+    std::thread matcher_;
+};
+
+} // namespace exchange
+
+#endif
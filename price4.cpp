@@ -1,4 +1,5 @@
 #include <iostream> // some libs are included for test purpose only
+#include <climits>
 #include <cmath>
 #include <sstream>
 #include <string>
@@ -32,6 +33,44 @@ Price4::Price4(const std::string& s)
     }
 }
 
+bool Price4::parse(std::string_view s, Price4& p)
+{
+    size_t i = 0;
+    const bool negative = !s.empty() && s[0] == '-';
+    if (negative) ++i;
+
+    long unit = 1;
+    for (int k = 0; k < Price4::scale; ++k) unit *= 10;
+    // largest integer part whose scaled price still fits, whatever the decimals
+    const long max_integer = (LONG_MAX - (unit - 1)) / unit;
+
+    long integer = 0;
+    size_t num_integer_digits = 0;
+    for (; i < s.size() && s[i] >= '0' && s[i] <= '9'; ++i, ++num_integer_digits)
+    {
+        integer = integer * 10 + (s[i] - '0');
+        if (integer > max_integer) return false;
+    }
+
+    long decimal = 0;
+    int num_decimal_digits = 0;
+    if (i < s.size() && s[i] == '.')
+    {
+        for (++i; i < s.size() && s[i] >= '0' && s[i] <= '9'; ++i, ++num_decimal_digits)
+        {
+            if (num_decimal_digits == Price4::scale) return false;
+            decimal = decimal * 10 + (s[i] - '0');
+        }
+    }
+    if (i != s.size() || (num_integer_digits == 0 && num_decimal_digits == 0)) return false;
+
+    for (; num_decimal_digits < Price4::scale; ++num_decimal_digits) decimal *= 10;
+
+    const long unscaled = integer * unit + decimal;
+    p = Price4(negative ? -unscaled : unscaled);
+    return true;
+}
+
 std::string Price4::to_str() const
 {
     const long unit = std::pow(10, Price4::scale);
@@ -4,6 +4,7 @@
 #include <functional>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <string_view>
 
 namespace utils
 {
@@ -17,6 +18,8 @@ public:
 
     // convert from string
     explicit Price4(const std::string& str);
+    // non-throwing, non-allocating conversion - false on malformed input or more than scale decimals
+    static bool parse(std::string_view s, Price4& p);
 
     long unscaled() const { return unscaled_; }
 
@@ -0,0 +1,383 @@
+#include <climits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "request.hpp"
+
+namespace exchange
+{
+
+namespace
+{
+
+// fields seen so far, to check the request type has what it needs
+enum field : unsigned
+{
+    time_field = 1u << 0,
+    order_id_field = 1u << 1,
+    symbol_field = 1u << 2,
+    side_field = 1u << 3,
+    tif_field = 1u << 4,
+    quantity_field = 1u << 5,
+    display_quantity_field = 1u << 6,
+    hidden_quantity_field = 1u << 7,
+    limit_price_field = 1u << 8
+};
+
+// Cursor over JSON text. Strings are returned as views into the text without unescaping; escaped
+// strings are flagged so callers can refuse them where the raw bytes would be wrong.
+class Scanner
+{
+public:
+    explicit Scanner(std::string_view s) : p_(s.data()), end_(s.data() + s.size()) {}
+
+    bool at_end() { skip_whitespace(); return p_ == end_; }
+
+    bool consume(char c)
+    {
+        skip_whitespace();
+        if (p_ == end_ || *p_ != c) return false;
+        ++p_;
+        return true;
+    }
+
+    bool peek(char c)
+    {
+        skip_whitespace();
+        return p_ != end_ && *p_ == c;
+    }
+
+    bool read_string(std::string_view& s, bool& escaped)
+    {
+        if (!consume('"')) return false;
+        const char* begin = p_;
+        escaped = false;
+        for (; p_ != end_; ++p_)
+        {
+            if (*p_ == '\\')
+            {
+                escaped = true;
+                if (++p_ == end_) return false;
+            }
+            else if (*p_ == '"')
+            {
+                s = std::string_view(begin, p_ - begin);
+                ++p_;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // number or literal token
+    bool read_scalar(std::string_view& s)
+    {
+        skip_whitespace();
+        const char* begin = p_;
+        while (p_ != end_ && *p_ != ',' && *p_ != '}' && *p_ != ']' && !is_whitespace(*p_)) ++p_;
+        s = std::string_view(begin, p_ - begin);
+        return !s.empty();
+    }
+
+    bool skip_value()
+    {
+        skip_whitespace();
+        if (p_ == end_) return false;
+
+        std::string_view s;
+        bool escaped;
+        if (*p_ == '"') return read_string(s, escaped);
+        if (*p_ != '{' && *p_ != '[') return read_scalar(s);
+
+        // nested object or array - only brackets outside strings count
+        int depth = 0;
+        while (p_ != end_)
+        {
+            const char c = *p_;
+            if (c == '"')
+            {
+                if (!read_string(s, escaped)) return false;
+                continue;
+            }
+            ++p_;
+            if (c == '{' || c == '[') ++depth;
+            else if ((c == '}' || c == ']') && --depth == 0) return true;
+        }
+        return false;
+    }
+
+private:
+    static bool is_whitespace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+    void skip_whitespace()
+    {
+        while (p_ != end_ && is_whitespace(*p_)) ++p_;
+    }
+
+    const char* p_;
+    const char* end_;
+};
+
+// integer with an optional all-zero fraction, e.g. 100 or 100.0
+bool parse_int(std::string_view s, int& value)
+{
+    size_t i = 0;
+    const bool negative = !s.empty() && s[0] == '-';
+    if (negative) ++i;
+    if (i == s.size()) return false;
+
+    long long v = 0;
+    size_t num_integer_digits = 0;
+    for (; i < s.size() && s[i] >= '0' && s[i] <= '9'; ++i, ++num_integer_digits)
+    {
+        v = v * 10 + (s[i] - '0');
+        if (v > INT_MAX) return false;
+    }
+    // a fraction needs its digits, as in a json number
+    size_t num_decimal_digits = 0;
+    if (i < s.size() && s[i] == '.')
+    {
+        for (++i; i < s.size() && s[i] == '0'; ++i, ++num_decimal_digits) {}
+        if (num_decimal_digits == 0) return false;
+    }
+    if (i != s.size() || (num_integer_digits == 0 && num_decimal_digits == 0)) return false;
+
+    value = static_cast<int>(negative ? -v : v);
+    return true;
+}
+
+// case-insensitive match against a lower-case literal
+bool equals_lower(std::string_view s, std::string_view lower)
+{
+    if (s.size() != lower.size()) return false;
+    for (size_t i = 0; i < s.size(); ++i)
+    {
+        const char c = s[i] >= 'A' && s[i] <= 'Z' ? static_cast<char>(s[i] - 'A' + 'a') : s[i];
+        if (c != lower[i]) return false;
+    }
+    return true;
+}
+
+bool parse_type(std::string_view s, request_type& type)
+{
+    if (s == "NEW") type = new_request;
+    else if (s == "CANCEL") type = cancel_request;
+    else if (s == "REPLENISH") type = replenish_request;
+    else if (s == "MODIFY") type = modify_request;
+    else type = unknown_request;
+    return true;
+}
+
+bool parse_side(std::string_view s, order::order_side& side)
+{
+    if (equals_lower(s, "buy")) side = order::order_side::bid;
+    else if (equals_lower(s, "sell")) side = order::order_side::ask;
+    else return false;
+    return true;
+}
+
+bool parse_tif(std::string_view s, order::time_in_force& tif)
+{
+    if (s == "day") tif = order::time_in_force::day;
+    else if (s == "immediate_or_cancel") tif = order::time_in_force::immediate_or_cancel;
+    else if (s == "good_till_cancel") tif = order::time_in_force::good_till_cancel;
+    else return false;
+    return true;
+}
+
+bool has_fields(unsigned seen, unsigned required)
+{
+    return (seen & required) == required;
+}
+
+} // anonymous namespace
+
+bool RequestParser::parse(std::string_view s, Request& r)
+{
+    r = Request();
+    unsigned seen = 0;
+    int display_quantity = 0;
+
+    Scanner scanner(s);
+    if (!scanner.consume('{')) return false;
+
+    bool first = true;
+    while (!scanner.consume('}'))
+    {
+        if (!first && !scanner.consume(',')) return false;
+        first = false;
+
+        std::string_view key;
+        bool escaped;
+        if (!scanner.read_string(key, escaped) || !scanner.consume(':')) return false;
+
+        std::string_view value;
+        bool ok = true;
+        if (escaped)
+        {
+            ok = scanner.skip_value();
+        }
+        else if (key == "type")
+        {
+            ok = scanner.read_string(value, escaped) && !escaped && parse_type(value, r.type);
+        }
+        else if (key == "time")
+        {
+            ok = scanner.read_scalar(value) && parse_int(value, r.time);
+            seen |= time_field;
+        }
+        else if (key == "order_id")
+        {
+            ok = scanner.read_scalar(value) && parse_int(value, r.order_id);
+            seen |= order_id_field;
+        }
+        else if (key == "symbol")
+        {
+            ok = scanner.read_string(value, escaped) && !escaped && value.size() <= Request::max_symbol_length;
+            if (ok)
+            {
+                value.copy(r.symbol_data, value.size());
+                r.symbol_data[value.size()] = '\0';
+                r.symbol_length = static_cast<std::uint8_t>(value.size());
+            }
+            seen |= symbol_field;
+        }
+        else if (key == "side")
+        {
+            ok = scanner.read_string(value, escaped) && !escaped && parse_side(value, r.side);
+            seen |= side_field;
+        }
+        else if (key == "tif")
+        {
+            ok = scanner.read_string(value, escaped) && !escaped && parse_tif(value, r.tif);
+            seen |= tif_field;
+        }
+        else if (key == "quantity")
+        {
+            ok = scanner.read_scalar(value) && parse_int(value, r.quantity);
+            seen |= quantity_field;
+        }
+        else if (key == "display_quantity")
+        {
+            // kept apart until the order type is known
+            ok = scanner.read_scalar(value) && parse_int(value, display_quantity);
+            seen |= display_quantity_field;
+        }
+        else if (key == "hidden_quantity")
+        {
+            ok = scanner.read_scalar(value) && parse_int(value, r.hidden_quantity);
+            seen |= hidden_quantity_field;
+        }
+        else if (key == "limit_price")
+        {
+            // prices are sent as strings, bare numbers are accepted too
+            ok = scanner.peek('"') ? scanner.read_string(value, escaped) && !escaped : scanner.read_scalar(value);
+            ok = ok && utils::Price4::parse(value, r.limit_price);
+            seen |= limit_price_field;
+        }
+        else
+        {
+            ok = scanner.skip_value();
+        }
+        if (!ok) return false;
+    }
+    if (!scanner.at_end()) return false;
+
+    switch (r.type)
+    {
+    case new_request:
+        if (!has_fields(seen, time_field | order_id_field | symbol_field | side_field | tif_field)) return false;
+        if (!(seen & limit_price_field))
+        {
+            r.order_type = order::order_type::market;
+            return has_fields(seen, quantity_field);
+        }
+        if (seen & hidden_quantity_field)
+        {
+            r.order_type = order::order_type::iceberg;
+            r.quantity = display_quantity;
+            return has_fields(seen, display_quantity_field);
+        }
+        r.order_type = order::order_type::limit;
+        return has_fields(seen, quantity_field);
+
+    case cancel_request:
+        return has_fields(seen, order_id_field);
+
+    case replenish_request:
+        return has_fields(seen, order_id_field | quantity_field);
+
+    case modify_request:
+        r.order_type = order::order_type::limit;
+        return has_fields(seen, time_field | order_id_field | symbol_field | side_field | tif_field |
+            limit_price_field | quantity_field);
+
+    default:
+        // requests of other types are ignored by the engine
+        return true;
+    }
+}
+
+void append_json(const Request& r, std::string& out)
+{
+    static const char* const types[] = {"NEW", "CANCEL", "REPLENISH", "MODIFY"};
+    if (r.type == unknown_request) return;
+
+    out += "{\"time\": ";
+    out += std::to_string(r.time);
+    out += ", \"type\": \"";
+    out += types[r.type];
+    out += "\", \"order_id\": ";
+    out += std::to_string(r.order_id);
+    if (r.type == new_request || r.type == modify_request)
+    {
+        out += ", \"symbol\": \"";
+        out += r.symbol();
+        out += r.side == order::order_side::bid ? "\", \"side\": \"buy\"" : "\", \"side\": \"sell\"";
+        if (r.order_type != order::order_type::market)
+        {
+            out += ", \"limit_price\": \"";
+            out += r.limit_price.to_str();
+            out += "\"";
+        }
+        out += r.tif == order::time_in_force::day ? ", \"tif\": \"day\"" :
+            r.tif == order::time_in_force::immediate_or_cancel ? ", \"tif\": \"immediate_or_cancel\"" :
+            ", \"tif\": \"good_till_cancel\"";
+    }
+    if (r.type != cancel_request)
+    {
+        // icebergs show their displayed quantity apart
+        out += r.order_type == order::order_type::iceberg && r.type == new_request ?
+            ", \"display_quantity\": " : ", \"quantity\": ";
+        out += std::to_string(r.quantity);
+    }
+    if (r.order_type == order::order_type::iceberg && r.type == new_request)
+    {
+        out += ", \"hidden_quantity\": ";
+        out += std::to_string(r.hidden_quantity);
+    }
+    out += "}";
+}
+
+order::OrderBasePtr create_order(const Request& r, int symbol_id)
+{
+    switch (r.order_type)
+    {
+    case order::order_type::limit:
+        // also the replacement order of MODIFY
+        return std::make_shared<order::LimitOrder>(
+            r.time, r.order_id, r.quantity, r.tif, r.limit_price, symbol_id, r.side);
+
+    case order::order_type::iceberg:
+        return std::make_shared<order::IcebergOrder>(
+            r.time, r.order_id, r.tif, r.limit_price, symbol_id, r.side, r.quantity, r.hidden_quantity);
+
+    case order::order_type::market:
+        return std::make_shared<order::MarketOrder>(r.time, r.order_id, r.quantity, r.tif, symbol_id, r.side);
+
+    default:
+        throw std::runtime_error("Request does not describe an order.");
+    }
+}
+
+} // namespace exchange
@@ -0,0 +1,70 @@
+#ifndef REQUEST_HPP_
+#define REQUEST_HPP_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "order.hpp"
+#include "price4.hpp"
+
+namespace exchange
+{
+
+enum request_type
+{
+    new_request,
+    cancel_request,
+    replenish_request,
+    // cancel-replace of a resting order with a limit order on the same book
+    modify_request,
+    unknown_request
+};
+
+// Fixed-layout order entry request - everything the engine reads from a NEW, CANCEL, REPLENISH or
+// MODIFY message, with the symbol held inline so parsing never touches the heap.
+struct Request
+{
+    static constexpr size_t max_symbol_length = 15;
+    // symbol_id of requests naming their symbol as text
+    static constexpr int unresolved_symbol_id = -1;
+
+    std::string_view symbol() const { return std::string_view(symbol_data, symbol_length); }
+
+    request_type type = unknown_request;
+    int time = 0;
+    int order_id = 0;
+    // interned symbol id when the sender knows it, e.g. binary requests
+    int symbol_id = unresolved_symbol_id;
+    // NEW only - market unless a limit price is given, iceberg if a hidden quantity is given too
+    order::order_type order_type = order::order_type::unknown;
+    order::order_side side = order::order_side::bid;
+    order::time_in_force tif = order::time_in_force::day;
+    // order quantity, displayed quantity of iceberg orders, replenished quantity of REPLENISH
+    int quantity = 0;
+    int hidden_quantity = 0;
+    utils::Price4 limit_price = utils::Price4(0);
+    std::uint8_t symbol_length = 0;
+    char symbol_data[max_symbol_length + 1] = {};
+};
+
+// Single-pass parser for the order entry JSON schema. Only the fields of Request are decoded; other
+// keys are skipped whatever their value. Never allocates and never throws - false when the text is
+// not a JSON object, a known field has the wrong type or an unknown value, or a required field of the
+// request type is missing.
+class RequestParser
+{
+public:
+    static bool parse(std::string_view s, Request& r);
+};
+
+// Appends r to out as a line of the order entry JSON schema, without the newline, which RequestParser
+// reads back the same.
+void append_json(const Request& r, std::string& out);
+
+// order described by a NEW or MODIFY request - throws if the order is inconsistent, e.g. a market order not
+// immediate_or_cancel
+order::OrderBasePtr create_order(const Request& r, int symbol_id);
+
+} // namespace exchange
+
+#endif
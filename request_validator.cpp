@@ -0,0 +1,57 @@
+#include "request_validator.hpp"
+
+namespace exchange
+{
+
+RequestValidator::RequestValidator(
+    const size_rules::TickSizeRulesCPtr& ticker_size_rules,
+    const size_rules::LotSizeRulesCPtr& lot_size_rules,
+    const ticker_rules::TickerRulesCPtr& ticker_rules
+)
+:
+ticker_size_rules_(ticker_size_rules),
+lot_size_rules_(lot_size_rules),
+ticker_rules_(ticker_rules)
+{
+}
+
+int RequestValidator::resolve_symbol_id(const Request& r) const
+{
+    if (r.symbol_id != Request::unresolved_symbol_id)
+    {
+        const bool listed = r.symbol_id >= 0 && static_cast<size_t>(r.symbol_id) < ticker_rules_->number_of_symbols();
+        return listed ? r.symbol_id : ticker_rules::TickerRules::invalid_symbol_id;
+    }
+    return ticker_rules_->symbol_id(r.symbol());
+}
+
+bool RequestValidator::validate(const Request& r, int symbol_id) const
+{
+    // iceberg orders count displayed and hidden quantity
+    const int quantity = r.quantity + r.hidden_quantity;
+
+    // remove invalid symbol
+    if (symbol_id == ticker_rules::TickerRules::invalid_symbol_id)
+    {
+        return false;
+    }
+    // remove zero quantity
+    if (quantity == 0)
+    {
+        return false;
+    }
+
+    // if limit order
+    if (r.order_type != order::order_type::market)
+    {
+        if (!ticker_size_rules_->is_valid(r.limit_price) || 
+            !(lot_size_rules_->lot_type(r.limit_price, quantity) == size_rules::lot_types::round_lot))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace exchange
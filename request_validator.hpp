@@ -0,0 +1,35 @@
+#ifndef REQUEST_VALIDATOR_HPP_
+#define REQUEST_VALIDATOR_HPP_
+
+#include "request.hpp"
+#include "size_rules.hpp"
+#include "ticker_rules.hpp"
+
+namespace exchange
+{
+
+// Checks NEW and MODIFY requests against the listing, tick size and lot size rules. The rules never
+// change once loaded, so one validator is safe to share between threads.
+class RequestValidator
+{
+public:
+    RequestValidator() = default;
+    RequestValidator(
+        const size_rules::TickSizeRulesCPtr& ticker_size_rules,
+        const size_rules::LotSizeRulesCPtr& lot_size_rules,
+        const ticker_rules::TickerRulesCPtr& ticker_rules
+    );
+
+    // interned id of the request symbol, invalid_symbol_id if it is not listed
+    int resolve_symbol_id(const Request& r) const;
+    bool validate(const Request& r, int symbol_id) const;
+
+private:
+    size_rules::TickSizeRulesCPtr ticker_size_rules_;
+    size_rules::LotSizeRulesCPtr lot_size_rules_;
+    ticker_rules::TickerRulesCPtr ticker_rules_;
+};
+
+} // namespace exchange
+
+#endif
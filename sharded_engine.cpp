@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include "sharded_engine.hpp"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace exchange
+{
+
+namespace
+{
+
+void pin_to_core(std::thread& thread, int core)
+{
+#if defined(__linux__)
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    if (pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus) != 0)
+    {
+        std::cerr << "Cannot pin matching shard to core " << core << "." << std::endl;
+    }
+#endif
+}
+
+} // anonymous namespace
+
+ShardedEngine::Shard::Shard(MatchingEnginePtr&& engine, const ShardingOptions& options)
+:
+engine(std::move(engine)),
+requests(options.queue_capacity),
+// every batch holds at least one request, so this many never block the shard before its requests do
+full_batches(options.queue_capacity),
+free_batches(options.queue_capacity)
+{
+}
+
+ShardedEngine::ShardedEngine(
+    const size_rules::TickSizeRulesCPtr& ticker_size_rules,
+    const size_rules::LotSizeRulesCPtr& lot_size_rules,
+    const ticker_rules::TickerRulesCPtr& ticker_rules,
+    const book_rules::BookRulesCPtr& book_rules,
+    const utils::PoolOptions& pool_options,
+    const ShardingOptions& options,
+    MarketDataPublisher& market_data_publisher
+)
+:
+ticker_rules_(ticker_rules),
+options_(options),
+market_data_publisher_(market_data_publisher),
+routes_(std::make_unique<utils::SpscQueue<std::uint32_t>>(options.queue_capacity))
+{
+    if (options_.shards == 0 || !ticker_rules_)
+    {
+        throw std::runtime_error("Sharded engine needs at least one shard and listed symbols.");
+    }
+    options_.batch_size = std::max<size_t>(options_.batch_size, 1);
+
+    const size_t number_of_symbols = ticker_rules_->number_of_symbols();
+    std::vector<std::vector<bool>> owned_symbols(options_.shards, std::vector<bool>(number_of_symbols, false));
+    symbol_shards_.resize(number_of_symbols);
+    for (size_t symbol_id = 0; symbol_id < number_of_symbols; ++symbol_id)
+    {
+        const auto found = options_.symbols.find(ticker_rules_->symbol(static_cast<int>(symbol_id)));
+        const size_t shard = found != options_.symbols.end() ? found->second : symbol_id % options_.shards;
+        if (shard >= options_.shards)
+        {
+            throw std::runtime_error("Symbol assigned to a shard that does not exist.");
+        }
+        symbol_shards_[symbol_id] = static_cast<std::uint32_t>(shard);
+        owned_symbols[shard][symbol_id] = true;
+    }
+
+    for (size_t i = 0; i < options_.shards; ++i)
+    {
+        shards_.push_back(std::make_unique<Shard>(std::make_unique<MatchingEngine>(
+            ticker_size_rules, lot_size_rules, ticker_rules, book_rules, pool_options, owned_symbols[i]), options_));
+    }
+    for (size_t i = 0; i < shards_.size(); ++i)
+    {
+        Shard& shard = *shards_[i];
+        shard.thread = std::thread(&ShardedEngine::match_loop, this, std::ref(shard));
+        if (i < options_.cores.size())
+        {
+            pin_to_core(shard.thread, options_.cores[i]);
+        }
+    }
+    sequencer_ = std::thread(&ShardedEngine::sequence_loop, this);
+}
+
+ShardedEngine::~ShardedEngine()
+{
+    drain();
+    stopping_.store(true, std::memory_order_release);
+    for (auto& shard : shards_)
+    {
+        shard->number_of_requests.fetch_add(1, std::memory_order_release);
+        shard->number_of_requests.notify_one();
+        shard->thread.join();
+    }
+    number_of_routed_.fetch_add(1, std::memory_order_release);
+    number_of_routed_.notify_one();
+    sequencer_.join();
+}
+
+int ShardedEngine::resolve_symbol_id(const Request& r) const
+{
+    if (r.symbol_id == Request::unresolved_symbol_id)
+    {
+        return ticker_rules_->symbol_id(r.symbol());
+    }
+    if (r.symbol_id < 0 || static_cast<size_t>(r.symbol_id) >= ticker_rules_->number_of_symbols())
+    {
+        return ticker_rules::TickerRules::invalid_symbol_id;
+    }
+    return r.symbol_id;
+}
+
+void ShardedEngine::process_order(std::string_view s)
+{
+    Request r;
+    if (!RequestParser::parse(s, r))
+    {
+        std::cout << "Cannot parse request: " << s << std::endl;
+        return;
+    }
+    process_order(r);
+}
+
+void ShardedEngine::process_order(const Request& r)
+{
+    // requests the engine would drop without events are dropped here
+    switch (r.type)
+    {
+    case new_request:
+    case modify_request:
+    {
+        Request routed = r;
+        routed.symbol_id = resolve_symbol_id(r);
+        if (routed.symbol_id == ticker_rules::TickerRules::invalid_symbol_id)
+        {
+            return;
+        }
+        const std::uint32_t shard_index = symbol_shards_[routed.symbol_id];
+        // a modify keeps the order on its book, so on its shard
+        if (r.type == new_request)
+        {
+            order_shards_.insert(r.order_id, order::OrderLocation{shard_index});
+        }
+        route(shard_index, routed);
+        break;
+    }
+
+    case cancel_request:
+    case replenish_request:
+    {
+        const order::OrderLocation* location = order_shards_.find(r.order_id);
+        if (!location)
+        {
+            return;
+        }
+        route(location->book, r);
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+void ShardedEngine::route(std::uint32_t shard_index, const Request& r)
+{
+    Shard& shard = *shards_[shard_index];
+    // back pressure - requests are never dropped
+    Request request = r;
+    while (!shard.requests.try_push(std::move(request)))
+    {
+        std::this_thread::yield();
+    }
+    shard.number_of_requests.fetch_add(1, std::memory_order_release);
+    shard.number_of_requests.notify_one();
+
+    while (!routes_->try_push(std::move(shard_index)))
+    {
+        std::this_thread::yield();
+    }
+    number_of_routed_.fetch_add(1, std::memory_order_release);
+    number_of_routed_.notify_one();
+}
+
+void ShardedEngine::drain()
+{
+    const size_t routed = number_of_routed_.load(std::memory_order_relaxed);
+    size_t published = number_of_published_.load(std::memory_order_acquire);
+    while (published != routed)
+    {
+        number_of_published_.wait(published, std::memory_order_acquire);
+        published = number_of_published_.load(std::memory_order_acquire);
+    }
+}
+
+void ShardedEngine::prev_open_setup(const std::string& close_order_cache_file)
+{
+    // shard threads are idle until the next request is routed
+    drain();
+
+    // publish the snapshots in book order, as a single engine does
+    std::vector<std::tuple<int, order::order_side, std::span<const trade_event::EventRecord>>> snapshots;
+    for (size_t i = 0; i < shards_.size(); ++i)
+    {
+        MatchingEngine& engine = *shards_[i]->engine;
+        const auto records = engine.prev_open_setup(close_order_cache_file).records();
+        for (size_t head = 0; head < records.size(); head += 1 + records[head].number_of_levels)
+        {
+            snapshots.emplace_back(records[head].symbol_id, records[head].side,
+                trade_event::event_records(records, head));
+        }
+        engine.order_index().for_each([&](int order_id, const order::OrderLocation&)
+        {
+            order_shards_.insert(order_id, order::OrderLocation{static_cast<std::uint32_t>(i)});
+        });
+    }
+    std::stable_sort(snapshots.begin(), snapshots.end(), [](const auto& a, const auto& b)
+    {
+        return std::get<0>(a) != std::get<0>(b) ? std::get<0>(a) < std::get<0>(b) : std::get<1>(a) < std::get<1>(b);
+    });
+    for (const auto& snapshot : snapshots)
+    {
+        market_data_publisher_.publish(std::get<2>(snapshot));
+    }
+}
+
+void ShardedEngine::eod_cleanup(const std::string& close_order_cache_file)
+{
+    drain();
+
+    // one snapshot holding the sections of every shard
+    order::BookSnapshotWriter snapshot;
+    for (auto& shard : shards_)
+    {
+        shard->engine->eod_cleanup(snapshot);
+    }
+    snapshot.write(close_order_cache_file);
+    order_shards_.clear();
+}
+
+void ShardedEngine::checkpoint(order::BookSnapshotWriter& snapshot) const
+{
+    for (const auto& shard : shards_)
+    {
+        shard->engine->checkpoint(snapshot);
+    }
+}
+
+void ShardedEngine::match_loop(Shard& shard)
+{
+    Request r;
+    while (true)
+    {
+        const size_t pushed = shard.number_of_requests.load(std::memory_order_acquire);
+        if (!shard.requests.try_pop(r))
+        {
+            // nothing queued - whatever was matched goes to the sequencer now
+            hand_off(shard);
+            if (stopping_.load(std::memory_order_acquire)) break;
+            shard.number_of_requests.wait(pushed, std::memory_order_acquire);
+            continue;
+        }
+
+        const auto records = shard.engine->process_order(r).records();
+        shard.filling.records.insert(shard.filling.records.end(), records.begin(), records.end());
+        shard.filling.sizes.push_back(static_cast<std::uint32_t>(records.size()));
+        if (shard.filling.sizes.size() >= options_.batch_size)
+        {
+            hand_off(shard);
+        }
+    }
+}
+
+void ShardedEngine::hand_off(Shard& shard)
+{
+    if (shard.filling.sizes.empty()) return;
+
+    while (!shard.full_batches.try_push(std::move(shard.filling)))
+    {
+        std::this_thread::yield();
+    }
+    shard.number_of_batches.fetch_add(1, std::memory_order_release);
+    shard.number_of_batches.notify_one();
+
+    if (!shard.free_batches.try_pop(shard.filling))
+    {
+        shard.filling = EventBatch();
+    }
+}
+
+void ShardedEngine::take_batch(Shard& shard)
+{
+    // back to the shard for reuse - dropped if the free queue is full
+    shard.draining.records.clear();
+    shard.draining.sizes.clear();
+    shard.free_batches.try_push(std::move(shard.draining));
+
+    while (true)
+    {
+        const size_t handed_off = shard.number_of_batches.load(std::memory_order_acquire);
+        if (shard.full_batches.try_pop(shard.draining)) break;
+        shard.number_of_batches.wait(handed_off, std::memory_order_acquire);
+    }
+    shard.next_request = 0;
+    shard.next_record = 0;
+}
+
+void ShardedEngine::sequence_loop()
+{
+    std::uint32_t shard_index;
+    while (true)
+    {
+        const size_t routed = number_of_routed_.load(std::memory_order_acquire);
+        if (!routes_->try_pop(shard_index))
+        {
+            if (stopping_.load(std::memory_order_acquire)) break;
+            number_of_routed_.wait(routed, std::memory_order_acquire);
+            continue;
+        }
+
+        Shard& shard = *shards_[shard_index];
+        if (shard.next_request == shard.draining.sizes.size())
+        {
+            take_batch(shard);
+        }
+        const size_t size = shard.draining.sizes[shard.next_request++];
+        market_data_publisher_.publish(
+            std::span<const trade_event::EventRecord>(shard.draining.records).subspan(shard.next_record, size));
+        shard.next_record += size;
+
+        number_of_published_.fetch_add(1, std::memory_order_release);
+        number_of_published_.notify_all();
+    }
+}
+
+} // namespace exchange
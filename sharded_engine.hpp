@@ -0,0 +1,157 @@
+#ifndef SHARDED_ENGINE_HPP_
+#define SHARDED_ENGINE_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "book_rules.hpp"
+#include "event_arena.hpp"
+#include "market_data_publisher.hpp"
+#include "matching_engine.hpp"
+#include "order_index.hpp"
+#include "request.hpp"
+#include "size_rules.hpp"
+#include "slab_pool.hpp"
+#include "spsc_queue.hpp"
+#include "ticker_rules.hpp"
+
+namespace exchange
+{
+
+class ShardedEngine;
+typedef std::unique_ptr<ShardedEngine> ShardedEnginePtr;
+typedef std::unique_ptr<const ShardedEngine> ShardedEngineCPtr;
+
+struct ShardingOptions
+{
+    // matching threads - 0 matches on the calling thread
+    size_t shards = 0;
+    // core each shard thread is pinned to, in shard order - shards past the list are not pinned
+    std::vector<int> cores;
+    // symbol -> shard, other symbols are spread round robin in listing order
+    std::unordered_map<std::string, size_t> symbols;
+    // requests in flight to each shard
+    size_t queue_capacity = 4096;
+    // most requests whose events a shard hands back at once - batches are handed back early whenever
+    // the shard runs out of requests
+    size_t batch_size = 256;
+};
+
+template <typename BasicJsonType>
+void from_json(const BasicJsonType& j, ShardingOptions& o)
+{
+    const ShardingOptions defaults;
+    o.shards = j.value("shards", defaults.shards);
+    o.cores = j.value("cores", defaults.cores);
+    o.symbols = j.value("symbols", defaults.symbols);
+    o.queue_capacity = j.value("queue_capacity", defaults.queue_capacity);
+    o.batch_size = j.value("batch_size", defaults.batch_size);
+}
+
+// Matches on several threads, each owning a MatchingEngine with the books of its share of the symbols.
+// The calling thread is the router: it hands each request over a lock-free queue to the shard of its
+// symbol, and cancels and replenishes, which name no symbol, to the shard their order id was last sent
+// to. A sequencer thread takes the events of every request back from its shard and publishes them in
+// routing order, so requests of a symbol are matched in arrival order and the market data keeps the
+// single engine's global order (and binary sequence numbers).
+// Order ids are expected to be unique across symbols - an engine cannot reject an order whose id
+// rests with another shard.
+class ShardedEngine
+{
+public:
+    ShardedEngine(
+        const size_rules::TickSizeRulesCPtr& ticker_size_rules,
+        const size_rules::LotSizeRulesCPtr& lot_size_rules,
+        const ticker_rules::TickerRulesCPtr& ticker_rules,
+        const book_rules::BookRulesCPtr& book_rules,
+        const utils::PoolOptions& pool_options,
+        const ShardingOptions& options,
+        MarketDataPublisher& market_data_publisher
+    );
+    ~ShardedEngine();
+
+    ShardedEngine(const ShardedEngine&) = delete;
+    ShardedEngine& operator=(const ShardedEngine&) = delete;
+
+    // events are published by the sequencer thread
+    void process_order(std::string_view s);
+    void process_order(const Request& r);
+
+    // both wait for the routed requests, then run every shard's engine on the calling thread
+    void prev_open_setup(const std::string& close_order_cache_file);
+    void eod_cleanup(const std::string& close_order_cache_file);
+
+    // returns once the events of every routed request are published
+    void drain();
+    // reads every shard's books on the calling thread - only consistent once drained
+    void checkpoint(order::BookSnapshotWriter& snapshot) const;
+
+    size_t number_of_shards() const { return shards_.size(); }
+    size_t shard_of(int symbol_id) const { return symbol_shards_[symbol_id]; }
+
+private:
+    // events of consecutive requests of one shard
+    struct EventBatch
+    {
+        std::vector<trade_event::EventRecord> records;
+        // number of records of each request
+        std::vector<std::uint32_t> sizes;
+    };
+
+    struct Shard
+    {
+        Shard(MatchingEnginePtr&& engine, const ShardingOptions& options);
+
+        MatchingEnginePtr engine;
+        utils::SpscQueue<Request> requests;
+        // bumped on every request, so the idle shard thread can wait on it
+        std::atomic<size_t> number_of_requests{0};
+        // filled batches to the sequencer, drained ones back for reuse
+        utils::SpscQueue<EventBatch> full_batches;
+        utils::SpscQueue<EventBatch> free_batches;
+        std::atomic<size_t> number_of_batches{0};
+        std::thread thread;
+
+        // shard thread side
+        EventBatch filling;
+        // sequencer thread side
+        EventBatch draining;
+        size_t next_request = 0;
+        size_t next_record = 0;
+    };
+
+    int resolve_symbol_id(const Request& r) const;
+    void route(std::uint32_t shard_index, const Request& r);
+
+    void match_loop(Shard& shard);
+    void hand_off(Shard& shard);
+    void sequence_loop();
+    void take_batch(Shard& shard);
+
+    ticker_rules::TickerRulesCPtr ticker_rules_;
+    ShardingOptions options_;
+    MarketDataPublisher& market_data_publisher_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    // shard of every listed symbol, by symbol id
+    std::vector<std::uint32_t> symbol_shards_;
+
+    // router side - shard each order id was last routed to
+    order::OrderIndex order_shards_;
+    // shard of every routed request, in routing order, to the sequencer
+    std::unique_ptr<utils::SpscQueue<std::uint32_t>> routes_;
+    std::atomic<size_t> number_of_routed_{0};
+    std::atomic<size_t> number_of_published_{0};
+    std::atomic<bool> stopping_{false};
+
+    std::thread sequencer_;
+};
+
+} // namespace exchange
+
+#endif
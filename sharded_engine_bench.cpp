@@ -0,0 +1,201 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "book_rules.hpp"
+#include "market_data_publisher.hpp"
+#include "matching_engine.hpp"
+#include "request.hpp"
+#include "serialise.hpp"
+#include "sharded_engine.hpp"
+#include "size_rules.hpp"
+#include "ticker_rules.hpp"
+
+// Throughput of the matching engine on the calling thread against the sharded engine with 1 to N
+// shards, on pre-parsed requests spread evenly over many symbols, publishing binary market data to
+// /dev/null. Each shard is pinned to its own core when there are enough of them.
+// usage: sharded_engine_bench [number_of_requests] [max_shards] [number_of_symbols] [seed]
+
+namespace
+{
+
+using json = nlohmann::json;
+
+struct Rules
+{
+    size_rules::TickSizeRulesCPtr tick_size;
+    size_rules::LotSizeRulesCPtr lot_size;
+    ticker_rules::TickerRulesCPtr tickers;
+    book_rules::BookRulesCPtr books;
+};
+
+Rules create_rules(const std::vector<std::string>& symbols)
+{
+    const json j = json::parse(R"({
+        "lot_size": [{"from_price": "1", "lot_size": "100"}],
+        "tick_size": [{"from_price": "0", "to_price": "1", "tick_size": "0.0001"}, {"from_price": "1", "tick_size": "0.01"}],
+        "order_books": {"default": "price_level"}
+    })");
+    Rules rules;
+    rules.lot_size = j.at("lot_size").get<size_rules::LotSizeRulesCPtr>();
+    rules.tick_size = j.at("tick_size").get<size_rules::TickSizeRulesCPtr>();
+    rules.books = j.at("order_books").get<book_rules::BookRulesCPtr>();
+    rules.tickers = std::make_shared<const ticker_rules::TickerRules>(symbols);
+    return rules;
+}
+
+exchange::Request new_request(int time, int order_id, const std::string& symbol, order::order_side side,
+    int quantity, long price)
+{
+    exchange::Request r;
+    r.type = exchange::new_request;
+    r.time = time;
+    r.order_id = order_id;
+    r.order_type = order::order_type::limit;
+    r.side = side;
+    r.tif = order::time_in_force::day;
+    r.quantity = quantity;
+    r.limit_price = utils::Price4(price);
+    r.symbol_length = static_cast<std::uint8_t>(symbol.size());
+    std::memcpy(r.symbol_data, symbol.data(), symbol.size());
+    return r;
+}
+
+// resting orders a few ticks around each symbol's mid, most cancelled, some crossing the spread
+std::vector<exchange::Request> create_requests(size_t number_of_requests, const std::vector<std::string>& symbols,
+    unsigned int seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::geometric_distribution<int> distance_from_touch(0.35);
+    std::uniform_int_distribution<int> lots(1, 10);
+    std::uniform_int_distribution<size_t> symbol(0, symbols.size() - 1);
+
+    const long tick = 100; // 0.01
+    const long mid = 1000000; // 100.00
+    std::vector<exchange::Request> requests;
+    requests.reserve(number_of_requests);
+    std::vector<int> live;
+    int next_id = 0;
+    int time = 1625787615;
+
+    while (requests.size() < number_of_requests)
+    {
+        const double r = uniform(gen);
+        if (r < 0.45 && !live.empty())
+        {
+            const size_t idx = static_cast<size_t>(uniform(gen) * live.size());
+            exchange::Request cancel;
+            cancel.type = exchange::cancel_request;
+            cancel.time = time;
+            cancel.order_id = live[idx];
+            requests.push_back(cancel);
+            live[idx] = live.back();
+            live.pop_back();
+            continue;
+        }
+
+        const order::order_side side = uniform(gen) < 0.5 ? order::order_side::bid : order::order_side::ask;
+        const bool aggressive = r > 0.95;
+        const long offset = aggressive ? -2 * tick : (distance_from_touch(gen) + 1) * tick;
+        requests.push_back(new_request(time, next_id, symbols[symbol(gen)], side, 100 * lots(gen),
+            side == order::order_side::bid ? mid - offset : mid + offset));
+        if (!aggressive) live.push_back(next_id);
+        ++next_id;
+        if (next_id % 100 == 0) ++time;
+    }
+    return requests;
+}
+
+exchange::PublisherOptions binary_options()
+{
+    exchange::PublisherOptions options;
+    options.format = exchange::binary;
+    return options;
+}
+
+void report(const std::string& name, size_t number_of_requests, double ns, double single_ns)
+{
+    std::cout << std::left << std::setw(14) << name
+        << std::right << std::setw(12) << std::fixed << std::setprecision(1) << ns / number_of_requests
+        << std::setw(14) << std::setprecision(0) << number_of_requests / ns * 1e9
+        << std::setw(10) << std::setprecision(2) << single_ns / ns
+        << "\n";
+}
+
+double run_single(const Rules& rules, const std::vector<exchange::Request>& requests)
+{
+    exchange::MarketDataPublisher publisher("/dev/null", binary_options(), rules.tickers);
+    exchange::MatchingEngine engine(rules.tick_size, rules.lot_size, rules.tickers, rules.books);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto& r : requests)
+    {
+        publisher.publish(engine.process_order(r));
+    }
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+double run_sharded(const Rules& rules, const std::vector<exchange::Request>& requests, size_t shards)
+{
+    exchange::MarketDataPublisher publisher("/dev/null", binary_options(), rules.tickers);
+    exchange::ShardingOptions options;
+    options.shards = shards;
+    // the router and the sequencer keep cores 0 and 1
+    const unsigned int cores = std::thread::hardware_concurrency();
+    for (size_t i = 0; i < shards && i + 2 < cores; ++i)
+    {
+        options.cores.push_back(static_cast<int>(i + 2));
+    }
+    exchange::ShardedEngine engine(rules.tick_size, rules.lot_size, rules.tickers, rules.books,
+        utils::PoolOptions(), options, publisher);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto& r : requests)
+    {
+        engine.process_order(r);
+    }
+    engine.drain();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    const size_t number_of_requests = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const size_t max_shards = argc > 2 ? std::strtoul(argv[2], nullptr, 10) :
+        std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    const size_t number_of_symbols = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 64;
+    const unsigned int seed = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 42;
+
+    std::vector<std::string> symbols;
+    for (size_t i = 0; i < number_of_symbols; ++i)
+    {
+        symbols.push_back(std::string("S") + std::to_string(i));
+    }
+    const Rules rules = create_rules(symbols);
+    const auto requests = create_requests(number_of_requests, symbols, seed);
+
+    std::cout << number_of_requests << " requests, " << number_of_symbols << " symbols, seed " << seed
+        << ", " << std::thread::hardware_concurrency() << " cores\n";
+    std::cout << std::left << std::setw(14) << "engine" << std::right << std::setw(12) << "ns/req"
+        << std::setw(14) << "req/s" << std::setw(10) << "speedup" << "\n";
+    const double single_ns = run_single(rules, requests);
+    report("single", number_of_requests, single_ns, single_ns);
+    for (size_t shards = 1; shards <= max_shards; ++shards)
+    {
+        report(std::to_string(shards) + " shards", number_of_requests,
+            run_sharded(rules, requests, shards), single_ns);
+    }
+    return 0;
+}
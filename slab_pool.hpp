@@ -0,0 +1,325 @@
+#ifndef SLAB_POOL_HPP_
+#define SLAB_POOL_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace utils
+{
+
+struct PoolOptions
+{
+    // rounded up to a power of two
+    size_t objects_per_slab = 4096;
+    // back slabs with 2MB pages - reserved ones if the OS has them, transparent ones otherwise
+    bool huge_pages = false;
+};
+
+template <typename BasicJsonType>
+void from_json(const BasicJsonType& j, PoolOptions& o)
+{
+    const PoolOptions defaults;
+    o.objects_per_slab = j.value("objects_per_slab", defaults.objects_per_slab);
+    o.huge_pages = j.value("huge_pages", defaults.huge_pages);
+}
+
+struct PoolStats
+{
+    size_t slot_size = 0;
+    size_t slabs = 0;
+    // slabs on reserved huge pages
+    size_t huge_page_slabs = 0;
+    size_t reserved_bytes = 0;
+    size_t capacity = 0;
+    size_t live = 0;
+    size_t peak = 0;
+    size_t allocations = 0;
+    size_t frees = 0;
+};
+
+// where the free list of a pool over memory it does not own stands, kept next to that memory
+struct PoolCursor
+{
+    std::uint32_t free_list;
+    std::uint32_t next_unused;
+};
+
+// Fixed size objects carved out of large slabs and recycled through a free list threaded through the
+// free slots, so allocating and freeing is a couple of loads and stores with no malloc. Slabs never
+// move: pointers stay valid until the object is freed, and objects are also named by 32-bit handles.
+// Slots are rounded up to a size class - powers of two up to a cache line, whole cache lines above -
+// so no object straddles more cache lines than it has to. Not thread safe.
+template <typename T>
+class SlabPool
+{
+    static_assert(std::is_trivially_destructible_v<T>, "Slabs are released without running destructors.");
+    static_assert(alignof(T) <= 64, "Slabs are cache line aligned.");
+
+public:
+    typedef std::uint32_t Handle;
+
+    static constexpr Handle null_handle = std::numeric_limits<Handle>::max();
+    static constexpr size_t cache_line = 64;
+    static constexpr size_t huge_page_size = size_t(1) << 21;
+
+    static constexpr size_t size_class(size_t size)
+    {
+        if (size > cache_line) return (size + cache_line - 1) / cache_line * cache_line;
+        size_t slot = sizeof(Handle);
+        while (slot < size) slot *= 2;
+        return slot;
+    }
+    static constexpr size_t slot_size = size_class(sizeof(T));
+
+    explicit SlabPool(const PoolOptions& options = PoolOptions());
+    ~SlabPool();
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    template <typename... Args>
+    Handle allocate(Args&&... args);
+    void free(Handle handle);
+    // frees every object, slabs are kept for reuse
+    void clear();
+    // Objects in one slab of memory owned by the caller, e.g. a mapped file that outlives the process,
+    // with the free list mirrored to cursor. With adopt, the objects a pool over the same memory left
+    // there are taken over, otherwise the pool starts empty. Only before the first allocate - the pool
+    // never grows past the memory.
+    void use_memory(std::byte* memory, size_t capacity, PoolCursor* cursor, bool adopt);
+    // slots handed out since the last clear - handles below it name live or freed objects
+    Handle used_slots() const { return next_unused_; }
+
+    T& operator[](Handle handle) { return *reinterpret_cast<T*>(slot(handle)); }
+    const T& operator[](Handle handle) const { return *reinterpret_cast<const T*>(slot(handle)); }
+
+    const PoolStats& stats() const { return stats_; }
+
+private:
+    struct Slab
+    {
+        std::byte* memory;
+        size_t bytes;
+        bool mapped;
+        // memory of the caller, left as it is
+        bool borrowed = false;
+    };
+
+    std::byte* slot(Handle handle) const
+    {
+        return slabs_[handle >> shift_].memory + (handle & mask_) * slot_size;
+    }
+    void add_slab();
+    void save_cursor()
+    {
+        if (cursor_) *cursor_ = PoolCursor{free_list_, next_unused_};
+    }
+    Slab allocate_slab(size_t bytes);
+    static void release_slab(const Slab& slab);
+
+    PoolOptions options_;
+    unsigned shift_ = 0;
+    Handle mask_ = 0;
+    std::vector<Slab> slabs_;
+    Handle free_list_ = null_handle;
+    // slots from here on were never handed out since the last clear
+    Handle next_unused_ = 0;
+    PoolCursor* cursor_ = nullptr;
+    PoolStats stats_;
+};
+
+template <typename T>
+SlabPool<T>::SlabPool(const PoolOptions& options)
+:
+options_(options)
+{
+    size_t objects_per_slab = std::max<size_t>(options_.objects_per_slab, 1);
+    if (options_.huge_pages)
+    {
+        // fill whole huge pages
+        objects_per_slab = std::max(objects_per_slab, huge_page_size / slot_size);
+    }
+    while ((size_t(1) << shift_) < objects_per_slab) ++shift_;
+    if (shift_ >= 31)
+    {
+        throw std::runtime_error("Too many objects per slab.");
+    }
+    mask_ = (Handle(1) << shift_) - 1;
+    stats_.slot_size = slot_size;
+}
+
+template <typename T>
+SlabPool<T>::~SlabPool()
+{
+    for (const Slab& slab : slabs_)
+    {
+        release_slab(slab);
+    }
+}
+
+template <typename T>
+template <typename... Args>
+typename SlabPool<T>::Handle SlabPool<T>::allocate(Args&&... args)
+{
+    Handle handle;
+    if (free_list_ != null_handle)
+    {
+        handle = free_list_;
+        std::memcpy(&free_list_, slot(handle), sizeof(Handle));
+    }
+    else
+    {
+        if (next_unused_ == stats_.capacity)
+        {
+            add_slab();
+        }
+        handle = next_unused_++;
+    }
+    save_cursor();
+    new (slot(handle)) T(std::forward<Args>(args)...);
+
+    ++stats_.allocations;
+    stats_.peak = std::max(stats_.peak, ++stats_.live);
+    return handle;
+}
+
+template <typename T>
+void SlabPool<T>::free(Handle handle)
+{
+    std::memcpy(slot(handle), &free_list_, sizeof(Handle));
+    free_list_ = handle;
+    save_cursor();
+    ++stats_.frees;
+    --stats_.live;
+}
+
+template <typename T>
+void SlabPool<T>::clear()
+{
+    free_list_ = null_handle;
+    next_unused_ = 0;
+    save_cursor();
+    stats_.frees += stats_.live;
+    stats_.live = 0;
+}
+
+template <typename T>
+void SlabPool<T>::use_memory(std::byte* memory, size_t capacity, PoolCursor* cursor, bool adopt)
+{
+    if (stats_.allocations > 0)
+    {
+        throw std::runtime_error("Slab pool memory can only be replaced before the first allocation.");
+    }
+    if (capacity == 0 || capacity > (size_t(1) << 31) || reinterpret_cast<std::uintptr_t>(memory) % cache_line != 0)
+    {
+        throw std::runtime_error("Slab pool memory is not usable.");
+    }
+    for (const Slab& slab : slabs_)
+    {
+        release_slab(slab);
+    }
+    // a single slab covers every handle
+    shift_ = 0;
+    while ((size_t(1) << shift_) < capacity) ++shift_;
+    mask_ = (Handle(1) << shift_) - 1;
+    slabs_.assign(1, Slab{memory, capacity * slot_size, false, true});
+    stats_.slabs = 1;
+    stats_.huge_page_slabs = 0;
+    stats_.reserved_bytes = capacity * slot_size;
+    stats_.capacity = capacity;
+    cursor_ = cursor;
+
+    if (!adopt)
+    {
+        free_list_ = null_handle;
+        next_unused_ = 0;
+        save_cursor();
+        return;
+    }
+    free_list_ = cursor_->free_list;
+    next_unused_ = cursor_->next_unused;
+    // a free list running outside the used slots or in a loop was not written by a pool
+    bool valid = next_unused_ <= capacity;
+    size_t number_of_free = 0;
+    for (Handle handle = free_list_; valid && handle != null_handle; ++number_of_free)
+    {
+        valid = handle < next_unused_ && number_of_free < next_unused_;
+        if (valid) std::memcpy(&handle, slot(handle), sizeof(Handle));
+    }
+    if (!valid)
+    {
+        throw std::runtime_error("Slab pool memory holds a broken free list.");
+    }
+    stats_.live = stats_.peak = next_unused_ - number_of_free;
+}
+
+template <typename T>
+void SlabPool<T>::add_slab()
+{
+    const size_t objects_per_slab = size_t(1) << shift_;
+    if (cursor_ || (slabs_.size() + 1) * objects_per_slab >= null_handle)
+    {
+        throw std::runtime_error("Slab pool exhausted.");
+    }
+    slabs_.push_back(allocate_slab(objects_per_slab * slot_size));
+
+    ++stats_.slabs;
+    stats_.reserved_bytes += slabs_.back().bytes;
+    stats_.capacity += objects_per_slab;
+}
+
+template <typename T>
+typename SlabPool<T>::Slab SlabPool<T>::allocate_slab(size_t bytes)
+{
+#if defined(__linux__)
+    if (options_.huge_pages)
+    {
+        const size_t mapped_bytes = (bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+        void* p = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED)
+        {
+            ++stats_.huge_page_slabs;
+            return Slab{static_cast<std::byte*>(p), mapped_bytes, true};
+        }
+        // no reserved huge pages - ask for transparent ones
+        p = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p != MAP_FAILED)
+        {
+            madvise(p, mapped_bytes, MADV_HUGEPAGE);
+            return Slab{static_cast<std::byte*>(p), mapped_bytes, true};
+        }
+    }
+#endif
+    void* p = ::operator new(bytes, std::align_val_t(cache_line));
+    return Slab{static_cast<std::byte*>(p), bytes, false};
+}
+
+template <typename T>
+void SlabPool<T>::release_slab(const Slab& slab)
+{
+    if (slab.borrowed) return;
+#if defined(__linux__)
+    if (slab.mapped)
+    {
+        munmap(slab.memory, slab.bytes);
+        return;
+    }
+#endif
+    ::operator delete(slab.memory, std::align_val_t(cache_line));
+}
+
+} // namespace utils
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef SPSC_QUEUE_HPP_
+#define SPSC_QUEUE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace utils
+{
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread. Capacity is rounded
+// up to a power of two. Each side keeps a cached copy of the other side's index so the shared cache
+// line is only read when the queue looks full (producer) or empty (consumer).
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t capacity);
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    size_t capacity() const { return slots_.size(); }
+
+    // producer side - false if the queue is full, value is left untouched then
+    bool try_push(T&& value);
+    // consumer side - false if the queue is empty
+    bool try_pop(T& value);
+
+private:
+    static constexpr size_t cache_line_size = 64;
+
+    static size_t round_up(size_t capacity);
+
+    std::vector<T> slots_;
+    size_t mask_;
+
+    // next slot to pop, written by the consumer
+    alignas(cache_line_size) std::atomic<size_t> head_{0};
+    size_t cached_tail_ = 0;
+    // next slot to push, written by the producer
+    alignas(cache_line_size) std::atomic<size_t> tail_{0};
+    size_t cached_head_ = 0;
+};
+
+template <typename T>
+size_t SpscQueue<T>::round_up(size_t capacity)
+{
+    size_t n = 1;
+    while (n < capacity) n <<= 1;
+    return n;
+}
+
+template <typename T>
+SpscQueue<T>::SpscQueue(size_t capacity)
+:
+slots_(round_up(capacity)),
+mask_(slots_.size() - 1)
+{
+}
+
+template <typename T>
+bool SpscQueue<T>::try_push(T&& value)
+{
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ == slots_.size())
+    {
+        cached_head_ = head_.load(std::memory_order_acquire);
+        if (tail - cached_head_ == slots_.size()) return false;
+    }
+    slots_[tail & mask_] = std::move(value);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+bool SpscQueue<T>::try_pop(T& value)
+{
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == cached_tail_)
+    {
+        cached_tail_ = tail_.load(std::memory_order_acquire);
+        if (head == cached_tail_) return false;
+    }
+    value = std::move(slots_[head & mask_]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+} // namespace utils
+
+#endif
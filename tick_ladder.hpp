@@ -0,0 +1,352 @@
+#ifndef TICK_LADDER_
+#define TICK_LADDER_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <type_traits>
+#include <vector>
+
+#include "level_order_book.hpp"
+#include "price4.hpp"
+#include "size_rules.hpp"
+
+namespace order
+{
+
+// Price levels stored in a flat window indexed by (price - base) / tick, with a two-level bitmap of
+// occupied slots so the best level is found with a couple of bit scans instead of a tree or heap top.
+// Prices outside the window (or off its tick grid, e.g. in another tick band) go to an ordered overflow
+// map. The window is recentred around the touch when the best price leaves it, which moves levels, so
+// level references are only valid until the next find_or_create or erase.
+// The window costs window_size * sizeof(PriceLevel) per book side - meant for liquid symbols only.
+template <typename Comparer>
+class TickLadder
+{
+public:
+    static constexpr size_t window_size = 4096;
+
+    TickLadder();
+    explicit TickLadder(const size_rules::TickSizeRulesCPtr& tick_size_rules);
+
+    bool empty() const { return summary_ == 0 && overflow_.empty(); }
+    size_t size() const;
+    size_t number_of_recentres() const { return number_of_recentres_; }
+
+    PriceLevel* best();
+    // the level has to exist
+    PriceLevel& find(const utils::Price4& price);
+    PriceLevel& find_or_create(const utils::Price4& price);
+    void erase(PriceLevel& level);
+    void clear();
+    // displayed quantity of the level, 0 without one
+    int quantity_at(const utils::Price4& price) const;
+
+    // visit levels in priority order
+    template <typename F>
+    void for_each(F f) const;
+
+private:
+    // bids keep the highest price first
+    static constexpr bool descending = std::is_same<Comparer, std::greater<utils::Price4>>::value;
+    static constexpr size_t word_bits = 64;
+    static_assert(window_size == word_bits * word_bits, "Ladder bitmap is two levels of 64-bit words.");
+
+    bool in_window(const utils::Price4& price, size_t& idx) const;
+    long find_tick(const utils::Price4& price) const;
+    PriceLevel* best_in_window();
+    void recentre(const utils::Price4& touch);
+    void move_level(PriceLevel& from, PriceLevel& to);
+    void set_occupied(size_t idx);
+    void clear_occupied(size_t idx);
+
+    size_rules::TickSizeRulesCPtr tick_size_rules_;
+    long base_ = 0;
+    // 0 until the first level is created
+    long tick_ = 0;
+    std::vector<PriceLevel> levels_;
+    std::array<std::uint64_t, word_bits> occupied_;
+    // bit i set when occupied_[i] is non-zero
+    std::uint64_t summary_ = 0;
+    std::map<utils::Price4, PriceLevel, Comparer> overflow_;
+    size_t number_of_recentres_ = 0;
+};
+
+template <typename Comparer>
+TickLadder<Comparer>::TickLadder()
+:
+levels_(window_size)
+{
+    occupied_.fill(0);
+}
+
+template <typename Comparer>
+TickLadder<Comparer>::TickLadder(const size_rules::TickSizeRulesCPtr& tick_size_rules)
+:
+tick_size_rules_(tick_size_rules),
+levels_(window_size)
+{
+    occupied_.fill(0);
+}
+
+template <typename Comparer>
+long TickLadder<Comparer>::find_tick(const utils::Price4& price) const
+{
+    if (!tick_size_rules_ || !tick_size_rules_->has_rules()) return 1;
+    try
+    {
+        const long tick = tick_size_rules_->find_size(price).unscaled();
+        return tick > 0 ? tick : 1;
+    }
+    catch (const std::exception&)
+    {
+        // price not covered by tick rules - fall back to the finest grid
+        return 1;
+    }
+}
+
+template <typename Comparer>
+bool TickLadder<Comparer>::in_window(const utils::Price4& price, size_t& idx) const
+{
+    if (tick_ == 0) return false;
+
+    const long offset = price.unscaled() - base_;
+    if (offset < 0 || offset % tick_ != 0) return false;
+
+    const long i = offset / tick_;
+    if (i >= static_cast<long>(window_size)) return false;
+
+    idx = static_cast<size_t>(i);
+    return true;
+}
+
+template <typename Comparer>
+void TickLadder<Comparer>::set_occupied(size_t idx)
+{
+    const size_t word = idx / word_bits;
+    occupied_[word] |= std::uint64_t(1) << (idx % word_bits);
+    summary_ |= std::uint64_t(1) << word;
+}
+
+template <typename Comparer>
+void TickLadder<Comparer>::clear_occupied(size_t idx)
+{
+    const size_t word = idx / word_bits;
+    occupied_[word] &= ~(std::uint64_t(1) << (idx % word_bits));
+    if (occupied_[word] == 0)
+    {
+        summary_ &= ~(std::uint64_t(1) << word);
+    }
+}
+
+template <typename Comparer>
+PriceLevel* TickLadder<Comparer>::best_in_window()
+{
+    if (summary_ == 0) return nullptr;
+
+    if (descending)
+    {
+        const size_t word = word_bits - 1 - __builtin_clzll(summary_);
+        const size_t bit = word_bits - 1 - __builtin_clzll(occupied_[word]);
+        return &levels_[word * word_bits + bit];
+    }
+    const size_t word = __builtin_ctzll(summary_);
+    const size_t bit = __builtin_ctzll(occupied_[word]);
+    return &levels_[word * word_bits + bit];
+}
+
+template <typename Comparer>
+PriceLevel* TickLadder<Comparer>::best()
+{
+    PriceLevel* in_window_best = best_in_window();
+    if (overflow_.empty()) return in_window_best;
+
+    PriceLevel* overflow_best = &overflow_.begin()->second;
+    if (!in_window_best || Comparer()(overflow_best->price, in_window_best->price))
+    {
+        return overflow_best;
+    }
+    return in_window_best;
+}
+
+template <typename Comparer>
+void TickLadder<Comparer>::move_level(PriceLevel& from, PriceLevel& to)
+{
+    // orders link to each other, not to their level - nothing else to fix up
+    to = from;
+    from = PriceLevel();
+}
+
+template <typename Comparer>
+void TickLadder<Comparer>::recentre(const utils::Price4& touch)
+{
+    // park every level of the current window in the overflow map
+    while (summary_ != 0)
+    {
+        const size_t word = __builtin_ctzll(summary_);
+        const size_t idx = word * word_bits + __builtin_ctzll(occupied_[word]);
+        PriceLevel& level = levels_[idx];
+        move_level(level, overflow_[level.price]);
+        clear_occupied(idx);
+    }
+
+    // centre the window on the touch, aligned to its tick grid
+    tick_ = find_tick(touch);
+    const long half = static_cast<long>(window_size / 2);
+    base_ = touch.unscaled() - std::min(half, touch.unscaled() / tick_) * tick_;
+    ++number_of_recentres_;
+
+    for (auto it = overflow_.begin(); it != overflow_.end();)
+    {
+        size_t idx;
+        if (!in_window(it->first, idx))
+        {
+            ++it;
+            continue;
+        }
+        move_level(it->second, levels_[idx]);
+        set_occupied(idx);
+        it = overflow_.erase(it);
+    }
+}
+
+template <typename Comparer>
+PriceLevel& TickLadder<Comparer>::find(const utils::Price4& price)
+{
+    size_t idx;
+    if (in_window(price, idx))
+    {
+        return levels_[idx];
+    }
+    const auto found = overflow_.find(price);
+    if (found == overflow_.end())
+    {
+        throw std::runtime_error("Inconsistent price levels information.");
+    }
+    return found->second;
+}
+
+template <typename Comparer>
+PriceLevel& TickLadder<Comparer>::find_or_create(const utils::Price4& price)
+{
+    size_t idx;
+    if (!in_window(price, idx))
+    {
+        const auto found = overflow_.find(price);
+        if (found != overflow_.end())
+        {
+            return found->second;
+        }
+
+        // the touch moved beyond the window (or there is no window yet) - follow it
+        const PriceLevel* curr_best = best();
+        if (!curr_best || Comparer()(price, curr_best->price))
+        {
+            recentre(price);
+        }
+    }
+
+    if (in_window(price, idx))
+    {
+        PriceLevel& level = levels_[idx];
+        if (level.empty())
+        {
+            level.price = price;
+            set_occupied(idx);
+        }
+        return level;
+    }
+
+    PriceLevel& level = overflow_[price];
+    level.price = price;
+    return level;
+}
+
+template <typename Comparer>
+void TickLadder<Comparer>::erase(PriceLevel& level)
+{
+    if (&level >= levels_.data() && &level < levels_.data() + window_size)
+    {
+        const size_t idx = static_cast<size_t>(&level - levels_.data());
+        level = PriceLevel();
+        clear_occupied(idx);
+    }
+    else if (!overflow_.erase(level.price))
+    {
+        throw std::runtime_error("Inconsistent price levels information.");
+    }
+
+    // window drained while levels remain outside it
+    if (summary_ == 0 && !overflow_.empty())
+    {
+        recentre(overflow_.begin()->first);
+    }
+}
+
+template <typename Comparer>
+size_t TickLadder<Comparer>::size() const
+{
+    size_t number_of_levels = overflow_.size();
+    for (const std::uint64_t bits : occupied_) number_of_levels += __builtin_popcountll(bits);
+    return number_of_levels;
+}
+
+template <typename Comparer>
+void TickLadder<Comparer>::clear()
+{
+    while (summary_ != 0)
+    {
+        const size_t word = __builtin_ctzll(summary_);
+        const size_t idx = word * word_bits + __builtin_ctzll(occupied_[word]);
+        levels_[idx] = PriceLevel();
+        clear_occupied(idx);
+    }
+    overflow_.clear();
+    tick_ = 0;
+}
+
+template <typename Comparer>
+int TickLadder<Comparer>::quantity_at(const utils::Price4& price) const
+{
+    size_t idx;
+    if (in_window(price, idx))
+    {
+        return levels_[idx].quantity;
+    }
+    const auto found = overflow_.find(price);
+    return found == overflow_.end() ? 0 : found->second.quantity;
+}
+
+template <typename Comparer>
+template <typename F>
+void TickLadder<Comparer>::for_each(F f) const
+{
+    // window and overflow prices can interleave across tick bands, so merge them by priority
+    std::vector<const PriceLevel*> levels;
+    for (size_t word = 0; word < word_bits; ++word)
+    {
+        for (std::uint64_t bits = occupied_[word]; bits != 0; bits &= bits - 1)
+        {
+            levels.push_back(&levels_[word * word_bits + __builtin_ctzll(bits)]);
+        }
+    }
+    for (const auto& kv : overflow_) levels.push_back(&kv.second);
+
+    std::sort(levels.begin(), levels.end(), [](const PriceLevel* a, const PriceLevel* b)
+    {
+        return Comparer()(a->price, b->price);
+    });
+    for (const PriceLevel* level : levels) f(*level);
+}
+
+typedef TickLadder<std::less<utils::Price4>> AskTickLadder;
+typedef TickLadder<std::greater<utils::Price4>> BidTickLadder;
+
+typedef LevelOrderBook<std::less<utils::Price4>, AskTickLadder> AskTickLadderOrderBook;
+typedef LevelOrderBook<std::greater<utils::Price4>, BidTickLadder> BidTickLadderOrderBook;
+
+} // namespace order
+
+#endif
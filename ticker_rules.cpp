@@ -7,13 +7,27 @@ namespace ticker_rules
 TickerRules::TickerRules(
     const std::vector<std::string>& tickers
 )
-:
-valid_symbols_(tickers.begin(), tickers.end())
-{}
+{
+    symbols_.reserve(tickers.size());
+    for (const auto& ticker : tickers)
+    {
+        // duplicated tickers keep their first id
+        if (symbol_ids_.emplace(ticker, static_cast<int>(symbols_.size())).second)
+        {
+            symbols_.push_back(ticker);
+        }
+    }
+}
+
+bool TickerRules::is_valid(std::string_view symbol) const
+{
+    return symbol_ids_.find(symbol) != symbol_ids_.end();
+}
 
-bool TickerRules::is_valid(const std::string& symbol) const
+int TickerRules::symbol_id(std::string_view symbol) const
 {
-    return valid_symbols_.count(symbol) > 0;
+    const auto found = symbol_ids_.find(symbol);
+    return found == symbol_ids_.end() ? invalid_symbol_id : found->second;
 }
 
 }
\ No newline at end of file
@@ -4,7 +4,8 @@
 #include <memory>
 #include <nlohmann/json.hpp>
 #include <string>
-#include <unordered_set>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace ticker_rules
@@ -16,13 +17,20 @@ class TickerRules;
 typedef std::shared_ptr<TickerRules> TickerRulesPtr;
 typedef std::shared_ptr<const TickerRules> TickerRulesCPtr;
 
+// valid symbols, interned into dense ids in config order
 class TickerRules
 {
 public:
+    static const int invalid_symbol_id = -1;
+
     TickerRules() = default;
     TickerRules(const std::vector<std::string>& tickers);
 
-    bool is_valid(const std::string& symbol) const;
+    bool is_valid(std::string_view symbol) const;
+    // invalid_symbol_id if the symbol is not listed
+    int symbol_id(std::string_view symbol) const;
+    const std::string& symbol(int symbol_id) const { return symbols_[symbol_id]; }
+    size_t number_of_symbols() const { return symbols_.size(); }
 
 private:
     // function for serialise
@@ -31,13 +39,21 @@ private:
     template <typename BasicJsonType>
     friend void from_json(const BasicJsonType& j, TickerRules& o);
 
-    std::unordered_set<std::string> valid_symbols_;
+    // lets string_view lookups skip building a std::string
+    struct SymbolHash
+    {
+        typedef void is_transparent;
+        size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    };
+
+    std::vector<std::string> symbols_;
+    std::unordered_map<std::string, int, SymbolHash, std::equal_to<>> symbol_ids_;
 };
 
 template <typename BasicJsonType>
 void to_json(BasicJsonType& j, const TickerRules& o)
 {
-    j = BasicJsonType(o.valid_symbols_);
+    j = BasicJsonType(o.symbols_);
 }
 
 template <typename BasicJsonType>
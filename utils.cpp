@@ -1,4 +1,8 @@
+#include <algorithm>
+#include <cerrno>
 #include <chrono>
+#include <signal.h>
+#include <sys/resource.h>
 #include "utils.hpp"
 
 namespace utils
@@ -12,4 +16,22 @@ int get_epoch_time()
     return static_cast<int>(ms.count());
 }
 
+bool process_alive(int pid)
+{
+    return pid > 0 && (::kill(pid, 0) == 0 || errno == EPERM);
+}
+
+size_t raise_open_files_limit(size_t wanted)
+{
+    rlimit limit;
+    if (::getrlimit(RLIMIT_NOFILE, &limit) != 0) return 0;
+    if (limit.rlim_cur < wanted && limit.rlim_cur != RLIM_INFINITY)
+    {
+        limit.rlim_cur = limit.rlim_max == RLIM_INFINITY ? wanted : std::min<rlim_t>(wanted, limit.rlim_max);
+        ::setrlimit(RLIMIT_NOFILE, &limit);
+        ::getrlimit(RLIMIT_NOFILE, &limit);
+    }
+    return static_cast<size_t>(limit.rlim_cur);
+}
+
 } // namespace utils
\ No newline at end of file
@@ -1,10 +1,17 @@
 #ifndef UTILS_H_
 #define UTILS_H_
 
+#include <cstddef>
+
 namespace utils
 {
 
 int get_epoch_time();
+// the process exists, e.g. the other end of a queue in shared memory
+bool process_alive(int pid);
+// raises the soft limit of open files towards wanted, as far as the hard limit allows - returns the
+// limit now in force
+size_t raise_open_files_limit(size_t wanted);
 
 } // namespace utils
 